@@ -0,0 +1,149 @@
+/*
+ * Batch stepping benchmark.
+ *
+ * Steps instances copies of a ROM a frame at a time with gbc_batch_run_frame,
+ * on 1 thread and then doubling up to one per CPU, and reports frames per
+ * second, the speedup over 1 thread and how much longer a step takes than
+ * stepping the instances one by one without a batch, divided by the threads.
+ * The framebuffers on every thread count must match those on 1 thread.
+ * Usage: batch rom [instances] [steps] [downsample] [max threads]
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include<unistd.h>
+#include"gbc.h"
+
+static double _bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint8_t *_bench_read_rom(const char *path, size_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+
+	uint8_t *rom = malloc(*size);
+	if (rom != NULL && fread(rom, 1, *size, file) != *size) {
+		free(rom);
+		rom = NULL;
+	}
+	fclose(file);
+	return rom;
+}
+
+// Different buttons for every instance and step, so they drift apart
+static void _bench_buttons(unsigned *buttons, int instances, int step)
+{
+	for (int i = 0; i < instances; i++)
+		buttons[i] = ((step / 8 + i) % 3 == 0) ? GBC_BUTTON_START | GBC_BUTTON_A : 0;
+}
+
+// 1, 2, 4 and so on, ending with the number of CPUs
+static int _bench_next_threads(int threads, int cpus)
+{
+	if (threads == cpus)
+		return cpus + 1;
+	return threads * 2 < cpus ? threads * 2 : cpus;
+}
+
+static void _bench_reset(struct gbc **gbcs, int instances)
+{
+	for (int i = 0; i < instances; i++)
+		gbc_reset(gbcs[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		printf("Usage: %s rom [instances] [steps] [downsample] [max threads]\n", argv[0]);
+		return 1;
+	}
+
+	int instances = argc > 2 ? atoi(argv[2]) : 64;
+	int steps = argc > 3 ? atoi(argv[3]) : 300;
+	int downsample = argc > 4 ? atoi(argv[4]) : 1;
+	size_t frame_size = gbc_batch_frame_size(downsample);
+	int cpus = argc > 5 ? atoi(argv[5]) : sysconf(_SC_NPROCESSORS_ONLN);
+
+	size_t rom_size;
+	uint8_t *rom = _bench_read_rom(argv[1], &rom_size);
+	if (rom == NULL || instances <= 0 || frame_size == 0 || cpus <= 0) {
+		printf("Couldn't read %s, or bad arguments\n", argv[1]);
+		return 1;
+	}
+
+	struct gbc **gbcs = malloc(instances * sizeof(*gbcs));
+	unsigned *buttons = malloc(instances * sizeof(*buttons));
+	uint8_t *frames = malloc(instances * frame_size);
+	uint8_t *expected = malloc(instances * frame_size);
+	for (int i = 0; i < instances; i++) {
+		gbcs[i] = gbc_create(rom, rom_size);
+		if (gbcs[i] == NULL) {
+			printf("Couldn't create instance %d\n", i);
+			return 1;
+		}
+	}
+
+	// One by one, without a batch
+	double start = _bench_now();
+	for (int step = 0; step < steps; step++) {
+		_bench_buttons(buttons, instances, step);
+		for (int i = 0; i < instances; i++) {
+			gbc_set_joypad(gbcs[i], buttons[i]);
+			gbc_run_frame(gbcs[i]);
+		}
+	}
+	double serial = (_bench_now() - start) / steps;
+
+	int failed = 0;
+	double single = 0;
+	printf("%d instances, %d steps, %zu bytes per frame\n",
+			instances, steps, frame_size);
+	for (int threads = 1; threads <= cpus; threads = _bench_next_threads(threads, cpus)) {
+		struct gbc_batch *batch = gbc_batch_create(threads);
+		_bench_reset(gbcs, instances);
+
+		start = _bench_now();
+		for (int step = 0; step < steps; step++) {
+			_bench_buttons(buttons, instances, step);
+			gbc_batch_run_frame(batch, gbcs, buttons, instances, frames, downsample);
+		}
+		double elapsed = _bench_now() - start;
+
+		gbc_batch_destroy(batch);
+
+		// On a single thread the batch steps the instances in order
+		if (threads == 1) {
+			memcpy(expected, frames, instances * frame_size);
+			single = elapsed;
+		} else if (memcmp(frames, expected, instances * frame_size) != 0) {
+			printf("%2d threads: MISMATCH with a single thread\n", threads);
+			failed = 1;
+		}
+		printf("%2d threads: %8.0f frames/s, %7.3f ms/step (%.1fx), "
+				"%+8.1f us/step over ideal\n",
+				threads, (double)instances * steps / elapsed,
+				elapsed * 1e3 / steps, single / elapsed,
+				(elapsed / steps - serial / threads) * 1e6);
+	}
+
+	for (int i = 0; i < instances; i++)
+		gbc_destroy(gbcs[i]);
+	free(gbcs);
+	free(buttons);
+	free(frames);
+	free(expected);
+	free(rom);
+
+	return failed;
+}
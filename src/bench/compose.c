@@ -0,0 +1,110 @@
+/*
+ * Line composition microbenchmark.
+ *
+ * Checks gpu_compose_line (SSE2 where available) against the portable
+ * gpu_compose_line_scalar used on the Pi, and gpu_compose_resolve against a
+ * plain lookup, on random planes with and without sprites_over_bg.
+ * Usage: compose [iterations]
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include"gpu_compose.h"
+#include"types.h"
+
+#define BENCH_LINES 1024
+
+static u8 g_bg[BENCH_LINES][SCREEN_WIDTH];
+static u8 g_sprites[BENCH_LINES][SCREEN_WIDTH];
+static u8 g_front[BENCH_LINES][SCREEN_WIDTH];
+static u8 g_out[BENCH_LINES][SCREEN_WIDTH];
+static u8 g_expected[BENCH_LINES][SCREEN_WIDTH];
+static pixel g_lut[GPU_COMPOSE_LUT_SIZE];
+static pixel g_pixels[SCREEN_WIDTH];
+
+typedef void (*compose_function)(const u8 *, const u8 *, const u8 *, bool, u8 *);
+
+static void _bench_compose(compose_function compose, bool sprites_over_bg)
+{
+	for (int line = 0; line < BENCH_LINES; line++)
+		compose(g_bg[line], g_sprites[line], g_front[line], sprites_over_bg,
+				g_out[line]);
+}
+
+static double _bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double _bench_time(const char *name, compose_function compose,
+		bool sprites_over_bg, int iterations, double baseline)
+{
+	double start = _bench_now();
+	for (int i = 0; i < iterations; i++)
+		_bench_compose(compose, sprites_over_bg);
+	double ns_per_line = (_bench_now() - start) * 1e9
+		/ ((double)iterations * BENCH_LINES);
+
+	printf("%-10s over_bg=%d: %6.2f ns/line", name, sprites_over_bg, ns_per_line);
+	if (baseline > 0)
+		printf("  (%.1fx)", baseline / ns_per_line);
+	printf("\n");
+	return ns_per_line;
+}
+
+static int _bench_resolve(void)
+{
+	for (int line = 0; line < BENCH_LINES; line++) {
+		gpu_compose_resolve(g_expected[line], g_lut, g_pixels);
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			if (memcmp(&g_pixels[x], &g_lut[g_expected[line][x]],
+					sizeof(pixel)) != 0) {
+				printf("resolve: MISMATCH at line %d, x %d\n", line, x);
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+	int failed = 0;
+
+	srand(0x6BC);
+	for (int line = 0; line < BENCH_LINES; line++) {
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			g_bg[line][x] = rand() & 0xFF;
+			g_sprites[line][x] = rand() & 0xFF;
+			g_front[line][x] = rand() & 0xFF;
+		}
+	}
+	for (int i = 0; i < GPU_COMPOSE_LUT_SIZE; i++) {
+		colour c = { rand() & 0xFF, rand() & 0xFF, rand() & 0xFF, rand() & 1 };
+		g_lut[i] = display_pixel(c);
+	}
+
+	for (int over_bg = 0; over_bg < 2; over_bg++) {
+		_bench_compose(gpu_compose_line_scalar, over_bg);
+		memcpy(g_expected, g_out, sizeof(g_out));
+
+		memset(g_out, 0xFF, sizeof(g_out));
+		_bench_compose(gpu_compose_line, over_bg);
+		if (memcmp(g_out, g_expected, sizeof(g_out)) != 0) {
+			printf("%-10s over_bg=%d: MISMATCH\n", "line", over_bg);
+			failed = 1;
+			continue;
+		}
+		failed |= _bench_resolve();
+
+		double baseline = _bench_time("scalar", gpu_compose_line_scalar, over_bg,
+				iterations, 0);
+		_bench_time("line", gpu_compose_line, over_bg, iterations, baseline);
+	}
+
+	return failed;
+}
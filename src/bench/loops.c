@@ -0,0 +1,111 @@
+/*
+ * Native loop benchmark.
+ *
+ * Builds a ROM that keeps running the copy and fill loops recognised by the
+ * CPU (16 bit copies to WRAM and VRAM, a 16 bit fill, 8 bit copy and fill)
+ * with the V-blank interrupt enabled, and runs it with the fast core and
+ * with the reference interpreter. Reports frames per second of both and the
+ * speedup. The emulated state after every run must be the same on both.
+ * Built with CPU_LOCKSTEP for the reference interpreter (make bench).
+ * Usage: loops [frames]
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include"cpu.h"
+#include"gbc.h"
+
+#define BENCH_ROM_SIZE  0x8000
+#define BENCH_CODE      0x0150
+#define BENCH_DATA      0x1000
+
+static u8 g_rom[BENCH_ROM_SIZE];
+
+static const u8 g_program[] = {
+	0x3E, 0x01, 0xE0, 0xFF,                     // LD A,0x01 / LDH (IE),A
+	0xFB,                                       // EI
+	// loop: 16 bit copy of 4 KiB from ROM to WRAM
+	0x21, 0x00, 0x10, 0x11, 0x00, 0xC0, 0x01, 0x00, 0x10,
+	0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8,
+	// 16 bit copy of 2 KiB from ROM to the tiles in VRAM
+	0x21, 0x00, 0x10, 0x11, 0x00, 0x80, 0x01, 0x00, 0x08,
+	0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8,
+	// 16 bit fill of 4 KiB of WRAM
+	0x21, 0x00, 0xD0, 0x01, 0x00, 0x10,
+	0x3E, 0x00, 0x22, 0x0B, 0x78, 0xB1, 0x20, 0xF8,
+	// 8 bit copy of 256 bytes
+	0x21, 0x00, 0x11, 0x11, 0x00, 0xC0, 0x06, 0x00,
+	0x2A, 0x12, 0x13, 0x05, 0x20, 0xFA,
+	// 8 bit fill of 256 bytes
+	0x21, 0x00, 0xD0, 0x06, 0x00, 0x3E, 0x55,
+	0x22, 0x05, 0x20, 0xFC,
+	0xC3, 0x55, 0x01,                           // JP loop
+};
+
+static double _bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _bench_build_rom(void)
+{
+	srand(0x6BC);
+	for (int i = 0; i < 0x1000; i++)
+		g_rom[BENCH_DATA + i] = rand() & 0xFF;
+
+	g_rom[0x0040] = 0xD9;                       // RETI
+	memcpy(g_rom + 0x0100, (const u8[]){ 0x00, 0xC3, 0x50, 0x01 }, 4);
+	memcpy(g_rom + BENCH_CODE, g_program, sizeof(g_program));
+}
+
+// Frames per second, the state after the run is left in state
+static double _bench_run(bool reference, int frames, u8 **state, size_t *size)
+{
+	struct gbc *gbc = gbc_create(g_rom, sizeof(g_rom));
+	if (gbc == NULL)
+		return 0;
+	cpu_set_reference(reference);
+
+	double start = _bench_now();
+	for (int i = 0; i < frames; i++)
+		gbc_run_frame(gbc);
+	double elapsed = _bench_now() - start;
+
+	*size = gbc_state_size(gbc);
+	*state = malloc(*size);
+	if (*state != NULL)
+		gbc_state_save(gbc, *state);
+	gbc_destroy(gbc);
+
+	return frames / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 2000;
+	u8 *fast_state, *reference_state;
+	size_t fast_size, reference_size;
+
+	gbc_set_quiet(true);
+	_bench_build_rom();
+
+	double reference = _bench_run(true, frames, &reference_state, &reference_size);
+	double fast = _bench_run(false, frames, &fast_state, &fast_size);
+	if (reference == 0 || fast == 0 || fast_state == NULL || reference_state == NULL) {
+		printf("Couldn't run the ROM\n");
+		return 1;
+	}
+
+	printf("reference %8.1f frames/s\n", reference);
+	printf("fast      %8.1f frames/s  (%.2fx)\n", fast, fast / reference);
+
+	if (fast_size != reference_size
+			|| memcmp(fast_state, reference_state, fast_size) != 0) {
+		printf("state after %d frames: MISMATCH\n", frames);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Upscaler benchmark.
+ *
+ * Scales a synthetic frame with every filter, on the calling thread alone
+ * and with the worker pool, and reports milliseconds per frame. The Scale2x
+ * output is checked against a plain reference implementation first.
+ * Build with CFLAGS=-DDISPLAY_RGB565 to measure 16 bit texels.
+ * Usage: scale [iterations]
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include"scale.h"
+#include"types.h"
+
+#define BENCH_PITCH  (SCREEN_WIDTH * SCALE_MAX_FACTOR * (int) sizeof(texel))
+
+static texel g_frame[SCREEN_HEIGHT * SCREEN_WIDTH];
+static texel g_out[SCREEN_HEIGHT * SCALE_MAX_FACTOR][SCREEN_WIDTH * SCALE_MAX_FACTOR];
+static texel g_expected[SCREEN_HEIGHT * 2][SCREEN_WIDTH * SCALE_MAX_FACTOR];
+
+static const char *g_filter_names[] = { "scale2x", "scale3x", "xbr" };
+
+static texel _bench_pixel(int x, int y)
+{
+	return g_frame[MIN(MAX(y, 0), SCREEN_HEIGHT - 1) * SCREEN_WIDTH
+		+ MIN(MAX(x, 0), SCREEN_WIDTH - 1)];
+}
+
+// Scale2x as usually written, one pixel at a time
+static void _bench_reference_scale2x(void)
+{
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			texel b = _bench_pixel(x, y - 1), h = _bench_pixel(x, y + 1);
+			texel d = _bench_pixel(x - 1, y), f = _bench_pixel(x + 1, y);
+			texel e = _bench_pixel(x, y);
+			texel *out0 = &g_expected[2 * y][2 * x];
+			texel *out1 = &g_expected[2 * y + 1][2 * x];
+
+			out0[0] = out0[1] = out1[0] = out1[1] = e;
+			if (b != h && d != f) {
+				if (d == b) out0[0] = d;
+				if (b == f) out0[1] = f;
+				if (d == h) out1[0] = d;
+				if (h == f) out1[1] = f;
+			}
+		}
+	}
+}
+
+// Tiles of a few colours with diagonal lines, a rough stand-in for a game
+static void _bench_fill_frame(void)
+{
+	const texel palette[4] = {
+		(texel) 0xFFFFFFFF, (texel) 0xFFAAAAAA, (texel) 0xFF555555, (texel) 0xFF000000
+	};
+
+	srand(0x5CA1E);
+	for (int ty = 0; ty < SCREEN_HEIGHT; ty += 8) {
+		for (int tx = 0; tx < SCREEN_WIDTH; tx += 8) {
+			int background = rand() % 4, line = rand() % 4, slope = rand() % 3;
+			for (int y = 0; y < 8; y++)
+				for (int x = 0; x < 8; x++)
+					g_frame[(ty + y) * SCREEN_WIDTH + tx + x] =
+						palette[(x == (y * slope) % 8) ? line : background];
+		}
+	}
+}
+
+static double _bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double _bench_run(const char *filter, int workers, int iterations,
+		int *factor)
+{
+	scale_prepare(filter, workers);
+	*factor = scale_factor();
+
+	double start = _bench_now();
+	for (int i = 0; i < iterations; i++)
+		scale_frame(g_frame, 0, SCREEN_HEIGHT - 1, g_out, BENCH_PITCH);
+	double elapsed = _bench_now() - start;
+
+	scale_destroy();
+	return elapsed * 1e3 / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+	int failed = 0;
+
+	_bench_fill_frame();
+
+	_bench_reference_scale2x();
+	scale_prepare("scale2x", 0);
+	scale_frame(g_frame, 0, SCREEN_HEIGHT - 1, g_out, BENCH_PITCH);
+	scale_destroy();
+	for (int y = 0; y < SCREEN_HEIGHT * 2; y++) {
+		if (memcmp(g_out[y], g_expected[y], SCREEN_WIDTH * 2 * sizeof(texel))) {
+			printf("scale2x: MISMATCH on line %d\n", y);
+			failed = 1;
+			break;
+		}
+	}
+
+	printf("%d bit texels\n", (int) sizeof(texel) * 8);
+	for (size_t i = 0; i < sizeof(g_filter_names) / sizeof(g_filter_names[0]); i++) {
+		int factor;
+		double single = _bench_run(g_filter_names[i], 0, iterations, &factor);
+		double pooled = _bench_run(g_filter_names[i], SCALE_WORKERS_AUTO,
+				iterations, &factor);
+		printf("%-8s %dx: %6.3f ms/frame, %6.3f ms/frame with workers  (%.1fx)\n",
+				g_filter_names[i], factor, single, pooled,
+				single / pooled);
+	}
+
+	return failed;
+}
@@ -0,0 +1,112 @@
+/*
+ * Tile decode microbenchmark.
+ *
+ * Compares the original bit-by-bit row conversion against gpu_tile_decode_row
+ * and whole-tile gpu_tile_decode, for both normal and flipped rows.
+ * Usage: tile_decode [iterations]
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include"gpu_tile.h"
+#include"types.h"
+
+#define BENCH_TILES      384
+#define BENCH_DATA_SIZE  (BENCH_TILES * GPU_TILE_BYTES)
+#define BENCH_OUT_SIZE   (BENCH_TILES * GPU_TILE_ROWS * 8)
+
+static u8 g_data[BENCH_DATA_SIZE];
+static u8 g_out[BENCH_OUT_SIZE];
+static u8 g_expected[BENCH_OUT_SIZE];
+
+// Conversion loop as used by the GPU before the kernel was introduced
+static void _bench_reference_row(u8 lower, u8 upper, bool flip_x, u8 dst[8])
+{
+	u8 current_index;
+	for(u8 i = 0; i < 8; i++)
+	{
+		current_index = !flip_x ? 7 - i : i;
+		dst[i] = (BV(upper, current_index) << 1) | BV(lower, current_index);
+	}
+}
+
+static void _bench_reference(bool flip_x)
+{
+	for (int row = 0; row < BENCH_TILES * GPU_TILE_ROWS; row++)
+		_bench_reference_row(g_data[row * 2], g_data[row * 2 + 1], flip_x,
+				g_out + row * 8);
+}
+
+static void _bench_row(bool flip_x)
+{
+	for (int row = 0; row < BENCH_TILES * GPU_TILE_ROWS; row++)
+		gpu_tile_decode_row(g_data[row * 2], g_data[row * 2 + 1], flip_x,
+				g_out + row * 8);
+}
+
+static void _bench_tile(bool flip_x)
+{
+	for (int tile = 0; tile < BENCH_TILES; tile++)
+		gpu_tile_decode(g_data + tile * GPU_TILE_BYTES, GPU_TILE_ROWS, flip_x,
+				g_out + tile * GPU_TILE_ROWS * 8);
+}
+
+static double _bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int _bench_run(const char *name, void (*decode)(bool), bool flip_x,
+		int iterations, double baseline)
+{
+	memset(g_out, 0xFF, sizeof(g_out));
+	decode(flip_x);
+	if (memcmp(g_out, g_expected, sizeof(g_out)) != 0) {
+		printf("%-10s flip=%d: MISMATCH\n", name, flip_x);
+		return 1;
+	}
+
+	double start = _bench_now();
+	for (int i = 0; i < iterations; i++)
+		decode(flip_x);
+	double elapsed = _bench_now() - start;
+
+	double ns_per_row = elapsed * 1e9
+		/ ((double)iterations * BENCH_TILES * GPU_TILE_ROWS);
+	printf("%-10s flip=%d: %6.2f ns/row", name, flip_x, ns_per_row);
+	if (baseline > 0)
+		printf("  (%.1fx)", baseline / ns_per_row);
+	printf("\n");
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+	int failed = 0;
+
+	srand(0x6BC);
+	for (int i = 0; i < BENCH_DATA_SIZE; i++)
+		g_data[i] = rand() & 0xFF;
+
+	for (int flip_x = 0; flip_x < 2; flip_x++) {
+		_bench_reference(flip_x);
+		memcpy(g_expected, g_out, sizeof(g_out));
+
+		double start = _bench_now();
+		for (int i = 0; i < iterations; i++)
+			_bench_reference(flip_x);
+		double baseline = (_bench_now() - start) * 1e9
+			/ ((double)iterations * BENCH_TILES * GPU_TILE_ROWS);
+		printf("%-10s flip=%d: %6.2f ns/row\n", "reference", flip_x, baseline);
+
+		failed |= _bench_run("row", _bench_row, flip_x, iterations, baseline);
+		failed |= _bench_run("tile", _bench_tile, flip_x, iterations, baseline);
+	}
+
+	return failed;
+}
@@ -0,0 +1,269 @@
+#include<pthread.h>
+#include<semaphore.h>
+#include<stdatomic.h>
+#include<stdio.h>
+#include<string.h>
+#include<time.h>
+#include"capture.h"
+#include"logger.h"
+
+/*
+ * Frames are copied into a preallocated pool and handed to a writer thread
+ * through a single producer, single consumer ring, the producer being the
+ * renderer. Conversion to the output format and all I/O happen on the writer
+ * thread.
+ */
+
+#define CAPTURE_POOL_FRAMES  32
+#define CAPTURE_LINE_BITMAP  ((SCREEN_HEIGHT + 7) / 8)
+#define CAPTURE_FRAME_BYTES  (SCREEN_WIDTH * SCREEN_HEIGHT * 3)
+
+enum capture_format {
+	FORMAT_Y4M,
+	FORMAT_RGB,
+	FORMAT_RGB565
+};
+
+static const struct {
+	const char          *name;
+	enum capture_format  format;
+	bool                 diff;
+} g_formats[] = {
+	{ "y4m",         FORMAT_Y4M,    false },
+	{ "rgb",         FORMAT_RGB,    false },
+	{ "rgb565",      FORMAT_RGB565, false },
+	{ "rgb-diff",    FORMAT_RGB,    true  },
+	{ "rgb565-diff", FORMAT_RGB565, true  },
+};
+
+static FILE               *g_output    = NULL;
+static enum capture_format g_format;
+static bool                g_diff;
+
+static pixel             g_pool[CAPTURE_POOL_FRAMES][SCREEN_HEIGHT][SCREEN_WIDTH];
+static _Atomic uint32_t  g_head        = 0;
+static _Atomic uint32_t  g_tail        = 0;
+static _Atomic bool      g_stop        = false;
+static pthread_t         g_writer;
+static sem_t             g_not_empty;
+
+// Writer side state
+static u8                g_line[SCREEN_WIDTH * 3];
+static u8                g_previous[SCREEN_HEIGHT][SCREEN_WIDTH * 3];
+static bool              g_has_previous = false;
+
+static unsigned long     g_frames_queued    = 0;
+static unsigned long     g_frames_dropped   = 0;
+static uint32_t          g_high_water       = 0;
+static unsigned long     g_bytes_written    = 0;
+static struct timespec   g_start;
+
+
+static void _capture_write(const void *data, size_t length)
+{
+	if (fwrite(data, 1, length, g_output) == length)
+		g_bytes_written += length;
+}
+
+
+static int _capture_convert_line(const pixel line[SCREEN_WIDTH], u8 dst[])
+{
+	u8 *ptr = dst;
+
+	if (g_format == FORMAT_RGB565) {
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			colour c = display_pixel_colour(line[x]);
+			u16 rgb565 = ((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3);
+			*ptr++ = rgb565 & 0xFF;
+			*ptr++ = rgb565 >> 8;
+		}
+	} else {
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			colour c = display_pixel_colour(line[x]);
+			*ptr++ = c.r;
+			*ptr++ = c.g;
+			*ptr++ = c.b;
+		}
+	}
+
+	return ptr - dst;
+}
+
+
+// BT.601 limited range, one full resolution plane at a time
+static void _capture_write_y4m(pixel frame[SCREEN_HEIGHT][SCREEN_WIDTH])
+{
+	static u8 planes[3][SCREEN_HEIGHT * SCREEN_WIDTH];
+	u8 *y_plane = planes[0], *u_plane = planes[1], *v_plane = planes[2];
+
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			colour c = display_pixel_colour(frame[y][x]);
+			int r = c.r, g = c.g, b = c.b;
+			*y_plane++ = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+			*u_plane++ = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+			*v_plane++ = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+		}
+	}
+
+	_capture_write("FRAME\n", 6);
+	_capture_write(planes, sizeof(planes));
+}
+
+
+static void _capture_write_raw(pixel frame[SCREEN_HEIGHT][SCREEN_WIDTH])
+{
+	u8 changed[CAPTURE_LINE_BITMAP] = {0};
+	int length = 0;
+
+	if (!g_diff) {
+		for (int y = 0; y < SCREEN_HEIGHT; y++) {
+			length = _capture_convert_line(frame[y], g_line);
+			_capture_write(g_line, length);
+		}
+		return;
+	}
+
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		length = _capture_convert_line(frame[y], g_line);
+		if (!g_has_previous || memcmp(g_previous[y], g_line, length) != 0) {
+			memcpy(g_previous[y], g_line, length);
+			changed[y / 8] |= 1 << (y % 8);
+		}
+	}
+	g_has_previous = true;
+
+	_capture_write(changed, sizeof(changed));
+	for (int y = 0; y < SCREEN_HEIGHT; y++)
+		if (changed[y / 8] & (1 << (y % 8)))
+			_capture_write(g_previous[y], length);
+}
+
+
+static void *_capture_writer(__attribute__((unused)) void *arg)
+{
+	uint32_t tail = 0;
+
+	while (true) {
+		sem_wait(&g_not_empty);
+		if (tail == atomic_load_explicit(&g_head, memory_order_acquire)) {
+			if (atomic_load(&g_stop))
+				break;
+			continue;
+		}
+
+		pixel (*frame)[SCREEN_WIDTH] = g_pool[tail % CAPTURE_POOL_FRAMES];
+		if (g_format == FORMAT_Y4M)
+			_capture_write_y4m(frame);
+		else
+			_capture_write_raw(frame);
+
+		atomic_store_explicit(&g_tail, ++tail, memory_order_release);
+	}
+
+	fflush(g_output);
+	return NULL;
+}
+
+
+/* Start capturing to path (a file or a named pipe) in the given format,
+ * see capture.h.
+ */
+bool capture_prepare(const char *path, const char *format)
+{
+	size_t i;
+	for (i = 0; i < sizeof(g_formats) / sizeof(g_formats[0]); i++)
+		if (strcmp(format, g_formats[i].name) == 0)
+			break;
+
+	if (i == sizeof(g_formats) / sizeof(g_formats[0])) {
+		logger_print(LOG_WARN, "CAPTURE: unknown format %s.\n", format);
+		return false;
+	}
+	g_format = g_formats[i].format;
+	g_diff = g_formats[i].diff;
+
+	g_output = fopen(path, "wb");
+	if (g_output == NULL) {
+		logger_print(LOG_WARN, "CAPTURE: couldn't open %s.\n", path);
+		return false;
+	}
+
+	// Game Boy frame rate: 4194304 Hz / 70224 clocks per frame
+	if (g_format == FORMAT_Y4M)
+		fprintf(g_output, "YUV4MPEG2 W%d H%d F4194304:70224 Ip A1:1 C444\n",
+				SCREEN_WIDTH, SCREEN_HEIGHT);
+
+	sem_init(&g_not_empty, 0, 0);
+	int error_code = pthread_create(&g_writer, NULL, _capture_writer, NULL);
+	if (error_code != 0) {
+		logger_print(LOG_WARN,
+				"CAPTURE: writer thread could not be created (%d).\n",
+				error_code);
+		fclose(g_output);
+		g_output = NULL;
+		return false;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &g_start);
+	logger_print(LOG_INFO, "Capturing %s to %s.\n", format, path);
+	return true;
+}
+
+
+bool capture_is_active(void)
+{
+	return g_output != NULL;
+}
+
+
+void capture_frame(pixel screen[SCREEN_HEIGHT][SCREEN_WIDTH])
+{
+	if (g_output == NULL)
+		return;
+
+	uint32_t head = atomic_load_explicit(&g_head, memory_order_relaxed);
+	uint32_t depth = head - atomic_load_explicit(&g_tail, memory_order_acquire);
+	if (depth == CAPTURE_POOL_FRAMES) {
+		g_frames_dropped++;
+		return;
+	}
+
+	memcpy(g_pool[head % CAPTURE_POOL_FRAMES], screen,
+			sizeof(g_pool[0]));
+	atomic_store_explicit(&g_head, head + 1, memory_order_release);
+	sem_post(&g_not_empty);
+
+	g_frames_queued++;
+	g_high_water = MAX(g_high_water, depth + 1);
+}
+
+
+void capture_destroy(void)
+{
+	if (g_output == NULL)
+		return;
+
+	atomic_store(&g_stop, true);
+	sem_post(&g_not_empty);
+	pthread_join(g_writer, NULL);
+	fclose(g_output);
+	g_output = NULL;
+	sem_destroy(&g_not_empty);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double elapsed = (now.tv_sec - g_start.tv_sec)
+		+ (now.tv_nsec - g_start.tv_nsec) * 1e-9;
+
+	logger_print(
+		LOG_INFO,
+		"Capture: %lu frames written, %lu dropped, %.1f KiB/s, "
+		"queue high-water mark %u/%d.\n",
+		g_frames_queued,
+		g_frames_dropped,
+		elapsed > 0 ? g_bytes_written / 1024.0 / elapsed : 0.0,
+		g_high_water,
+		CAPTURE_POOL_FRAMES
+	);
+}
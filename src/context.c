@@ -0,0 +1,51 @@
+#include<stdlib.h>
+#include"context_priv.h"
+#include"logger.h"
+#include"state.h"
+
+_Thread_local struct gb_context *g_context = NULL;
+
+
+struct gb_context *context_create(void)
+{
+	struct gb_context *context = calloc(1, sizeof(*context));
+	if (context == NULL) {
+		logger_print(LOG_FATAL, "CONTEXT: couldn't allocate a context.\n");
+		return NULL;
+	}
+
+	g_context = context;
+	if (!state_prepare()) {
+		free(context);
+		g_context = NULL;
+		return NULL;
+	}
+
+	return context;
+}
+
+
+void context_destroy(struct gb_context *context)
+{
+	if (context == NULL)
+		return;
+
+	struct gb_context *previous = g_context;
+	g_context = context;
+	state_destroy();
+	g_context = previous == context ? NULL : previous;
+
+	free(context);
+}
+
+
+void context_set_current(struct gb_context *context)
+{
+	g_context = context;
+}
+
+
+struct gb_context *context_get_current(void)
+{
+	return g_context;
+}
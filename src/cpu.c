@@ -1,9 +1,22 @@
+#include<limits.h>
+#include<pthread.h>
+#ifdef CPU_OPCODE_PROFILE
+#include<signal.h>
+#include<stdio.h>
+#endif
+#include<stddef.h>
+#include<stdlib.h>
+#include"context_priv.h"
 #include"cpu.h"
 #include"debug.h"
+#include"gpu.h"
 #include"ints.h"
 #include"mem.h"
 #include"mem_priv.h"
 #include"regs.h"
+#include"serial.h"
+#include"state.h"
+#include"timer.h"
 
 #define INSTRUCTIONS_NUMBER 256
 
@@ -27,34 +40,94 @@
 
 #define SPEED_SWITCH_ADDR 0xFF4D
 
+#define CPU_PAIR_PROFILE_TOP 32
+
 typedef int (*cpu_instruction_t)(void);
 
 static cpu_instruction_t g_instruction_table[INSTRUCTIONS_NUMBER];
 static cpu_instruction_t g_cb_prefix_instruction_table[INSTRUCTIONS_NUMBER];
 
-static struct cpu_registers g_registers;
+// Handlers executing an instruction together with the one following it.
+// NULL entries are dispatched through g_instruction_table only.
+static cpu_instruction_t g_fused_instruction_table[INSTRUCTIONS_NUMBER];
+
+#ifdef CPU_PAIR_PROFILE
+static uint64_t g_pair_counts[INSTRUCTIONS_NUMBER][INSTRUCTIONS_NUMBER];
+static int g_pair_previous = -1;
+#endif
+
+#ifdef CPU_OPCODE_PROFILE
+// Indexed by [CB prefixed][opcode], printed at exit and on SIGUSR2
+static uint64_t g_opcode_counts[2][INSTRUCTIONS_NUMBER];
+static uint64_t g_opcode_cycles[2][INSTRUCTIONS_NUMBER];
+static uint64_t g_opcode_taken[INSTRUCTIONS_NUMBER];
+static volatile sig_atomic_t g_opcode_profile_requested;
+
+// Cycles of the conditional branches when not taken, 0 for the rest
+static const int g_branch_not_taken_cycles[INSTRUCTIONS_NUMBER] = {
+	[0x20] = 8,  [0x28] = 8,  [0x30] = 8,  [0x38] = 8,  // JR cc
+	[0xC2] = 12, [0xCA] = 12, [0xD2] = 12, [0xDA] = 12, // JP cc
+	[0xC4] = 12, [0xCC] = 12, [0xD4] = 12, [0xDC] = 12, // CALL cc
+	[0xC0] = 8,  [0xC8] = 8,  [0xD0] = 8,  [0xD8] = 8,  // RET cc
+};
+#endif
 
-// cpu state
-static bool g_cpu_halted = 0;
-static bool g_cpu_stopped = 0;
+struct cpu_context {
+	struct cpu_registers registers;
+
+	// cpu state
+	bool halted;
+	bool stopped;
+
+	// cpu speed state
+	bool double_speed;
+	bool speed_switch;
+
+	// cpu ime delay
+	int ime_delay;
+	int ime_op;
+
+#ifdef CPU_LOCKSTEP
+	// Only the plain instruction handlers, for the lockstep tester
+	bool reference;
+#endif
 
-// cpu speed state
-static bool g_double_speed = false;
-static bool g_speed_switch = false;
+	// Not part of the state
+	const struct cpu_call_hooks *call_hooks;
+	// _cpu_cycles_until_event(), counted down by every instruction,
+	// negative once it has to be worked out again
+	int event_cycles;
+};
 
-// cpu ime delay
-static int g_ime_delay = 0;
-static int g_ime_op = IME_OP_DI;
+// State of the current context
+#define g_cpu (g_context->cpu)
+
+
+static inline void _cpu_notify_call(void)
+{
+	if (g_cpu->call_hooks != NULL)
+		g_cpu->call_hooks->call(g_cpu->registers.PC, g_cpu->registers.SP);
+}
+
+static inline void _cpu_notify_ret(void)
+{
+	if (g_cpu->call_hooks != NULL)
+		g_cpu->call_hooks->ret(g_cpu->registers.SP);
+}
 
 
 bool cpu_is_double_speed() {
-	return g_double_speed;
+	return g_cpu->double_speed;
 }
 
 
 struct cpu_registers cpu_register_get()
 {
-	return g_registers;
+	// Also called from threads with no context, or before the CPU is ready
+	if (g_context == NULL || g_cpu == NULL)
+		return (struct cpu_registers) {0};
+
+	return g_cpu->registers;
 }
 
 static u8 _cpu_double_speed_read_handler(a16 addr)
@@ -62,7 +135,7 @@ static u8 _cpu_double_speed_read_handler(a16 addr)
 	if (addr != SPEED_SWITCH_ADDR)
 		return 0;
 
-	return (g_double_speed ? 0x80 : 0x00) | (g_speed_switch ? 0x01 : 0x00);
+	return (g_cpu->double_speed ? 0x80 : 0x00) | (g_cpu->speed_switch ? 0x01 : 0x00);
 }
 
 static void _cpu_double_speed_write_handler(a16 addr, u8 data)
@@ -70,13 +143,13 @@ static void _cpu_double_speed_write_handler(a16 addr, u8 data)
 	if (addr != SPEED_SWITCH_ADDR)
 		return;
 
-	g_speed_switch = (data & 0x01) == 1;
+	g_cpu->speed_switch = (data & 0x01) == 1;
 }
 
 static int _cpu_not_implemented(void)
 {
 	// This  way of accessing memory is temporary
-	d8 instruction_code = mem_read8(g_registers.PC);
+	d8 instruction_code = mem_read8(g_cpu->registers.PC);
 	logger_log(
 		LOG_FATAL,
 		"UNKOWN INSTRUCTION",
@@ -93,48 +166,50 @@ static int _cpu_not_implemented(void)
 
 static int _cpu_nop(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	return 4;
 }
 
 static int _cpu_stop(void)
 {
-	if (g_speed_switch)
-		g_double_speed = !g_double_speed;
-	else
-		g_cpu_stopped = 1;
+	if (g_cpu->speed_switch) {
+		g_cpu->double_speed = !g_cpu->double_speed;
+		cpu_events_changed();
+	} else
+		g_cpu->stopped = 1;
 
-	g_registers.PC += 2;
+	g_cpu->registers.PC += 2;
 	return 4;
 }
 
 static int _cpu_halt(void)
 {
-	g_cpu_halted = 1;
-	g_registers.PC += 1;
+	g_cpu->halted = 1;
+	g_cpu->registers.PC += 1;
 	return 4;
 }
 
 static int _cpu_prefix_cb(void)
 {
-	g_registers.PC += 1;
-	d8 opcode = mem_read8(g_registers.PC);
+	g_cpu->registers.PC += 1;
+	d8 opcode = mem_read8(g_cpu->registers.PC);
 	return g_cb_prefix_instruction_table[opcode]();
 }
 
 static int _cpu_di(void)
 {
-	g_ime_delay = 2;
-	g_ime_op = IME_OP_DI;
-	g_registers.PC += 1;
+	g_cpu->ime_delay = 2;
+	g_cpu->ime_op = IME_OP_DI;
+	g_cpu->event_cycles = -1;
+	g_cpu->registers.PC += 1;
 	return 4;
 }
 
 static int _cpu_ei(void)
 {
-	g_ime_delay = 2;
-	g_ime_op = IME_OP_EI;
-	g_registers.PC += 1;
+	g_cpu->ime_delay = 2;
+	g_cpu->ime_op = IME_OP_EI;
+	g_cpu->registers.PC += 1;
 	return 4;
 }
 
@@ -144,58 +219,58 @@ static int _cpu_ei(void)
 //========================================
 static int _cpu_ld_imm_bc_a(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.BC;
-	mem_write8(address, g_registers.A);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.BC;
+	mem_write8(address, g_cpu->registers.A);
 	return 8;
 }
 
 static int _cpu_ld_imm_de_a(void){
-	g_registers.PC += 1;
-	a16 address = g_registers.DE;
-	mem_write8(address, g_registers.A);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.DE;
+	mem_write8(address, g_cpu->registers.A);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_inc_a(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL++;
-	mem_write8(address, g_registers.A);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL++;
+	mem_write8(address, g_cpu->registers.A);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_dec_a(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL--;
-	mem_write8(address, g_registers.A);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL--;
+	mem_write8(address, g_cpu->registers.A);
 	return 8;
 }
 
 static int _cpu_ldh_imm_a8_a(void)
 {
-	g_registers.PC += 1;
-	a16 address = (a16)mem_read8(g_registers.PC) + 0xFF00;
-	g_registers.PC += 1;
-	mem_write8(address, g_registers.A);
+	g_cpu->registers.PC += 1;
+	a16 address = (a16)mem_read8(g_cpu->registers.PC) + 0xFF00;
+	g_cpu->registers.PC += 1;
+	mem_write8(address, g_cpu->registers.A);
 	return 12;
 }
 
 static int _cpu_ld_imm_a16_a(void)
 {
-	g_registers.PC += 1;
-	a16 address = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	mem_write8(address, g_registers.A);
+	g_cpu->registers.PC += 1;
+	a16 address = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	mem_write8(address, g_cpu->registers.A);
 	return 16;
 }
 
 static int _cpu_ld_imm_c_a(void)
 {
-	g_registers.PC += 1;
-	a16 address = (a16)g_registers.C + 0xFF00;
-	mem_write8(address, g_registers.A);
+	g_cpu->registers.PC += 1;
+	a16 address = (a16)g_cpu->registers.C + 0xFF00;
+	mem_write8(address, g_cpu->registers.A);
 	return 8;
 }
 
@@ -203,59 +278,59 @@ static int _cpu_ld_imm_c_a(void)
 //========================================
 static int _cpu_ld_a_imm_bc(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.BC;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.BC;
+	g_cpu->registers.A = mem_read8(address);
 	return 8;
 }
 
 static int _cpu_ld_a_imm_de(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.DE;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.DE;
+	g_cpu->registers.A = mem_read8(address);
 	return 8;
 }
 
 static int _cpu_ld_a_imm_hl_inc(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL++;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL++;
+	g_cpu->registers.A = mem_read8(address);
 	return 8;
 }
 
 static int _cpu_ld_a_imm_hl_dec(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL--;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL--;
+	g_cpu->registers.A = mem_read8(address);
 	return 8;
 }
 
 static int _cpu_ldh_a_imm_a8(void)
 {
-	g_registers.PC += 1;
-	a16 address = (a16)mem_read8(g_registers.PC) + 0xFF00;
-	g_registers.PC += 1;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = (a16)mem_read8(g_cpu->registers.PC) + 0xFF00;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = mem_read8(address);
 	return 12;
 }
 
 static int _cpu_ld_a_imm_a16(void)
 {
-	g_registers.PC += 1;
-	a16 address = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	g_cpu->registers.A = mem_read8(address);
 	return 16;
 }
 
 static int _cpu_ld_a_imm_c(void)
 {
-	g_registers.PC += 1;
-	a16 address = (a16)g_registers.C + 0xFF00;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = (a16)g_cpu->registers.C + 0xFF00;
+	g_cpu->registers.A = mem_read8(address);
 	return 8;
 }
 
@@ -263,66 +338,66 @@ static int _cpu_ld_a_imm_c(void)
 //========================================
 static int _cpu_ld_a_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	return 8;
 }
 
 static int _cpu_ld_b_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.B = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	return 8;
 }
 
 static int _cpu_ld_c_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	return 8;
 }
 
 static int _cpu_ld_d_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.D = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	return 8;
 }
 
 static int _cpu_ld_e_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	return 8;
 }
 
 static int _cpu_ld_h_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.H = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	return 8;
 }
 
 static int _cpu_ld_l_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_d8(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
 	mem_write8(address, data);
 	return 12;
 }
@@ -331,58 +406,58 @@ static int _cpu_ld_imm_hl_d8(void)
 //========================================
 static int _cpu_ld_a_a(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Assigment to itself
 	return 4;
 }
 
 static int _cpu_ld_a_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.B;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.B;
 	return 4;
 }
 
 static int _cpu_ld_a_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.C;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.C;
 	return 4;
 }
 
 static int _cpu_ld_a_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.D;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.D;
 	return 4;
 }
 
 static int _cpu_ld_a_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.E;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.E;
 	return 4;
 }
 
 static int _cpu_ld_a_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.H;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.H;
 	return 4;
 }
 
 static int _cpu_ld_a_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.L;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.L;
 	return 4;
 }
 
 static int _cpu_ld_a_imm_hl(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	g_registers.A = mem_read8(address);
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	g_cpu->registers.A = mem_read8(address);
 	return 8;
 }
 
@@ -390,59 +465,59 @@ static int _cpu_ld_a_imm_hl(void)
 //========================================
 static int _cpu_ld_b_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.B = g_registers.A;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B = g_cpu->registers.A;
 	return 4;
 }
 
 static int _cpu_ld_b_b(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Assigment to itself
 	return 4;
 }
 
 static int _cpu_ld_b_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.B = g_registers.C;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B = g_cpu->registers.C;
 	return 4;
 }
 
 static int _cpu_ld_b_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.B = g_registers.D;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B = g_cpu->registers.D;
 	return 4;
 }
 
 static int _cpu_ld_b_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.B = g_registers.E;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B = g_cpu->registers.E;
 	return 4;
 }
 
 static int _cpu_ld_b_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.B = g_registers.H;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B = g_cpu->registers.H;
 	return 4;
 }
 
 static int _cpu_ld_b_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.B = g_registers.L;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B = g_cpu->registers.L;
 	return 4;
 }
 
 static int _cpu_ld_b_imm_hl(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
 	d8 data = mem_read8(address);
-	g_registers.B = data;
+	g_cpu->registers.B = data;
 	return 8;
 }
 
@@ -450,59 +525,59 @@ static int _cpu_ld_b_imm_hl(void)
 //========================================
 static int _cpu_ld_c_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = g_registers.A;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = g_cpu->registers.A;
 	return 4;
 }
 
 static int _cpu_ld_c_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = g_registers.B;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = g_cpu->registers.B;
 	return 4;
 }
 
 static int _cpu_ld_c_c(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Assigment to itself
 	return 4;
 }
 
 static int _cpu_ld_c_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = g_registers.D;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = g_cpu->registers.D;
 	return 4;
 }
 
 static int _cpu_ld_c_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = g_registers.E;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = g_cpu->registers.E;
 	return 4;
 }
 
 static int _cpu_ld_c_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = g_registers.H;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = g_cpu->registers.H;
 	return 4;
 }
 
 static int _cpu_ld_c_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = g_registers.L;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = g_cpu->registers.L;
 	return 4;
 }
 
 static int _cpu_ld_c_imm_hl(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
 	d8 data = mem_read8(address);
-	g_registers.C = data;
+	g_cpu->registers.C = data;
 	return 8;
 }
 
@@ -510,59 +585,59 @@ static int _cpu_ld_c_imm_hl(void)
 //========================================
 static int _cpu_ld_d_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.D = g_registers.A;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D = g_cpu->registers.A;
 	return 4;
 }
 
 static int _cpu_ld_d_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.D = g_registers.B;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D = g_cpu->registers.B;
 	return 4;
 }
 
 static int _cpu_ld_d_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.D = g_registers.C;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D = g_cpu->registers.C;
 	return 4;
 }
 
 static int _cpu_ld_d_d(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Assigment to itself
 	return 4;
 }
 
 static int _cpu_ld_d_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.D = g_registers.E;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D = g_cpu->registers.E;
 	return 4;
 }
 
 static int _cpu_ld_d_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.D = g_registers.H;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D = g_cpu->registers.H;
 	return 4;
 }
 
 static int _cpu_ld_d_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.D = g_registers.L;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D = g_cpu->registers.L;
 	return 4;
 }
 
 static int _cpu_ld_d_imm_hl(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
 	d8 data = mem_read8(address);
-	g_registers.D = data;
+	g_cpu->registers.D = data;
 	return 8;
 }
 
@@ -570,59 +645,59 @@ static int _cpu_ld_d_imm_hl(void)
 //========================================
 static int _cpu_ld_e_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = g_registers.A;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = g_cpu->registers.A;
 	return 4;
 }
 
 static int _cpu_ld_e_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = g_registers.B;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = g_cpu->registers.B;
 	return 4;
 }
 
 static int _cpu_ld_e_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = g_registers.C;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = g_cpu->registers.C;
 	return 4;
 }
 
 static int _cpu_ld_e_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = g_registers.D;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = g_cpu->registers.D;
 	return 4;
 }
 
 static int _cpu_ld_e_e(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Assigment to itself
 	return 4;
 }
 
 static int _cpu_ld_e_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = g_registers.H;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = g_cpu->registers.H;
 	return 4;
 }
 
 static int _cpu_ld_e_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = g_registers.L;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = g_cpu->registers.L;
 	return 4;
 }
 
 static int _cpu_ld_e_imm_hl(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
 	d8 data = mem_read8(address);
-	g_registers.E = data;
+	g_cpu->registers.E = data;
 	return 8;
 }
 
@@ -630,59 +705,59 @@ static int _cpu_ld_e_imm_hl(void)
 //========================================
 static int _cpu_ld_h_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.H = g_registers.A;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H = g_cpu->registers.A;
 	return 4;
 }
 
 static int _cpu_ld_h_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.H = g_registers.B;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H = g_cpu->registers.B;
 	return 4;
 }
 
 static int _cpu_ld_h_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.H = g_registers.C;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H = g_cpu->registers.C;
 	return 4;
 }
 
 static int _cpu_ld_h_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.H = g_registers.D;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H = g_cpu->registers.D;
 	return 4;
 }
 
 static int _cpu_ld_h_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.H = g_registers.E;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H = g_cpu->registers.E;
 	return 4;
 }
 
 static int _cpu_ld_h_h(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Assigment to itself
 	return 4;
 }
 
 static int _cpu_ld_h_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.H = g_registers.L;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H = g_cpu->registers.L;
 	return 4;
 }
 
 static int _cpu_ld_h_imm_hl(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
 	d8 data = mem_read8(address);
-	g_registers.H = data;
+	g_cpu->registers.H = data;
 	return 8;
 }
 
@@ -690,59 +765,59 @@ static int _cpu_ld_h_imm_hl(void)
 //========================================
 static int _cpu_ld_l_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = g_registers.A;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = g_cpu->registers.A;
 	return 4;
 }
 
 static int _cpu_ld_l_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = g_registers.B;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = g_cpu->registers.B;
 	return 4;
 }
 
 static int _cpu_ld_l_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = g_registers.C;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = g_cpu->registers.C;
 	return 4;
 }
 
 static int _cpu_ld_l_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = g_registers.D;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = g_cpu->registers.D;
 	return 4;
 }
 
 static int _cpu_ld_l_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = g_registers.E;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = g_cpu->registers.E;
 	return 4;
 }
 
 static int _cpu_ld_l_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = g_registers.H;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = g_cpu->registers.H;
 	return 4;
 }
 
 static int _cpu_ld_l_l(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Assigment to itself
 	return 4;
 }
 
 static int _cpu_ld_l_imm_hl(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
 	d8 data = mem_read8(address);
-	g_registers.L = data;
+	g_cpu->registers.L = data;
 	return 8;
 }
 
@@ -750,63 +825,63 @@ static int _cpu_ld_l_imm_hl(void)
 //========================================
 static int _cpu_ld_imm_hl_a(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = g_registers.A;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = g_cpu->registers.A;
 	mem_write8(address, data);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_b(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = g_registers.B;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = g_cpu->registers.B;
 	mem_write8(address, data);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_c(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = g_registers.C;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = g_cpu->registers.C;
 	mem_write8(address, data);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_d(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = g_registers.D;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = g_cpu->registers.D;
 	mem_write8(address, data);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_e(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = g_registers.E;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = g_cpu->registers.E;
 	mem_write8(address, data);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_h(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = g_registers.H;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = g_cpu->registers.H;
 	mem_write8(address, data);
 	return 8;
 }
 
 static int _cpu_ld_imm_hl_l(void)
 {
-	g_registers.PC += 1;
-	a16 address = g_registers.HL;
-	d8 data = g_registers.L;
+	g_cpu->registers.PC += 1;
+	a16 address = g_cpu->registers.HL;
+	d8 data = g_cpu->registers.L;
 	mem_write8(address, data);
 	return 8;
 }
@@ -815,141 +890,141 @@ static int _cpu_ld_imm_hl_l(void)
 //========================================
 static int _cpu_ld_bc_d16(void)
 {
-	g_registers.PC += 1;
-	d16 data = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	g_registers.BC = data;
+	g_cpu->registers.PC += 1;
+	d16 data = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	g_cpu->registers.BC = data;
 	return 12;
 }
 
 static int _cpu_ld_de_d16(void)
 {
-	g_registers.PC += 1;
-	d16 data = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	g_registers.DE = data;
+	g_cpu->registers.PC += 1;
+	d16 data = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	g_cpu->registers.DE = data;
 	return 12;
 }
 
 static int _cpu_ld_hl_d16(void)
 {
-	g_registers.PC += 1;
-	d16 data = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	g_registers.HL = data;
+	g_cpu->registers.PC += 1;
+	d16 data = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	g_cpu->registers.HL = data;
 	return 12;
 }
 
 static int _cpu_ld_sp_d16(void)
 {
-	g_registers.PC += 1;
-	d16 data = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	g_registers.SP = data;
+	g_cpu->registers.PC += 1;
+	d16 data = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	g_cpu->registers.SP = data;
 	return 12;
 }
 
 static int _cpu_ld_imm_a16_sp(void)
 {
-	g_registers.PC += 1;
-	a16 address = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	d16 data = g_registers.SP;
+	g_cpu->registers.PC += 1;
+	a16 address = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	d16 data = g_cpu->registers.SP;
 	mem_write16(address, data);
 	return 20;
 }
 
 static int _cpu_ld_sp_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.SP = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.SP = g_cpu->registers.HL;
 	return 8;
 }
 
 static int _cpu_ld_hl_sp_add_d8(void)
 {
-	g_registers.PC += 1;
-	s8 index = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	d16 result = g_registers.SP + index;
-	g_registers.FLAGS.Z = 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(g_registers.SP, (d8)index);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(g_registers.SP, (d8)index);
-	g_registers.HL = result;
+	g_cpu->registers.PC += 1;
+	s8 index = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	d16 result = g_cpu->registers.SP + index;
+	g_cpu->registers.FLAGS.Z = 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(g_cpu->registers.SP, (d8)index);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(g_cpu->registers.SP, (d8)index);
+	g_cpu->registers.HL = result;
 	return 12;
 }
 
 static int _cpu_pop_bc(void)
 {
-	g_registers.PC += 1;
-	g_registers.C = mem_read8(g_registers.SP);
-	g_registers.B = mem_read8(g_registers.SP + 1);
-	g_registers.SP += 2;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C = mem_read8(g_cpu->registers.SP);
+	g_cpu->registers.B = mem_read8(g_cpu->registers.SP + 1);
+	g_cpu->registers.SP += 2;
 	return 12;
 }
 
 static int _cpu_pop_de(void)
 {
-	g_registers.PC += 1;
-	g_registers.E = mem_read8(g_registers.SP);
-	g_registers.D = mem_read8(g_registers.SP + 1);
-	g_registers.SP += 2;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E = mem_read8(g_cpu->registers.SP);
+	g_cpu->registers.D = mem_read8(g_cpu->registers.SP + 1);
+	g_cpu->registers.SP += 2;
 	return 12;
 }
 
 static int _cpu_pop_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.L = mem_read8(g_registers.SP);
-	g_registers.H = mem_read8(g_registers.SP + 1);
-	g_registers.SP += 2;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L = mem_read8(g_cpu->registers.SP);
+	g_cpu->registers.H = mem_read8(g_cpu->registers.SP + 1);
+	g_cpu->registers.SP += 2;
 	return 12;
 }
 
 static int _cpu_pop_af(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	// Flag register 4 lower bits are always 0
-	g_registers.F = mem_read8(g_registers.SP) & 0xF0;
-	g_registers.A = mem_read8(g_registers.SP + 1);
-	g_registers.SP += 2;
+	g_cpu->registers.F = mem_read8(g_cpu->registers.SP) & 0xF0;
+	g_cpu->registers.A = mem_read8(g_cpu->registers.SP + 1);
+	g_cpu->registers.SP += 2;
 	return 12;
 }
 
 static int _cpu_push_bc(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP - 1, g_registers.B);
-	mem_write8(g_registers.SP - 2, g_registers.C);
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP - 1, g_cpu->registers.B);
+	mem_write8(g_cpu->registers.SP - 2, g_cpu->registers.C);
+	g_cpu->registers.SP -= 2;
 	return 16;
 }
 
 static int _cpu_push_de(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP - 1, g_registers.D);
-	mem_write8(g_registers.SP - 2, g_registers.E);
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP - 1, g_cpu->registers.D);
+	mem_write8(g_cpu->registers.SP - 2, g_cpu->registers.E);
+	g_cpu->registers.SP -= 2;
 	return 16;
 }
 
 static int _cpu_push_hl(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP - 1, g_registers.H);
-	mem_write8(g_registers.SP - 2, g_registers.L);
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP - 1, g_cpu->registers.H);
+	mem_write8(g_cpu->registers.SP - 2, g_cpu->registers.L);
+	g_cpu->registers.SP -= 2;
 	return 16;
 }
 
 static int _cpu_push_af(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP - 1, g_registers.A);
-	mem_write8(g_registers.SP - 2, g_registers.F);
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP - 1, g_cpu->registers.A);
+	mem_write8(g_cpu->registers.SP - 2, g_cpu->registers.F);
+	g_cpu->registers.SP -= 2;
 	return 16;
 }
 
@@ -957,11 +1032,11 @@ static int _cpu_push_af(void)
 //========================================
 static int _cpu_jr_nz_r8(void)
 {
-	g_registers.PC += 1;
-	r8 offset = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.Z == 0) {
-		g_registers.PC += offset;
+	g_cpu->registers.PC += 1;
+	r8 offset = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.Z == 0) {
+		g_cpu->registers.PC += offset;
 		return 12;
 	}
 	return 8;
@@ -969,11 +1044,11 @@ static int _cpu_jr_nz_r8(void)
 
 static int _cpu_jp_nz_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.Z == 0) {
-		g_registers.PC = absolute;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.Z == 0) {
+		g_cpu->registers.PC = absolute;
 		return 16;
 	}
 	return 12;
@@ -981,11 +1056,11 @@ static int _cpu_jp_nz_a16(void)
 
 static int _cpu_jr_nc_r8(void)
 {
-	g_registers.PC += 1;
-	r8 offset = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.C == 0) {
-		g_registers.PC += offset;
+	g_cpu->registers.PC += 1;
+	r8 offset = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.C == 0) {
+		g_cpu->registers.PC += offset;
 		return 12;
 	}
 	return 8;
@@ -993,11 +1068,11 @@ static int _cpu_jr_nc_r8(void)
 
 static int _cpu_jp_nc_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.C == 0) {
-		g_registers.PC = absolute;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.C == 0) {
+		g_cpu->registers.PC = absolute;
 		return 16;
 	}
 	return 12;
@@ -1005,11 +1080,11 @@ static int _cpu_jp_nc_a16(void)
 
 static int _cpu_jr_z_r8(void)
 {
-	g_registers.PC += 1;
-	r8 offset = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.Z == 1) {
-		g_registers.PC += offset;
+	g_cpu->registers.PC += 1;
+	r8 offset = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.Z == 1) {
+		g_cpu->registers.PC += offset;
 		return 12;
 	}
 	return 8;
@@ -1017,11 +1092,11 @@ static int _cpu_jr_z_r8(void)
 
 static int _cpu_jp_z_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.Z == 1) {
-		g_registers.PC = absolute;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.Z == 1) {
+		g_cpu->registers.PC = absolute;
 		return 16;
 	}
 	return 12;
@@ -1029,11 +1104,11 @@ static int _cpu_jp_z_a16(void)
 
 static int _cpu_jr_c_r8(void)
 {
-	g_registers.PC += 1;
-	r8 offset = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.C == 1) {
-		g_registers.PC += offset;
+	g_cpu->registers.PC += 1;
+	r8 offset = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.C == 1) {
+		g_cpu->registers.PC += offset;
 		return 12;
 	}
 	return 8;
@@ -1041,11 +1116,11 @@ static int _cpu_jr_c_r8(void)
 
 static int _cpu_jp_c_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.C == 1) {
-		g_registers.PC = absolute;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.C == 1) {
+		g_cpu->registers.PC = absolute;
 		return 16;
 	}
 	return 12;
@@ -1053,26 +1128,26 @@ static int _cpu_jp_c_a16(void)
 
 static int _cpu_jr_r8(void)
 {
-	g_registers.PC += 1;
-	r8 offset = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.PC += offset;
+	g_cpu->registers.PC += 1;
+	r8 offset = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.PC += offset;
 	return 12;
 }
 
 static int _cpu_jp_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	g_registers.PC = absolute;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	g_cpu->registers.PC = absolute;
 	return 16;
 }
 
 static int _cpu_jp_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.PC = g_registers.HL;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.PC = g_cpu->registers.HL;
 	return 4;
 }
 
@@ -1080,14 +1155,15 @@ static int _cpu_jp_imm_hl(void)
 //========================================
 static int _cpu_call_nz_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.Z == 0) {
-		mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-		mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-		g_registers.PC = absolute;
-		g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.Z == 0) {
+		mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+		mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+		g_cpu->registers.PC = absolute;
+		g_cpu->registers.SP -= 2;
+		_cpu_notify_call();
 		return 24;
 	}
 	return 12;
@@ -1095,14 +1171,15 @@ static int _cpu_call_nz_a16(void)
 
 static int _cpu_call_nc_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.C == 0) {
-		mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-		mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-		g_registers.PC = absolute;
-		g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.C == 0) {
+		mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+		mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+		g_cpu->registers.PC = absolute;
+		g_cpu->registers.SP -= 2;
+		_cpu_notify_call();
 		return 24;
 	}
 	return 12;
@@ -1110,14 +1187,15 @@ static int _cpu_call_nc_a16(void)
 
 static int _cpu_call_z_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.Z == 1) {
-		mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-		mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-		g_registers.PC = absolute;
-		g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.Z == 1) {
+		mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+		mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+		g_cpu->registers.PC = absolute;
+		g_cpu->registers.SP -= 2;
+		_cpu_notify_call();
 		return 24;
 	}
 	return 12;
@@ -1125,14 +1203,15 @@ static int _cpu_call_z_a16(void)
 
 static int _cpu_call_c_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	if(g_registers.FLAGS.C == 1) {
-		mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-		mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-		g_registers.PC = absolute;
-		g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	if(g_cpu->registers.FLAGS.C == 1) {
+		mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+		mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+		g_cpu->registers.PC = absolute;
+		g_cpu->registers.SP -= 2;
+		_cpu_notify_call();
 		return 24;
 	}
 	return 12;
@@ -1140,13 +1219,14 @@ static int _cpu_call_c_a16(void)
 
 static int _cpu_call_a16(void)
 {
-	g_registers.PC += 1;
-	a16 absolute = mem_read16(g_registers.PC);
-	g_registers.PC += 2;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = absolute;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	a16 absolute = mem_read16(g_cpu->registers.PC);
+	g_cpu->registers.PC += 2;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = absolute;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 24;
 }
 
@@ -1154,13 +1234,14 @@ static int _cpu_call_a16(void)
 //========================================
 static int _cpu_ret_nz(void)
 {
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.Z == 0) {
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.Z == 0) {
 		a16 addr = 0x0000;
-		addr = mem_read8(g_registers.SP);
-		addr += (mem_read8(g_registers.SP+1) << 8);
-		g_registers.PC = addr;
-		g_registers.SP += 2;
+		addr = mem_read8(g_cpu->registers.SP);
+		addr += (mem_read8(g_cpu->registers.SP+1) << 8);
+		g_cpu->registers.PC = addr;
+		g_cpu->registers.SP += 2;
+		_cpu_notify_ret();
 		return 20;
 	}
 	return 8;
@@ -1168,13 +1249,14 @@ static int _cpu_ret_nz(void)
 
 static int _cpu_ret_nc(void)
 {
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.C == 0) {
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.C == 0) {
 		a16 addr = 0x0000;
-		addr = mem_read8(g_registers.SP);
-		addr += (mem_read8(g_registers.SP+1) << 8);
-		g_registers.PC = addr;
-		g_registers.SP += 2;
+		addr = mem_read8(g_cpu->registers.SP);
+		addr += (mem_read8(g_cpu->registers.SP+1) << 8);
+		g_cpu->registers.PC = addr;
+		g_cpu->registers.SP += 2;
+		_cpu_notify_ret();
 		return 20;
 	}
 	return 8;
@@ -1182,13 +1264,14 @@ static int _cpu_ret_nc(void)
 
 static int _cpu_ret_z(void)
 {
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.Z == 1) {
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.Z == 1) {
 		a16 addr = 0x0000;
-		addr = mem_read8(g_registers.SP);
-		addr += (mem_read8(g_registers.SP+1) << 8);
-		g_registers.PC = addr;
-		g_registers.SP += 2;
+		addr = mem_read8(g_cpu->registers.SP);
+		addr += (mem_read8(g_cpu->registers.SP+1) << 8);
+		g_cpu->registers.PC = addr;
+		g_cpu->registers.SP += 2;
+		_cpu_notify_ret();
 		return 20;
 	}
 	return 8;
@@ -1196,13 +1279,14 @@ static int _cpu_ret_z(void)
 
 static int _cpu_ret_c(void)
 {
-	g_registers.PC += 1;
-	if(g_registers.FLAGS.C == 1) {
+	g_cpu->registers.PC += 1;
+	if(g_cpu->registers.FLAGS.C == 1) {
 		a16 addr = 0x0000;
-		addr = mem_read8(g_registers.SP);
-		addr += (mem_read8(g_registers.SP+1) << 8);
-		g_registers.PC = addr;
-		g_registers.SP += 2;
+		addr = mem_read8(g_cpu->registers.SP);
+		addr += (mem_read8(g_cpu->registers.SP+1) << 8);
+		g_cpu->registers.PC = addr;
+		g_cpu->registers.SP += 2;
+		_cpu_notify_ret();
 		return 20;
 	}
 	return 8;
@@ -1210,23 +1294,25 @@ static int _cpu_ret_c(void)
 
 static int _cpu_ret(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	a16 addr = 0x0000;
-	addr = mem_read8(g_registers.SP);
-	addr += (mem_read8(g_registers.SP+1) << 8);
-	g_registers.PC = addr;
-	g_registers.SP += 2;
+	addr = mem_read8(g_cpu->registers.SP);
+	addr += (mem_read8(g_cpu->registers.SP+1) << 8);
+	g_cpu->registers.PC = addr;
+	g_cpu->registers.SP += 2;
+	_cpu_notify_ret();
 	return 16;
 }
 
 static int _cpu_reti(void)
 {
-	g_registers.PC += 1;
+	g_cpu->registers.PC += 1;
 	a16 addr = 0x0000;
-	addr = mem_read8(g_registers.SP);
-	addr += (mem_read8(g_registers.SP+1) << 8);
-	g_registers.PC = addr;
-	g_registers.SP += 2;
+	addr = mem_read8(g_cpu->registers.SP);
+	addr += (mem_read8(g_cpu->registers.SP+1) << 8);
+	g_cpu->registers.PC = addr;
+	g_cpu->registers.SP += 2;
+	_cpu_notify_ret();
 	ints_set_ime();
 	return 16;
 }
@@ -1235,81 +1321,89 @@ static int _cpu_reti(void)
 //========================================
 static int _cpu_rst_00H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0000;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0000;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
 static int _cpu_rst_08H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0008;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0008;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
 static int _cpu_rst_10H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0010;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0010;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
 static int _cpu_rst_18H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0018;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0018;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
 static int _cpu_rst_20H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0020;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0020;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
 static int _cpu_rst_28H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0028;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0028;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
 static int _cpu_rst_30H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0030;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0030;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
 static int _cpu_rst_38H(void)
 {
-	g_registers.PC += 1;
-	mem_write8(g_registers.SP-1, (g_registers.PC >> 8) & 0xFF);
-	mem_write8(g_registers.SP-2, g_registers.PC & 0xFF);
-	g_registers.PC = 0x0038;
-	g_registers.SP -= 2;
+	g_cpu->registers.PC += 1;
+	mem_write8(g_cpu->registers.SP-1, (g_cpu->registers.PC >> 8) & 0xFF);
+	mem_write8(g_cpu->registers.SP-2, g_cpu->registers.PC & 0xFF);
+	g_cpu->registers.PC = 0x0038;
+	g_cpu->registers.SP -= 2;
+	_cpu_notify_call();
 	return 16;
 }
 
@@ -1318,119 +1412,119 @@ static int _cpu_rst_38H(void)
 
 static int _cpu_add_a_b(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.B;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.B;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 4;
 }
 
 static int _cpu_add_a_c(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.C;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.C;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 4;
 }
 
 static int _cpu_add_a_d(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.D;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.D;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 4;
 }
 
 static int _cpu_add_a_e(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.E;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.E;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 4;
 }
 
 static int _cpu_add_a_h(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.H;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.H;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 4;
 }
 
 static int _cpu_add_a_l(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.L;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.L;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 4;
 }
 
 static int _cpu_add_a_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.HL);
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 8;
 }
 
 static int _cpu_add_a_a(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.A;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.A;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 4;
 }
 
 static int _cpu_add_a_d8(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, right);
 	return 8;
 }
 
@@ -1439,119 +1533,119 @@ static int _cpu_add_a_d8(void)
 
 static int _cpu_adc_a_b(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.B;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.B;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_adc_a_c(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.C;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.C;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_adc_a_d(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.D;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.D;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_adc_a_e(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.E;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.E;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_adc_a_h(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.H;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.H;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_adc_a_l(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.L;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.L;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_adc_a_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.HL);
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 8;
 }
 
 static int _cpu_adc_a_a(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.A;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.A;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_adc_a_d8(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.A = left + right + g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = left + right + g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY_C(left, right, g_cpu->registers.FLAGS.C);
 	return 8;
 }
 
@@ -1561,119 +1655,119 @@ static int _cpu_adc_a_d8(void)
 
 static int _cpu_sub_b(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.B;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.B;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_sub_c(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.C;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.C;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_sub_d(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.D;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.D;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_sub_e(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.E;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.E;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_sub_h(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.H;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.H;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_sub_l(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.L;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.L;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_sub_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.HL);
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 8;
 }
 
 static int _cpu_sub_a(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.A;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.A;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_sub_d8(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 8;
 }
 
@@ -1682,119 +1776,119 @@ static int _cpu_sub_d8(void)
 
 static int _cpu_sbc_a_b(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.B;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.B;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_sbc_a_c(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.C;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.C;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_sbc_a_d(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.D;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.D;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_sbc_a_e(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.E;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.E;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_sbc_a_h(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.H;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.H;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_sbc_a_l(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.L;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.L;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_sbc_a_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.HL);
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 8;
 }
 
 static int _cpu_sbc_a_a(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.A;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.A;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 4;
 }
 
 static int _cpu_sbc_a_d8(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.A = left - right - g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_registers.FLAGS.C);
-	g_registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_registers.FLAGS.C);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = left - right - g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW_C(left, right, g_cpu->registers.FLAGS.C);
 	return 8;
 }
 
@@ -1803,101 +1897,101 @@ static int _cpu_sbc_a_d8(void)
 
 static int _cpu_and_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & g_registers.B;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & g_cpu->registers.B;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_and_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & g_registers.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & g_cpu->registers.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_and_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & g_registers.D;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & g_cpu->registers.D;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_and_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & g_registers.E;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & g_cpu->registers.E;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_and_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & g_registers.H;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & g_cpu->registers.H;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_and_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & g_registers.L;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & g_cpu->registers.L;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_and_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_and_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & g_registers.A;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & g_cpu->registers.A;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_and_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A & mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A & mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
@@ -1907,101 +2001,101 @@ static int _cpu_and_d8(void)
 
 static int _cpu_xor_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ g_registers.B;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ g_cpu->registers.B;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_xor_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ g_registers.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ g_cpu->registers.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_xor_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ g_registers.D;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ g_cpu->registers.D;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_xor_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ g_registers.E;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ g_cpu->registers.E;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_xor_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ g_registers.H;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ g_cpu->registers.H;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_xor_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ g_registers.L;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ g_cpu->registers.L;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_xor_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_xor_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ g_registers.A;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ g_cpu->registers.A;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_xor_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A ^ mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A ^ mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
@@ -2011,101 +2105,101 @@ static int _cpu_xor_d8(void)
 
 static int _cpu_or_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | g_registers.B;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | g_cpu->registers.B;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_or_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | g_registers.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | g_cpu->registers.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_or_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | g_registers.D;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | g_cpu->registers.D;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_or_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | g_registers.E;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | g_cpu->registers.E;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_or_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | g_registers.H;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | g_cpu->registers.H;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_or_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | g_registers.L;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | g_cpu->registers.L;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_or_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_or_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | g_registers.A;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | g_cpu->registers.A;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 4;
 }
 
 static int _cpu_or_d8(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = g_registers.A | mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = g_cpu->registers.A | mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
@@ -2115,110 +2209,110 @@ static int _cpu_or_d8(void)
 
 static int _cpu_cp_b(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.B;
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.B;
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_cp_c(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.C;
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.C;
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_cp_d(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.D;
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.D;
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_cp_e(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.E;
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.E;
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_cp_h(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.H;
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.H;
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_cp_l(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.L;
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.L;
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_cp_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 8;
 }
 
 static int _cpu_cp_a(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = g_registers.A;
-	g_registers.FLAGS.Z = left == right;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = g_cpu->registers.A;
+	g_cpu->registers.FLAGS.Z = left == right;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_cp_d8(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
-	d8 right = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (left - right) == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
-	g_registers.FLAGS.C = _CPU_IS_BORROW(left, right);
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
+	d8 right = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (left - right) == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_BORROW(left, right);
 	return 8;
 }
 
@@ -2227,98 +2321,98 @@ static int _cpu_cp_d8(void)
 
 static int _cpu_inc_b(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.B;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.B;
 	d8 right = 0x01;
-	g_registers.B = left + right;
-	g_registers.FLAGS.Z = g_registers.B == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	g_cpu->registers.B = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 4;
 }
 
 static int _cpu_inc_c(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.C;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.C;
 	d8 right = 0x01;
-	g_registers.C = left + right;
-	g_registers.FLAGS.Z = g_registers.C == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	g_cpu->registers.C = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 4;
 }
 
 static int _cpu_inc_d(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.D;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.D;
 	d8 right = 0x01;
-	g_registers.D = left + right;
-	g_registers.FLAGS.Z = g_registers.D == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	g_cpu->registers.D = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 4;
 }
 
 static int _cpu_inc_e(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.E;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.E;
 	d8 right = 0x01;
-	g_registers.E = left + right;
-	g_registers.FLAGS.Z = g_registers.E == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	g_cpu->registers.E = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 4;
 }
 
 static int _cpu_inc_h(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.H;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.H;
 	d8 right = 0x01;
-	g_registers.H = left + right;
-	g_registers.FLAGS.Z = g_registers.H == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	g_cpu->registers.H = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 4;
 }
 
 static int _cpu_inc_l(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.L;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.L;
 	d8 right = 0x01;
-	g_registers.L = left + right;
-	g_registers.FLAGS.Z = g_registers.L == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	g_cpu->registers.L = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 4;
 }
 
 static int _cpu_inc_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 left = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 left = mem_read8(g_cpu->registers.HL);
 	d8 right = 0x01;
 	d8 temp = left + right;
-	mem_write8(g_registers.HL, temp);
-	g_registers.FLAGS.Z = temp == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	mem_write8(g_cpu->registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 12;
 }
 
 static int _cpu_inc_a(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
 	d8 right = 0x01;
-	g_registers.A = left + right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = (left & 0x0F) == 0x0F;
+	g_cpu->registers.A = left + right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = (left & 0x0F) == 0x0F;
 	return 4;
 }
 
@@ -2327,98 +2421,98 @@ static int _cpu_inc_a(void)
 
 static int _cpu_dec_b(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.B;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.B;
 	d8 right = 0x01;
-	g_registers.B = left - right;
-	g_registers.FLAGS.Z = g_registers.B == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.B = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_dec_c(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.C;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.C;
 	d8 right = 0x01;
-	g_registers.C = left - right;
-	g_registers.FLAGS.Z = g_registers.C == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.C = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_dec_d(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.D;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.D;
 	d8 right = 0x01;
-	g_registers.D = left - right;
-	g_registers.FLAGS.Z = g_registers.D == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.D = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_dec_e(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.E;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.E;
 	d8 right = 0x01;
-	g_registers.E = left - right;
-	g_registers.FLAGS.Z = g_registers.E == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.E = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_dec_h(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.H;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.H;
 	d8 right = 0x01;
-	g_registers.H = left - right;
-	g_registers.FLAGS.Z = g_registers.H == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.H = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_dec_l(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.L;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.L;
 	d8 right = 0x01;
-	g_registers.L = left - right;
-	g_registers.FLAGS.Z = g_registers.L == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.L = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 4;
 }
 
 static int _cpu_dec_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 left = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 left = mem_read8(g_cpu->registers.HL);
 	d8 right = 0x01;
 	d8 temp = left - right;
-	mem_write8(g_registers.HL, temp);
-	g_registers.FLAGS.Z = temp == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	mem_write8(g_cpu->registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 12;
 }
 
 static int _cpu_dec_a(void)
 {
-	g_registers.PC += 1;
-	d8 left = g_registers.A;
+	g_cpu->registers.PC += 1;
+	d8 left = g_cpu->registers.A;
 	d8 right = 0x01;
-	g_registers.A = left - right;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
+	g_cpu->registers.A = left - right;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, right);
 	return 4;
 }
 
@@ -2428,29 +2522,29 @@ static int _cpu_dec_a(void)
 
 static int _cpu_inc_bc(void)
 {
-	g_registers.PC += 1;
-	g_registers.BC += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.BC += 1;
 	return 8;
 }
 
 static int _cpu_inc_de(void)
 {
-	g_registers.PC += 1;
-	g_registers.DE += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.DE += 1;
 	return 8;
 }
 
 static int _cpu_inc_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.HL += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.HL += 1;
 	return 8;
 }
 
 static int _cpu_inc_sp(void)
 {
-	g_registers.PC += 1;
-	g_registers.SP += 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.SP += 1;
 	return 8;
 }
 
@@ -2459,29 +2553,29 @@ static int _cpu_inc_sp(void)
 
 static int _cpu_dec_bc(void)
 {
-	g_registers.PC += 1;
-	g_registers.BC -= 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.BC -= 1;
 	return 8;
 }
 
 static int _cpu_dec_de(void)
 {
-	g_registers.PC += 1;
-	g_registers.DE -= 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.DE -= 1;
 	return 8;
 }
 
 static int _cpu_dec_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.HL -= 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.HL -= 1;
 	return 8;
 }
 
 static int _cpu_dec_sp(void)
 {
-	g_registers.PC += 1;
-	g_registers.SP -= 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.SP -= 1;
 	return 8;
 }
 
@@ -2490,54 +2584,54 @@ static int _cpu_dec_sp(void)
 
 static int _cpu_daa(void)
 {
-	g_registers.PC += 1;
-	if(!g_registers.FLAGS.N) {
+	g_cpu->registers.PC += 1;
+	if(!g_cpu->registers.FLAGS.N) {
 		// After BCD addition
-		if(g_registers.FLAGS.C || g_registers.A > 0x99) {
-			g_registers.A += 0x60;
-			g_registers.FLAGS.C = 1;
+		if(g_cpu->registers.FLAGS.C || g_cpu->registers.A > 0x99) {
+			g_cpu->registers.A += 0x60;
+			g_cpu->registers.FLAGS.C = 1;
 		}
-		if(g_registers.FLAGS.H || (g_registers.A & 0x0F) > 0x09) {
-			g_registers.A += 0x06;
+		if(g_cpu->registers.FLAGS.H || (g_cpu->registers.A & 0x0F) > 0x09) {
+			g_cpu->registers.A += 0x06;
 		}
 	} else {
 		// After BCD subtraction
-		if(g_registers.FLAGS.C) {
-			g_registers.A -= 0x60;
+		if(g_cpu->registers.FLAGS.C) {
+			g_cpu->registers.A -= 0x60;
 		}
-		if(g_registers.FLAGS.H) {
-			g_registers.A -= 0x06;
+		if(g_cpu->registers.FLAGS.H) {
+			g_cpu->registers.A -= 0x06;
 		}
 	}
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 4;
 }
 
 static int _cpu_scf(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 1;
 	return 4;
 }
 
 static int _cpu_ccf(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = g_registers.FLAGS.C ? 0 : 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = g_cpu->registers.FLAGS.C ? 0 : 1;
 	return 4;
 }
 
 static int _cpu_cpl(void)
 {
-	g_registers.PC += 1;
-	g_registers.A = ~g_registers.A;
-	g_registers.FLAGS.N = 1;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A = ~g_cpu->registers.A;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = 1;
 	return 4;
 }
 
@@ -2546,63 +2640,63 @@ static int _cpu_cpl(void)
 
 static int _cpu_add_hl_bc(void)
 {
-	g_registers.PC += 1;
-	d16 left = g_registers.HL;
-	d16 right = g_registers.BC;
-	g_registers.HL = left + right;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
+	g_cpu->registers.PC += 1;
+	d16 left = g_cpu->registers.HL;
+	d16 right = g_cpu->registers.BC;
+	g_cpu->registers.HL = left + right;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
 	return 8;
 }
 
 static int _cpu_add_hl_de(void)
 {
-	g_registers.PC += 1;
-	d16 left = g_registers.HL;
-	d16 right = g_registers.DE;
-	g_registers.HL = left + right;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
+	g_cpu->registers.PC += 1;
+	d16 left = g_cpu->registers.HL;
+	d16 right = g_cpu->registers.DE;
+	g_cpu->registers.HL = left + right;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
 	return 8;
 }
 
 static int _cpu_add_hl_hl(void)
 {
-	g_registers.PC += 1;
-	d16 left = g_registers.HL;
-	d16 right = g_registers.HL;
-	g_registers.HL = left + right;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
+	g_cpu->registers.PC += 1;
+	d16 left = g_cpu->registers.HL;
+	d16 right = g_cpu->registers.HL;
+	g_cpu->registers.HL = left + right;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
 	return 8;
 }
 
 static int _cpu_add_hl_sp(void)
 {
-	g_registers.PC += 1;
-	d16 left = g_registers.HL;
-	d16 right = g_registers.SP;
-	g_registers.HL = left + right;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
+	g_cpu->registers.PC += 1;
+	d16 left = g_cpu->registers.HL;
+	d16 right = g_cpu->registers.SP;
+	g_cpu->registers.HL = left + right;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY16(left, right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY16(left, right);
 	return 8;
 }
 
 static int _cpu_add_sp_r8(void)
 {
-	g_registers.PC += 1;
-	d16 left = g_registers.SP;
-	r8 right = mem_read8(g_registers.PC);
-	g_registers.PC += 1;
-	g_registers.SP = left + right;
-	g_registers.FLAGS.Z = 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, (d8)right);
-	g_registers.FLAGS.C = _CPU_IS_CARRY(left, (d8)right);
+	g_cpu->registers.PC += 1;
+	d16 left = g_cpu->registers.SP;
+	r8 right = mem_read8(g_cpu->registers.PC);
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.SP = left + right;
+	g_cpu->registers.FLAGS.Z = 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_CARRY(left, (d8)right);
+	g_cpu->registers.FLAGS.C = _CPU_IS_CARRY(left, (d8)right);
 	return 16;
 }
 
@@ -2612,2409 +2706,2850 @@ static int _cpu_add_sp_r8(void)
 
 static int _cpu_rlca(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.A & 0x80) != 0;
-	g_registers.A <<= 1;
-	g_registers.A |= g_registers.FLAGS.C;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x80) != 0;
+	g_cpu->registers.A <<= 1;
+	g_cpu->registers.A |= g_cpu->registers.FLAGS.C;
 	return 4;
 }
 
 static int _cpu_rla(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.A & 0x80) != 0;
-	g_registers.A <<= 1;
-	g_registers.A |= temp;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x80) != 0;
+	g_cpu->registers.A <<= 1;
+	g_cpu->registers.A |= temp;
 	return 4;
 }
 
 static int _cpu_rrca(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.A & 0x01) != 0;
-	g_registers.A >>= 1;
-	g_registers.A |= g_registers.FLAGS.C << 7;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x01) != 0;
+	g_cpu->registers.A >>= 1;
+	g_cpu->registers.A |= g_cpu->registers.FLAGS.C << 7;
 	return 4;
 }
 
 static int _cpu_rra(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.A & 0x01) != 0;
-	g_registers.A >>= 1;
-	g_registers.A |= temp << 7;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x01) != 0;
+	g_cpu->registers.A >>= 1;
+	g_cpu->registers.A |= temp << 7;
 	return 4;
 }
 
 static int _cpu_rlc_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.B & 0x80) != 0;
-	g_registers.B <<= 1;
-	g_registers.B |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.B == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.B & 0x80) != 0;
+	g_cpu->registers.B <<= 1;
+	g_cpu->registers.B |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
 	return 8;
 }
 
 static int _cpu_rlc_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.C & 0x80) != 0;
-	g_registers.C <<= 1;
-	g_registers.C |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.C == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.C & 0x80) != 0;
+	g_cpu->registers.C <<= 1;
+	g_cpu->registers.C |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
 	return 8;
 }
 
 static int _cpu_rlc_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.D & 0x80) != 0;
-	g_registers.D <<= 1;
-	g_registers.D |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.D == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.D & 0x80) != 0;
+	g_cpu->registers.D <<= 1;
+	g_cpu->registers.D |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
 	return 8;
 }
 
 static int _cpu_rlc_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.E & 0x80) != 0;
-	g_registers.E <<= 1;
-	g_registers.E |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.E == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.E & 0x80) != 0;
+	g_cpu->registers.E <<= 1;
+	g_cpu->registers.E |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
 	return 8;
 }
 
 static int _cpu_rlc_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.H & 0x80) != 0;
-	g_registers.H <<= 1;
-	g_registers.H |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.H == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.H & 0x80) != 0;
+	g_cpu->registers.H <<= 1;
+	g_cpu->registers.H |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
 	return 8;
 }
 
 static int _cpu_rlc_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.L & 0x80) != 0;
-	g_registers.L <<= 1;
-	g_registers.L |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.L == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.L & 0x80) != 0;
+	g_cpu->registers.L <<= 1;
+	g_cpu->registers.L |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
 	return 8;
 }
 
 static int _cpu_rlc_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.C = (temp & 0x80) != 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.C = (temp & 0x80) != 0;
 	temp <<= 1;
-	temp |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = temp == 0;
-	mem_write8(g_registers.HL, temp);
+	temp |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_rlc_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.A & 0x80) != 0;
-	g_registers.A <<= 1;
-	g_registers.A |= g_registers.FLAGS.C;
-	g_registers.FLAGS.Z = g_registers.A == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x80) != 0;
+	g_cpu->registers.A <<= 1;
+	g_cpu->registers.A |= g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
 	return 8;
 }
 
 static int _cpu_rrc_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.B & 0x01) != 0;
-	g_registers.B >>= 1;
-	g_registers.B |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = g_registers.B == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.B & 0x01) != 0;
+	g_cpu->registers.B >>= 1;
+	g_cpu->registers.B |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
 	return 8;
 }
 
 static int _cpu_rrc_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.C & 0x01) != 0;
-	g_registers.C >>= 1;
-	g_registers.C |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = g_registers.C == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.C & 0x01) != 0;
+	g_cpu->registers.C >>= 1;
+	g_cpu->registers.C |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
 	return 8;
 }
 
 static int _cpu_rrc_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.D & 0x01) != 0;
-	g_registers.D >>= 1;
-	g_registers.D |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = g_registers.D == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.D & 0x01) != 0;
+	g_cpu->registers.D >>= 1;
+	g_cpu->registers.D |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
 	return 8;
 }
 
 static int _cpu_rrc_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.E & 0x01) != 0;
-	g_registers.E >>= 1;
-	g_registers.E |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = g_registers.E == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.E & 0x01) != 0;
+	g_cpu->registers.E >>= 1;
+	g_cpu->registers.E |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
 	return 8;
 }
 
 static int _cpu_rrc_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.H & 0x01) != 0;
-	g_registers.H >>= 1;
-	g_registers.H |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = g_registers.H == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.H & 0x01) != 0;
+	g_cpu->registers.H >>= 1;
+	g_cpu->registers.H |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
 	return 8;
 }
 
 static int _cpu_rrc_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.L & 0x01) != 0;
-	g_registers.L >>= 1;
-	g_registers.L |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = g_registers.L == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.L & 0x01) != 0;
+	g_cpu->registers.L >>= 1;
+	g_cpu->registers.L |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
 	return 8;
 }
 
 static int _cpu_rrc_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.C = (temp & 0x01) != 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.C = (temp & 0x01) != 0;
 	temp >>= 1;
-	temp |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = temp == 0;
-	mem_write8(g_registers.HL, temp);
+	temp |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_rrc_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.A & 0x01) != 0;
-	g_registers.A >>= 1;
-	g_registers.A |= g_registers.FLAGS.C << 7;
-	g_registers.FLAGS.Z = g_registers.A == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x01) != 0;
+	g_cpu->registers.A >>= 1;
+	g_cpu->registers.A |= g_cpu->registers.FLAGS.C << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
 	return 8;
 }
 
 static int _cpu_rl_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.B & 0x80) != 0;
-	g_registers.B <<= 1;
-	g_registers.B |= temp_c;
-	g_registers.FLAGS.Z = g_registers.B == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.B & 0x80) != 0;
+	g_cpu->registers.B <<= 1;
+	g_cpu->registers.B |= temp_c;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
 	return 8;
 }
 
 static int _cpu_rl_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.C & 0x80) != 0;
-	g_registers.C <<= 1;
-	g_registers.C |= temp_c;
-	g_registers.FLAGS.Z = g_registers.C == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.C & 0x80) != 0;
+	g_cpu->registers.C <<= 1;
+	g_cpu->registers.C |= temp_c;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
 	return 8;
 }
 
 static int _cpu_rl_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.D & 0x80) != 0;
-	g_registers.D <<= 1;
-	g_registers.D |= temp_c;
-	g_registers.FLAGS.Z = g_registers.D == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.D & 0x80) != 0;
+	g_cpu->registers.D <<= 1;
+	g_cpu->registers.D |= temp_c;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
 	return 8;
 }
 
 static int _cpu_rl_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.E & 0x80) != 0;
-	g_registers.E <<= 1;
-	g_registers.E |= temp_c;
-	g_registers.FLAGS.Z = g_registers.E == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.E & 0x80) != 0;
+	g_cpu->registers.E <<= 1;
+	g_cpu->registers.E |= temp_c;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
 	return 8;
 }
 
 static int _cpu_rl_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.H & 0x80) != 0;
-	g_registers.H <<= 1;
-	g_registers.H |= temp_c;
-	g_registers.FLAGS.Z = g_registers.H == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.H & 0x80) != 0;
+	g_cpu->registers.H <<= 1;
+	g_cpu->registers.H |= temp_c;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
 	return 8;
 }
 
 static int _cpu_rl_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.L & 0x80) != 0;
-	g_registers.L <<= 1;
-	g_registers.L |= temp_c;
-	g_registers.FLAGS.Z = g_registers.L == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.L & 0x80) != 0;
+	g_cpu->registers.L <<= 1;
+	g_cpu->registers.L |= temp_c;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
 	return 8;
 }
 
 static int _cpu_rl_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = mem_read8(g_registers.HL);
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (temp & 0x80) != 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (temp & 0x80) != 0;
 	temp <<= 1;
 	temp |= temp_c;
-	g_registers.FLAGS.Z = temp == 0;
-	mem_write8(g_registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_rl_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.A & 0x80) != 0;
-	g_registers.A <<= 1;
-	g_registers.A |= temp_c;
-	g_registers.FLAGS.Z = g_registers.A == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x80) != 0;
+	g_cpu->registers.A <<= 1;
+	g_cpu->registers.A |= temp_c;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
 	return 8;
 }
 
 static int _cpu_rr_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.B & 0x01) != 0;
-	g_registers.B >>= 1;
-	g_registers.B |= temp_c << 7;
-	g_registers.FLAGS.Z = g_registers.B == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.B & 0x01) != 0;
+	g_cpu->registers.B >>= 1;
+	g_cpu->registers.B |= temp_c << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
 	return 8;
 }
 
 static int _cpu_rr_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.C & 0x01) != 0;
-	g_registers.C >>= 1;
-	g_registers.C |= temp_c << 7;
-	g_registers.FLAGS.Z = g_registers.C == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.C & 0x01) != 0;
+	g_cpu->registers.C >>= 1;
+	g_cpu->registers.C |= temp_c << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
 	return 8;
 }
 
 static int _cpu_rr_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.D & 0x01) != 0;
-	g_registers.D >>= 1;
-	g_registers.D |= temp_c << 7;
-	g_registers.FLAGS.Z = g_registers.D == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.D & 0x01) != 0;
+	g_cpu->registers.D >>= 1;
+	g_cpu->registers.D |= temp_c << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
 	return 8;
 }
 
 static int _cpu_rr_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.E & 0x01) != 0;
-	g_registers.E >>= 1;
-	g_registers.E |= temp_c << 7;
-	g_registers.FLAGS.Z = g_registers.E == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.E & 0x01) != 0;
+	g_cpu->registers.E >>= 1;
+	g_cpu->registers.E |= temp_c << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
 	return 8;
 }
 
 static int _cpu_rr_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.H & 0x01) != 0;
-	g_registers.H >>= 1;
-	g_registers.H |= temp_c << 7;
-	g_registers.FLAGS.Z = g_registers.H == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.H & 0x01) != 0;
+	g_cpu->registers.H >>= 1;
+	g_cpu->registers.H |= temp_c << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
 	return 8;
 }
 
 static int _cpu_rr_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.L & 0x01) != 0;
-	g_registers.L >>= 1;
-	g_registers.L |= temp_c << 7;
-	g_registers.FLAGS.Z = g_registers.L == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.L & 0x01) != 0;
+	g_cpu->registers.L >>= 1;
+	g_cpu->registers.L |= temp_c << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
 	return 8;
 }
 
 static int _cpu_rr_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = mem_read8(g_registers.HL);
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (temp & 0x01) != 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (temp & 0x01) != 0;
 	temp >>= 1;
 	temp |= temp_c << 7;
-	g_registers.FLAGS.Z = temp == 0;
-	mem_write8(g_registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_rr_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp_c = g_registers.FLAGS.C;
-	g_registers.FLAGS.C = (g_registers.A & 0x01) != 0;
-	g_registers.A >>= 1;
-	g_registers.A |= temp_c << 7;
-	g_registers.FLAGS.Z = g_registers.A == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp_c = g_cpu->registers.FLAGS.C;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x01) != 0;
+	g_cpu->registers.A >>= 1;
+	g_cpu->registers.A |= temp_c << 7;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
 	return 8;
 }
 
 static int _cpu_sla_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.B & 0x80) != 0;
-	g_registers.B <<= 1;
-	g_registers.FLAGS.Z = g_registers.B == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.B & 0x80) != 0;
+	g_cpu->registers.B <<= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
 	return 8;
 }
 
 static int _cpu_sla_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.C & 0x80) != 0;
-	g_registers.C <<= 1;
-	g_registers.FLAGS.Z = g_registers.C == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.C & 0x80) != 0;
+	g_cpu->registers.C <<= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
 	return 8;
 }
 
 static int _cpu_sla_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.D & 0x80) != 0;
-	g_registers.D <<= 1;
-	g_registers.FLAGS.Z = g_registers.D == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.D & 0x80) != 0;
+	g_cpu->registers.D <<= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
 	return 8;
 }
 
 static int _cpu_sla_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.E & 0x80) != 0;
-	g_registers.E <<= 1;
-	g_registers.FLAGS.Z = g_registers.E == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.E & 0x80) != 0;
+	g_cpu->registers.E <<= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
 	return 8;
 }
 
 static int _cpu_sla_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.H & 0x80) != 0;
-	g_registers.H <<= 1;
-	g_registers.FLAGS.Z = g_registers.H == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.H & 0x80) != 0;
+	g_cpu->registers.H <<= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
 	return 8;
 }
 
 static int _cpu_sla_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.L & 0x80) != 0;
-	g_registers.L <<= 1;
-	g_registers.FLAGS.Z = g_registers.L == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.L & 0x80) != 0;
+	g_cpu->registers.L <<= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
 	return 8;
 }
 
 static int _cpu_sla_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.C = (temp & 0x80) != 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.C = (temp & 0x80) != 0;
 	temp <<= 1;
-	g_registers.FLAGS.Z = temp == 0;
-	mem_write8(g_registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_sla_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.A & 0x80) != 0;
-	g_registers.A <<= 1;
-	g_registers.FLAGS.Z = g_registers.A == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x80) != 0;
+	g_cpu->registers.A <<= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
 	return 8;
 }
 
 static int _cpu_sra_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.B & 0x01) != 0;
-	d8 old_bit = g_registers.B & 0x80;
-	g_registers.B >>= 1;
-	g_registers.B |= old_bit;
-	g_registers.FLAGS.Z = g_registers.B == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.B & 0x01) != 0;
+	d8 old_bit = g_cpu->registers.B & 0x80;
+	g_cpu->registers.B >>= 1;
+	g_cpu->registers.B |= old_bit;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
 	return 8;
 }
 
 static int _cpu_sra_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.C & 0x01) != 0;
-	d8 old_bit = g_registers.C & 0x80;
-	g_registers.C >>= 1;
-	g_registers.C |= old_bit;
-	g_registers.FLAGS.Z = g_registers.C == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.C & 0x01) != 0;
+	d8 old_bit = g_cpu->registers.C & 0x80;
+	g_cpu->registers.C >>= 1;
+	g_cpu->registers.C |= old_bit;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
 	return 8;
 }
 
 static int _cpu_sra_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.D & 0x01) != 0;
-	d8 old_bit = g_registers.D & 0x80;
-	g_registers.D >>= 1;
-	g_registers.D |= old_bit;
-	g_registers.FLAGS.Z = g_registers.D == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.D & 0x01) != 0;
+	d8 old_bit = g_cpu->registers.D & 0x80;
+	g_cpu->registers.D >>= 1;
+	g_cpu->registers.D |= old_bit;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
 	return 8;
 }
 
 static int _cpu_sra_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.E & 0x01) != 0;
-	d8 old_bit = g_registers.E & 0x80;
-	g_registers.E >>= 1;
-	g_registers.E |= old_bit;
-	g_registers.FLAGS.Z = g_registers.E == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.E & 0x01) != 0;
+	d8 old_bit = g_cpu->registers.E & 0x80;
+	g_cpu->registers.E >>= 1;
+	g_cpu->registers.E |= old_bit;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
 	return 8;
 }
 
 static int _cpu_sra_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.H & 0x01) != 0;
-	d8 old_bit = g_registers.H & 0x80;
-	g_registers.H >>= 1;
-	g_registers.H |= old_bit;
-	g_registers.FLAGS.Z = g_registers.H == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.H & 0x01) != 0;
+	d8 old_bit = g_cpu->registers.H & 0x80;
+	g_cpu->registers.H >>= 1;
+	g_cpu->registers.H |= old_bit;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
 	return 8;
 }
 
 static int _cpu_sra_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.L & 0x01) != 0;
-	d8 old_bit = g_registers.L & 0x80;
-	g_registers.L >>= 1;
-	g_registers.L |= old_bit;
-	g_registers.FLAGS.Z = g_registers.L == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.L & 0x01) != 0;
+	d8 old_bit = g_cpu->registers.L & 0x80;
+	g_cpu->registers.L >>= 1;
+	g_cpu->registers.L |= old_bit;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
 	return 8;
 }
 
 static int _cpu_sra_imm_hl(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.C = (temp & 0x01) != 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.C = (temp & 0x01) != 0;
 	d8 old_bit = temp & 0x80;
 	temp >>= 1;
 	temp |= old_bit;
-	g_registers.FLAGS.Z = temp == 0;
-	mem_write8(g_registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_sra_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = (g_registers.A & 0x01) != 0;
-	d8 old_bit = g_registers.A & 0x80;
-	g_registers.A >>= 1;
-	g_registers.A |= old_bit;
-	g_registers.FLAGS.Z = g_registers.A == 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x01) != 0;
+	d8 old_bit = g_cpu->registers.A & 0x80;
+	g_cpu->registers.A >>= 1;
+	g_cpu->registers.A |= old_bit;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
 	return 8;
 }
 
 static int _cpu_swap_b(void)
 {
-	g_registers.PC += 1;
-	d8 upper_nibble = (g_registers.B & 0xF0) >> 4;
-	d8 lower_nibble = g_registers.B & 0x0F;
-	g_registers.B = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = g_registers.B == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	d8 upper_nibble = (g_cpu->registers.B & 0xF0) >> 4;
+	d8 lower_nibble = g_cpu->registers.B & 0x0F;
+	g_cpu->registers.B = (lower_nibble << 4) | upper_nibble;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_swap_c(void)
 {
-	g_registers.PC += 1;
-	d8 upper_nibble = (g_registers.C & 0xF0) >> 4;
-	d8 lower_nibble = g_registers.C & 0x0F;
-	g_registers.C = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = g_registers.C == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	d8 upper_nibble = (g_cpu->registers.C & 0xF0) >> 4;
+	d8 lower_nibble = g_cpu->registers.C & 0x0F;
+	g_cpu->registers.C = (lower_nibble << 4) | upper_nibble;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_swap_d(void)
 {
-	g_registers.PC += 1;
-	d8 upper_nibble = (g_registers.D & 0xF0) >> 4;
-	d8 lower_nibble = g_registers.D & 0x0F;
-	g_registers.D = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = g_registers.D == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	d8 upper_nibble = (g_cpu->registers.D & 0xF0) >> 4;
+	d8 lower_nibble = g_cpu->registers.D & 0x0F;
+	g_cpu->registers.D = (lower_nibble << 4) | upper_nibble;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_swap_e(void)
 {
-	g_registers.PC += 1;
-	d8 upper_nibble = (g_registers.E & 0xF0) >> 4;
-	d8 lower_nibble = g_registers.E & 0x0F;
-	g_registers.E = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = g_registers.E == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	d8 upper_nibble = (g_cpu->registers.E & 0xF0) >> 4;
+	d8 lower_nibble = g_cpu->registers.E & 0x0F;
+	g_cpu->registers.E = (lower_nibble << 4) | upper_nibble;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_swap_h(void)
 {
-	g_registers.PC += 1;
-	d8 upper_nibble = (g_registers.H & 0xF0) >> 4;
-	d8 lower_nibble = g_registers.H & 0x0F;
-	g_registers.H = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = g_registers.H == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	d8 upper_nibble = (g_cpu->registers.H & 0xF0) >> 4;
+	d8 lower_nibble = g_cpu->registers.H & 0x0F;
+	g_cpu->registers.H = (lower_nibble << 4) | upper_nibble;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_swap_l(void)
 {
-	g_registers.PC += 1;
-	d8 upper_nibble = (g_registers.L & 0xF0) >> 4;
-	d8 lower_nibble = g_registers.L & 0x0F;
-	g_registers.L = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = g_registers.L == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	d8 upper_nibble = (g_cpu->registers.L & 0xF0) >> 4;
+	d8 lower_nibble = g_cpu->registers.L & 0x0F;
+	g_cpu->registers.L = (lower_nibble << 4) | upper_nibble;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_swap_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	d8 upper_nibble = (temp & 0xF0) >> 4;
 	d8 lower_nibble = temp & 0x0F;
 	temp = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = temp == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
-	mem_write8(g_registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_swap_a(void)
 {
-	g_registers.PC += 1;
-	d8 upper_nibble = (g_registers.A & 0xF0) >> 4;
-	d8 lower_nibble = g_registers.A & 0x0F;
-	g_registers.A = (lower_nibble << 4) | upper_nibble;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	g_registers.FLAGS.C = 0;
+	g_cpu->registers.PC += 1;
+	d8 upper_nibble = (g_cpu->registers.A & 0xF0) >> 4;
+	d8 lower_nibble = g_cpu->registers.A & 0x0F;
+	g_cpu->registers.A = (lower_nibble << 4) | upper_nibble;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
 	return 8;
 }
 
 static int _cpu_srl_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.C = (g_registers.B & 0x01) != 0;
-	g_registers.B >>= 1;
-	g_registers.FLAGS.Z = g_registers.B == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.B & 0x01) != 0;
+	g_cpu->registers.B >>= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 8;
 }
 
 static int _cpu_srl_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.C = (g_registers.C & 0x01) != 0;
-	g_registers.C >>= 1;
-	g_registers.FLAGS.Z = g_registers.C == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.C & 0x01) != 0;
+	g_cpu->registers.C >>= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.C == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 8;
 }
 
 static int _cpu_srl_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.C = (g_registers.D & 0x01) != 0;
-	g_registers.D >>= 1;
-	g_registers.FLAGS.Z = g_registers.D == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.D & 0x01) != 0;
+	g_cpu->registers.D >>= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.D == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 8;
 }
 
 static int _cpu_srl_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.C = (g_registers.E & 0x01) != 0;
-	g_registers.E >>= 1;
-	g_registers.FLAGS.Z = g_registers.E == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.E & 0x01) != 0;
+	g_cpu->registers.E >>= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.E == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 8;
 }
 
 static int _cpu_srl_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.C = (g_registers.H & 0x01) != 0;
-	g_registers.H >>= 1;
-	g_registers.FLAGS.Z = g_registers.H == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.H & 0x01) != 0;
+	g_cpu->registers.H >>= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.H == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 8;
 }
 
 static int _cpu_srl_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.C = (g_registers.L & 0x01) != 0;
-	g_registers.L >>= 1;
-	g_registers.FLAGS.Z = g_registers.L == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.L & 0x01) != 0;
+	g_cpu->registers.L >>= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.L == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 8;
 }
 
 static int _cpu_srl_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.C = (temp & 0x01) != 0;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.C = (temp & 0x01) != 0;
 	temp >>= 1;
-	g_registers.FLAGS.Z = temp == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
-	mem_write8(g_registers.HL, temp);
+	g_cpu->registers.FLAGS.Z = temp == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_srl_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.C = (g_registers.A & 0x01) != 0;
-	g_registers.A >>= 1;
-	g_registers.FLAGS.Z = g_registers.A == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 0;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.C = (g_cpu->registers.A & 0x01) != 0;
+	g_cpu->registers.A >>= 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
 	return 8;
 }
 
 static int _cpu_bit_0_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_0_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_0_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_0_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_0_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_0_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_0_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_0_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x01) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x01) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_1_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_1_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_1_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_1_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_1_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_1_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_1_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_1_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x02) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x02) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_2_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_2_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_2_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_2_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_2_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_2_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_2_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_2_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x04) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x04) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_3_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_3_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_3_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_3_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_3_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_3_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_3_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_3_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x08) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x08) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_4_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_4_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_4_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_4_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_4_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_4_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_4_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_4_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x10) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x10) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_5_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_5_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_5_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_5_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_5_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_5_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_5_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_5_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x20) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x20) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_6_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_6_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_6_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_6_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_6_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_6_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_6_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_6_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x40) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x40) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_7_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.B & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.B & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_7_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.C & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.C & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_7_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.D & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.D & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_7_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.E & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.E & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_7_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.H & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.H & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_7_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.L & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.L & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_bit_7_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
-	g_registers.FLAGS.Z = (temp & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
+	g_cpu->registers.FLAGS.Z = (temp & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 16;
 }
 
 static int _cpu_bit_7_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.FLAGS.Z = (g_registers.A & 0x80) == 0;
-	g_registers.FLAGS.N = 0;
-	g_registers.FLAGS.H = 1;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.FLAGS.Z = (g_cpu->registers.A & 0x80) == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 1;
 	return 8;
 }
 
 static int _cpu_res_0_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x01;
 	return 8;
 }
 
 static int _cpu_res_0_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x01;
 	return 8;
 }
 
 static int _cpu_res_0_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x01;
 	return 8;
 }
 
 static int _cpu_res_0_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x01;
 	return 8;
 }
 
 static int _cpu_res_0_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x01;
 	return 8;
 }
 
 static int _cpu_res_0_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x01;
 	return 8;
 }
 
 static int _cpu_res_0_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x01;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_0_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x01;
 	return 8;
 }
 
 static int _cpu_res_1_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x02;
 	return 8;
 }
 
 static int _cpu_res_1_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x02;
 	return 8;
 }
 
 static int _cpu_res_1_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x02;
 	return 8;
 }
 
 static int _cpu_res_1_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x02;
 	return 8;
 }
 
 static int _cpu_res_1_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x02;
 	return 8;
 }
 
 static int _cpu_res_1_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x02;
 	return 8;
 }
 
 static int _cpu_res_1_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x02;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_1_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x02;
 	return 8;
 }
 
 static int _cpu_res_2_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x04;
 	return 8;
 }
 
 static int _cpu_res_2_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x04;
 	return 8;
 }
 
 static int _cpu_res_2_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x04;
 	return 8;
 }
 
 static int _cpu_res_2_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x04;
 	return 8;
 }
 
 static int _cpu_res_2_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x04;
 	return 8;
 }
 
 static int _cpu_res_2_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x04;
 	return 8;
 }
 
 static int _cpu_res_2_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x04;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_2_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x04;
 	return 8;
 }
 
 static int _cpu_res_3_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x08;
 	return 8;
 }
 
 static int _cpu_res_3_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x08;
 	return 8;
 }
 
 static int _cpu_res_3_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x08;
 	return 8;
 }
 
 static int _cpu_res_3_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x08;
 	return 8;
 }
 
 static int _cpu_res_3_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x08;
 	return 8;
 }
 
 static int _cpu_res_3_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x08;
 	return 8;
 }
 
 static int _cpu_res_3_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x08;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_3_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x08;
 	return 8;
 }
 
 static int _cpu_res_4_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x10;
 	return 8;
 }
 
 static int _cpu_res_4_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x10;
 	return 8;
 }
 
 static int _cpu_res_4_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x10;
 	return 8;
 }
 
 static int _cpu_res_4_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x10;
 	return 8;
 }
 
 static int _cpu_res_4_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x10;
 	return 8;
 }
 
 static int _cpu_res_4_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x10;
 	return 8;
 }
 
 static int _cpu_res_4_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x10;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_4_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x10;
 	return 8;
 }
 
 static int _cpu_res_5_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x20;
 	return 8;
 }
 
 static int _cpu_res_5_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x20;
 	return 8;
 }
 
 static int _cpu_res_5_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x20;
 	return 8;
 }
 
 static int _cpu_res_5_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x20;
 	return 8;
 }
 
 static int _cpu_res_5_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x20;
 	return 8;
 }
 
 static int _cpu_res_5_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x20;
 	return 8;
 }
 
 static int _cpu_res_5_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x20;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_5_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x20;
 	return 8;
 }
 
 static int _cpu_res_6_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x40;
 	return 8;
 }
 
 static int _cpu_res_6_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x40;
 	return 8;
 }
 
 static int _cpu_res_6_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x40;
 	return 8;
 }
 
 static int _cpu_res_6_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x40;
 	return 8;
 }
 
 static int _cpu_res_6_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x40;
 	return 8;
 }
 
 static int _cpu_res_6_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x40;
 	return 8;
 }
 
 static int _cpu_res_6_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x40;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_6_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x40;
 	return 8;
 }
 
 static int _cpu_res_7_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B &= ~0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B &= ~0x80;
 	return 8;
 }
 
 static int _cpu_res_7_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C &= ~0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C &= ~0x80;
 	return 8;
 }
 
 static int _cpu_res_7_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D &= ~0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D &= ~0x80;
 	return 8;
 }
 
 static int _cpu_res_7_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E &= ~0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E &= ~0x80;
 	return 8;
 }
 
 static int _cpu_res_7_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H &= ~0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H &= ~0x80;
 	return 8;
 }
 
 static int _cpu_res_7_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L &= ~0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L &= ~0x80;
 	return 8;
 }
 
 static int _cpu_res_7_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp &= ~0x80;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_res_7_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A &= ~0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A &= ~0x80;
 	return 8;
 }
 
 static int _cpu_set_0_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x01;
 	return 8;
 }
 
 static int _cpu_set_0_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x01;
 	return 8;
 }
 
 static int _cpu_set_0_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x01;
 	return 8;
 }
 
 static int _cpu_set_0_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x01;
 	return 8;
 }
 
 static int _cpu_set_0_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x01;
 	return 8;
 }
 
 static int _cpu_set_0_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x01;
 	return 8;
 }
 
 static int _cpu_set_0_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x01;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_0_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x01;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x01;
 	return 8;
 }
 
 static int _cpu_set_1_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x02;
 	return 8;
 }
 
 static int _cpu_set_1_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x02;
 	return 8;
 }
 
 static int _cpu_set_1_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x02;
 	return 8;
 }
 
 static int _cpu_set_1_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x02;
 	return 8;
 }
 
 static int _cpu_set_1_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x02;
 	return 8;
 }
 
 static int _cpu_set_1_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x02;
 	return 8;
 }
 
 static int _cpu_set_1_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x02;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_1_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x02;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x02;
 	return 8;
 }
 
 static int _cpu_set_2_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x04;
 	return 8;
 }
 
 static int _cpu_set_2_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x04;
 	return 8;
 }
 
 static int _cpu_set_2_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x04;
 	return 8;
 }
 
 static int _cpu_set_2_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x04;
 	return 8;
 }
 
 static int _cpu_set_2_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x04;
 	return 8;
 }
 
 static int _cpu_set_2_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x04;
 	return 8;
 }
 
 static int _cpu_set_2_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x04;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_2_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x04;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x04;
 	return 8;
 }
 
 static int _cpu_set_3_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x08;
 	return 8;
 }
 
 static int _cpu_set_3_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x08;
 	return 8;
 }
 
 static int _cpu_set_3_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x08;
 	return 8;
 }
 
 static int _cpu_set_3_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x08;
 	return 8;
 }
 
 static int _cpu_set_3_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x08;
 	return 8;
 }
 
 static int _cpu_set_3_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x08;
 	return 8;
 }
 
 static int _cpu_set_3_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x08;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_3_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x08;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x08;
 	return 8;
 }
 
 static int _cpu_set_4_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x10;
 	return 8;
 }
 
 static int _cpu_set_4_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x10;
 	return 8;
 }
 
 static int _cpu_set_4_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x10;
 	return 8;
 }
 
 static int _cpu_set_4_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x10;
 	return 8;
 }
 
 static int _cpu_set_4_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x10;
 	return 8;
 }
 
 static int _cpu_set_4_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x10;
 	return 8;
 }
 
 static int _cpu_set_4_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x10;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_4_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x10;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x10;
 	return 8;
 }
 
 static int _cpu_set_5_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x20;
 	return 8;
 }
 
 static int _cpu_set_5_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x20;
 	return 8;
 }
 
 static int _cpu_set_5_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x20;
 	return 8;
 }
 
 static int _cpu_set_5_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x20;
 	return 8;
 }
 
 static int _cpu_set_5_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x20;
 	return 8;
 }
 
 static int _cpu_set_5_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x20;
 	return 8;
 }
 
 static int _cpu_set_5_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x20;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_5_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x20;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x20;
 	return 8;
 }
 
 static int _cpu_set_6_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x40;
 	return 8;
 }
 
 static int _cpu_set_6_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x40;
 	return 8;
 }
 
 static int _cpu_set_6_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x40;
 	return 8;
 }
 
 static int _cpu_set_6_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x40;
 	return 8;
 }
 
 static int _cpu_set_6_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x40;
 	return 8;
 }
 
 static int _cpu_set_6_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x40;
 	return 8;
 }
 
 static int _cpu_set_6_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x40;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_6_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x40;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x40;
 	return 8;
 }
 
 static int _cpu_set_7_b(void)
 {
-	g_registers.PC += 1;
-	g_registers.B |= 0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.B |= 0x80;
 	return 8;
 }
 
 static int _cpu_set_7_c(void)
 {
-	g_registers.PC += 1;
-	g_registers.C |= 0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.C |= 0x80;
 	return 8;
 }
 
 static int _cpu_set_7_d(void)
 {
-	g_registers.PC += 1;
-	g_registers.D |= 0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.D |= 0x80;
 	return 8;
 }
 
 static int _cpu_set_7_e(void)
 {
-	g_registers.PC += 1;
-	g_registers.E |= 0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.E |= 0x80;
 	return 8;
 }
 
 static int _cpu_set_7_h(void)
 {
-	g_registers.PC += 1;
-	g_registers.H |= 0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.H |= 0x80;
 	return 8;
 }
 
 static int _cpu_set_7_l(void)
 {
-	g_registers.PC += 1;
-	g_registers.L |= 0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.L |= 0x80;
 	return 8;
 }
 
 static int _cpu_set_7_imm_hl(void)
 {
-	g_registers.PC += 1;
-	d8 temp = mem_read8(g_registers.HL);
+	g_cpu->registers.PC += 1;
+	d8 temp = mem_read8(g_cpu->registers.HL);
 	temp |= 0x80;
-	mem_write8(g_registers.HL, temp);
+	mem_write8(g_cpu->registers.HL, temp);
 	return 16;
 }
 
 static int _cpu_set_7_a(void)
 {
-	g_registers.PC += 1;
-	g_registers.A |= 0x80;
+	g_cpu->registers.PC += 1;
+	g_cpu->registers.A |= 0x80;
 	return 8;
 }
 
+/*
+ * Cycles that can run without any other component doing something the
+ * running code could observe: an interrupt that would be serviced (GPU,
+ * timer, serial), an H-blank DMA block or a scanline being drawn, see
+ * gpu_cycles_until_event. 0 while an interrupt is waiting to be serviced or
+ * an OAM DMA transfer locks memory.
+ * Only worked out when event_cycles has run out or after
+ * cpu_events_changed(), in between it is counted down by each instruction.
+ */
+static int _cpu_cycles_until_event(void)
+{
+	if (ints_is_pending() || mem_is_dma_locked())
+		return 0;
+
+	int budget = gpu_cycles_until_event();
+
+	if (g_cpu->double_speed)
+		budget = budget > INT_MAX / 2 ? INT_MAX : budget * 2;
+
+	if (ints_is_enabled(INT_TIMER_OVERFLOW))
+		budget = MIN(budget, timer_cycles_until_overflow());
+	if (ints_is_enabled(INT_SERIAL_IO_TRANSFER_COMPLETE))
+		budget = MIN(budget, serial_cycles_until_complete());
+
+	return budget;
+}
+
+// Fused instructions
+//========================================
+
+/*
+ * Superinstructions for the opcode pairs most frequently seen in games
+ * (copy/fill loops, polling of IO registers, counted loops).
+ * The second instruction is only executed when the byte following the first
+ * one matches the expected opcode, otherwise just the first one is executed.
+ * The second handler may be a fused handler itself, which chains short
+ * sequences like LD A,B / OR C / JR NZ into a single dispatch.
+ * Nothing else is stepped between the fused instructions, so they are only
+ * dispatched when the whole chain fits in _cpu_cycles_until_event(), which
+ * keeps interrupt dispatch and IO timing the same as one by one.
+ */
+#define CPU_FUSED_DEF_IF(NAME, FIRST, SECOND_CODE, CONDITION, SECOND)	\
+static int _cpu_fused_ ##NAME(void)	\
+{	\
+	int cycles = FIRST();	\
+	if (mem_read8(g_cpu->registers.PC) != SECOND_CODE || !(CONDITION))	\
+		return cycles;	\
+	return cycles + SECOND();	\
+}
+#define CPU_FUSED_DEF(NAME, FIRST, SECOND_CODE, SECOND)	\
+	CPU_FUSED_DEF_IF(NAME, FIRST, SECOND_CODE, true, SECOND)
+
+/*
+ * IO registers (DIV, LY, ...) would see a write of the second instruction
+ * before the cycles of the first one are stepped.
+ */
+#define _CPU_IS_IO(addr) (((addr) >= 0xFF00 && (addr) < 0xFF80) || (addr) == 0xFFFF)
+
+CPU_FUSED_DEF(or_c_jr_nz,        _cpu_or_c,             0x20, _cpu_jr_nz_r8)
+CPU_FUSED_DEF(ld_a_b_or_c,       _cpu_ld_a_b,           0xB1, _cpu_fused_or_c_jr_nz)
+CPU_FUSED_DEF_IF(ld_a_hl_inc_ld_de, _cpu_ld_a_imm_hl_inc, 0x12,
+		!_CPU_IS_IO(g_cpu->registers.DE), _cpu_ld_imm_de_a)
+CPU_FUSED_DEF(inc_de_dec_bc,     _cpu_inc_de,           0x0B, _cpu_dec_bc)
+CPU_FUSED_DEF(ld_hl_inc_dec_bc,  _cpu_ld_imm_hl_inc_a,  0x0B, _cpu_dec_bc)
+CPU_FUSED_DEF(dec_b_jr_nz,       _cpu_dec_b,            0x20, _cpu_jr_nz_r8)
+CPU_FUSED_DEF(dec_c_jr_nz,       _cpu_dec_c,            0x20, _cpu_jr_nz_r8)
+CPU_FUSED_DEF(dec_a_jr_nz,       _cpu_dec_a,            0x20, _cpu_jr_nz_r8)
+CPU_FUSED_DEF(and_d8_jr_z,       _cpu_and_d8,           0x28, _cpu_jr_z_r8)
+CPU_FUSED_DEF(ldh_a_a8_and_d8,   _cpu_ldh_a_imm_a8,     0xE6, _cpu_fused_and_d8_jr_z)
+
+#undef CPU_FUSED_DEF
+#undef CPU_FUSED_DEF_IF
+
+// Longest chain: LDH A,(a8) / AND d8 / JR Z taken
+#define CPU_FUSED_MAX_CYCLES	32
+
+// Block copy/fill loops
+//========================================
+
+/*
+ * Common memcpy/memset idioms are recognised at the head of the loop and
+ * executed natively, as many iterations at once as fit before the next
+ * event, see _cpu_cycles_until_event. Registers, flags and cycle count are
+ * the same as if the loop was executed instruction by instruction.
+ * If the loop cannot be executed natively (IO ports, overlapping ranges,
+ * writes to the loop's own code, not enough cycles until the next event)
+ * the regular handler is used.
+ */
+
+// LD A,(HL+) / LD (DE),A / INC DE / DEC BC / LD A,B / OR C / JR NZ,-8
+static const u8 g_loop_copy16[] = {0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8};
+// LD A,(HL+) / LD (DE),A / INC DE / DEC B / JR NZ,-6
+static const u8 g_loop_copy8[]  = {0x2A, 0x12, 0x13, 0x05, 0x20, 0xFA};
+// LD (HL+),A / DEC B / JR NZ,-4
+static const u8 g_loop_fill8[]  = {0x22, 0x05, 0x20, 0xFC};
+// LD A,d8 / LD (HL+),A / DEC BC / LD A,B / OR C / JR NZ,-8
+static const u8 g_loop_fill16[] = {0x3E, 0x00, 0x22, 0x0B, 0x78, 0xB1, 0x20, 0xF8};
+
+// Cycles of a single iteration, with the final jump taken
+#define CPU_LOOP_COPY16_CYCLES	52
+#define CPU_LOOP_COPY8_CYCLES	40
+#define CPU_LOOP_FILL8_CYCLES	24
+#define CPU_LOOP_FILL16_CYCLES	44
+// JR not taken on the last iteration
+#define CPU_LOOP_EXIT_CYCLES	4
+
+static bool _cpu_loop_match(const u8 *code, int length, int skip)
+{
+	for (int i = 0; i < length; i++)
+		if (i != skip && mem_read8(g_cpu->registers.PC + i) != code[i])
+			return false;
+	return true;
+}
+
+static int _cpu_loop_iterations(int iterations, int cycles_per_iteration)
+{
+	return MIN(iterations, g_cpu->event_cycles / cycles_per_iteration);
+}
+
+// Whether writing iterations bytes at dst would change the loop's own code
+static bool _cpu_loop_writes_code(a16 dst, int iterations, int length)
+{
+	a16 pc = g_cpu->registers.PC;
+	return dst < pc + length && pc < dst + iterations;
+}
+
+static int _cpu_loop_finish(int iterations, int remaining, int length,
+		int cycles_per_iteration)
+{
+	if (remaining != 0)
+		return iterations * cycles_per_iteration;
+
+	g_cpu->registers.PC += length;
+	return iterations * cycles_per_iteration - CPU_LOOP_EXIT_CYCLES;
+}
+
+static void _cpu_loop_or_bc(void)
+{
+	g_cpu->registers.A = g_cpu->registers.B | g_cpu->registers.C;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.A == 0;
+	g_cpu->registers.FLAGS.N = 0;
+	g_cpu->registers.FLAGS.H = 0;
+	g_cpu->registers.FLAGS.C = 0;
+}
+
+static void _cpu_loop_dec_b(int iterations)
+{
+	d8 left = g_cpu->registers.B - iterations + 1;
+	g_cpu->registers.B = left - 1;
+	g_cpu->registers.FLAGS.Z = g_cpu->registers.B == 0;
+	g_cpu->registers.FLAGS.N = 1;
+	g_cpu->registers.FLAGS.H = _CPU_IS_HALF_BORROW(left, 0x01);
+}
+
+static int _cpu_loop_copy16(void)
+{
+	if (g_cpu->registers.BC == 0
+			|| !_cpu_loop_match(g_loop_copy16, sizeof(g_loop_copy16), -1))
+		return 0;
+
+	int n = _cpu_loop_iterations(g_cpu->registers.BC, CPU_LOOP_COPY16_CYCLES);
+	if (n == 0
+			|| _cpu_loop_writes_code(g_cpu->registers.DE, n, sizeof(g_loop_copy16))
+			|| !mem_block_copy(g_cpu->registers.DE, g_cpu->registers.HL, n))
+		return 0;
+
+	g_cpu->registers.HL += n;
+	g_cpu->registers.DE += n;
+	g_cpu->registers.BC -= n;
+	_cpu_loop_or_bc();
+
+	return _cpu_loop_finish(n, g_cpu->registers.BC, sizeof(g_loop_copy16),
+			CPU_LOOP_COPY16_CYCLES);
+}
+
+static int _cpu_loop_copy8(void)
+{
+	if (!_cpu_loop_match(g_loop_copy8, sizeof(g_loop_copy8), -1))
+		return 0;
+
+	int count = g_cpu->registers.B == 0 ? 0x100 : g_cpu->registers.B;
+	int n = _cpu_loop_iterations(count, CPU_LOOP_COPY8_CYCLES);
+	if (n == 0
+			|| _cpu_loop_writes_code(g_cpu->registers.DE, n, sizeof(g_loop_copy8))
+			|| !mem_block_copy(g_cpu->registers.DE, g_cpu->registers.HL, n))
+		return 0;
+
+	g_cpu->registers.A = mem_read8(g_cpu->registers.HL + n - 1);
+	g_cpu->registers.HL += n;
+	g_cpu->registers.DE += n;
+	_cpu_loop_dec_b(n);
+
+	return _cpu_loop_finish(n, g_cpu->registers.B, sizeof(g_loop_copy8),
+			CPU_LOOP_COPY8_CYCLES);
+}
+
+static int _cpu_loop_fill8(void)
+{
+	if (!_cpu_loop_match(g_loop_fill8, sizeof(g_loop_fill8), -1))
+		return 0;
+
+	int count = g_cpu->registers.B == 0 ? 0x100 : g_cpu->registers.B;
+	int n = _cpu_loop_iterations(count, CPU_LOOP_FILL8_CYCLES);
+	if (n == 0
+			|| _cpu_loop_writes_code(g_cpu->registers.HL, n, sizeof(g_loop_fill8))
+			|| !mem_block_fill(g_cpu->registers.HL, g_cpu->registers.A, n))
+		return 0;
+
+	g_cpu->registers.HL += n;
+	_cpu_loop_dec_b(n);
+
+	return _cpu_loop_finish(n, g_cpu->registers.B, sizeof(g_loop_fill8),
+			CPU_LOOP_FILL8_CYCLES);
+}
+
+static int _cpu_loop_fill16(void)
+{
+	if (g_cpu->registers.BC == 0
+			|| !_cpu_loop_match(g_loop_fill16, sizeof(g_loop_fill16), 1))
+		return 0;
+
+	int n = _cpu_loop_iterations(g_cpu->registers.BC, CPU_LOOP_FILL16_CYCLES);
+	u8 data = mem_read8(g_cpu->registers.PC + 1);
+	if (n == 0
+			|| _cpu_loop_writes_code(g_cpu->registers.HL, n, sizeof(g_loop_fill16))
+			|| !mem_block_fill(g_cpu->registers.HL, data, n))
+		return 0;
+
+	g_cpu->registers.HL += n;
+	g_cpu->registers.BC -= n;
+	_cpu_loop_or_bc();
+
+	return _cpu_loop_finish(n, g_cpu->registers.BC, sizeof(g_loop_fill16),
+			CPU_LOOP_FILL16_CYCLES);
+}
+
+static int _cpu_loop_ld_a_hl_inc(void)
+{
+	int cycles = _cpu_loop_copy16();
+	if (cycles == 0)
+		cycles = _cpu_loop_copy8();
+	return cycles != 0 ? cycles : _cpu_fused_ld_a_hl_inc_ld_de();
+}
+
+static int _cpu_loop_ld_hl_inc_a(void)
+{
+	int cycles = _cpu_loop_fill8();
+	return cycles != 0 ? cycles : _cpu_fused_ld_hl_inc_dec_bc();
+}
+
+static int _cpu_loop_ld_a_d8(void)
+{
+	int cycles = _cpu_loop_fill16();
+	return cycles != 0 ? cycles : _cpu_ld_a_d8();
+}
+
+#ifdef CPU_PAIR_PROFILE
+static void _cpu_profile_pair(int opcode)
+{
+	if (g_pair_previous >= 0)
+		g_pair_counts[g_pair_previous][opcode]++;
+	g_pair_previous = opcode;
+}
+
+static void _cpu_print_pair_profile(void)
+{
+	uint64_t total = 0;
+	uint64_t printed[CPU_PAIR_PROFILE_TOP] = {0};
+	int first[CPU_PAIR_PROFILE_TOP], second[CPU_PAIR_PROFILE_TOP];
+
+	for (int i = 0; i < INSTRUCTIONS_NUMBER; i++)
+		for (int j = 0; j < INSTRUCTIONS_NUMBER; j++)
+			total += g_pair_counts[i][j];
+
+	if (total == 0)
+		return;
+
+	// Simple insertion into a sorted top list, the matrix is small enough
+	for (int i = 0; i < INSTRUCTIONS_NUMBER; i++) {
+		for (int j = 0; j < INSTRUCTIONS_NUMBER; j++) {
+			uint64_t count = g_pair_counts[i][j];
+			int k = CPU_PAIR_PROFILE_TOP;
+
+			while (k > 0 && printed[k - 1] < count) {
+				if (k < CPU_PAIR_PROFILE_TOP) {
+					printed[k] = printed[k - 1];
+					first[k] = first[k - 1];
+					second[k] = second[k - 1];
+				}
+				k--;
+			}
+			if (k < CPU_PAIR_PROFILE_TOP) {
+				printed[k] = count;
+				first[k] = i;
+				second[k] = j;
+			}
+		}
+	}
+
+	logger_print(LOG_INFO, "[CPU] Top opcode pairs (%llu total):\n",
+			(unsigned long long)total);
+	for (int k = 0; k < CPU_PAIR_PROFILE_TOP && printed[k] > 0; k++) {
+		logger_print(LOG_INFO, "  0x%02X 0x%02X  %12llu  %6.2f%%%s\n",
+				first[k], second[k],
+				(unsigned long long)printed[k],
+				100.0 * printed[k] / total,
+				g_fused_instruction_table[first[k]] ? "  (fused)" : "");
+	}
+}
+#endif
+
+#ifdef CPU_OPCODE_PROFILE
+static void _cpu_profile_opcode(int opcode, int cb_opcode, int cycles)
+{
+	if (opcode == 0xCB) {
+		g_opcode_counts[1][cb_opcode]++;
+		g_opcode_cycles[1][cb_opcode] += cycles;
+	} else {
+		g_opcode_counts[0][opcode]++;
+		g_opcode_cycles[0][opcode] += cycles;
+		if (cycles > g_branch_not_taken_cycles[opcode]
+				&& g_branch_not_taken_cycles[opcode] != 0)
+			g_opcode_taken[opcode]++;
+	}
+}
+
+static int _cpu_compare_opcodes(const void *a, const void *b)
+{
+	const int *x = a, *y = b;
+	uint64_t cycles_x = g_opcode_cycles[*x / INSTRUCTIONS_NUMBER][*x % INSTRUCTIONS_NUMBER];
+	uint64_t cycles_y = g_opcode_cycles[*y / INSTRUCTIONS_NUMBER][*y % INSTRUCTIONS_NUMBER];
+
+	if (cycles_x != cycles_y)
+		return cycles_x < cycles_y ? 1 : -1;
+	return *x - *y;
+}
+
+static void _cpu_print_opcode_profile(void)
+{
+	int order[2 * INSTRUCTIONS_NUMBER];
+	uint64_t total_count = 0, total_cycles = 0;
+
+	for (int i = 0; i < 2 * INSTRUCTIONS_NUMBER; i++) {
+		order[i] = i;
+		total_count += g_opcode_counts[i / INSTRUCTIONS_NUMBER][i % INSTRUCTIONS_NUMBER];
+		total_cycles += g_opcode_cycles[i / INSTRUCTIONS_NUMBER][i % INSTRUCTIONS_NUMBER];
+	}
+
+	if (total_count == 0)
+		return;
+
+	qsort(order, 2 * INSTRUCTIONS_NUMBER, sizeof(order[0]), _cpu_compare_opcodes);
+
+	logger_print(LOG_INFO, "[CPU] Opcodes by cycles (%llu instructions, %llu cycles):\n",
+			(unsigned long long)total_count, (unsigned long long)total_cycles);
+	logger_print(LOG_INFO, "  %-7s %-18s %12s %7s %14s %7s  %s\n",
+			"OPCODE", "MNEMONIC", "COUNT", "%", "CYCLES", "%", "TAKEN/NOT TAKEN");
+	for (int i = 0; i < 2 * INSTRUCTIONS_NUMBER; i++) {
+		int extended = order[i] / INSTRUCTIONS_NUMBER;
+		int opcode = order[i] % INSTRUCTIONS_NUMBER;
+		uint64_t count = g_opcode_counts[extended][opcode];
+		uint64_t cycles = g_opcode_cycles[extended][opcode];
+		char mnemonic[32];
+		char opcode_name[8];
+		char branches[48] = "";
+
+		if (count == 0)
+			break;
+
+		debug_mnemonic(opcode, extended, mnemonic, sizeof(mnemonic));
+		snprintf(opcode_name, sizeof(opcode_name), extended ? "CB %02X" : "%02X", opcode);
+		if (!extended && g_branch_not_taken_cycles[opcode] != 0)
+			snprintf(branches, sizeof(branches), "%llu/%llu",
+					(unsigned long long)g_opcode_taken[opcode],
+					(unsigned long long)(count - g_opcode_taken[opcode]));
+
+		logger_print(LOG_INFO, "  %-7s %-18s %12llu %6.2f%% %14llu %6.2f%%  %s\n",
+				opcode_name, mnemonic,
+				(unsigned long long)count, 100.0 * count / total_count,
+				(unsigned long long)cycles, 100.0 * cycles / total_cycles,
+				branches);
+	}
+}
+
+static void _cpu_opcode_profile_signal(int number __attribute__((unused)))
+{
+	g_opcode_profile_requested = 1;
+}
+#endif
+
 int cpu_single_step(void)
 {
-	if(g_cpu_stopped) {
+#ifdef CPU_OPCODE_PROFILE
+	if (g_opcode_profile_requested) {
+		g_opcode_profile_requested = 0;
+		_cpu_print_opcode_profile();
+	}
+#endif
+
+	if(g_cpu->stopped) {
+		g_cpu->event_cycles = -1;
 		return 4;
-	} else if(g_cpu_halted) {
+	} else if(g_cpu->halted) {
+#ifdef CPU_PAIR_PROFILE
+		g_pair_previous = -1;
+#endif
+		g_cpu->event_cycles = -1;
 		return 4;
 	} else {
 		// Fetch
 #ifdef DEBUG
-		debug_print_instruction(g_registers.PC);
+		debug_print_instruction(g_cpu->registers.PC);
 #endif
-		d8 instruction_code = mem_read8(g_registers.PC);
+		d8 instruction_code = mem_read8(g_cpu->registers.PC);
 		// Decode & Execute
+#if defined(CPU_PAIR_PROFILE) || defined(CPU_OPCODE_PROFILE) || defined(DEBUG)
+		// Profile and trace (DEBUG) the unfused instruction stream
+#ifdef CPU_PAIR_PROFILE
+		_cpu_profile_pair(instruction_code);
+#endif
+#ifdef CPU_OPCODE_PROFILE
+		d8 cb_code = instruction_code == 0xCB
+				? mem_read8(g_cpu->registers.PC + 1) : 0;
+#endif
 		int cycles = g_instruction_table[instruction_code]();
+#ifdef CPU_OPCODE_PROFILE
+		_cpu_profile_opcode(instruction_code, cb_code, cycles);
+#endif
+#else
+		// Fused handlers skip the per-instruction IME delay bookkeeping,
+		// so they are only used when no EI/DI is pending, and nothing is
+		// stepped between their instructions, so only when no interrupt
+		// or other event can come up until the end of the chain
+		cpu_instruction_t fused = g_fused_instruction_table[instruction_code];
+#ifdef CPU_LOCKSTEP
+		if (g_cpu->reference)
+			fused = NULL;
+#endif
+		if (g_cpu->event_cycles < 0)
+			g_cpu->event_cycles = _cpu_cycles_until_event();
+		int cycles = (fused != NULL && g_cpu->ime_delay < 0
+				&& g_cpu->event_cycles >= CPU_FUSED_MAX_CYCLES)
+				? fused()
+				: g_instruction_table[instruction_code]();
+		g_cpu->event_cycles -= cycles;
+#endif
 
-		if(g_ime_delay > 0) {
-			g_ime_delay -= 1;
+		if(g_cpu->ime_delay > 0) {
+			g_cpu->ime_delay -= 1;
 		}
-		if(g_ime_delay == 0) {
-			g_ime_delay = -1;
-			g_ime_op == IME_OP_EI ? ints_set_ime() : ints_reset_ime();
+		if(g_cpu->ime_delay == 0) {
+			g_cpu->ime_delay = -1;
+			g_cpu->ime_op == IME_OP_EI ? ints_set_ime() : ints_reset_ime();
 		}
 		return cycles;
 	}
 }
 
 
+void cpu_events_changed(void)
+{
+	if (g_cpu != NULL)
+		g_cpu->event_cycles = -1;
+}
+
+
 void cpu_jump(a16 addr)
 {
-	g_registers.PC = addr;
+	g_cpu->registers.PC = addr;
 }
 
 
 void cpu_call(a16 addr)
 {
 	// Push PC onto stack
-	cpu_push16(g_registers.PC);
+	cpu_push16(g_cpu->registers.PC);
 	// Jump to given address
 	cpu_jump(addr);
+	_cpu_notify_call();
 }
 
 
-void cpu_prepare(void)
+// Instruction tables are shared by all contexts and filled in only once
+static void _cpu_prepare_tables(void)
 {
 	g_instruction_table[0x00] = _cpu_nop;
 	g_instruction_table[0x01] = _cpu_ld_bc_d16;
@@ -5529,45 +6064,113 @@ void cpu_prepare(void)
 	g_cb_prefix_instruction_table[0xFE] = _cpu_set_7_imm_hl;
 	g_cb_prefix_instruction_table[0xFF] = _cpu_set_7_a;
 
-	registers_prepare(&g_registers);
+	g_fused_instruction_table[0x05] = _cpu_fused_dec_b_jr_nz;
+	g_fused_instruction_table[0x0D] = _cpu_fused_dec_c_jr_nz;
+	g_fused_instruction_table[0x13] = _cpu_fused_inc_de_dec_bc;
+	g_fused_instruction_table[0x22] = _cpu_loop_ld_hl_inc_a;
+	g_fused_instruction_table[0x2A] = _cpu_loop_ld_a_hl_inc;
+	g_fused_instruction_table[0x3D] = _cpu_fused_dec_a_jr_nz;
+	g_fused_instruction_table[0x3E] = _cpu_loop_ld_a_d8;
+	g_fused_instruction_table[0x78] = _cpu_fused_ld_a_b_or_c;
+	g_fused_instruction_table[0xB1] = _cpu_fused_or_c_jr_nz;
+	g_fused_instruction_table[0xE6] = _cpu_fused_and_d8_jr_z;
+	g_fused_instruction_table[0xF0] = _cpu_fused_ldh_a_a8_and_d8;
+}
+
+
+bool cpu_prepare(void)
+{
+	static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+	pthread_once(&tables_once, _cpu_prepare_tables);
+
+	g_cpu = calloc(1, sizeof(*g_cpu));
+	if (g_cpu == NULL) {
+		logger_print(LOG_FATAL, "CPU: couldn't allocate the context.\n");
+		return false;
+	}
+	g_cpu->ime_op = IME_OP_DI;
+
+#ifdef CPU_OPCODE_PROFILE
+	struct sigaction action = { .sa_handler = _cpu_opcode_profile_signal };
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGUSR2, &action, NULL);
+#endif
+
+	registers_prepare(&g_cpu->registers);
 	mem_register_handlers(SPEED_SWITCH_ADDR,
 			_cpu_double_speed_read_handler, _cpu_double_speed_write_handler);
+
+	state_register(&g_cpu->registers, sizeof(g_cpu->registers));
+	state_register(&g_cpu->halted, sizeof(g_cpu->halted));
+	state_register(&g_cpu->stopped, sizeof(g_cpu->stopped));
+	state_register(&g_cpu->double_speed, sizeof(g_cpu->double_speed));
+	state_register(&g_cpu->speed_switch, sizeof(g_cpu->speed_switch));
+	state_register(&g_cpu->ime_delay, sizeof(g_cpu->ime_delay));
+	state_register(&g_cpu->ime_op, sizeof(g_cpu->ime_op));
+
+	return true;
+}
+
+#ifdef CPU_LOCKSTEP
+void cpu_set_reference(bool reference)
+{
+	g_cpu->reference = reference;
+}
+#endif
+
+void cpu_set_call_hooks(const struct cpu_call_hooks *hooks)
+{
+	g_cpu->call_hooks = hooks;
+}
+
+void cpu_destroy(void)
+{
+#ifdef CPU_PAIR_PROFILE
+	_cpu_print_pair_profile();
+#endif
+#ifdef CPU_OPCODE_PROFILE
+	_cpu_print_opcode_profile();
+#endif
+
+	free(g_cpu);
+	g_cpu = NULL;
 }
 
 
 void cpu_push8(u8 data)
 {
 	//Decrement Stack Pointer
-	g_registers.SP -= 1;
+	g_cpu->registers.SP -= 1;
 	// Save data at the new location
-	mem_write8(g_registers.SP, data);
+	mem_write8(g_cpu->registers.SP, data);
 }
 
 
 void cpu_push16(u16 data)
 {
 	//Decrement Stack Pointer
-	g_registers.SP -= 2;
+	g_cpu->registers.SP -= 2;
 	// Save data at the new location
-	mem_write16(g_registers.SP, data);
+	mem_write16(g_cpu->registers.SP, data);
 }
 
 bool cpu_get_halted()
 {
-	return g_cpu_halted;
+	return g_cpu->halted;
 }
 
 void cpu_set_halted(bool val)
 {
-	g_cpu_halted = val;
+	g_cpu->halted = val;
 }
 
 bool cpu_get_stopped()
 {
-	return g_cpu_stopped;
+	return g_cpu->stopped;
 }
 
 void cpu_set_stopped(bool val)
 {
-	g_cpu_stopped = val;
+	g_cpu->stopped = val;
 }
@@ -1,3 +1,4 @@
+#include<stdio.h>
 #include<stdlib.h>
 #include"debug.h"
 #include"logger.h"
@@ -545,33 +546,71 @@ static char* _debug_op_extended_mnemonic_format(d8 opcode)
 	return extended_instruction_infos[opcode].mnemonic_format;
 }
 
-void debug_print_instruction(u16 pc)
+/* Write the mnemonic of the given opcode to buffer, with the operands
+ * left as nn (8 bit) or nnnn (16 bit).
+ */
+void debug_mnemonic(d8 opcode, bool extended, char *buffer, size_t size)
+{
+	const char *format = extended
+			? _debug_op_extended_mnemonic_format(opcode)
+			: _debug_op_mnemonic_format(opcode);
+	size_t length = 0;
+
+	if (size == 0)
+		return;
+
+	while (*format != '\0' && length + 1 < size) {
+		if (*format != '%') {
+			buffer[length++] = *format == '\t' ? ' ' : *format;
+			format++;
+			continue;
+		}
+		// %02X, %04X or %d, as wide as the operand
+		char *end;
+		long digits = strtol(format + 1, &end, 10);
+		if (digits == 0)
+			digits = 2;
+		for (long i = 0; i < digits && length + 1 < size; i++)
+			buffer[length++] = 'n';
+		format = *end != '\0' ? end + 1 : end;
+	}
+	buffer[length] = '\0';
+}
+
+/* Write the instruction at pc, with its operands, to buffer.
+ *
+ * @return the length of the instruction in bytes
+ */
+int debug_disassemble(u16 pc, char *buffer, size_t size)
 {
 	d8 opcode = mem_read8(pc);
 
-	int len = _debug_op_length(opcode);
-	switch(len) {
-	case 1:
-		logger_print(LOG_INFO, "0x%04X\t%s\n", pc,
-				_debug_op_mnemonic_format(opcode));
-		break;
+	switch(_debug_op_length(opcode)) {
 	case 2:
-		logger_print(LOG_INFO, "0x%04X\t", pc);
-		logger_print(LOG_INFO, _debug_op_mnemonic_format(opcode), mem_read8(pc+1));
-		logger_print(LOG_INFO, "\n");
-		break;
+		snprintf(buffer, size, _debug_op_mnemonic_format(opcode), mem_read8(pc+1));
+		return 2;
 	case 3:
-		logger_print(LOG_INFO, "0x%04X\t", pc);
-		logger_print(LOG_INFO, _debug_op_mnemonic_format(opcode), mem_read16(pc+1));
-		logger_print(LOG_INFO, "\n");
-		break;
+		snprintf(buffer, size, _debug_op_mnemonic_format(opcode), mem_read16(pc+1));
+		return 3;
 	case 4:
-		// CB prefix special print
-		logger_print(LOG_INFO, "0x%04X\tCB %s\n", pc,
+		// CB prefix
+		snprintf(buffer, size, "CB %s",
 				_debug_op_extended_mnemonic_format(mem_read8(pc+1)));
+		return 2;
+	default:
+		snprintf(buffer, size, "%s", _debug_op_mnemonic_format(opcode));
+		return 1;
 	}
 }
 
+void debug_print_instruction(u16 pc)
+{
+	char instruction[32];
+
+	debug_disassemble(pc, instruction, sizeof(instruction));
+	logger_print(LOG_INFO, "0x%04X\t%s\n", pc, instruction);
+}
+
 void debug_assert(
 #ifdef DEBUG
 		bool         expr,
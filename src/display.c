@@ -1,19 +1,73 @@
 #include<SDL2/SDL.h>
+#include<stdatomic.h>
+#include<string.h>
 #include"cpu.h"
 #include"debug.h"
 #include"display.h"
 #include"events.h"
 #include"logger.h"
-
+#include"profile.h"
+#include"scale.h"
+#include"trace.h"
+
+/*
+ * Every frame comes with a hash of each of its lines. Buffers and the texture
+ * remember the hashes of the lines they hold, so only lines that changed are
+ * converted and uploaded, and a frame identical to the one on screen is not
+ * presented at all.
+ *
+ * Frames are presented by a separate thread, which owns the SDL renderer and
+ * wakes up on every tick of the frame timer. Completed frames are handed over
+ * through a triple buffer: the emulation thread fills the back buffer and
+ * swaps it with the shared one, the presenter swaps the shared buffer with
+ * its front buffer when a new frame is there. Neither side ever waits for the
+ * other. A frame replaced before the presenter got to it is dropped, a tick
+ * without a new frame presents the previous one again.
+ *
+ * When upscaling (see scale.h), the lines around the changed ones are scaled
+ * straight into the locked texture instead.
+ */
+
+#define DISPLAY_BUFFERS       3
+#define DISPLAY_BUFFER_INDEX  0x03
+#define DISPLAY_BUFFER_NEW    0x04
+
+// RGB565 pixels go to the texture as they are, colours are converted
+#ifdef DISPLAY_RGB565
+#define DISPLAY_TEXTURE_FORMAT  SDL_PIXELFORMAT_RGB565
+#else
+#define DISPLAY_TEXTURE_FORMAT  SDL_PIXELFORMAT_ABGR8888
+#endif
 
 static SDL_Window   * g_window    = NULL;
 static SDL_Renderer * g_renderer  = NULL;
 static SDL_Texture  * g_texture   = NULL;
-static uint32_t       g_buffer[SCREEN_WIDTH * SCREEN_HEIGHT];
 static SDL_TimerID    g_sdl_timer;
 
 static float g_scale = SCALING_FACTOR;
 
+static texel       g_buffers[DISPLAY_BUFFERS][SCREEN_WIDTH * SCREEN_HEIGHT];
+static uint64_t    g_buffer_hashes[DISPLAY_BUFFERS][SCREEN_HEIGHT];
+static uint64_t    g_texture_hashes[SCREEN_HEIGHT];
+static int         g_back_buffer   = 0;
+static int         g_front_buffer  = 1;
+static atomic_int  g_shared_buffer = 2;
+
+static SDL_Thread  * g_presenter         = NULL;
+static SDL_sem     * g_presenter_tick    = NULL;
+static SDL_sem     * g_presenter_ready   = NULL;
+static atomic_bool   g_presenter_stop    = false;
+static bool          g_presenter_failed  = false;
+
+static unsigned long g_frames_drawn      = 0;
+static unsigned long g_frames_presented  = 0;
+static unsigned long g_frames_unchanged  = 0;
+static unsigned long g_frames_dropped    = 0;
+static unsigned long g_frames_duplicated = 0;
+static unsigned long g_lines_uploaded    = 0;
+static Uint64        g_convert_ticks     = 0;
+static Uint64        g_upload_ticks      = 0;
+
 
 static void _display_error(enum logger_log_type type, char *title, const char *message)
 {
@@ -33,50 +87,13 @@ static Uint32 _display_timer_callback(
 		Uint32 interval,
 		__attribute__((unused)) void * param )
 {
-	SDL_Event event;
-	SDL_UserEvent user_event;
-
-	user_event.type  = SDL_USEREVENT;
-	user_event.code  = FRAME_TIMER_EVENT;
-	user_event.data1 = NULL;
-	user_event.data2 = NULL;
-
-	event.type = SDL_USEREVENT;
-	event.user = user_event;
-
-	SDL_PushEvent(&event);
+	SDL_SemPost(g_presenter_tick);
 	return interval;
 }
 
 
-static void _display_sdl_prepare(float period, char * rom_title, bool fullscreen)
+static bool _display_sdl_renderer_prepare(void)
 {
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_EVENTS) != 0) {
-		_display_error(
-			LOG_FATAL,
-			"SDL INIT",
-			SDL_GetError()
-		);
-		return;
-	}
-
-	g_window = SDL_CreateWindow(
-		rom_title,
-		SDL_WINDOWPOS_CENTERED,
-		SDL_WINDOWPOS_CENTERED,
-		SCREEN_WIDTH  * g_scale,
-		SCREEN_HEIGHT * g_scale,
-		fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : SDL_WINDOW_SHOWN
-	);
-	if (g_window == NULL) {
-		_display_error(
-			LOG_FATAL,
-			"SDL WINDOW",
-			SDL_GetError()
-		);
-		return;
-	}
-
 	g_renderer = SDL_CreateRenderer(
 		g_window,
 		-1,
@@ -88,7 +105,7 @@ static void _display_sdl_prepare(float period, char * rom_title, bool fullscreen
 			"SDL RENDERER",
 			SDL_GetError()
 		);
-		return;
+		return false;
 	} else {
 		if (SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, SDL_ALPHA_OPAQUE) != 0) {
 			_display_error(
@@ -96,7 +113,7 @@ static void _display_sdl_prepare(float period, char * rom_title, bool fullscreen
 				"SDL SET RENDER COLOR",
 				SDL_GetError()
 			);
-			return;
+			return false;
 		}
 	}
 
@@ -104,10 +121,10 @@ static void _display_sdl_prepare(float period, char * rom_title, bool fullscreen
 
 	g_texture = SDL_CreateTexture(
 		g_renderer,
-		SDL_PIXELFORMAT_ABGR8888,
+		DISPLAY_TEXTURE_FORMAT,
 		SDL_TEXTUREACCESS_STREAMING,
-		SCREEN_WIDTH,
-		SCREEN_HEIGHT
+		SCREEN_WIDTH * scale_factor(),
+		SCREEN_HEIGHT * scale_factor()
 	);
 	if (g_texture == NULL) {
 		_display_error(
@@ -115,25 +132,98 @@ static void _display_sdl_prepare(float period, char * rom_title, bool fullscreen
 			"SDL TEXTURE",
 			SDL_GetError()
 		);
-		return;
+		return false;
 	}
 
-	g_sdl_timer = SDL_AddTimer(period * 1000, _display_timer_callback, NULL);
-	if(g_sdl_timer == 0) {
+	return true;
+}
+
+
+static void _display_sdl_renderer_destroy(void)
+{
+	if(g_texture != NULL)
+		SDL_DestroyTexture(g_texture);
+	if(g_renderer != NULL)
+		SDL_DestroyRenderer(g_renderer);
+}
+
+
+// Scale the lines of the front buffer that differ from the texture into it
+static int _display_sdl_upload_scaled(void)
+{
+	const uint64_t *hashes = g_buffer_hashes[g_front_buffer];
+	int first = SCREEN_HEIGHT, last = -1;
+
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		if (hashes[y] == g_texture_hashes[y])
+			continue;
+		g_texture_hashes[y] = hashes[y];
+		first = MIN(first, y);
+		last = y;
+	}
+	if (last < 0)
+		return 0;
+
+	// Filters look at neighbouring lines too
+	int changed = last - first + 1;
+	first = MAX(first - scale_radius(), 0);
+	last = MIN(last + scale_radius(), SCREEN_HEIGHT - 1);
+
+	int factor = scale_factor();
+	SDL_Rect rect = {
+		0, first * factor, SCREEN_WIDTH * factor, (last - first + 1) * factor
+	};
+	void *pixels;
+	int pitch;
+	if (SDL_LockTexture(g_texture, &rect, &pixels, &pitch) != 0) {
 		_display_error(
-			LOG_FATAL,
-			"SDL TIMER",
+			LOG_WARN,
+			"SDL LOCK TEXTURE",
 			SDL_GetError()
 		);
-		return;
+		return changed;
 	}
+	scale_frame(g_buffers[g_front_buffer], first, last, pixels, pitch);
+	SDL_UnlockTexture(g_texture);
 
-	if (fullscreen)
-		SDL_ShowCursor(SDL_DISABLE);
+	return changed;
+}
+
+
+// Upload the lines of the front buffer that differ from the texture
+static int _display_sdl_upload(void)
+{
+	const uint64_t *hashes = g_buffer_hashes[g_front_buffer];
+	int uploaded = 0;
+
+	if (scale_factor() > 1)
+		return _display_sdl_upload_scaled();
+
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		if (hashes[y] == g_texture_hashes[y])
+			continue;
+
+		int first = y;
+		while (y < SCREEN_HEIGHT && hashes[y] != g_texture_hashes[y]) {
+			g_texture_hashes[y] = hashes[y];
+			y++;
+		}
+
+		SDL_Rect rect = { 0, first, SCREEN_WIDTH, y - first };
+		SDL_UpdateTexture(
+			g_texture,
+			&rect,
+			g_buffers[g_front_buffer] + first * SCREEN_WIDTH,
+			SCREEN_WIDTH * sizeof(texel)
+		);
+		uploaded += y - first;
+	}
+
+	return uploaded;
 }
 
 
-static void _display_sdl_draw(colour screen[SCREEN_HEIGHT][SCREEN_WIDTH])
+static void _display_sdl_draw(void)
 {
 	if (SDL_RenderClear(g_renderer) != 0) {
 		_display_error(
@@ -144,27 +234,115 @@ static void _display_sdl_draw(colour screen[SCREEN_HEIGHT][SCREEN_WIDTH])
 		return;
 	}
 
-	u8 *ptr = (u8*) g_buffer;
-	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+	SDL_RenderCopy(g_renderer, g_texture, NULL, NULL);
+	SDL_RenderPresent(g_renderer);
+}
+
 
-		for(int x = 0; x < SCREEN_WIDTH; x++) {
-			*ptr++ = screen[y][x].r;
-			*ptr++ = screen[y][x].g;
-			*ptr++ = screen[y][x].b;
-			*ptr++ = (screen[y][x].a) ? SDL_ALPHA_OPAQUE : SDL_ALPHA_TRANSPARENT;
+static int _display_presenter(__attribute__((unused)) void *data)
+{
+	g_presenter_failed = !_display_sdl_renderer_prepare();
+	SDL_SemPost(g_presenter_ready);
+	if (g_presenter_failed)
+		return 1;
+
+	while (true) {
+		SDL_SemWait(g_presenter_tick);
+		if (atomic_load(&g_presenter_stop))
+			break;
+
+		if (atomic_load(&g_shared_buffer) & DISPLAY_BUFFER_NEW) {
+			g_front_buffer = atomic_exchange(&g_shared_buffer, g_front_buffer)
+				& DISPLAY_BUFFER_INDEX;
+
+			Uint64 start = SDL_GetPerformanceCounter();
+			int uploaded = _display_sdl_upload();
+			g_upload_ticks += SDL_GetPerformanceCounter() - start;
+			if (uploaded == 0) {
+				g_frames_unchanged++;
+				continue;
+			}
+			g_lines_uploaded += uploaded;
+			g_frames_presented++;
+		} else if (g_frames_presented > 0) {
+			g_frames_duplicated++;
+		} else {
+			continue;
 		}
 
+		_display_sdl_draw();
 	}
 
-	SDL_UpdateTexture(
-		g_texture,
-		NULL,
-		&g_buffer,
-		SCREEN_WIDTH * 4
+	_display_sdl_renderer_destroy();
+	return 0;
+}
+
+
+static void _display_sdl_prepare(float period, char * rom_title, bool fullscreen)
+{
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_EVENTS) != 0) {
+		_display_error(
+			LOG_FATAL,
+			"SDL INIT",
+			SDL_GetError()
+		);
+		return;
+	}
+
+	g_window = SDL_CreateWindow(
+		rom_title,
+		SDL_WINDOWPOS_CENTERED,
+		SDL_WINDOWPOS_CENTERED,
+		SCREEN_WIDTH  * g_scale,
+		SCREEN_HEIGHT * g_scale,
+		fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : SDL_WINDOW_SHOWN
 	);
+	if (g_window == NULL) {
+		_display_error(
+			LOG_FATAL,
+			"SDL WINDOW",
+			SDL_GetError()
+		);
+		return;
+	}
 
-	SDL_RenderCopy(g_renderer, g_texture, NULL, NULL);
-	SDL_RenderPresent(g_renderer);
+	g_presenter_tick = SDL_CreateSemaphore(0);
+	g_presenter_ready = SDL_CreateSemaphore(0);
+	if (g_presenter_tick == NULL || g_presenter_ready == NULL) {
+		_display_error(
+			LOG_FATAL,
+			"SDL SEMAPHORE",
+			SDL_GetError()
+		);
+		return;
+	}
+
+	// The renderer is created, used and destroyed by the presenter only
+	g_presenter = SDL_CreateThread(_display_presenter, "presenter", NULL);
+	if (g_presenter == NULL) {
+		_display_error(
+			LOG_FATAL,
+			"SDL THREAD",
+			SDL_GetError()
+		);
+		return;
+	}
+	SDL_SemWait(g_presenter_ready);
+	if (g_presenter_failed)
+		return;
+
+	g_sdl_timer = SDL_AddTimer(period * 1000, _display_timer_callback, NULL);
+	if(g_sdl_timer == 0) {
+		_display_error(
+			LOG_FATAL,
+			"SDL TIMER",
+			SDL_GetError()
+		);
+		return;
+	}
+
+	if (fullscreen)
+		SDL_ShowCursor(SDL_DISABLE);
 }
 
 
@@ -172,8 +350,15 @@ static void _display_sdl_destroy()
 {
 	if(g_sdl_timer != 0)
 		SDL_RemoveTimer(g_sdl_timer);
-	if(g_texture != NULL)
-		SDL_DestroyTexture(g_texture);
+	if(g_presenter != NULL) {
+		atomic_store(&g_presenter_stop, true);
+		SDL_SemPost(g_presenter_tick);
+		SDL_WaitThread(g_presenter, NULL);
+	}
+	if(g_presenter_tick != NULL)
+		SDL_DestroySemaphore(g_presenter_tick);
+	if(g_presenter_ready != NULL)
+		SDL_DestroySemaphore(g_presenter_ready);
 	if(g_window != NULL)
 		SDL_DestroyWindow(g_window);
 	SDL_Quit();
@@ -183,21 +368,64 @@ static void _display_sdl_destroy()
 // -------------- MAIN SECTION --------------
 
 
+static void _display_convert_line(const pixel src[SCREEN_WIDTH], texel dst[SCREEN_WIDTH])
+{
+#ifdef DISPLAY_RGB565
+	memcpy(dst, src, SCREEN_WIDTH * sizeof(texel));
+#else
+	u8 *ptr = (u8*) dst;
+	for(int x = 0; x < SCREEN_WIDTH; x++) {
+		*ptr++ = src[x].r;
+		*ptr++ = src[x].g;
+		*ptr++ = src[x].b;
+		*ptr++ = (src[x].a) ? SDL_ALPHA_OPAQUE : SDL_ALPHA_TRANSPARENT;
+	}
+#endif
+}
+
+
 void display_prepare(float period, char * rom_title, bool fullscreen)
 {
+	g_scale = SCALING_FACTOR * scale_factor();
 	_display_sdl_prepare(period, rom_title, fullscreen);
 }
 
-void display_draw(colour screen[SCREEN_HEIGHT][SCREEN_WIDTH])
+void display_draw(pixel screen[SCREEN_HEIGHT][SCREEN_WIDTH],
+		const uint64_t line_hashes[SCREEN_HEIGHT])
 {
-	if(!events_is_frame_ready()) {
+	PROFILE_BEGIN(PROFILE_DISPLAY);
+	TRACE_BEGIN(present);
+	Uint64 start = SDL_GetPerformanceCounter();
+	uint64_t *hashes = g_buffer_hashes[g_back_buffer];
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		if (hashes[y] == line_hashes[y])
+			continue;
+		hashes[y] = line_hashes[y];
+
+		_display_convert_line(screen[y],
+				g_buffers[g_back_buffer] + y * SCREEN_WIDTH);
+	}
+	g_convert_ticks += SDL_GetPerformanceCounter() - start;
+	g_frames_drawn++;
+
+	int previous = atomic_exchange(&g_shared_buffer,
+			g_back_buffer | DISPLAY_BUFFER_NEW);
+	if (previous & DISPLAY_BUFFER_NEW) {
+		g_frames_dropped++;
 #ifdef DEBUG
-		logger_print(LOG_INFO, "[DISPLAY] SDL Premature frame calculation\n");
+		logger_print(LOG_INFO, "[DISPLAY] Frame dropped before presentation\n");
 #endif
-		return;
 	}
+	g_back_buffer = previous & DISPLAY_BUFFER_INDEX;
+	TRACE_END(present, TRACE_DISPLAY, "present", "dropped",
+			(previous & DISPLAY_BUFFER_NEW) != 0);
+	PROFILE_END(PROFILE_DISPLAY);
+}
 
-	_display_sdl_draw(screen);
+
+bool display_frame_wanted(void)
+{
+	return !(atomic_load(&g_shared_buffer) & DISPLAY_BUFFER_NEW);
 }
 
 
@@ -212,4 +440,27 @@ bool display_get_closed_status(void)
 void display_destroy(void)
 {
 	_display_sdl_destroy();
+
+	unsigned long frames = g_frames_presented + g_frames_unchanged;
+	logger_print(
+		LOG_INFO,
+		"Display: %lu frames presented, %lu dropped, %lu duplicated, "
+		"%lu unchanged (%.1f%% skipped, %.1f%% of lines uploaded).\n",
+		g_frames_presented,
+		g_frames_dropped,
+		g_frames_duplicated,
+		g_frames_unchanged,
+		frames ? 100.0 * g_frames_unchanged / frames : 0.0,
+		frames ? 100.0 * g_lines_uploaded / (frames * SCREEN_HEIGHT) : 0.0
+	);
+
+	// Time spent moving pixels towards the GPU
+	double us_per_tick = 1e6 / SDL_GetPerformanceFrequency();
+	logger_print(
+		LOG_INFO,
+		"Display: %d bit pixels, %.1f us converting, %.1f us uploading per frame.\n",
+		(int) sizeof(texel) * 8,
+		g_frames_drawn ? g_convert_ticks * us_per_tick / g_frames_drawn : 0.0,
+		frames ? g_upload_ticks * us_per_tick / frames : 0.0
+	);
 }
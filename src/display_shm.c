@@ -0,0 +1,141 @@
+#include<fcntl.h>
+#include<limits.h>
+#include<linux/futex.h>
+#include<string.h>
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<time.h>
+#include<unistd.h>
+#include"display_shm.h"
+#include"logger.h"
+
+#define _DISPLAY_SHM_STRIDE    (SCREEN_WIDTH * 4)
+#define _DISPLAY_SHM_SLOT_SIZE (sizeof(struct display_shm_slot) \
+		+ _DISPLAY_SHM_STRIDE * SCREEN_HEIGHT)
+#define _DISPLAY_SHM_SIZE      (sizeof(struct display_shm_header) \
+		+ _DISPLAY_SHM_SLOT_SIZE * DISPLAY_SHM_SLOTS)
+
+static char                       g_name[NAME_MAX]  = {0};
+static struct display_shm_header *g_header          = NULL;
+static uint64_t                   g_frame           = 0;
+
+
+static void _display_shm_error(const char *message)
+{
+	logger_log(
+		LOG_WARN,
+		"SHARED MEMORY",
+		"[DISPLAY MODULE] %s: %s\n",
+		message,
+		g_name
+	);
+}
+
+
+static struct display_shm_slot *_display_shm_slot(uint64_t frame)
+{
+	return (struct display_shm_slot *)((u8 *)(g_header + 1)
+		+ ((frame - 1) % DISPLAY_SHM_SLOTS) * _DISPLAY_SHM_SLOT_SIZE);
+}
+
+
+static void _display_shm_wake(void)
+{
+	syscall(SYS_futex, &g_header->frames, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+/* Create (or replace) the shared memory object name, e.g. "/gbc". Frames are
+ * only published once this succeeds.
+ */
+bool display_shm_prepare(const char *name)
+{
+	strncpy(g_name, name, NAME_MAX - 1);
+
+	int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0) {
+		_display_shm_error("COULD NOT OPEN");
+		return false;
+	}
+
+	if (ftruncate(fd, _DISPLAY_SHM_SIZE) != 0) {
+		_display_shm_error("COULD NOT RESIZE");
+		close(fd);
+		shm_unlink(name);
+		return false;
+	}
+
+	void *mem = mmap(NULL, _DISPLAY_SHM_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		_display_shm_error("COULD NOT MAP");
+		shm_unlink(name);
+		return false;
+	}
+
+	g_header = mem;
+	g_header->magic     = DISPLAY_SHM_MAGIC;
+	g_header->version   = DISPLAY_SHM_VERSION;
+	g_header->slots     = DISPLAY_SHM_SLOTS;
+	g_header->slot_size = _DISPLAY_SHM_SLOT_SIZE;
+	g_header->width     = SCREEN_WIDTH;
+	g_header->height    = SCREEN_HEIGHT;
+	g_header->stride    = _DISPLAY_SHM_STRIDE;
+	g_header->format    = DISPLAY_SHM_FORMAT_RGBA;
+
+	logger_print(LOG_INFO, "Exporting frames to shared memory %s.\n", name);
+	return true;
+}
+
+
+bool display_shm_is_active(void)
+{
+	return g_header != NULL;
+}
+
+
+void display_shm_publish(pixel screen[SCREEN_HEIGHT][SCREEN_WIDTH])
+{
+	if (g_header == NULL)
+		return;
+
+	struct display_shm_slot *slot = _display_shm_slot(++g_frame);
+	atomic_store_explicit(&slot->sequence, 2 * g_frame - 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	u8 *ptr = slot->pixels;
+	for (int y = 0; y < SCREEN_HEIGHT; y++) {
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			colour c = display_pixel_colour(screen[y][x]);
+			*ptr++ = c.r;
+			*ptr++ = c.g;
+			*ptr++ = c.b;
+			// Opaque, whatever the build keeps in the pixel
+			*ptr++ = 0xFF;
+		}
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	slot->timestamp = now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+	atomic_store_explicit(&slot->sequence, 2 * g_frame, memory_order_release);
+	atomic_fetch_add_explicit(&g_header->frames, 1, memory_order_release);
+	_display_shm_wake();
+}
+
+
+void display_shm_destroy(void)
+{
+	if (g_header == NULL)
+		return;
+
+	atomic_store(&g_header->closed, 1);
+	atomic_fetch_add(&g_header->frames, 1);
+	_display_shm_wake();
+
+	munmap(g_header, _DISPLAY_SHM_SIZE);
+	shm_unlink(g_name);
+	g_header = NULL;
+}
@@ -2,26 +2,15 @@
 #include"events.h"
 #include"input.h"
 #include"logger.h"
+#include"trace.h"
 
 
 static SDL_Thread * g_thread;
 static SDL_mutex  * g_mutex;
 
 static bool              g_closed      = false;
-static bool              g_frame_ready = false;
 static struct all_inputs g_inputs;
 
-bool events_is_frame_ready(void)
-{
-	bool frame_ready = false;
-	if (SDL_LockMutex(g_mutex) == 0) {
-		frame_ready = g_frame_ready;
-		g_frame_ready = false;
-		SDL_UnlockMutex(g_mutex);
-	}
-	return frame_ready;
-}
-
 bool events_is_display_closed(void)
 {
 	bool closed = false;
@@ -64,7 +53,6 @@ static int _events_filter(
 	// Both joypad and controllers events have to be catched here, don't ask me why.
 	switch(event->type) {
 		case SDL_QUIT:
-		case SDL_USEREVENT:
 		case SDL_KEYDOWN:
 		case SDL_KEYUP:
 		case SDL_CONTROLLERAXISMOTION:
@@ -82,6 +70,30 @@ static int _events_filter(
 		}
 }
 
+#ifdef TRACE
+static void _events_trace(const SDL_Event *event)
+{
+	switch(event->type) {
+	case SDL_KEYDOWN:
+		if (!event->key.repeat)
+			TRACE_INSTANT(TRACE_INPUT, "key down", "key", event->key.keysym.sym);
+		break;
+	case SDL_KEYUP:
+		TRACE_INSTANT(TRACE_INPUT, "key up", "key", event->key.keysym.sym);
+		break;
+	case SDL_CONTROLLERAXISMOTION:
+		TRACE_INSTANT(TRACE_INPUT, "axis motion", "axis", event->caxis.axis);
+		break;
+	case SDL_CONTROLLERBUTTONDOWN:
+		TRACE_INSTANT(TRACE_INPUT, "button down", "button", event->cbutton.button);
+		break;
+	case SDL_CONTROLLERBUTTONUP:
+		TRACE_INSTANT(TRACE_INPUT, "button up", "button", event->cbutton.button);
+		break;
+	}
+}
+#endif
+
 int events_thread(__attribute__((unused)) void *data)
 {
 	SDL_Event event;
@@ -93,16 +105,15 @@ int events_thread(__attribute__((unused)) void *data)
 				g_closed = true;
 				SDL_UnlockMutex(g_mutex);
 				return 0;
-			case SDL_USEREVENT:
-				if (event.user.code == FRAME_TIMER_EVENT)
-					g_frame_ready = true;
-				break;
 			//Nice idea - similarly to MEM, register input handlers
 			case SDL_KEYDOWN:
 			case SDL_KEYUP:
 			case SDL_CONTROLLERAXISMOTION:
 			case SDL_CONTROLLERBUTTONDOWN:
 			case SDL_CONTROLLERBUTTONUP:
+#ifdef TRACE
+				_events_trace(&event);
+#endif
 				input_handle_event(event, &g_inputs);
 
 				if (g_inputs.QUIT) {
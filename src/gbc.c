@@ -0,0 +1,280 @@
+#include<pthread.h>
+#include<stdlib.h>
+#include<string.h>
+#include"context.h"
+#include"cpu.h"
+#include"gbc.h"
+#include"gpu.h"
+#include"gpu_render.h"
+#include"ints.h"
+#include"joypad.h"
+#include"logger.h"
+#include"mem.h"
+#include"serial.h"
+#include"sound.h"
+#include"state.h"
+#include"timer.h"
+#include"types.h"
+
+struct gbc {
+	struct gb_context       *context;
+	bool                     halted;
+	// State right after preparing, for gbc_reset
+	u8                      *power_on;
+	// Staging for the renderer part of a state, buffers may be unaligned
+	struct gpu_render_state  render;
+};
+
+struct gbc_module {
+	bool (*prepare)(void);
+	void (*destroy)(void);
+};
+
+static bool _gbc_gpu_prepare(void)
+{
+	// No sink: frames stay with the renderer, and every one is drawn
+	return gpu_prepare(NULL, false, false);
+}
+
+static void _gbc_mem_destroy(void)
+{
+	mem_destroy(NULL);
+}
+
+// Prepared in this order once memory is, destroyed in reverse
+static const struct gbc_module g_modules[] = {
+	{ sound_prepare,    sound_destroy },
+	{ cpu_prepare,      cpu_destroy },
+	{ ints_prepare,     ints_destroy },
+	{ _gbc_gpu_prepare, gpu_destroy },
+	{ joypad_prepare,   joypad_destroy },
+	{ timer_prepare,    timer_destroy },
+	{ serial_prepare,   serial_destroy },
+};
+
+#define GBC_NUM_MODULES (sizeof(g_modules) / sizeof(g_modules[0]))
+
+static pthread_once_t g_logger_once = PTHREAD_ONCE_INIT;
+static bool           g_logger_ready;
+
+
+static void _gbc_prepare_logger(void)
+{
+	g_logger_ready = logger_prepare();
+}
+
+
+static void _gbc_destroy_modules(size_t prepared)
+{
+	while (prepared-- > 0)
+		g_modules[prepared].destroy();
+	_gbc_mem_destroy();
+}
+
+
+// Run a single instruction and let every module catch up with it
+static int _gbc_step(struct gbc *gbc)
+{
+	int cycles_delta = cpu_single_step();
+	if (cycles_delta < 0) {
+		gbc->halted = true;
+		return -1;
+	}
+
+	gpu_step(cpu_is_double_speed() ? cycles_delta/2 : cycles_delta);
+	mem_step(cycles_delta);
+	joypad_step();
+	timer_step(cycles_delta);
+	serial_step(cycles_delta);
+	ints_check();
+
+	return cycles_delta;
+}
+
+
+GBC_API void gbc_set_quiet(bool quiet)
+{
+	logger_set_quiet(quiet);
+}
+
+
+GBC_API struct gbc *gbc_create(const uint8_t *rom, size_t rom_size)
+{
+	pthread_once(&g_logger_once, _gbc_prepare_logger);
+	if (!g_logger_ready)
+		return NULL;
+
+	struct gbc *gbc = calloc(1, sizeof(*gbc));
+	if (gbc == NULL) {
+		logger_print(LOG_FATAL, "GBC: couldn't allocate a handle.\n");
+		return NULL;
+	}
+
+	gbc->context = context_create();
+	if (gbc->context == NULL) {
+		free(gbc);
+		return NULL;
+	}
+
+	if (!mem_prepare_buffer(rom, rom_size)) {
+		context_destroy(gbc->context);
+		free(gbc);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < GBC_NUM_MODULES; i++) {
+		if (!g_modules[i].prepare()) {
+			_gbc_destroy_modules(i);
+			context_destroy(gbc->context);
+			free(gbc);
+			return NULL;
+		}
+	}
+
+	gbc->power_on = malloc(gbc_state_size(gbc));
+	if (gbc->power_on == NULL) {
+		logger_print(LOG_FATAL, "GBC: couldn't allocate the power on state.\n");
+		gbc_destroy(gbc);
+		return NULL;
+	}
+	gbc_state_save(gbc, gbc->power_on);
+
+	return gbc;
+}
+
+
+GBC_API void gbc_destroy(struct gbc *gbc)
+{
+	if (gbc == NULL)
+		return;
+
+	context_set_current(gbc->context);
+	_gbc_destroy_modules(GBC_NUM_MODULES);
+	context_destroy(gbc->context);
+
+	free(gbc->power_on);
+	free(gbc);
+}
+
+
+GBC_API void gbc_reset(struct gbc *gbc)
+{
+	gbc_state_load(gbc, gbc->power_on);
+	serial_clear_output();
+}
+
+
+GBC_API bool gbc_run_frame(struct gbc *gbc)
+{
+	context_set_current(gbc->context);
+
+	unsigned long frame = gpu_get_frame_count();
+	long clocks = 0;
+
+	while (!gbc->halted && gpu_get_frame_count() == frame
+			&& clocks < GBC_FRAME_CYCLES) {
+		int cycles_delta = _gbc_step(gbc);
+		clocks += cpu_is_double_speed() ? cycles_delta/2 : cycles_delta;
+	}
+
+	return !gbc->halted;
+}
+
+
+GBC_API bool gbc_run_cycles(struct gbc *gbc, long cycles)
+{
+	context_set_current(gbc->context);
+
+	while (!gbc->halted && cycles > 0)
+		cycles -= _gbc_step(gbc);
+
+	return !gbc->halted;
+}
+
+
+GBC_API void gbc_set_joypad(struct gbc *gbc, unsigned buttons)
+{
+	context_set_current(gbc->context);
+
+	struct all_inputs inputs = {
+		.RIGHT  = (buttons & GBC_BUTTON_RIGHT) != 0,
+		.LEFT   = (buttons & GBC_BUTTON_LEFT) != 0,
+		.UP     = (buttons & GBC_BUTTON_UP) != 0,
+		.DOWN   = (buttons & GBC_BUTTON_DOWN) != 0,
+		.A      = (buttons & GBC_BUTTON_A) != 0,
+		.B      = (buttons & GBC_BUTTON_B) != 0,
+		.SELECT = (buttons & GBC_BUTTON_SELECT) != 0,
+		.START  = (buttons & GBC_BUTTON_START) != 0,
+	};
+	joypad_set_inputs(inputs);
+}
+
+
+GBC_API const void *gbc_framebuffer(struct gbc *gbc)
+{
+	context_set_current(gbc->context);
+
+	return gpu_render_get_screen();
+}
+
+
+GBC_API size_t gbc_pixel_size(void)
+{
+	return sizeof(pixel);
+}
+
+
+#define GBC_SCREEN_SIZE (GBC_SCREEN_WIDTH * GBC_SCREEN_HEIGHT * sizeof(pixel))
+
+/* A state is the snapshot of the emulated machine followed by the renderer's
+ * copies of video memory and the framebuffer, which keeps its contents while
+ * the LCD is off.
+ */
+GBC_API size_t gbc_state_size(struct gbc *gbc)
+{
+	context_set_current(gbc->context);
+
+	return state_size() + sizeof(struct gpu_render_state) + GBC_SCREEN_SIZE;
+}
+
+
+GBC_API void gbc_state_save(struct gbc *gbc, void *buffer)
+{
+	context_set_current(gbc->context);
+
+	state_save(buffer);
+	gpu_render_save(&gbc->render);
+	u8 *render = (u8 *)buffer + state_size();
+	memcpy(render, &gbc->render, sizeof(gbc->render));
+	memcpy(render + sizeof(gbc->render), gpu_render_get_screen(), GBC_SCREEN_SIZE);
+}
+
+
+GBC_API void gbc_state_load(struct gbc *gbc, const void *buffer)
+{
+	context_set_current(gbc->context);
+
+	state_load(buffer);
+	cpu_events_changed();
+	const u8 *render = (const u8 *)buffer + state_size();
+	memcpy(&gbc->render, render, sizeof(gbc->render));
+	gpu_render_load(&gbc->render);
+	gpu_render_set_screen((const pixel *)(render + sizeof(gbc->render)));
+	gbc->halted = false;
+}
+
+
+GBC_API uint8_t gbc_read8(struct gbc *gbc, uint16_t addr)
+{
+	context_set_current(gbc->context);
+
+	return mem_read8(addr);
+}
+
+
+GBC_API const char *gbc_serial_output(struct gbc *gbc, size_t *length)
+{
+	context_set_current(gbc->context);
+
+	return serial_get_output(length);
+}
@@ -0,0 +1,316 @@
+#include<pthread.h>
+#include<semaphore.h>
+#include<stdatomic.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include"display.h"
+#include"gbc.h"
+#include"logger.h"
+#include"types.h"
+
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#endif
+
+/*
+ * Every step the handles are split into one range per thread, the caller
+ * being thread 0. A thread runs the handles of its own range from the front
+ * and, once it is empty, steals from the back of the others. Both ends of a
+ * range are packed into one word so either side takes a handle with a single
+ * compare and swap.
+ *
+ * Between steps workers spin for a while before going to sleep, so steps
+ * issued back to back don't pay for a wakeup.
+ */
+
+#define GBC_BATCH_SPINS  20000
+
+struct gbc_batch_worker {
+	struct gbc_batch     *batch;
+	int                   index;
+	pthread_t             thread;
+	sem_t                 wake;
+	atomic_bool           sleeping;
+	// Next handle in the low, end of the range in the high half
+	_Atomic uint64_t      range;
+} __attribute__((aligned(64)));
+
+struct gbc_batch {
+	int                      threads;
+	struct gbc_batch_worker *workers;
+
+	atomic_ulong             step;
+	atomic_int               pending;
+	atomic_int               halted;
+	atomic_bool              stop;
+
+	struct {
+		struct gbc     **gbcs;
+		const unsigned  *buttons;
+		u8              *frames;
+		int              downsample;
+		size_t           frame_size;
+	} job;
+};
+
+
+static inline void _gbc_batch_relax(void)
+{
+#if defined(__SSE2__)
+	_mm_pause();
+#endif
+}
+
+
+static inline uint64_t _gbc_batch_range(uint32_t next, uint32_t end)
+{
+	return (uint64_t)end << 32 | next;
+}
+
+
+// Next handle of the own range, -1 once it is empty
+static int _gbc_batch_pop(struct gbc_batch_worker *worker)
+{
+	uint64_t range = atomic_load(&worker->range);
+	uint32_t next, end;
+
+	do {
+		next = (uint32_t)range;
+		end = range >> 32;
+		if (next >= end)
+			return -1;
+	} while (!atomic_compare_exchange_weak(&worker->range, &range,
+			_gbc_batch_range(next + 1, end)));
+
+	return next;
+}
+
+
+// Last handle of another thread's range, -1 if all of them are empty
+static int _gbc_batch_steal(struct gbc_batch *batch, int thief)
+{
+	for (int i = 1; i < batch->threads; i++) {
+		struct gbc_batch_worker *victim = &batch->workers[(thief + i) % batch->threads];
+		uint64_t range = atomic_load(&victim->range);
+		uint32_t next, end;
+
+		do {
+			next = (uint32_t)range;
+			end = range >> 32;
+		} while (next < end && !atomic_compare_exchange_weak(&victim->range,
+				&range, _gbc_batch_range(next, end - 1)));
+
+		if (next < end)
+			return end - 1;
+	}
+
+	return -1;
+}
+
+
+// Box filter the framebuffer down by the job's factor
+static void _gbc_batch_copy_frame(struct gbc_batch *batch, struct gbc *gbc,
+		u8 *dst)
+{
+	const pixel *screen = gbc_framebuffer(gbc);
+	int factor = batch->job.downsample;
+
+	if (factor == 1) {
+		memcpy(dst, screen, batch->job.frame_size);
+		return;
+	}
+
+	pixel *out = (pixel *)dst;
+	int area = factor * factor;
+	for (int y = 0; y < SCREEN_HEIGHT; y += factor) {
+		for (int x = 0; x < SCREEN_WIDTH; x += factor) {
+			int r = 0, g = 0, b = 0;
+			for (int dy = 0; dy < factor; dy++) {
+				for (int dx = 0; dx < factor; dx++) {
+					colour c = display_pixel_colour(
+						screen[(y + dy) * SCREEN_WIDTH + x + dx]);
+					r += c.r;
+					g += c.g;
+					b += c.b;
+				}
+			}
+			colour average = { r / area, g / area, b / area, true };
+			*out++ = display_pixel(average);
+		}
+	}
+}
+
+
+static void _gbc_batch_run(struct gbc_batch *batch, int index)
+{
+	struct gbc *gbc = batch->job.gbcs[index];
+
+	if (batch->job.buttons)
+		gbc_set_joypad(gbc, batch->job.buttons[index]);
+	if (!gbc_run_frame(gbc))
+		atomic_fetch_add(&batch->halted, 1);
+	if (batch->job.frames)
+		_gbc_batch_copy_frame(batch, gbc,
+				batch->job.frames + index * batch->job.frame_size);
+
+	atomic_fetch_sub_explicit(&batch->pending, 1, memory_order_release);
+}
+
+
+static void _gbc_batch_work(struct gbc_batch *batch, int thread)
+{
+	int index;
+
+	while ((index = _gbc_batch_pop(&batch->workers[thread])) >= 0)
+		_gbc_batch_run(batch, index);
+	while ((index = _gbc_batch_steal(batch, thread)) >= 0)
+		_gbc_batch_run(batch, index);
+}
+
+
+// Wait for the step after seen, false once the batch is destroyed
+static bool _gbc_batch_wait(struct gbc_batch *batch,
+		struct gbc_batch_worker *worker, unsigned long seen)
+{
+	for (int spin = 0; spin < GBC_BATCH_SPINS; spin++) {
+		if (atomic_load(&batch->step) != seen)
+			return !atomic_load(&batch->stop);
+		_gbc_batch_relax();
+	}
+
+	atomic_store(&worker->sleeping, true);
+	if (atomic_load(&batch->step) != seen
+			&& atomic_exchange(&worker->sleeping, false))
+		return !atomic_load(&batch->stop);
+
+	// Either asleep, or woken up already and the post has to be taken
+	while (sem_wait(&worker->wake) != 0)
+		;
+
+	return !atomic_load(&batch->stop);
+}
+
+
+static void *_gbc_batch_worker(void *arg)
+{
+	struct gbc_batch_worker *worker = arg;
+	unsigned long seen = 0;
+
+	while (_gbc_batch_wait(worker->batch, worker, seen)) {
+		seen = atomic_load(&worker->batch->step);
+		_gbc_batch_work(worker->batch, worker->index);
+	}
+
+	return NULL;
+}
+
+
+GBC_API struct gbc_batch *gbc_batch_create(int threads)
+{
+	struct gbc_batch *batch = calloc(1, sizeof(*batch));
+	if (batch == NULL) {
+		logger_print(LOG_FATAL, "GBC: couldn't allocate a batch.\n");
+		return NULL;
+	}
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	batch->threads = MAX(threads, 1);
+
+	batch->workers = aligned_alloc(64, batch->threads * sizeof(*batch->workers));
+	if (batch->workers == NULL) {
+		logger_print(LOG_FATAL, "GBC: couldn't allocate the batch workers.\n");
+		free(batch);
+		return NULL;
+	}
+	memset(batch->workers, 0, batch->threads * sizeof(*batch->workers));
+
+	for (int i = 1; i < batch->threads; i++) {
+		batch->workers[i].batch = batch;
+		batch->workers[i].index = i;
+		sem_init(&batch->workers[i].wake, 0, 0);
+	}
+	for (int i = 1; i < batch->threads; i++) {
+		if (pthread_create(&batch->workers[i].thread, NULL, _gbc_batch_worker,
+				&batch->workers[i]) != 0) {
+			// Carry on with the workers there are
+			logger_print(LOG_WARN, "GBC: batch runs on %d threads.\n", i);
+			for (int j = i; j < batch->threads; j++)
+				sem_destroy(&batch->workers[j].wake);
+			batch->threads = i;
+			break;
+		}
+	}
+
+	return batch;
+}
+
+
+GBC_API void gbc_batch_destroy(struct gbc_batch *batch)
+{
+	if (batch == NULL)
+		return;
+
+	atomic_store(&batch->stop, true);
+	atomic_fetch_add(&batch->step, 1);
+	for (int i = 1; i < batch->threads; i++) {
+		if (atomic_exchange(&batch->workers[i].sleeping, false))
+			sem_post(&batch->workers[i].wake);
+		pthread_join(batch->workers[i].thread, NULL);
+		sem_destroy(&batch->workers[i].wake);
+	}
+
+	free(batch->workers);
+	free(batch);
+}
+
+
+GBC_API int gbc_batch_threads(struct gbc_batch *batch)
+{
+	return batch->threads;
+}
+
+
+GBC_API size_t gbc_batch_frame_size(int downsample)
+{
+	if (downsample <= 0 || SCREEN_WIDTH % downsample != 0
+			|| SCREEN_HEIGHT % downsample != 0)
+		return 0;
+
+	return (SCREEN_WIDTH / downsample) * (SCREEN_HEIGHT / downsample)
+		* sizeof(pixel);
+}
+
+
+GBC_API int gbc_batch_run_frame(struct gbc_batch *batch, struct gbc **gbcs,
+		const unsigned *buttons, int count, void *frames, int downsample)
+{
+	size_t frame_size = gbc_batch_frame_size(downsample);
+	if (frame_size == 0)
+		return -1;
+
+	batch->job.gbcs       = gbcs;
+	batch->job.buttons    = buttons;
+	batch->job.frames     = frames;
+	batch->job.downsample = downsample;
+	batch->job.frame_size = frame_size;
+	atomic_store(&batch->halted, 0);
+	atomic_store(&batch->pending, count);
+
+	for (int i = 0; i < batch->threads; i++)
+		atomic_store(&batch->workers[i].range, _gbc_batch_range(
+				(uint64_t)count * i / batch->threads,
+				(uint64_t)count * (i + 1) / batch->threads));
+
+	atomic_fetch_add(&batch->step, 1);
+	for (int i = 1; i < batch->threads; i++)
+		if (atomic_exchange(&batch->workers[i].sleeping, false))
+			sem_post(&batch->workers[i].wake);
+
+	_gbc_batch_work(batch, 0);
+	while (atomic_load_explicit(&batch->pending, memory_order_acquire) > 0)
+		_gbc_batch_relax();
+
+	return atomic_load(&batch->halted);
+}
@@ -0,0 +1,110 @@
+#include"gpu_compose.h"
+#include"types.h"
+
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#endif
+
+// Layer pixel format, see gpu_layer.h
+#define _GPU_COMPOSE_COLOUR_MASK   0x03
+#define _GPU_COMPOSE_PRIORITY_MASK 0x20
+#define _GPU_COMPOSE_INDEX_MASK    0x1F
+
+/*
+ * Per pixel, a sprite is visible if:
+ *   - sprites are drawn over everything or background colour is 0: first
+ *     opaque sprite,
+ *   - otherwise, unless the background tile has priority: first opaque
+ *     sprite which is drawn over background colours 1-3.
+ */
+
+#if defined(__SSE2__)
+static void _gpu_compose_line_sse2(
+	const u8 *bg_plane,
+	const u8 *sprites_plane,
+	const u8 *front_plane,
+	bool sprites_over_bg,
+	u8 *dst
+)
+{
+	const __m128i zero         = _mm_setzero_si128();
+	const __m128i colour_mask  = _mm_set1_epi8(_GPU_COMPOSE_COLOUR_MASK);
+	const __m128i priority     = _mm_set1_epi8(_GPU_COMPOSE_PRIORITY_MASK);
+	const __m128i index_mask   = _mm_set1_epi8(_GPU_COMPOSE_INDEX_MASK);
+	const __m128i opaque       = _mm_set1_epi8((char)GPU_COMPOSE_SPRITE_OPAQUE);
+	const __m128i sprite_lut   = _mm_set1_epi8(GPU_COMPOSE_SPRITE_LUT);
+	const __m128i over_bg      = sprites_over_bg ? _mm_cmpeq_epi8(zero, zero) : zero;
+
+	for (int i = 0; i < SCREEN_WIDTH; i += 16) {
+		__m128i bg      = _mm_loadu_si128((const __m128i *)(bg_plane + i));
+		__m128i sprites = _mm_loadu_si128((const __m128i *)(sprites_plane + i));
+		__m128i front   = _mm_loadu_si128((const __m128i *)(front_plane + i));
+
+		__m128i bg_colour_0 = _mm_cmpeq_epi8(_mm_and_si128(bg, colour_mask), zero);
+		__m128i bg_priority = _mm_cmpeq_epi8(_mm_and_si128(bg, priority), priority);
+		__m128i use_all     = _mm_or_si128(over_bg, bg_colour_0);
+
+		__m128i sprite = _mm_or_si128(
+			_mm_and_si128(use_all, sprites),
+			_mm_andnot_si128(_mm_or_si128(use_all, bg_priority), front));
+		__m128i visible = _mm_cmpeq_epi8(_mm_and_si128(sprite, opaque), opaque);
+
+		__m128i sprite_index = _mm_add_epi8(_mm_and_si128(sprite, index_mask),
+				sprite_lut);
+		__m128i bg_index = _mm_and_si128(bg, index_mask);
+
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(
+			_mm_and_si128(visible, sprite_index),
+			_mm_andnot_si128(visible, bg_index)));
+	}
+}
+#endif
+
+void gpu_compose_line_scalar(
+	const u8 bg_plane[SCREEN_WIDTH],
+	const u8 sprites_plane[SCREEN_WIDTH],
+	const u8 front_plane[SCREEN_WIDTH],
+	bool sprites_over_bg,
+	u8 dst[SCREEN_WIDTH]
+)
+{
+	for (int i = 0; i < SCREEN_WIDTH; i++) {
+		u8 bg = bg_plane[i];
+		u8 sprite = 0;
+
+		if (sprites_over_bg || (bg & _GPU_COMPOSE_COLOUR_MASK) == 0)
+			sprite = sprites_plane[i];
+		else if ((bg & _GPU_COMPOSE_PRIORITY_MASK) == 0)
+			sprite = front_plane[i];
+
+		if (sprite & GPU_COMPOSE_SPRITE_OPAQUE)
+			dst[i] = GPU_COMPOSE_SPRITE_LUT + (sprite & _GPU_COMPOSE_INDEX_MASK);
+		else
+			dst[i] = bg & _GPU_COMPOSE_INDEX_MASK;
+	}
+}
+
+void gpu_compose_line(
+	const u8 bg[SCREEN_WIDTH],
+	const u8 sprites[SCREEN_WIDTH],
+	const u8 sprites_front[SCREEN_WIDTH],
+	bool sprites_over_bg,
+	u8 dst[SCREEN_WIDTH]
+)
+{
+#if defined(__SSE2__)
+	_gpu_compose_line_sse2(bg, sprites, sprites_front, sprites_over_bg, dst);
+#else
+	gpu_compose_line_scalar(bg, sprites, sprites_front, sprites_over_bg, dst);
+#endif
+}
+
+void gpu_compose_resolve(
+	const u8 indices[SCREEN_WIDTH],
+	const pixel lut[GPU_COMPOSE_LUT_SIZE],
+	pixel dst[SCREEN_WIDTH]
+)
+{
+	for (int i = 0; i < SCREEN_WIDTH; i++)
+		dst[i] = lut[indices[i]];
+}
@@ -0,0 +1,174 @@
+#include<stdlib.h>
+#include<string.h>
+#include"context_priv.h"
+#include"gpu_layer.h"
+#include"gpu_tile.h"
+#include"logger.h"
+#include"rom.h"
+#include"types.h"
+
+/*
+ * Both tile maps are kept rendered as 256x256 bitmaps of colour numbers and
+ * attributes, so that drawing a background or window scanline boils down to
+ * a copy. Bitmaps are updated lazily, one 8x8 cell at a time, when a cell is
+ * about to be used and either its tile map entry was written, its tile data
+ * changed (tracked with per-tile generation counters) or it was rendered with
+ * the other tile data addressing mode (LCDC bit 4).
+ */
+
+#define _GPU_LAYER_TILES_PER_ROW  32
+#define _GPU_LAYER_CELLS          (_GPU_LAYER_TILES_PER_ROW * _GPU_LAYER_TILES_PER_ROW)
+#define _GPU_LAYER_VRAM_BANKS     2
+#define _GPU_LAYER_TILES          384
+
+#define _GPU_LAYER_TILE_DATA_ADDR 0x8000
+#define _GPU_LAYER_MAP_ADDR       0x9800
+#define _GPU_LAYER_MAP_SIZE       0x0400
+#define _GPU_LAYER_VRAM_END       0xA000
+
+struct gpu_layer_cell {
+	bool valid;
+	bool signed_data;
+	u8   bank;
+	u16  tile;
+	uint32_t  generation;
+};
+
+struct gpu_layer_context {
+	u8 layer[GPU_LAYER_MAPS][GPU_LAYER_SIZE][GPU_LAYER_SIZE];
+	struct gpu_layer_cell cells[GPU_LAYER_MAPS][_GPU_LAYER_CELLS];
+	uint32_t tile_generation[_GPU_LAYER_VRAM_BANKS][_GPU_LAYER_TILES];
+	u8 (*vram)[GPU_LAYER_VRAM_SIZE];
+};
+
+// State of the current context
+#define g_gpu_layer (g_context->gpu_layer)
+
+
+void gpu_layer_vram_written(int bank, a16 addr, int length)
+{
+	int end = MIN(addr + length, _GPU_LAYER_VRAM_END);
+
+	for (int tile_addr = addr; tile_addr < MIN(end, _GPU_LAYER_MAP_ADDR);
+			tile_addr += GPU_TILE_BYTES - (tile_addr % GPU_TILE_BYTES))
+		g_gpu_layer->tile_generation[bank]
+			[(tile_addr - _GPU_LAYER_TILE_DATA_ADDR) / GPU_TILE_BYTES]++;
+
+	// Both tile numbers (bank 0) and attributes (bank 1) invalidate the cell
+	for (int map_addr = MAX(addr, _GPU_LAYER_MAP_ADDR); map_addr < end;
+			map_addr++) {
+		int offset = map_addr - _GPU_LAYER_MAP_ADDR;
+		g_gpu_layer->cells[offset / _GPU_LAYER_MAP_SIZE]
+			[offset % _GPU_LAYER_MAP_SIZE].valid = false;
+	}
+}
+
+
+static void _gpu_layer_render_cell(int map, bool signed_data, int cell)
+{
+	a16 map_addr = _GPU_LAYER_MAP_ADDR + map * _GPU_LAYER_MAP_SIZE + cell;
+	u8 number = g_gpu_layer->vram[0][map_addr - _GPU_LAYER_TILE_DATA_ADDR];
+	u8 attr = rom_is_cgb() ? g_gpu_layer->vram[1][map_addr - _GPU_LAYER_TILE_DATA_ADDR] : 0;
+
+	// 0x8000 addressing uses tiles 0-255, 0x9000 addressing tiles 128-383
+	u16 tile = signed_data ? 256 + (s8)number : number;
+	u8  bank = (attr & 0x08) >> 3;
+
+	u8 colour_numbers[GPU_TILE_ROWS * 8];
+	gpu_tile_decode(&g_gpu_layer->vram[bank][tile * GPU_TILE_BYTES], GPU_TILE_ROWS,
+			(attr & 0x20) != 0, colour_numbers);
+
+	// Palette number and BG-to-OAM priority
+	u8 extra = ((attr & 0x07) << 2) | ((attr & 0x80) >> 2);
+	int y = (cell / _GPU_LAYER_TILES_PER_ROW) * 8;
+	int x = (cell % _GPU_LAYER_TILES_PER_ROW) * 8;
+	for (int row = 0; row < GPU_TILE_ROWS; row++) {
+		u8 *src = colour_numbers + ((attr & 0x40) ? 7 - row : row) * 8;
+		u8 *dst = &g_gpu_layer->layer[map][y + row][x];
+
+		for (int i = 0; i < 8; i++)
+			dst[i] = src[i] | extra;
+	}
+
+	struct gpu_layer_cell *info = &g_gpu_layer->cells[map][cell];
+	info->valid = true;
+	info->signed_data = signed_data;
+	info->bank = bank;
+	info->tile = tile;
+	info->generation = g_gpu_layer->tile_generation[bank][tile];
+}
+
+
+static inline void _gpu_layer_update_cell(int map, bool signed_data, int cell)
+{
+	struct gpu_layer_cell *info = &g_gpu_layer->cells[map][cell];
+
+	if (!info->valid || info->signed_data != signed_data
+			|| info->generation != g_gpu_layer->tile_generation[info->bank][info->tile])
+		_gpu_layer_render_cell(map, signed_data, cell);
+}
+
+
+void gpu_layer_fetch(int map, bool signed_data, u8 x, u8 y,
+		u8 dst[SCREEN_WIDTH])
+{
+	int row = (y / 8) * _GPU_LAYER_TILES_PER_ROW;
+	int first = x / 8;
+
+	for (int i = 0; i <= SCREEN_WIDTH / 8; i++)
+		_gpu_layer_update_cell(map, signed_data,
+				row + (first + i) % _GPU_LAYER_TILES_PER_ROW);
+
+	const u8 *src = g_gpu_layer->layer[map][y];
+	int head = MIN(GPU_LAYER_SIZE - x, SCREEN_WIDTH);
+	memcpy(dst, src + x, head);
+	memcpy(dst + head, src, SCREEN_WIDTH - head);
+}
+
+
+void gpu_layer_fetch_linear(int map, bool signed_data, u8 x, u8 y,
+		u8 dst[SCREEN_WIDTH])
+{
+	int first = (y / 8) * _GPU_LAYER_TILES_PER_ROW + x / 8;
+
+	for (int i = 0; i <= SCREEN_WIDTH / 8 && first + i < _GPU_LAYER_CELLS; i++)
+		_gpu_layer_update_cell(map, signed_data, first + i);
+
+	int head = MIN(GPU_LAYER_SIZE - x, SCREEN_WIDTH);
+	memcpy(dst, &g_gpu_layer->layer[map][y][x], head);
+
+	if (head == SCREEN_WIDTH)
+		return;
+
+	if (y + 8 < GPU_LAYER_SIZE)
+		memcpy(dst + head, g_gpu_layer->layer[map][y + 8], SCREEN_WIDTH - head);
+	else
+		memset(dst + head, 0, SCREEN_WIDTH - head);
+}
+
+
+void gpu_layer_invalidate(void)
+{
+	memset(g_gpu_layer->cells, 0, sizeof(g_gpu_layer->cells));
+}
+
+
+bool gpu_layer_prepare(u8 vram[][GPU_LAYER_VRAM_SIZE])
+{
+	g_gpu_layer = calloc(1, sizeof(*g_gpu_layer));
+	if (g_gpu_layer == NULL) {
+		logger_print(LOG_FATAL, "LAYER: couldn't allocate the context.\n");
+		return false;
+	}
+
+	g_gpu_layer->vram = vram;
+	gpu_layer_invalidate();
+	return true;
+}
+
+
+void gpu_layer_destroy(void)
+{
+	free(g_gpu_layer);
+	g_gpu_layer = NULL;
+}
@@ -0,0 +1,713 @@
+#include<pthread.h>
+#include<sched.h>
+#include<semaphore.h>
+#include<stdatomic.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include"capture.h"
+#include"context_priv.h"
+#include"display.h"
+#include"display_shm.h"
+#include"gpu_compose.h"
+#include"gpu_gb_palettes.h"
+#include"gpu_layer.h"
+#include"gpu_priv.h"
+#include"gpu_render.h"
+#include"gpu_tile.h"
+#include"logger.h"
+#include"mem_priv.h"
+#include"rom.h"
+#include"types.h"
+
+/*
+ * Scanlines are drawn from a snapshot of the GPU registers taken when the
+ * line ends (struct gpu_render_line) and from shadow copies of VRAM, OAM and
+ * palette memory. Writes to the latter are appended to a log and only applied
+ * when the command that needs them is processed, so the renderer always sees
+ * memory exactly as it was at the end of the line.
+ *
+ * Commands travel through a single producer, single consumer ring. Without
+ * the render thread they are processed right away by the emulation thread,
+ * with the render thread it blocks only at V-Blank, until the frame is done.
+ */
+
+#define _GPU_RENDER_VRAM_BANKS   2
+#define _GPU_RENDER_VRAM_ADDR    0x8000
+#define _GPU_RENDER_OAM_ADDR     0xFE00
+#define _GPU_RENDER_OAM_SIZE     0xA0
+#define _GPU_RENDER_PALETTE_SIZE 64
+// Background colour while LCDC.0 blanks it on DMG, which has no palette 1
+#define _GPU_RENDER_BLANK_INDEX  4
+
+#define _GPU_RENDER_QUEUE_SIZE   512
+#define _GPU_RENDER_LOG_SIZE     (1 << 16)
+
+#define spriteScreenPosX(SpriteX) (SpriteX-8)
+#define spriteScreenPosY(SpriteY) (SpriteY-16)
+
+
+enum gpu_drawing_type {
+	BACKGROUND,
+	WINDOW,
+	SPRITE
+};
+
+
+typedef struct sprite {
+	d8   x;
+	d8   y;
+	d8   tile_number;
+	d8   palette_number_cgb;
+	d8   vram_bank_number;
+	d8   palette_number_gb;
+	bool flipped_x;
+	bool flipped_y;
+	bool has_priority_over_bg_1_3;
+} sprite;
+
+
+enum gpu_render_target {
+	TARGET_VRAM,
+	TARGET_OAM,
+	TARGET_BG_PALETTE,
+	TARGET_SPRITE_PALETTE
+};
+
+struct gpu_render_write {
+	u8  target;
+	u8  bank;
+	u16 addr;
+	u8  data;
+};
+
+enum gpu_render_command_type {
+	COMMAND_WRITES,
+	COMMAND_LINE,
+	COMMAND_FRAME,
+	COMMAND_STOP
+};
+
+struct gpu_render_command {
+	enum gpu_render_command_type type;
+	// Writes up to this log position are applied before the command
+	uint32_t                     log_end;
+	struct gpu_render_line       line;
+	struct timespec              queued;
+};
+
+
+struct gpu_render_context {
+	u8 vram[_GPU_RENDER_VRAM_BANKS][GPU_LAYER_VRAM_SIZE];
+	u8 oam[_GPU_RENDER_OAM_SIZE];
+	d8 background_palette_memory[_GPU_RENDER_PALETTE_SIZE];
+	d8 sprite_palette_memory[_GPU_RENDER_PALETTE_SIZE];
+	palette_config palette_configuration;
+
+	struct gpu_render_line line;
+	u8        sprite_height;
+	a16       window_tile_map_display_address;
+	a16       bg_window_tile_data_address;
+	a16       bg_tile_map_display_address;
+
+	pixel  palette_lut[GPU_COMPOSE_LUT_SIZE];
+	bool   palette_lut_dirty;
+
+	pixel    screen[SCREEN_HEIGHT][SCREEN_WIDTH];
+	uint64_t line_hashes[SCREEN_HEIGHT];
+
+	// Renderer variant for the hardware mode, see gpu_render_mode.inc
+	void (*draw_scanline)(void);
+
+	struct gpu_render_write   log[_GPU_RENDER_LOG_SIZE];
+	uint32_t                  log_head;
+	uint32_t                  log_flushed;
+	_Atomic uint32_t          log_tail;
+
+	struct gpu_render_command queue[_GPU_RENDER_QUEUE_SIZE];
+	_Atomic uint32_t          queue_head;
+	_Atomic uint32_t          queue_tail;
+	_Atomic uint32_t          queue_done;
+
+	bool      threaded;
+	pthread_t thread;
+	sem_t     queue_not_empty;
+	sem_t     frame_done;
+
+	// Time between the end of the last scanline and the frame being ready
+	long   latency_frames;
+	double latency_sum;
+	double latency_max;
+};
+
+// State of the current context, the render thread works on its owner's
+#define g_render (g_context->gpu_render)
+
+
+static void _gpu_render_error(enum logger_log_type type, char *title, char *message)
+{
+	logger_log(
+		type,
+		title,
+		"[GPU MODULE] %s\n",
+		message
+	);
+}
+
+
+static d16 _gpu_render_read_spm(u8 index)
+{
+	d16 spm_colour;
+	spm_colour = ((g_render->sprite_palette_memory[index+1]) << 8) | (g_render->sprite_palette_memory[index]);
+	return spm_colour;
+}
+
+
+static d16 _gpu_render_read_bgpm(u8 index)
+{
+	d16 bgpm_colour;
+	bgpm_colour = ((g_render->background_palette_memory[index+1]) << 8) | (g_render->background_palette_memory[index]);
+	return bgpm_colour;
+}
+
+
+static colour _gpu_render_get_colour_cgb_sprite(u8 colour_number, u8 palette_number)
+{
+	//Setup
+	colour found_colour;
+	found_colour.a = (colour_number == 0) ? true : false;
+	d16 obp = _gpu_render_read_spm(palette_number * 8 + colour_number * 2);
+
+	//Acquire colour value
+	found_colour.r = obp & (B4 | B3 | B2 | B1 | B0);
+	found_colour.g = (obp >> 5) & (B4 | B3 | B2 | B1 | B0);
+	found_colour.b = (obp >> 10) & (B4 | B3 | B2 | B1 | B0);
+
+	//Translate colour value to a colour variable
+	found_colour.r = (found_colour.r << 3) + ( (found_colour.r >> 2) & (B2 | B1 | B0) );
+	found_colour.g = (found_colour.g << 3) + ( (found_colour.g >> 2) & (B2 | B1 | B0) );
+	found_colour.b = (found_colour.b << 3) + ( (found_colour.b >> 2) & (B2 | B1 | B0) );
+
+	return found_colour;
+}
+
+
+static colour _gpu_render_get_colour_cgb(u8 colour_number, u8 palette_number)
+{
+	//Setup
+	colour found_colour;
+	found_colour.a = false;
+	d16 bgp = _gpu_render_read_bgpm(palette_number * 8 + colour_number * 2);
+
+	//Acquire colour value
+	found_colour.r = bgp & (B4 | B3 | B2 | B1 | B0);
+	found_colour.g = (bgp >> 5) & (B4 | B3 | B2 | B1 | B0);
+	found_colour.b = (bgp >> 10) & (B4 | B3 | B2 | B1 | B0);
+
+	//Translate colour value to a colour variable
+	found_colour.r = (found_colour.r << 3) + ( (found_colour.r >> 2) & (B2 | B1 | B0) );
+	found_colour.g = (found_colour.g << 3) + ( (found_colour.g >> 2) & (B2 | B1 | B0) );
+	found_colour.b = (found_colour.b << 3) + ( (found_colour.b >> 2) & (B2 | B1 | B0) );
+
+	return found_colour;
+}
+
+
+static colour _gpu_render_get_colour_gb_sprite(u8 colour_number, u8 palette_number)
+{
+	//Setup
+	colour found_colour;
+	u8 obp = 0;
+	switch(palette_number) {
+	case 0:
+		obp = g_render->line.obp0;
+		break;
+	case 1:
+		obp = g_render->line.obp1;
+		break;
+	}
+
+	//Acquire colour value
+	obp >>= colour_number * 2;
+	obp &= (B0 | B1);
+
+	//Translate colour value to a colour variable
+	switch(palette_number) {
+	case 0:
+		found_colour = g_render->palette_configuration.obj0_palette[obp];
+		break;
+	case 1:
+		found_colour = g_render->palette_configuration.obj1_palette[obp];
+		break;
+	}
+
+	found_colour.a = (colour_number == 0) ? true : false;
+	return found_colour;
+}
+
+
+static colour _gpu_render_get_colour_gb(u8 colour_number)
+{
+	//Setup
+	colour found_colour;
+	found_colour.a = false;
+	u8 bgp = g_render->line.bgp;
+
+	//Acquire colour value
+	bgp >>= colour_number * 2;
+	bgp &= (B0 | B1);
+
+	//Translate colour value to a colour variable
+	found_colour = g_render->palette_configuration.bg_palette[bgp];
+
+	return found_colour;
+}
+
+
+static sprite _gpu_render_lazy_get_sprite(u8 number)
+{
+	sprite current_sprite;
+
+	current_sprite.y = spriteScreenPosY( g_render->oam[number * 4] );
+
+	return current_sprite;
+}
+
+
+static void _gpu_render_lazy_get_sprite_rest(sprite * current_sprite, u8 number)
+{
+	const u8 *attributes = &g_render->oam[number * 4 + 1];
+
+	current_sprite->x = spriteScreenPosX( attributes[0] );
+	current_sprite->tile_number = attributes[1];
+	d8 bit_data = attributes[2];
+	current_sprite->palette_number_cgb =        bit_data & (B2 | B1 | B0);
+	current_sprite->vram_bank_number =         (bit_data & B3) >> 3;
+	current_sprite->palette_number_gb =        (bit_data & B4) >> 4;
+	current_sprite->flipped_x =                (bit_data & B5) == B5;
+	current_sprite->flipped_y =                (bit_data & B6) == B6;
+	current_sprite->has_priority_over_bg_1_3 = (bit_data & B7) == 0;
+}
+
+
+static void _gpu_render_get_colour_numbers(
+	s16 tile_number,
+	u8 line_index,
+	u8 vram_bank_number,
+	bool flip_x,
+	u8 dst[8]
+)
+{
+	//Get line
+	const u8 *line = &g_render->vram[vram_bank_number][tile_number * 2 * 8 + line_index * 2];
+
+	gpu_tile_decode_row(line[0], line[1], flip_x, dst);
+}
+
+
+static void _gpu_render_put_window(u8 bg_plane[SCREEN_WIDTH])
+{
+	//Get data
+	u8  ly              = g_render->line.ly;
+	u8  wy              = g_render->line.wy;
+	s16 wx              = g_render->line.wx - 7;
+	s16 tile_map_y      = ly - wy;
+	u8  tile_map_x      = (wx < 0) ? 7 : wx;
+	u8  tile_map_tile_x = (tile_map_x - tile_map_x % 8) / 8;
+
+	//Is the window on screen right now?
+	if((ly < wy) || (wy > 143) || (wx > 159)) {
+		return;
+	}
+
+	//Window tiles are fetched from the tile map in order, continuing on the
+	//next tile map row, and wrap around the screen
+	u8 pixels[SCREEN_WIDTH];
+	gpu_layer_fetch_linear(
+		g_render->window_tile_map_display_address == 0x9C00,
+		g_render->bg_window_tile_data_address == 0x9000,
+		tile_map_tile_x * 8,
+		tile_map_y,
+		pixels
+	);
+
+	s16 current_index;
+	for(u8 i = 0; i < SCREEN_WIDTH; i++)
+	{
+		current_index = (wx + i) % SCREEN_WIDTH;
+		if(current_index >= 0)
+			bg_plane[current_index] = pixels[i];
+	}
+}
+
+
+static void _gpu_render_put_background(u8 bg_plane[SCREEN_WIDTH])
+{
+	//Get data
+	u8 ly              = g_render->line.ly;
+	u8 scy             = g_render->line.scy;
+	u8 scx             = g_render->line.scx;
+	u8 tile_map_y      = (scy + ly) % 256;
+	u8 tile_map_x      = scx;
+
+	gpu_layer_fetch(
+		g_render->bg_tile_map_display_address == 0x9C00,
+		g_render->bg_window_tile_data_address == 0x9000,
+		tile_map_x,
+		tile_map_y,
+		bg_plane
+	);
+}
+
+
+#define GPU_RENDER_CGB        0
+#define GPU_RENDER_MODE(name) name##_dmg
+#include"gpu_render_mode.inc"
+
+#define GPU_RENDER_CGB        1
+#define GPU_RENDER_MODE(name) name##_cgb
+#include"gpu_render_mode.inc"
+
+
+static uint64_t _gpu_render_hash_line(const pixel line[SCREEN_WIDTH])
+{
+	//Hash the line 8 bytes at a time
+	const u8 *bytes = (const u8*) line;
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	uint64_t chunk;
+
+	for(size_t i = 0; i < SCREEN_WIDTH * sizeof(pixel); i += sizeof(chunk))
+	{
+		memcpy(&chunk, bytes + i, sizeof(chunk));
+		hash = (hash ^ chunk) * 0x100000001B3ULL;
+		hash ^= hash >> 29;
+	}
+
+	return hash;
+}
+
+
+static void _gpu_render_apply_writes(uint32_t log_end)
+{
+	uint32_t tail = atomic_load_explicit(&g_render->log_tail, memory_order_relaxed);
+
+	for(; tail != log_end; tail++)
+	{
+		struct gpu_render_write *write = &g_render->log[tail % _GPU_RENDER_LOG_SIZE];
+
+		switch(write->target) {
+		case TARGET_VRAM:
+			g_render->vram[write->bank][write->addr - _GPU_RENDER_VRAM_ADDR] = write->data;
+			gpu_layer_vram_written(write->bank, write->addr, 1);
+			break;
+		case TARGET_OAM:
+			g_render->oam[write->addr - _GPU_RENDER_OAM_ADDR] = write->data;
+			break;
+		case TARGET_BG_PALETTE:
+			g_render->background_palette_memory[write->addr] = write->data;
+			g_render->palette_lut_dirty = true;
+			break;
+		case TARGET_SPRITE_PALETTE:
+			g_render->sprite_palette_memory[write->addr] = write->data;
+			g_render->palette_lut_dirty = true;
+			break;
+		}
+	}
+
+	atomic_store_explicit(&g_render->log_tail, tail, memory_order_release);
+}
+
+
+static double _gpu_render_seconds_since(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+
+static void _gpu_render_process(const struct gpu_render_command *command)
+{
+	_gpu_render_apply_writes(command->log_end);
+
+	switch(command->type) {
+	case COMMAND_LINE:
+		//DMG palettes are registers, not memory
+		if(command->line.bgp != g_render->line.bgp
+				|| command->line.obp0 != g_render->line.obp0
+				|| command->line.obp1 != g_render->line.obp1)
+			g_render->palette_lut_dirty = true;
+		g_render->line = command->line;
+		g_render->draw_scanline();
+		g_render->line_hashes[g_render->line.ly] =
+			_gpu_render_hash_line(g_render->screen[g_render->line.ly]);
+		break;
+	case COMMAND_FRAME:
+		if(g_render->threaded) {
+			double latency = _gpu_render_seconds_since(&command->queued);
+			g_render->latency_frames++;
+			g_render->latency_sum += latency;
+			g_render->latency_max = MAX(g_render->latency_max, latency);
+			sem_post(&g_render->frame_done);
+		}
+		display_shm_publish(g_render->screen);
+		capture_frame(g_render->screen);
+		break;
+	case COMMAND_WRITES:
+	case COMMAND_STOP:
+		break;
+	}
+}
+
+
+static void *_gpu_render_thread(void *context)
+{
+	struct gpu_render_command command;
+	uint32_t tail;
+
+	g_context = context;
+
+	do {
+		sem_wait(&g_render->queue_not_empty);
+		tail = atomic_load_explicit(&g_render->queue_tail, memory_order_relaxed);
+		command = g_render->queue[tail % _GPU_RENDER_QUEUE_SIZE];
+		atomic_store_explicit(&g_render->queue_tail, tail + 1, memory_order_release);
+
+		_gpu_render_process(&command);
+		atomic_store_explicit(&g_render->queue_done, tail + 1, memory_order_release);
+	} while(command.type != COMMAND_STOP);
+
+	return NULL;
+}
+
+
+static void _gpu_render_push(enum gpu_render_command_type type,
+		const struct gpu_render_line *line)
+{
+	struct gpu_render_command command = {
+		.type    = type,
+		.log_end = g_render->log_head
+	};
+	g_render->log_flushed = g_render->log_head;
+
+	if(line != NULL)
+		command.line = *line;
+
+	if(!g_render->threaded) {
+		_gpu_render_process(&command);
+		return;
+	}
+
+	if(type == COMMAND_FRAME)
+		clock_gettime(CLOCK_MONOTONIC, &command.queued);
+
+	uint32_t head = atomic_load_explicit(&g_render->queue_head, memory_order_relaxed);
+	while(head - atomic_load_explicit(&g_render->queue_tail, memory_order_acquire)
+			== _GPU_RENDER_QUEUE_SIZE)
+		sched_yield();
+
+	g_render->queue[head % _GPU_RENDER_QUEUE_SIZE] = command;
+	atomic_store_explicit(&g_render->queue_head, head + 1, memory_order_release);
+	sem_post(&g_render->queue_not_empty);
+}
+
+
+static void _gpu_render_log(enum gpu_render_target target, u8 bank, u16 addr,
+		u8 data)
+{
+	//Let the renderer catch up well before the log fills up
+	if(g_render->log_head - g_render->log_flushed >= _GPU_RENDER_LOG_SIZE / 2)
+		_gpu_render_push(COMMAND_WRITES, NULL);
+
+	while(g_render->log_head - atomic_load_explicit(&g_render->log_tail, memory_order_acquire)
+			== _GPU_RENDER_LOG_SIZE)
+		sched_yield();
+
+	g_render->log[g_render->log_head % _GPU_RENDER_LOG_SIZE] = (struct gpu_render_write){
+		.target = target,
+		.bank   = bank,
+		.addr   = addr,
+		.data   = data
+	};
+	g_render->log_head++;
+}
+
+
+static void _gpu_render_video_written(int bank, a16 addr, const u8 *data,
+		int length)
+{
+	enum gpu_render_target target = addr >= _GPU_RENDER_OAM_ADDR
+		? TARGET_OAM : TARGET_VRAM;
+
+	for(int i = 0; i < length; i++)
+		_gpu_render_log(target, bank, addr + i, data[i]);
+}
+
+
+void gpu_render_palette_written(bool sprite, u8 index, u8 data)
+{
+	_gpu_render_log(sprite ? TARGET_SPRITE_PALETTE : TARGET_BG_PALETTE,
+			0, index, data);
+}
+
+
+void gpu_render_line(const struct gpu_render_line *line)
+{
+	_gpu_render_push(COMMAND_LINE, line);
+}
+
+
+void gpu_render_frame(gpu_frame_draw_t *draw)
+{
+	_gpu_render_push(COMMAND_FRAME, NULL);
+	if(g_render->threaded)
+		sem_wait(&g_render->frame_done);
+
+	if(draw != NULL)
+		draw(g_render->screen, g_render->line_hashes);
+}
+
+
+const pixel *gpu_render_get_screen(void)
+{
+	return &g_render->screen[0][0];
+}
+
+
+
+// Apply every logged write and wait until the renderer is done with them
+static void _gpu_render_sync(void)
+{
+	_gpu_render_push(COMMAND_WRITES, NULL);
+	if(!g_render->threaded)
+		return;
+
+	uint32_t head = atomic_load_explicit(&g_render->queue_head, memory_order_relaxed);
+	while(atomic_load_explicit(&g_render->queue_done, memory_order_acquire) != head)
+		sched_yield();
+}
+
+
+void gpu_render_save(struct gpu_render_state *state)
+{
+	_gpu_render_sync();
+
+	memcpy(state->vram, g_render->vram, sizeof(state->vram));
+	memcpy(state->oam, g_render->oam, sizeof(state->oam));
+	memcpy(state->background_palette_memory, g_render->background_palette_memory,
+			sizeof(state->background_palette_memory));
+	memcpy(state->sprite_palette_memory, g_render->sprite_palette_memory,
+			sizeof(state->sprite_palette_memory));
+	state->line = g_render->line;
+}
+
+
+void gpu_render_load(const struct gpu_render_state *state)
+{
+	_gpu_render_sync();
+
+	//Only tiles and map entries that differ need to be rendered again
+	for(int bank = 0; bank < _GPU_RENDER_VRAM_BANKS; bank++)
+	{
+		for(int offset = 0; offset < GPU_LAYER_VRAM_SIZE; offset += GPU_TILE_BYTES)
+		{
+			if(memcmp(&g_render->vram[bank][offset], &state->vram[bank][offset],
+					GPU_TILE_BYTES) == 0)
+				continue;
+			memcpy(&g_render->vram[bank][offset], &state->vram[bank][offset],
+					GPU_TILE_BYTES);
+			gpu_layer_vram_written(bank, _GPU_RENDER_VRAM_ADDR + offset,
+					GPU_TILE_BYTES);
+		}
+	}
+
+	memcpy(g_render->oam, state->oam, sizeof(g_render->oam));
+	memcpy(g_render->background_palette_memory, state->background_palette_memory,
+			sizeof(g_render->background_palette_memory));
+	memcpy(g_render->sprite_palette_memory, state->sprite_palette_memory,
+			sizeof(g_render->sprite_palette_memory));
+	g_render->line = state->line;
+	g_render->palette_lut_dirty = true;
+}
+
+void gpu_render_set_screen(const pixel *screen)
+{
+	_gpu_render_sync();
+
+	memcpy(g_render->screen, screen, sizeof(g_render->screen));
+}
+
+
+static void _gpu_render_stop_thread(void)
+{
+	_gpu_render_push(COMMAND_STOP, NULL);
+	pthread_join(g_render->thread, NULL);
+	g_render->threaded = false;
+
+	sem_destroy(&g_render->queue_not_empty);
+	sem_destroy(&g_render->frame_done);
+
+	if(g_render->latency_frames > 0)
+		logger_print(
+			LOG_INFO,
+			"Render thread frame latency: %.3f ms average, %.3f ms max "
+			"over %ld frames.\n",
+			g_render->latency_sum * 1000 / g_render->latency_frames,
+			g_render->latency_max * 1000,
+			g_render->latency_frames
+		);
+}
+
+
+bool gpu_render_prepare(const palette_config *config, bool threaded)
+{
+	g_render = calloc(1, sizeof(*g_render));
+	if(g_render == NULL) {
+		logger_print(LOG_FATAL, "RENDER: couldn't allocate the context.\n");
+		return false;
+	}
+	g_render->palette_lut_dirty = true;
+
+	g_render->palette_configuration = *config;
+	g_render->draw_scanline = rom_is_cgb()
+		? _gpu_render_draw_scanline_cgb : _gpu_render_draw_scanline_dmg;
+	if(!gpu_layer_prepare(g_render->vram))
+		return false;
+	mem_register_video_write_handler(_gpu_render_video_written);
+
+	if(!threaded)
+		return true;
+
+	sem_init(&g_render->queue_not_empty, 0, 0);
+	sem_init(&g_render->frame_done, 0, 0);
+
+	int error_code = pthread_create(&g_render->thread, NULL,
+			_gpu_render_thread, g_context);
+	if(error_code != 0) {
+		logger_log(
+			LOG_WARN,
+			"RENDER THREAD",
+			"[GPU MODULE] PTHREAD COULD NOT BE CREATED - ERROR CODE %d, "
+			"DRAWING ON THE EMULATION THREAD\n",
+			error_code
+		);
+		return true;
+	}
+
+	g_render->threaded = true;
+	return true;
+}
+
+
+void gpu_render_destroy(void)
+{
+	if(g_render == NULL)
+		return;
+
+	if(g_render->threaded)
+		_gpu_render_stop_thread();
+
+	gpu_layer_destroy();
+	free(g_render);
+	g_render = NULL;
+}
@@ -0,0 +1,101 @@
+#include<string.h>
+#include"gpu_tile.h"
+#include"types.h"
+
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#endif
+
+/*
+ * Bits of a bitplane byte are spread into separate bytes by broadcasting the
+ * byte to all 8 lanes and masking a different bit in each lane. Leftmost
+ * pixel is bit 7 of the bitplane, so the non-flipped mask starts at 0x80.
+ */
+#define _GPU_TILE_LANES      0x0101010101010101ULL
+#define _GPU_TILE_MASK       0x0102040810204080ULL
+#define _GPU_TILE_MASK_FLIP  0x8040201008040201ULL
+
+static inline uint64_t _gpu_tile_spread(u8 bitplane, uint64_t mask)
+{
+	uint64_t lanes = (bitplane * _GPU_TILE_LANES) & mask;
+
+	// Each lane holds at most one bit, turn any non-zero lane into 0x01
+	return ((lanes + 0x7F * _GPU_TILE_LANES) >> 7) & _GPU_TILE_LANES;
+}
+
+static inline void _gpu_tile_decode_row(u8 lower, u8 upper, uint64_t mask,
+		u8 dst[8])
+{
+	uint64_t row = _gpu_tile_spread(lower, mask)
+		| _gpu_tile_spread(upper, mask) << 1;
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	row = __builtin_bswap64(row);
+#endif
+	memcpy(dst, &row, 8);
+}
+
+void gpu_tile_decode_row(u8 lower, u8 upper, bool flip_x, u8 dst[8])
+{
+	_gpu_tile_decode_row(lower, upper,
+			flip_x ? _GPU_TILE_MASK_FLIP : _GPU_TILE_MASK, dst);
+}
+
+#if defined(__SSE2__)
+/* Decode 8 rows (16 bytes of VRAM) into 64 colour numbers, two rows per
+ * vector. Each bitplane byte is broadcast to 8 lanes, masked and compared,
+ * which gives 0xFF for set bits.
+ */
+static void _gpu_tile_decode8_sse2(const u8 *data, __m128i mask, u8 *dst)
+{
+	__m128i in = _mm_loadu_si128((const __m128i *)data);
+	__m128i one = _mm_set1_epi8(1);
+	__m128i two = _mm_set1_epi8(2);
+	// lo0 x2, hi0 x2, lo1 x2, ... for rows 0-3 and 4-7
+	__m128i bytes[2] = {
+		_mm_unpacklo_epi8(in, in),
+		_mm_unpackhi_epi8(in, in),
+	};
+
+	for (int half = 0; half < 2; half++) {
+		// lo0 x4, hi0 x4, lo1 x4, hi1 x4 (rows 0-1 and 2-3 of the half)
+		__m128i words[2] = {
+			_mm_unpacklo_epi16(bytes[half], bytes[half]),
+			_mm_unpackhi_epi16(bytes[half], bytes[half]),
+		};
+
+		for (int pair = 0; pair < 2; pair++) {
+			__m128i lower = _mm_shuffle_epi32(words[pair],
+					_MM_SHUFFLE(2, 2, 0, 0));
+			__m128i upper = _mm_shuffle_epi32(words[pair],
+					_MM_SHUFFLE(3, 3, 1, 1));
+
+			lower = _mm_cmpeq_epi8(_mm_and_si128(lower, mask), mask);
+			upper = _mm_cmpeq_epi8(_mm_and_si128(upper, mask), mask);
+
+			__m128i out = _mm_or_si128(_mm_and_si128(lower, one),
+					_mm_and_si128(upper, two));
+			_mm_storeu_si128((__m128i *)(dst + (half * 2 + pair) * 16),
+					out);
+		}
+	}
+}
+#endif
+
+void gpu_tile_decode(const u8 *data, int rows, bool flip_x, u8 *dst)
+{
+	uint64_t mask = flip_x ? _GPU_TILE_MASK_FLIP : _GPU_TILE_MASK;
+	int row = 0;
+
+#if defined(__SSE2__)
+	__m128i mask_sse = _mm_set1_epi64x((long long)mask);
+
+	for (; row + GPU_TILE_ROWS <= rows; row += GPU_TILE_ROWS)
+		_gpu_tile_decode8_sse2(data + row * GPU_TILE_ROW_BYTES,
+				mask_sse, dst + row * 8);
+#endif
+
+	for (; row < rows; row++)
+		_gpu_tile_decode_row(data[row * GPU_TILE_ROW_BYTES],
+				data[row * GPU_TILE_ROW_BYTES + 1], mask, dst + row * 8);
+}
@@ -0,0 +1,499 @@
+#include<limits.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include"cpu.h"
+#include"hotspot.h"
+#include"logger.h"
+#include"mem.h"
+#include"regs.h"
+
+#define HOTSPOT_MAX_DEPTH 64
+#define HOTSPOT_MAX_NAME  64
+#define HOTSPOT_MAX_PATH  260
+// Rows of the tables in the log
+#define HOTSPOT_TOP       20
+// Marks the taken slots of count tables
+#define HOTSPOT_USED      (1u << 31)
+// Code outside of any call, keys are no wider than 25 bits
+#define HOTSPOT_ROOT      0x7FFFFFFF
+
+/*
+ * Code is keyed by bank << 16 | address. Stacks are counted in a hash table
+ * keyed by their call targets, root first, names are only looked up when
+ * writing them out. The stack is unwound by SP as well as by RET, so
+ * routines dropping their return address don't leave frames behind.
+ */
+
+struct hotspot_frame {
+	uint32_t function;
+	a16      sp;
+};
+
+struct hotspot_stack {
+	uint64_t       hash;
+	int            depth;
+	uint32_t      *functions;
+	unsigned long  samples;
+};
+
+// Open addressing, the key is or'ed with HOTSPOT_USED
+struct hotspot_count {
+	uint32_t      key;
+	unsigned long self;
+	unsigned long total;
+};
+
+struct hotspot_symbol {
+	uint32_t key;
+	char     name[HOTSPOT_MAX_NAME];
+};
+
+struct hotspot_table {
+	void   *entries;
+	size_t  capacity;
+	size_t  count;
+};
+
+long g_hotspot_countdown = LONG_MAX;
+
+static struct {
+	char                   folded_path[HOTSPOT_MAX_PATH];
+	long                   period;
+	unsigned long          samples;
+	struct hotspot_frame   frames[HOTSPOT_MAX_DEPTH];
+	int                    depth;
+	struct hotspot_table   stacks;
+	struct hotspot_table   addresses;
+	struct hotspot_symbol *symbols;
+	size_t                 symbol_count;
+} g_hotspot;
+
+
+static inline uint32_t _hotspot_key(a16 addr)
+{
+	return (uint32_t)mem_get_bank(addr) << 16 | addr;
+}
+
+
+static void _hotspot_unwind(int sp)
+{
+	while (g_hotspot.depth > 0 && g_hotspot.frames[g_hotspot.depth - 1].sp < sp)
+		g_hotspot.depth--;
+}
+
+
+static void _hotspot_call(a16 target, a16 sp)
+{
+	// Frames at or below the new return address were left without a RET
+	_hotspot_unwind(sp + 1);
+	if (g_hotspot.depth == HOTSPOT_MAX_DEPTH)
+		return;
+
+	g_hotspot.frames[g_hotspot.depth].function = _hotspot_key(target);
+	g_hotspot.frames[g_hotspot.depth].sp = sp;
+	g_hotspot.depth++;
+}
+
+
+static void _hotspot_ret(a16 sp)
+{
+	_hotspot_unwind(sp);
+}
+
+
+static const struct cpu_call_hooks g_hotspot_hooks = {
+	_hotspot_call,
+	_hotspot_ret,
+};
+
+
+static uint64_t _hotspot_hash(const uint32_t *functions, int depth)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	for (int i = 0; i < depth; i++) {
+		hash ^= functions[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash | 1;
+}
+
+
+static bool _hotspot_grow(struct hotspot_table *table, size_t entry_size,
+		void (*insert)(struct hotspot_table *, void *))
+{
+	if (table->count * 2 < table->capacity)
+		return true;
+
+	struct hotspot_table old = *table;
+	table->capacity = old.capacity ? old.capacity * 2 : 1024;
+	table->count = 0;
+	table->entries = calloc(table->capacity, entry_size);
+	if (table->entries == NULL) {
+		*table = old;
+		return false;
+	}
+
+	for (size_t i = 0; i < old.capacity; i++)
+		insert(table, (char *)old.entries + i * entry_size);
+	free(old.entries);
+
+	return true;
+}
+
+
+static void _hotspot_insert_stack(struct hotspot_table *table, void *entry)
+{
+	struct hotspot_stack *stack = entry;
+	struct hotspot_stack *stacks = table->entries;
+
+	if (stack->hash == 0)
+		return;
+
+	size_t i = stack->hash & (table->capacity - 1);
+	while (stacks[i].hash != 0)
+		i = (i + 1) & (table->capacity - 1);
+	stacks[i] = *stack;
+	table->count++;
+}
+
+
+static void _hotspot_insert_count(struct hotspot_table *table, void *entry)
+{
+	struct hotspot_count *count = entry;
+	struct hotspot_count *counts = table->entries;
+
+	if (count->key == 0)
+		return;
+
+	size_t i = (count->key * 2654435761u) & (table->capacity - 1);
+	while (counts[i].key != 0)
+		i = (i + 1) & (table->capacity - 1);
+	counts[i] = *count;
+	table->count++;
+}
+
+
+static struct hotspot_count *_hotspot_find_count(struct hotspot_table *table,
+		uint32_t key)
+{
+	key |= HOTSPOT_USED;
+	if (!_hotspot_grow(table, sizeof(struct hotspot_count), _hotspot_insert_count))
+		return NULL;
+
+	struct hotspot_count *counts = table->entries;
+	size_t i = (key * 2654435761u) & (table->capacity - 1);
+	while (counts[i].key != 0 && counts[i].key != key)
+		i = (i + 1) & (table->capacity - 1);
+
+	if (counts[i].key == 0) {
+		counts[i].key = key;
+		table->count++;
+	}
+	return &counts[i];
+}
+
+
+static void _hotspot_count_stack(void)
+{
+	uint32_t functions[HOTSPOT_MAX_DEPTH];
+	int depth = g_hotspot.depth;
+
+	for (int i = 0; i < depth; i++)
+		functions[i] = g_hotspot.frames[i].function;
+
+	uint64_t hash = _hotspot_hash(functions, depth);
+	if (!_hotspot_grow(&g_hotspot.stacks, sizeof(struct hotspot_stack),
+			_hotspot_insert_stack))
+		return;
+
+	struct hotspot_stack *stacks = g_hotspot.stacks.entries;
+	size_t mask = g_hotspot.stacks.capacity - 1;
+	size_t i = hash & mask;
+	while (stacks[i].hash != 0) {
+		if (stacks[i].hash == hash && stacks[i].depth == depth
+				&& memcmp(stacks[i].functions, functions,
+					depth * sizeof(*functions)) == 0) {
+			stacks[i].samples++;
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+
+	// Not NULL for the empty stack either
+	stacks[i].functions = malloc(depth * sizeof(*functions) + 1);
+	if (stacks[i].functions == NULL)
+		return;
+	memcpy(stacks[i].functions, functions, depth * sizeof(*functions));
+	stacks[i].hash = hash;
+	stacks[i].depth = depth;
+	stacks[i].samples = 1;
+	g_hotspot.stacks.count++;
+}
+
+
+void hotspot_sample(void)
+{
+	if (g_hotspot.period == 0) {
+		g_hotspot_countdown = LONG_MAX;
+		return;
+	}
+	g_hotspot_countdown += g_hotspot.period;
+	g_hotspot.samples++;
+
+	struct hotspot_count *address = _hotspot_find_count(&g_hotspot.addresses,
+			_hotspot_key(cpu_register_get().PC));
+	if (address != NULL)
+		address->self++;
+
+	_hotspot_count_stack();
+}
+
+
+static int _hotspot_compare_symbols(const void *a, const void *b)
+{
+	uint32_t x = ((const struct hotspot_symbol *)a)->key;
+	uint32_t y = ((const struct hotspot_symbol *)b)->key;
+	return (x > y) - (x < y);
+}
+
+
+// BB:AAAA Label per line, ; starts a comment
+static void _hotspot_load_symbols(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return;
+
+	char line[256];
+	unsigned bank, addr;
+	struct hotspot_symbol symbol;
+	size_t capacity = 0;
+
+	while (fgets(line, sizeof(line), file)) {
+		if (sscanf(line, "%x:%x %63s", &bank, &addr, symbol.name) != 3
+				|| symbol.name[0] == ';' || addr > 0xFFFF)
+			continue;
+		symbol.key = bank << 16 | addr;
+
+		if (g_hotspot.symbol_count == capacity) {
+			capacity = capacity ? capacity * 2 : 256;
+			struct hotspot_symbol *symbols = realloc(g_hotspot.symbols,
+					capacity * sizeof(*symbols));
+			if (symbols == NULL)
+				break;
+			g_hotspot.symbols = symbols;
+		}
+		g_hotspot.symbols[g_hotspot.symbol_count++] = symbol;
+	}
+	fclose(file);
+
+	qsort(g_hotspot.symbols, g_hotspot.symbol_count, sizeof(*g_hotspot.symbols),
+			_hotspot_compare_symbols);
+	logger_print(LOG_INFO, "[HOTSPOT] %zu symbols from %s\n",
+			g_hotspot.symbol_count, path);
+}
+
+
+// Symbol the code at key belongs to, NULL if none
+static const struct hotspot_symbol *_hotspot_symbol(uint32_t key)
+{
+	size_t low = 0, high = g_hotspot.symbol_count;
+
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		if (g_hotspot.symbols[middle].key <= key)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low == 0 || g_hotspot.symbols[low - 1].key >> 16 != key >> 16)
+		return NULL;
+	return &g_hotspot.symbols[low - 1];
+}
+
+
+// Functions are told apart by their symbol if they have one
+static uint32_t _hotspot_function(uint32_t key)
+{
+	const struct hotspot_symbol *symbol = _hotspot_symbol(key);
+	return symbol ? symbol->key : key;
+}
+
+
+static const char *_hotspot_name(uint32_t key, char *buffer, size_t size)
+{
+	const struct hotspot_symbol *symbol = _hotspot_symbol(key);
+
+	if (key == HOTSPOT_ROOT)
+		return "(root)";
+	if (symbol != NULL)
+		return symbol->name;
+	snprintf(buffer, size, "%02X:%04X", key >> 16, key & 0xFFFF);
+	return buffer;
+}
+
+
+static int _hotspot_compare_self(const void *a, const void *b)
+{
+	unsigned long x = ((const struct hotspot_count *)a)->self;
+	unsigned long y = ((const struct hotspot_count *)b)->self;
+	return (x < y) - (x > y);
+}
+
+
+static void _hotspot_write_folded(void)
+{
+	FILE *file = fopen(g_hotspot.folded_path, "w");
+	if (file == NULL) {
+		logger_print(LOG_WARN, "[HOTSPOT] Couldn't open %s\n", g_hotspot.folded_path);
+		return;
+	}
+
+	struct hotspot_stack *stacks = g_hotspot.stacks.entries;
+	char name[HOTSPOT_MAX_NAME];
+	for (size_t i = 0; i < g_hotspot.stacks.capacity; i++) {
+		if (stacks[i].hash == 0)
+			continue;
+
+		fputs("(root)", file);
+		for (int j = 0; j < stacks[i].depth; j++)
+			fprintf(file, ";%s", _hotspot_name(stacks[i].functions[j],
+					name, sizeof(name)));
+		fprintf(file, " %lu\n", stacks[i].samples * g_hotspot.period);
+	}
+
+	fclose(file);
+}
+
+
+static void _hotspot_print_functions(void)
+{
+	struct hotspot_table functions = { 0 };
+	struct hotspot_stack *stacks = g_hotspot.stacks.entries;
+
+	for (size_t i = 0; i < g_hotspot.stacks.capacity; i++) {
+		if (stacks[i].hash == 0)
+			continue;
+
+		uint32_t seen[HOTSPOT_MAX_DEPTH];
+		int unique = 0;
+		for (int j = 0; j < stacks[i].depth; j++) {
+			uint32_t function = _hotspot_function(stacks[i].functions[j]);
+			int k = 0;
+			while (k < unique && seen[k] != function)
+				k++;
+			if (k == unique) {
+				seen[unique++] = function;
+				struct hotspot_count *count = _hotspot_find_count(&functions, function);
+				if (count != NULL)
+					count->total += stacks[i].samples;
+			}
+		}
+
+		uint32_t leaf = stacks[i].depth
+			? _hotspot_function(stacks[i].functions[stacks[i].depth - 1])
+			: HOTSPOT_ROOT;
+		struct hotspot_count *count = _hotspot_find_count(&functions, leaf);
+		if (count != NULL)
+			count->self += stacks[i].samples;
+	}
+
+	struct hotspot_count *counts = functions.entries;
+	qsort(counts, functions.capacity, sizeof(*counts), _hotspot_compare_self);
+
+	char name[HOTSPOT_MAX_NAME];
+	double samples = g_hotspot.samples;
+	logger_print(LOG_INFO, "  %-32s %14s %7s %14s %7s\n", "function",
+			"self cycles", "%", "total cycles", "%");
+	for (size_t i = 0; i < functions.capacity && i < HOTSPOT_TOP; i++) {
+		if (counts[i].self == 0)
+			break;
+		logger_print(LOG_INFO, "  %-32s %14lu %7.2f %14lu %7.2f\n",
+				_hotspot_name(counts[i].key & ~HOTSPOT_USED, name, sizeof(name)),
+				counts[i].self * g_hotspot.period, 100 * counts[i].self / samples,
+				counts[i].total * g_hotspot.period, 100 * counts[i].total / samples);
+	}
+
+	free(functions.entries);
+}
+
+
+static void _hotspot_print_addresses(void)
+{
+	struct hotspot_count *counts = g_hotspot.addresses.entries;
+	qsort(counts, g_hotspot.addresses.capacity, sizeof(*counts),
+			_hotspot_compare_self);
+
+	char address[16];
+	double samples = g_hotspot.samples;
+	logger_print(LOG_INFO, "  %-8s %14s %7s  %s\n", "address", "cycles", "%", "symbol");
+	for (size_t i = 0; i < g_hotspot.addresses.capacity && i < HOTSPOT_TOP; i++) {
+		if (counts[i].self == 0)
+			break;
+		uint32_t key = counts[i].key & ~HOTSPOT_USED;
+		snprintf(address, sizeof(address), "%02X:%04X", key >> 16, key & 0xFFFF);
+		const struct hotspot_symbol *symbol = _hotspot_symbol(key);
+		char where[HOTSPOT_MAX_NAME + 8] = "";
+		if (symbol != NULL)
+			snprintf(where, sizeof(where), "%s+%u", symbol->name, key - symbol->key);
+		logger_print(LOG_INFO, "  %-8s %14lu %7.2f  %s\n", address,
+				counts[i].self * g_hotspot.period, 100 * counts[i].self / samples,
+				where);
+	}
+}
+
+
+bool hotspot_prepare(const char *folded_path, const char *rom_path, long period)
+{
+	if (period <= 0)
+		period = HOTSPOT_DEFAULT_PERIOD;
+
+	snprintf(g_hotspot.folded_path, sizeof(g_hotspot.folded_path), "%s", folded_path);
+	g_hotspot.period = period;
+	g_hotspot_countdown = period;
+
+	// game.gb comes with game.sym
+	char sym_path[HOTSPOT_MAX_PATH];
+	snprintf(sym_path, sizeof(sym_path), "%s", rom_path);
+	char *extension = strrchr(sym_path, '.');
+	if (extension != NULL && strchr(extension, '/') == NULL)
+		*extension = '\0';
+	if (strlen(sym_path) + 4 < sizeof(sym_path)) {
+		strcat(sym_path, ".sym");
+		_hotspot_load_symbols(sym_path);
+	}
+
+	cpu_set_call_hooks(&g_hotspot_hooks);
+	logger_print(LOG_INFO, "[HOTSPOT] Sampling every %ld cycles.\n", period);
+	return true;
+}
+
+
+void hotspot_destroy(void)
+{
+	if (g_hotspot.period == 0)
+		return;
+
+	cpu_set_call_hooks(NULL);
+	g_hotspot_countdown = LONG_MAX;
+
+	if (g_hotspot.samples > 0) {
+		logger_print(LOG_INFO, "[HOTSPOT] %lu samples, %lu cycles\n",
+				g_hotspot.samples, g_hotspot.samples * g_hotspot.period);
+		_hotspot_print_functions();
+		_hotspot_print_addresses();
+		_hotspot_write_folded();
+	}
+
+	struct hotspot_stack *stacks = g_hotspot.stacks.entries;
+	for (size_t i = 0; i < g_hotspot.stacks.capacity; i++)
+		free(stacks[i].functions);
+	free(g_hotspot.stacks.entries);
+	free(g_hotspot.addresses.entries);
+	free(g_hotspot.symbols);
+	memset(&g_hotspot, 0, sizeof(g_hotspot));
+}
@@ -0,0 +1,24 @@
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include"display.h"
+#include"types.h"
+
+/* Output formats:
+ *   y4m          YUV4MPEG2, 4:4:4, at the Game Boy frame rate
+ *   rgb          raw RGB888 frames
+ *   rgb565       raw RGB565 (little endian) frames
+ *   rgb-diff     per frame, a bitmap of changed lines (SCREEN_HEIGHT bits,
+ *   rgb565-diff  LSB first) followed by only those lines
+ */
+bool capture_prepare(const char *path, const char *format);
+bool capture_is_active(void);
+
+/* Queue a frame for writing. Never blocks, if the writer is behind the frame
+ * is dropped.
+ */
+void capture_frame(pixel screen[SCREEN_HEIGHT][SCREEN_WIDTH]);
+
+void capture_destroy(void);
+
+#endif /* CAPTURE_H_ */
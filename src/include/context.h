@@ -0,0 +1,20 @@
+#ifndef CONTEXT_H_
+#define CONTEXT_H_
+
+/* One emulated Game Boy. Module functions work on the context current on the
+ * calling thread, so any number of contexts can run side by side, each on
+ * one thread at a time.
+ *
+ * A new context is empty and becomes current; the module prepare functions
+ * fill it in. Module destroy functions have to be called on it (while it is
+ * current) before context_destroy.
+ */
+struct gb_context;
+
+struct gb_context *context_create(void);
+void context_destroy(struct gb_context *context);
+
+void context_set_current(struct gb_context *context);
+struct gb_context *context_get_current(void);
+
+#endif /* CONTEXT_H_ */
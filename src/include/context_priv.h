@@ -0,0 +1,32 @@
+#ifndef CONTEXT_PRIV_H_
+#define CONTEXT_PRIV_H_
+
+#include"context.h"
+#include"rom.h"
+
+/* Each module keeps its state in a structure private to it, allocated when
+ * the module is prepared and freed when it is destroyed.
+ */
+struct gb_context {
+	struct cpu_context        *cpu;
+	struct mem_context        *mem;
+	struct mem_rtc_context    *mem_rtc;
+	struct ints_context       *ints;
+	struct timer_context      *timer;
+	struct serial_context     *serial;
+	struct joypad_context     *joypad;
+	struct gpu_context        *gpu;
+	struct gpu_render_context *gpu_render;
+	struct gpu_layer_context  *gpu_layer;
+	struct sound_context      *sound;
+	struct state_context      *state;
+	struct rom_header          rom_header;
+};
+
+/* Initial exec, so that libgbc.so reaches it as directly as the executable
+ * does instead of through __tls_get_addr.
+ */
+extern _Thread_local struct gb_context *g_context
+	__attribute__((tls_model("initial-exec")));
+
+#endif /* CONTEXT_PRIV_H_ */
@@ -10,6 +10,14 @@
 // returns -1 if encountered fatal error
 int cpu_single_step(void);
 
+/* Something the next event (see gpu_cycles_until_event) depends on changed
+ * other than by cycles passing: an IO register or IE was written, an
+ * interrupt was requested, IME changed or a state was loaded. Makes the CPU
+ * work out the cycles until the next event again before the next
+ * instruction.
+ */
+void cpu_events_changed(void);
+
 // Set Program Counter to given address
 void cpu_jump(a16 addr);
 
@@ -17,8 +25,27 @@ void cpu_jump(a16 addr);
 // Then set Program Counter to given address
 void cpu_call(a16 addr);
 
-// Load all instructions
-void cpu_prepare(void);
+// Load all instructions, false if the CPU state couldn't be allocated
+bool cpu_prepare(void);
+
+// Print collected statistics (if enabled at compile time)
+void cpu_destroy(void);
+
+#ifdef CPU_LOCKSTEP
+// Execute instruction by instruction, without fused handlers or native loops
+void cpu_set_reference(bool reference);
+#endif
+
+/* Told about every CALL, RST and interrupt once the return address is pushed
+ * (with the new PC and SP), and about every RET and RETI taken once it is
+ * popped (with the new SP). NULL for none.
+ */
+struct cpu_call_hooks {
+	void (*call)(a16 target, a16 sp);
+	void (*ret)(a16 sp);
+};
+
+void cpu_set_call_hooks(const struct cpu_call_hooks *hooks);
 
 // Write given data to memory pointed by SP
 // Then decrement SP by proper amount
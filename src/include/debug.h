@@ -1,8 +1,11 @@
 #ifndef SRC_INCLUDE_DEBUG_H_
 #define SRC_INCLUDE_DEBUG_H_
 
+#include<stddef.h>
 #include"types.h"
 
+int debug_disassemble(u16 pc, char *buffer, size_t size);
+void debug_mnemonic(d8 opcode, bool extended, char *buffer, size_t size);
 void debug_print_instruction(u16 pc);
 void debug_assert(bool expr, const char *msg);
 
@@ -14,9 +14,54 @@ typedef struct colour {
 	bool a;
 } colour;
 
+/* Pixels of the frame, from the palette lookup tables to the SDL texture.
+ * Building with DISPLAY_RGB565 defined (make gbc_rgb565) switches them from
+ * colour to 16 bit RGB565, halving the bandwidth per frame.
+ */
+#ifdef DISPLAY_RGB565
+typedef u16 pixel;
+
+static inline pixel display_pixel(colour c)
+{
+	return ((c.r >> 3) << 11) | ((c.g >> 2) << 5) | (c.b >> 3);
+}
+
+static inline colour display_pixel_colour(pixel p)
+{
+	u8 r = p >> 11, g = (p >> 5) & 0x3F, b = p & 0x1F;
+	colour c = { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), true };
+	return c;
+}
+#else
+typedef colour pixel;
+
+static inline pixel display_pixel(colour c)
+{
+	return c;
+}
+
+static inline colour display_pixel_colour(pixel p)
+{
+	return p;
+}
+#endif
+
+// Pixels as uploaded to the texture, RGB565 or ABGR8888
+#ifdef DISPLAY_RGB565
+typedef u16      texel;
+#else
+typedef uint32_t texel;
+#endif
+
 
 void display_prepare(float frequency, char * rom_title, bool fullscreen);
-void display_draw(colour screen[SCREEN_HEIGHT][SCREEN_WIDTH]);
+/* line_hashes identify the contents of each line, lines with the same hash
+ * as last time are neither converted nor uploaded again.
+ */
+void display_draw(pixel screen[SCREEN_HEIGHT][SCREEN_WIDTH],
+		const uint64_t line_hashes[SCREEN_HEIGHT]);
+// Whether a frame passed to display_draw now would be presented
+bool display_frame_wanted(void);
 bool display_get_closed_status(void);
 void display_destroy(void);
 
@@ -0,0 +1,51 @@
+#ifndef DISPLAY_SHM_H_
+#define DISPLAY_SHM_H_
+
+#include<stdatomic.h>
+#include"display.h"
+#include"types.h"
+
+/*
+ * Shared memory frame export.
+ *
+ * The object starts with struct display_shm_header, followed by slots of
+ * slot_size bytes each: struct display_shm_slot and then height rows of
+ * width RGBA8888 pixels (4 bytes, in R, G, B, A order, A always 0xFF).
+ *
+ * Frame n (counting from 1) goes to slot (n - 1) % slots. A slot's sequence
+ * is odd while it is being written and 2 * n once frame n is complete, so a
+ * reader copying or processing pixels in place checks the sequence before
+ * and after. After each frame the header's frames counter is incremented
+ * and used as a futex word, readers can FUTEX_WAIT on it for the next frame.
+ */
+
+#define DISPLAY_SHM_MAGIC       0x46434247  /* "GBCF" */
+#define DISPLAY_SHM_VERSION     1
+#define DISPLAY_SHM_SLOTS       8
+#define DISPLAY_SHM_FORMAT_RGBA 0
+
+struct display_shm_header {
+	uint32_t          magic;
+	uint32_t          version;
+	uint32_t          slots;
+	uint32_t          slot_size;
+	uint32_t          width;
+	uint32_t          height;
+	uint32_t          stride;
+	uint32_t          format;
+	_Atomic uint32_t  frames;   /* Futex word, number of completed frames */
+	_Atomic uint32_t  closed;   /* Set once the emulator is done */
+};
+
+struct display_shm_slot {
+	_Atomic uint64_t  sequence;
+	uint64_t          timestamp; /* CLOCK_MONOTONIC, nanoseconds */
+	u8                pixels[];
+};
+
+bool display_shm_prepare(const char *name);
+bool display_shm_is_active(void);
+void display_shm_publish(pixel screen[SCREEN_HEIGHT][SCREEN_WIDTH]);
+void display_shm_destroy(void);
+
+#endif /* DISPLAY_SHM_H_ */
@@ -5,9 +5,6 @@
 #include"input.h"
 #include"types.h"
 
-#define FRAME_TIMER_EVENT  0
-
-bool events_is_frame_ready(void);
 bool events_is_display_closed(void);
 
 struct all_inputs events_get_inputs(void);
@@ -0,0 +1,101 @@
+#ifndef GBC_H_
+#define GBC_H_
+
+#include<stdbool.h>
+#include<stddef.h>
+#include<stdint.h>
+
+/* libgbc, the emulator core without a display, input or pacing of its own
+ * (make libgbc). Every handle is a separate Game Boy which can be driven from
+ * any thread, one thread at a time. Calls make the handle's context current
+ * on the calling thread.
+ */
+
+#define GBC_API __attribute__((visibility("default")))
+
+#define GBC_SCREEN_WIDTH  160
+#define GBC_SCREEN_HEIGHT 144
+
+// Clocks in a frame, at normal speed
+#define GBC_FRAME_CYCLES  70224
+
+enum gbc_button {
+	GBC_BUTTON_RIGHT  = 1 << 0,
+	GBC_BUTTON_LEFT   = 1 << 1,
+	GBC_BUTTON_UP     = 1 << 2,
+	GBC_BUTTON_DOWN   = 1 << 3,
+	GBC_BUTTON_A      = 1 << 4,
+	GBC_BUTTON_B      = 1 << 5,
+	GBC_BUTTON_SELECT = 1 << 6,
+	GBC_BUTTON_START  = 1 << 7,
+};
+
+struct gbc;
+
+// Only log warnings and errors, for all handles
+GBC_API void gbc_set_quiet(bool quiet);
+
+// The ROM is copied, NULL if it can't be loaded
+GBC_API struct gbc *gbc_create(const uint8_t *rom, size_t rom_size);
+GBC_API void gbc_destroy(struct gbc *gbc);
+
+// Back to the state right after gbc_create, the joypad state is kept
+GBC_API void gbc_reset(struct gbc *gbc);
+
+/* Run until the next frame starts (at most GBC_FRAME_CYCLES, in case the LCD
+ * is off), or for at least cycles clocks. Both return false once the CPU hit
+ * an instruction it can't execute, until a reset or a state is loaded.
+ */
+GBC_API bool gbc_run_frame(struct gbc *gbc);
+GBC_API bool gbc_run_cycles(struct gbc *gbc, long cycles);
+
+// Buttons held from now on, a mask of enum gbc_button
+GBC_API void gbc_set_joypad(struct gbc *gbc, unsigned buttons);
+
+/* The last finished frame, GBC_SCREEN_HEIGHT rows of GBC_SCREEN_WIDTH pixels
+ * of gbc_pixel_size() bytes each: R, G, B and 1, or RGB565 in native byte
+ * order if built with DISPLAY_RGB565. Stays valid until gbc_destroy.
+ */
+GBC_API const void *gbc_framebuffer(struct gbc *gbc);
+GBC_API size_t gbc_pixel_size(void);
+
+/* States can only be loaded into a handle created from the same ROM, by the
+ * same build of the library.
+ */
+GBC_API size_t gbc_state_size(struct gbc *gbc);
+GBC_API void gbc_state_save(struct gbc *gbc, void *buffer);
+GBC_API void gbc_state_load(struct gbc *gbc, const void *buffer);
+
+// Read as the CPU would
+GBC_API uint8_t gbc_read8(struct gbc *gbc, uint16_t addr);
+
+/* Bytes sent over the serial port since gbc_create or gbc_reset, the newest
+ * few KiB of them, NUL terminated. Valid until the handle runs again.
+ */
+GBC_API const char *gbc_serial_output(struct gbc *gbc, size_t *length);
+
+/* Batches run a frame on many handles at once, over a pool of threads of
+ * which the calling thread is one. threads 0 sizes the pool to the CPUs.
+ */
+struct gbc_batch;
+
+GBC_API struct gbc_batch *gbc_batch_create(int threads);
+GBC_API void gbc_batch_destroy(struct gbc_batch *batch);
+GBC_API int gbc_batch_threads(struct gbc_batch *batch);
+
+/* Bytes per frame downsampled by downsample (averaging downsample squared
+ * pixels), 0 unless it divides both screen dimensions.
+ */
+GBC_API size_t gbc_batch_frame_size(int downsample);
+
+/* gbc_run_frame on count handles, after setting buttons[i] on gbcs[i] unless
+ * buttons is NULL. Unless frames is NULL, the framebuffers are then copied to
+ * it one after the other, gbc_batch_frame_size(downsample) bytes each.
+ *
+ * @return how many handles stopped on an instruction they can't execute, -1
+ *         if downsample doesn't divide the screen
+ */
+GBC_API int gbc_batch_run_frame(struct gbc_batch *batch, struct gbc **gbcs,
+		const unsigned *buttons, int count, void *frames, int downsample);
+
+#endif /* GBC_H_ */
@@ -2,9 +2,31 @@
 #define GPU_H_
 
 #include"cpu.h"
+#include"gpu_render.h"
 
-void gpu_prepare(char * rom_title, int frame_rate, bool fullscreen);
+/* Where drawn frames go, set up by the frontend. Without draw frames are only
+ * kept by the renderer, without wanted every frame is wanted.
+ */
+struct gpu_frame_sink {
+	gpu_frame_draw_t *draw;
+	// Whether a frame finished now would be shown, for frameskip
+	bool (*wanted)(void);
+};
+
+bool gpu_prepare(const struct gpu_frame_sink *sink, bool render_thread,
+		bool auto_frameskip);
 void gpu_step(int cycles_delta);
+int gpu_cycles_until_event(void);
+void gpu_add_idle_time(long nsec);
+
+/* Frames are counted as they start (LY wrapping to 0), whether the frame is
+ * drawn is decided by frameskip right then. While frameskip is held, as when
+ * running ahead, only gpu_set_frame_drawn decides.
+ */
+unsigned long gpu_get_frame_count(void);
+bool gpu_is_frame_drawn(void);
+void gpu_set_frame_drawn(bool draw);
+void gpu_hold_frameskip(bool hold);
 void gpu_destroy(void);
 
 #endif /* GPU_H_ */
@@ -0,0 +1,51 @@
+#ifndef GPU_COMPOSE_H_
+#define GPU_COMPOSE_H_
+
+#include"display.h"
+#include"types.h"
+
+/* Sprite plane pixels use the same colour/palette layout as layer pixels,
+ * with the top bit marking pixels actually covered by a sprite.
+ */
+#define GPU_COMPOSE_SPRITE_OPAQUE 0x80
+
+/* Palette lookup table: background colours (palette * 4 + colour number)
+ * followed by sprite colours.
+ */
+#define GPU_COMPOSE_SPRITE_LUT    32
+#define GPU_COMPOSE_LUT_SIZE      64
+
+/* Merge background/window plane with sprite planes into palette lookup table
+ * indices.
+ *
+ * sprites holds the first opaque sprite pixel at each position, sprites_front
+ * the first one of sprites drawn over background colours 1-3. If
+ * sprites_over_bg is set, sprites are drawn regardless of background colours
+ * and priorities.
+ */
+void gpu_compose_line(
+	const u8 bg[SCREEN_WIDTH],
+	const u8 sprites[SCREEN_WIDTH],
+	const u8 sprites_front[SCREEN_WIDTH],
+	bool sprites_over_bg,
+	u8 dst[SCREEN_WIDTH]
+);
+
+/* Portable version of gpu_compose_line, used where SSE2 isn't available
+ * (the Pi). Always built, so bench/compose checks both give the same output.
+ */
+void gpu_compose_line_scalar(
+	const u8 bg[SCREEN_WIDTH],
+	const u8 sprites[SCREEN_WIDTH],
+	const u8 sprites_front[SCREEN_WIDTH],
+	bool sprites_over_bg,
+	u8 dst[SCREEN_WIDTH]
+);
+
+void gpu_compose_resolve(
+	const u8 indices[SCREEN_WIDTH],
+	const pixel lut[GPU_COMPOSE_LUT_SIZE],
+	pixel dst[SCREEN_WIDTH]
+);
+
+#endif /* GPU_COMPOSE_H_ */
@@ -0,0 +1,40 @@
+#ifndef GPU_LAYER_H_
+#define GPU_LAYER_H_
+
+#include"display.h"
+#include"types.h"
+
+#define GPU_LAYER_SIZE      256
+#define GPU_LAYER_MAPS      2
+#define GPU_LAYER_VRAM_SIZE 0x2000
+
+/* Every pixel of a layer packs the colour number with the CGB attributes of
+ * the tile it comes from.
+ */
+#define GPU_LAYER_COLOUR(pixel)   ((pixel) & 0x03)
+#define GPU_LAYER_PALETTE(pixel)  (((pixel) >> 2) & 0x07)
+#define GPU_LAYER_PRIORITY(pixel) (((pixel) & 0x20) != 0)
+
+/* Tiles are rendered from vram, both banks of which (one on DMG) start at
+ * 0x8000. Every change to it has to be reported with gpu_layer_vram_written.
+ */
+bool gpu_layer_prepare(u8 vram[][GPU_LAYER_VRAM_SIZE]);
+void gpu_layer_destroy(void);
+void gpu_layer_vram_written(int bank, a16 addr, int length);
+
+// Drop all cached pixels
+void gpu_layer_invalidate(void);
+
+/* Fetch a scanline of the tile map selected by map (0: 0x9800, 1: 0x9C00),
+ * starting at (x, y) and wrapping around both edges of the map.
+ */
+void gpu_layer_fetch(int map, bool signed_data, u8 x, u8 y,
+		u8 dst[SCREEN_WIDTH]);
+
+/* Same as gpu_layer_fetch, but pixels past the right edge of the map continue
+ * on the next tile row instead of wrapping to the left edge.
+ */
+void gpu_layer_fetch_linear(int map, bool signed_data, u8 x, u8 y,
+		u8 dst[SCREEN_WIDTH]);
+
+#endif /* GPU_LAYER_H_ */
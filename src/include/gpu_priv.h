@@ -0,0 +1,22 @@
+#ifndef GPU_PRIV_H_
+#define GPU_PRIV_H_
+
+#define B0 0x01
+#define B1 0x02
+#define B2 0x04
+#define B3 0x08
+#define B4 0x10
+#define B5 0x20
+#define B6 0x40
+#define B7 0x80
+
+#define isLCDC0(reg) ((reg & B0) != 0)
+#define isLCDC1(reg) ((reg & B1) != 0)
+#define isLCDC2(reg) ((reg & B2) != 0)
+#define isLCDC3(reg) ((reg & B3) != 0)
+#define isLCDC4(reg) ((reg & B4) != 0)
+#define isLCDC5(reg) ((reg & B5) != 0)
+#define isLCDC6(reg) ((reg & B6) != 0)
+#define isLCDC7(reg) ((reg & B7) != 0)
+
+#endif /* GPU_PRIV_H_ */
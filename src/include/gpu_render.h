@@ -0,0 +1,63 @@
+#ifndef GPU_RENDER_H_
+#define GPU_RENDER_H_
+
+#include"display.h"
+#include"gpu_gb_palettes.h"
+#include"types.h"
+
+/* Everything needed to draw a scanline, besides VRAM, OAM and palette
+ * memory, captured at the moment the line is drawn.
+ */
+struct gpu_render_line {
+	u8   lcdc;
+	u8   scy;
+	u8   scx;
+	u8   ly;
+	u8   wy;
+	u8   wx;
+	u8   bgp;
+	u8   obp0;
+	u8   obp1;
+	bool oam_locked;
+};
+
+/* The renderer's copies of video memory, saved and restored along with the
+ * emulated state when running ahead.
+ */
+struct gpu_render_state {
+	u8                     vram[2][0x2000];
+	u8                     oam[0xA0];
+	u8                     background_palette_memory[64];
+	u8                     sprite_palette_memory[64];
+	struct gpu_render_line line;
+};
+
+/* Scanlines are drawn either right away or, if threaded is set, on a
+ * separate render thread, which works on its own copy of VRAM, OAM and
+ * palettes kept up to date with a log of writes.
+ */
+bool gpu_render_prepare(const palette_config *config, bool threaded);
+void gpu_render_destroy(void);
+
+void gpu_render_palette_written(bool sprite, u8 index, u8 data);
+void gpu_render_line(const struct gpu_render_line *line);
+
+/* Receives every finished frame on the emulating thread, line_hashes identify
+ * the contents of each line.
+ */
+typedef void gpu_frame_draw_t(pixel screen[SCREEN_HEIGHT][SCREEN_WIDTH],
+		const uint64_t line_hashes[SCREEN_HEIGHT]);
+
+// Wait for all queued scanlines and pass the frame to draw, if set
+void gpu_render_frame(gpu_frame_draw_t *draw);
+// The last finished frame, until scanlines of the next one are drawn
+const pixel *gpu_render_get_screen(void);
+void gpu_render_set_screen(const pixel *screen);
+
+/* Both wait until the renderer has caught up with every write. Loading only
+ * invalidates the cached tiles that actually differ.
+ */
+void gpu_render_save(struct gpu_render_state *state);
+void gpu_render_load(const struct gpu_render_state *state);
+
+#endif /* GPU_RENDER_H_ */
@@ -0,0 +1,21 @@
+#ifndef GPU_TILE_H_
+#define GPU_TILE_H_
+
+#include"types.h"
+
+#define GPU_TILE_ROW_BYTES 2
+#define GPU_TILE_ROWS      8
+#define GPU_TILE_BYTES     (GPU_TILE_ROW_BYTES * GPU_TILE_ROWS)
+
+/* Decode single tile row (2bpp planar: lower bitplane byte followed by upper
+ * bitplane byte) into 8 colour numbers, leftmost pixel first.
+ * If flip_x is set the row is mirrored horizontally.
+ */
+void gpu_tile_decode_row(u8 lower, u8 upper, bool flip_x, u8 dst[8]);
+
+/* Decode rows consecutive tile rows (rows * 2 bytes of VRAM) into rows * 8
+ * colour numbers. Whole tiles are decoded with rows == GPU_TILE_ROWS.
+ */
+void gpu_tile_decode(const u8 *data, int rows, bool flip_x, u8 *dst);
+
+#endif /* GPU_TILE_H_ */
@@ -0,0 +1,33 @@
+#ifndef HOTSPOT_H_
+#define HOTSPOT_H_
+
+#include<limits.h>
+#include"types.h"
+
+/* Guest profiler. Every period emulated cycles the bank and PC are sampled,
+ * along with a call stack kept from CALL, RST, interrupts and RET. At exit
+ * the hottest functions and addresses are logged, and the stacks are
+ * written in the folded format of flamegraph.pl, weighted in cycles.
+ * Functions are named from the RGBDS .sym file next to the ROM if there is
+ * one, as bank:address otherwise.
+ */
+
+#define HOTSPOT_DEFAULT_PERIOD 1024
+
+// Cycles until the next sample, LONG_MAX while the profiler is off
+extern long g_hotspot_countdown;
+
+void hotspot_sample(void);
+
+static inline void hotspot_step(int cycles_delta)
+{
+	g_hotspot_countdown -= cycles_delta;
+	if (g_hotspot_countdown <= 0)
+		hotspot_sample();
+}
+
+// Once the CPU and memory are prepared
+bool hotspot_prepare(const char *folded_path, const char *rom_path, long period);
+void hotspot_destroy(void);
+
+#endif /* HOTSPOT_H_ */
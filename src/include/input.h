@@ -2,22 +2,11 @@
 #define SRC_INCLUDE_INPUT_H_
 
 #include<SDL2/SDL.h>
+#include"joypad.h"
 #include"types.h"
 
 #define INPUT_BINDINGS_TO_READ 7
 
-struct all_inputs {
-	bool DOWN;
-	bool UP;
-	bool LEFT;
-	bool RIGHT;
-	bool START;
-	bool SELECT;
-	bool A;
-	bool B;
-	bool QUIT;
-};
-
 struct keyboard_bindings {
 	int a_button;
 	int b_button;
@@ -1,6 +1,8 @@
 #ifndef INTS_H_
 #define INTS_H_
 
+#include"types.h"
+
 enum ints_interrupt_type {
 	INT_V_BLANK                     = 0,
 	INT_LCDC                        = 1,
@@ -12,9 +14,16 @@ enum ints_interrupt_type {
 void ints_set_ime(void);
 void ints_reset_ime(void);
 
-void ints_prepare(void);
+bool ints_prepare(void);
+void ints_destroy(void);
 void ints_check(void);
 
 void ints_request(enum ints_interrupt_type interrupt);
 
+// Whether given interrupt would be serviced if requested right now
+bool ints_is_enabled(enum ints_interrupt_type interrupt);
+
+// Whether a requested interrupt is waiting to be serviced
+bool ints_is_pending(void);
+
 #endif /* INTS_H_ */
@@ -20,7 +20,23 @@ struct joypad_register {
 	};
 };
 
-void joypad_prepare(void);
+// Buttons held, as set by the frontend (QUIT is only read by the frontend)
+struct all_inputs {
+	bool DOWN;
+	bool UP;
+	bool LEFT;
+	bool RIGHT;
+	bool START;
+	bool SELECT;
+	bool A;
+	bool B;
+	bool QUIT;
+};
+
+bool joypad_prepare(void);
+void joypad_destroy(void);
+// Inputs seen by the next joypad_step
+void joypad_set_inputs(struct all_inputs inputs);
 void joypad_step(void);
 
 #endif /* SRC_INCLUDE_JOYPAD_H_ */
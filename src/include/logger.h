@@ -25,6 +25,9 @@ enum logger_log_type {
 void logger_log(enum logger_log_type type, char *title, const char *fmt, ...);
 void logger_print(enum logger_log_type type, const char *fmt, ...);
 
+// Drop LOG_INFO messages
+void logger_set_quiet(bool quiet);
+
 bool logger_prepare(void);
 void logger_destroy(void);
 
@@ -1,6 +1,7 @@
 #ifndef __MEM_H_
 #define __MEM_H_
 
+#include<stddef.h>
 #include"types.h"
 
 u8 mem_read8(a16 addr);
@@ -10,8 +11,28 @@ void mem_write8(a16 addr, u8 data);
 void mem_write16(a16 addr, u16 data);
 
 int mem_prepare(const char *rom_path, const char *save_path);
+int mem_prepare_buffer(const u8 *rom, size_t rom_len);
 void mem_destroy(const char *save_path);
 
 void mem_step(int cycles_delta);
 
+// Bank mapped at addr, numbered as in RGBDS symbol files
+int mem_get_bank(a16 addr);
+
+#ifdef CPU_LOCKSTEP
+#define MEM_WRITE_LOG_SIZE 0x10000
+
+/* Writes through mem_write8, mem_write16 and the native block copies and
+ * fills, in order, while a log is set. count goes on past MEM_WRITE_LOG_SIZE,
+ * only the entries before it are kept.
+ */
+struct mem_write_log {
+	size_t count;
+	a16    addr[MEM_WRITE_LOG_SIZE];
+	u8     data[MEM_WRITE_LOG_SIZE];
+};
+
+void mem_set_write_log(struct mem_write_log *log);
+#endif
+
 #endif // __MEM_H_
@@ -5,14 +5,23 @@
 
 typedef u8 (*mem_read_handler_t)(a16 addr);
 typedef void (*mem_write_handler_t)(a16 addr, u8 data);
+typedef void (*mem_video_write_handler_t)(int bank, a16 addr,
+		const u8 *data, int length);
 
 u8 mem_vram_read8(int bank, a16 addr);
 void mem_vram_write8(int bank, a16 addr, u8 data);
 
 void mem_register_handlers(a16 addr,
 		mem_read_handler_t r, mem_write_handler_t w);
+void mem_register_video_write_handler(mem_video_write_handler_t w);
+
+bool mem_is_dma_locked(void);
+bool mem_is_h_blank_dma(void);
 
 void mem_h_blank_notify(void);
 
+bool mem_block_copy(a16 dst, a16 src, int length);
+bool mem_block_fill(a16 dst, u8 data, int length);
+
 #endif // __MEM_PRIV_H_
 
@@ -17,5 +17,6 @@ struct mem_rtc_save {
 u8 mem_rtc_read(u8 reg);
 void mem_rtc_write(u8 reg, u8 data);
 void mem_rtc_latch(u8 data);
-void mem_rtc_prepare(struct mem_rtc_save *save);
+bool mem_rtc_prepare(struct mem_rtc_save *save);
+void mem_rtc_destroy(void);
 struct mem_rtc_save mem_rtc_get_save(void);
@@ -0,0 +1,112 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include"types.h"
+
+/* Host time spent in each part of the main loop, in builds with PROFILE
+ * (make gbc_profile). Sections timed on every step are only timed on one
+ * step in PROFILE_SAMPLE_PERIOD and scaled up, those entered at most once a
+ * scanline are always timed. Time in a nested section isn't counted in the
+ * one around it. A table is printed at exit and on SIGUSR1.
+ */
+
+// Power of two
+#define PROFILE_SAMPLE_PERIOD 16
+
+enum profile_section {
+	// Timed on sampled steps
+	PROFILE_CPU,
+	PROFILE_GPU,
+	PROFILE_MEM,
+	PROFILE_JOYPAD,
+	PROFILE_TIMER,
+	PROFILE_SERIAL,
+	PROFILE_INTS,
+	PROFILE_WAIT,
+	// Timed every time
+	PROFILE_SCANLINE,
+	PROFILE_DISPLAY,
+	PROFILE_SECTIONS
+};
+
+#ifdef PROFILE
+
+#if defined(__x86_64__)
+#include<x86intrin.h>
+#else
+#include<time.h>
+#endif
+
+struct profile_mark {
+	uint64_t start;
+	uint64_t nested;
+};
+
+extern _Thread_local bool g_profile_sampled;
+extern _Thread_local uint64_t  g_profile_nested;
+extern unsigned           g_profile_steps;
+
+void profile_add(enum profile_section section, uint64_t ticks);
+
+static inline uint64_t profile_ticks(void)
+{
+#if defined(__x86_64__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline struct profile_mark profile_begin(enum profile_section section)
+{
+	struct profile_mark mark = { 0, g_profile_nested };
+	if (section >= PROFILE_SCANLINE || g_profile_sampled)
+		mark.start = profile_ticks();
+	return mark;
+}
+
+static inline void profile_end(enum profile_section section,
+		struct profile_mark mark)
+{
+	if (mark.start == 0)
+		return;
+
+	uint64_t ticks = profile_ticks() - mark.start;
+	uint64_t nested = g_profile_nested - mark.nested;
+	if (section >= PROFILE_SCANLINE)
+		g_profile_nested += ticks;
+	profile_add(section, ticks - nested);
+}
+
+// Decide whether the coming step is sampled
+static inline void profile_step(void)
+{
+	g_profile_sampled = (++g_profile_steps & (PROFILE_SAMPLE_PERIOD - 1)) == 0;
+}
+
+#define PROFILE_STEP() profile_step()
+#define PROFILE_BEGIN(section) \
+	struct profile_mark profile_mark_ ## section = profile_begin(section)
+#define PROFILE_END(section) \
+	profile_end(section, profile_mark_ ## section)
+
+#else
+
+#define PROFILE_STEP()
+#define PROFILE_BEGIN(section)
+#define PROFILE_END(section)
+
+#endif // PROFILE
+
+// Called once a frame, prints the table if SIGUSR1 came in
+void profile_frame(void);
+
+/* Rows are appended to the CSV file at exit, if any, tagged with label
+ * (the ROM title).
+ */
+void profile_prepare(const char *csv_path, const char *label);
+void profile_destroy(void);
+
+#endif /* PROFILE_H_ */
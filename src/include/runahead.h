@@ -0,0 +1,20 @@
+#ifndef RUNAHEAD_H_
+#define RUNAHEAD_H_
+
+#include"types.h"
+
+/* Run frames frames ahead of the emulation. Has to be called once every
+ * module is prepared, as it sizes the snapshot of their state.
+ */
+bool runahead_prepare(int frames);
+
+/* Called when a frame starts, step runs a single instruction and returns
+ * the cycles it took (-1 on error).
+ *
+ * @return nanoseconds spent running ahead
+ */
+long runahead_frame(int (*step)(void));
+
+void runahead_destroy(void);
+
+#endif /* RUNAHEAD_H_ */
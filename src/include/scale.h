@@ -0,0 +1,35 @@
+#ifndef SCALE_H_
+#define SCALE_H_
+
+#include"display.h"
+#include"types.h"
+
+#define SCALE_MAX_FACTOR    3
+#define SCALE_WORKERS_AUTO  -1
+
+/* Start upscaling frames with filter, one of:
+ *   scale2x   Scale2x (EPX), 2x
+ *   scale3x   Scale3x, 3x
+ *   xbr       lightweight xBR (level 1 rules, 50% blends), 2x
+ * Rows are split between the calling thread and workers extra threads,
+ * SCALE_WORKERS_AUTO picks a count from the number of CPUs.
+ *
+ * @return false if filter is unknown
+ */
+bool scale_prepare(const char *filter, int workers);
+
+// Upscaling factor, 1 when not scaling
+int scale_factor(void);
+
+// How many lines around a changed line are affected by the filter
+int scale_radius(void);
+
+/* Scale source lines first to last (inclusive) of frame into dst, which
+ * points at the first output line of source line first.
+ */
+void scale_frame(const texel frame[SCREEN_HEIGHT * SCREEN_WIDTH], int first,
+		int last, void *dst, int dst_pitch);
+
+void scale_destroy(void);
+
+#endif /* SCALE_H_ */
@@ -0,0 +1,25 @@
+#ifndef SERIAL_H_
+#define SERIAL_H_
+
+#include<stddef.h>
+#include"types.h"
+
+// Bytes of serial output kept, the oldest are dropped past that
+#define SERIAL_OUTPUT_SIZE 8192
+
+void serial_step(int cycles_delta);
+bool serial_prepare(void);
+void serial_destroy(void);
+
+/* Number of cycles after which the transfer in progress will complete,
+ * INT_MAX if there is none.
+ */
+int serial_cycles_until_complete(void);
+
+/* Bytes sent over an internal clock transfer since the last clear, with no
+ * link partner attached. NUL terminated.
+ */
+const char *serial_get_output(size_t *length);
+void serial_clear_output(void);
+
+#endif /* SERIAL_H_ */
@@ -1,7 +1,10 @@
 #ifndef SRC_INCLUDE_SOUND_H_
 #define SRC_INCLUDE_SOUND_H_
 
-void sound_prepare(void);
+#include"types.h"
+
+bool sound_prepare(void);
+void sound_destroy(void);
 
 #endif /* SRC_INCLUDE_SOUND_H_ */
 
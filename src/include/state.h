@@ -0,0 +1,23 @@
+#ifndef STATE_H_
+#define STATE_H_
+
+#include<stddef.h>
+#include"types.h"
+
+/* In-memory snapshots of the emulated machine. Modules register the memory
+ * holding their state when they are prepared, a snapshot is a copy of all of
+ * it in registration order. Host side state (display, frameskip, profiling)
+ * is not part of it. Every context has its own registry, set up when the
+ * context is created.
+ */
+bool state_prepare(void);
+void state_destroy(void);
+
+void state_register(void *data, size_t size);
+
+// Bytes needed for a snapshot
+size_t state_size(void);
+void state_save(u8 *snapshot);
+void state_load(const u8 *snapshot);
+
+#endif /* STATE_H_ */
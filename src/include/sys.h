@@ -2,13 +2,26 @@
 #include "input.h"
 
 #define PATH_LENGTH  260
+#define CAPTURE_FORMAT_LENGTH  16
+#define SCALE_FILTER_LENGTH    16
 
 struct sys_args {
 	char rom_path[PATH_LENGTH];
 	char save_path[PATH_LENGTH];
+	char shm_name[PATH_LENGTH + 1];
+	char capture_path[PATH_LENGTH + 1];
+	char capture_format[CAPTURE_FORMAT_LENGTH + 1];
+	char scale_filter[SCALE_FILTER_LENGTH + 1];
+	char profile_csv[PATH_LENGTH + 1];
+	char hotspot_path[PATH_LENGTH + 1];
+	char trace_path[PATH_LENGTH + 1];
 	struct input_bindings input_bindings;
 	bool fullscreen;
 	int frame_rate;
+	bool render_thread;
+	bool auto_frameskip;
+	int run_ahead;
+	long hotspot_period;
 };
 
 bool sys_parse_args(int argc, char *argv[], struct sys_args *opts);
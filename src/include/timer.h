@@ -2,6 +2,8 @@
 #define __TIMER_H_
 
 void timer_step(int cycles_delta);
-void timer_prepare(void);
+bool timer_prepare(void);
+void timer_destroy(void);
+int timer_cycles_until_overflow(void);
 
 #endif // __TIMER_H_
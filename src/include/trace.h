@@ -0,0 +1,116 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include"types.h"
+
+/* Timeline of the emulation in the Chrome trace event format (JSON), for
+ * ui.perfetto.dev or chrome://tracing, in builds with TRACE (make gbc_trace)
+ * given a file (-T). Every event has the host time and, in its arguments,
+ * the emulated cycle (CPU cycles since the start). Each track is shown as
+ * a thread:
+ *  - frames, PPU modes, drawn scanlines, DMA transfers (OAM, general and
+ *    every H-blank block) and presented frames are slices
+ *  - dispatched interrupts and input events are instants
+ *  - the host waits in wait_clock come after every instruction, so they
+ *    are summed up into a counter of the share of host time spent waiting,
+ *    once every TRACE_IDLE_PERIOD_NS; only waits of TRACE_SLEEP_MIN_NS or
+ *    more are slices of their own
+ * Events are buffered and written from any thread. The buffer is flushed at
+ * the end of every frame and never in the middle of an event, so if the
+ * emulator doesn't exit cleanly the file still holds whole events up to at
+ * least the last frame.
+ */
+
+#define TRACE_IDLE_PERIOD_NS 1000000
+#define TRACE_SLEEP_MIN_NS   50000
+
+enum trace_track {
+	TRACE_FRAME,
+	TRACE_PPU,
+	TRACE_SCANLINE,
+	TRACE_DMA,
+	TRACE_INTERRUPT,
+	TRACE_DISPLAY,
+	TRACE_INPUT,
+	TRACE_WAIT,
+	TRACE_TRACKS
+};
+
+#ifdef TRACE
+
+#include<stdatomic.h>
+#include<stdint.h>
+#include<time.h>
+
+struct trace_mark {
+	uint64_t ns;
+	uint64_t cycle;
+};
+
+extern _Atomic bool g_trace_active;
+extern _Atomic uint64_t g_trace_cycles;
+
+static inline uint64_t trace_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Only written from the emulation thread
+static inline void trace_step(int cycles)
+{
+	uint64_t cycle = atomic_load_explicit(&g_trace_cycles, memory_order_relaxed);
+	atomic_store_explicit(&g_trace_cycles, cycle + cycles, memory_order_relaxed);
+}
+
+static inline struct trace_mark trace_begin(void)
+{
+	struct trace_mark mark = { 0, 0 };
+	if (g_trace_active) {
+		mark.ns = trace_now();
+		mark.cycle = atomic_load_explicit(&g_trace_cycles, memory_order_relaxed);
+	}
+	return mark;
+}
+
+// arg names an integer argument next to the cycle, NULL for none
+void trace_slice(enum trace_track track, const char *name,
+		struct trace_mark start, const char *arg, long value);
+void trace_instant(enum trace_track track, const char *name,
+		const char *arg, long value);
+// Ends the slice of the frame before, and of the PPU mode before
+void trace_frame(unsigned long frame);
+void trace_ppu_mode(int mode, int ly);
+void trace_wait(long nsec);
+
+#define TRACE_STEP(cycles) trace_step(cycles)
+#define TRACE_BEGIN(mark) struct trace_mark trace_mark_ ## mark = trace_begin()
+#define TRACE_END(mark, track, name, arg, value) \
+	trace_slice(track, name, trace_mark_ ## mark, arg, value)
+#define TRACE_INSTANT(track, name, arg, value) \
+	do { if (g_trace_active) trace_instant(track, name, arg, value); } while (0)
+#define TRACE_FRAME(frame) \
+	do { if (g_trace_active) trace_frame(frame); } while (0)
+#define TRACE_PPU_MODE(mode, ly) \
+	do { if (g_trace_active) trace_ppu_mode(mode, ly); } while (0)
+#define TRACE_WAIT(nsec) \
+	do { if (g_trace_active) trace_wait(nsec); } while (0)
+
+#else
+
+#define TRACE_STEP(cycles)
+#define TRACE_BEGIN(mark)
+#define TRACE_END(mark, track, name, arg, value)
+#define TRACE_INSTANT(track, name, arg, value)
+#define TRACE_FRAME(frame)
+#define TRACE_PPU_MODE(mode, ly)
+#define TRACE_WAIT(nsec)
+
+#endif // TRACE
+
+// The process is named after label (the ROM title)
+void trace_prepare(const char *path, const char *label);
+void trace_destroy(void);
+
+#endif /* TRACE_H_ */
@@ -1,9 +1,13 @@
+#include<stdlib.h>
+#include"context_priv.h"
 #include"cpu.h"
 #include"debug.h"
 #include"ints.h"
 #include"logger.h"
 #include"mem_priv.h"
 #include"regs.h"
+#include"state.h"
+#include"trace.h"
 #include"types.h"
 
 #define IFAddress 0xFF0F
@@ -38,11 +42,16 @@
 #define noF6(reg) (reg & ~B6)
 #define noF7(reg) (reg & ~B7)
 
-static bool g_ime;
+struct ints_context {
+	bool ime;
 
-static u8 g_if = 0;
-static u8 g_ie = 1;
-static u8 g_old_if = 0;
+	u8 if_reg;
+	u8 ie_reg;
+	u8 old_if;
+};
+
+// State of the current context
+#define g_ints (g_context->ints)
 
 static void _ints_undefined_int_info(u8 i_e, u8 i_f)
 {
@@ -59,10 +68,10 @@ static u8 _ints_read_handler(a16 addr)
 {
 	switch(addr) {
 		case IFAddress:
-			return g_if;
+			return g_ints->if_reg;
 			break;
 		case IEAddress:
-			return g_ie;
+			return g_ints->ie_reg;
 			break;
 	}
 
@@ -74,10 +83,10 @@ static void _ints_write_handler(a16 addr, u8 data)
 {
 	switch(addr) {
 		case IFAddress:
-			g_if = data;
+			g_ints->if_reg = data;
 			break;
 		case IEAddress:
-			g_ie = data;
+			g_ints->ie_reg = data;
 			break;
 		default:
 			debug_assert(false, "_ints_read_handler: invalid address");
@@ -87,26 +96,48 @@ static void _ints_write_handler(a16 addr, u8 data)
 
 void ints_set_ime(void)
 {
-	g_ime = 1;
+	g_ints->ime = 1;
+	cpu_events_changed();
 }
 
 
 void ints_reset_ime(void)
 {
-	g_ime = 0;
+	g_ints->ime = 0;
+	cpu_events_changed();
 }
 
 
-void ints_prepare(void)
+bool ints_prepare(void)
 {
+	g_ints = calloc(1, sizeof(*g_ints));
+	if (g_ints == NULL) {
+		logger_print(LOG_FATAL, "INTS: couldn't allocate the context.\n");
+		return false;
+	}
+
 	ints_set_ime();
-	g_if = IFBase;
-	g_ie = IEBase;
+	g_ints->if_reg = IFBase;
+	g_ints->ie_reg = IEBase;
 
 	mem_register_handlers(IFAddress,
 			_ints_read_handler, _ints_write_handler);
 	mem_register_handlers(IEAddress,
 			_ints_read_handler, _ints_write_handler);
+
+	state_register(&g_ints->ime, sizeof(g_ints->ime));
+	state_register(&g_ints->if_reg, sizeof(g_ints->if_reg));
+	state_register(&g_ints->ie_reg, sizeof(g_ints->ie_reg));
+	state_register(&g_ints->old_if, sizeof(g_ints->old_if));
+
+	return true;
+}
+
+
+void ints_destroy(void)
+{
+	free(g_ints);
+	g_ints = NULL;
 }
 
 
@@ -114,83 +145,101 @@ void ints_check(void)
 {
 	// Resolve cpu halted/stopped state
 	// Doesn't require interrupts service to be enabled
-	if(g_if & g_ie) {
+	if(g_ints->if_reg & g_ints->ie_reg) {
 		cpu_set_halted(0);
 		cpu_set_stopped(0);
 	}
 
-	g_old_if = g_if;
+	g_ints->old_if = g_ints->if_reg;
 
 	// Are interrupts enabled at all?
-	if (!g_ime)
+	if (!g_ints->ime)
 		return;
 
 	// Check which interrupts are enabled
-	g_if &= g_ie;
-	if (!g_if)
+	g_ints->if_reg &= g_ints->ie_reg;
+	if (!g_ints->if_reg)
 		return;
 	ints_reset_ime();
 
 	// Resolve interrupt
-	if (isF0(g_if)) {
+	if (isF0(g_ints->if_reg)) {
 		cpu_call(0x0040);
+		TRACE_INSTANT(TRACE_INTERRUPT, "V-blank", "vector", 0x0040);
 
 		// Clear interrupt register
-		g_if = noF0(g_if);
+		g_ints->if_reg = noF0(g_ints->if_reg);
 	}
-	else if (isF1(g_if)) {
+	else if (isF1(g_ints->if_reg)) {
 		cpu_call(0x0048);
+		TRACE_INSTANT(TRACE_INTERRUPT, "LCDC", "vector", 0x0048);
 
 		// Clear interrupt register
-		g_if = noF1(g_if);
+		g_ints->if_reg = noF1(g_ints->if_reg);
 	}
-	else if (isF2(g_if)) {
+	else if (isF2(g_ints->if_reg)) {
 		cpu_call(0x0050);
+		TRACE_INSTANT(TRACE_INTERRUPT, "timer", "vector", 0x0050);
 
 		// Clear interrupt register
-		g_if = noF2(g_if);
+		g_ints->if_reg = noF2(g_ints->if_reg);
 	}
-	else if (isF3(g_if)) {
+	else if (isF3(g_ints->if_reg)) {
 		cpu_call(0x0058);
+		TRACE_INSTANT(TRACE_INTERRUPT, "serial", "vector", 0x0058);
 
 		// Clear interrupt register
-		g_if = noF3(g_if);
+		g_ints->if_reg = noF3(g_ints->if_reg);
 	}
-	else if (isF4(g_if)) {
+	else if (isF4(g_ints->if_reg)) {
 		cpu_call(0x0060);
+		TRACE_INSTANT(TRACE_INTERRUPT, "joypad", "vector", 0x0060);
 
 		// Clear interrupt register
-		g_if = noF4(g_if);
+		g_ints->if_reg = noF4(g_ints->if_reg);
 	}
 	else {
 		// Logging the problem
-		_ints_undefined_int_info(g_ie, g_if);
+		_ints_undefined_int_info(g_ints->ie_reg, g_ints->if_reg);
 
 		// Clearing IE to default value in attempt of recovery
-		g_ie = IEBase;
+		g_ints->ie_reg = IEBase;
 	}
 }
 
 
+bool ints_is_enabled(enum ints_interrupt_type interrupt)
+{
+	return g_ints->ime && (g_ints->ie_reg & (1 << interrupt)) != 0;
+}
+
+
+bool ints_is_pending(void)
+{
+	return g_ints->ime && (g_ints->if_reg & g_ints->ie_reg & 0x1F) != 0;
+}
+
+
 void ints_request(enum ints_interrupt_type interrupt)
 {
 	switch(interrupt) {
 	case INT_V_BLANK:
-		g_if |= B0;
+		g_ints->if_reg |= B0;
 		break;
 	case INT_LCDC:
-		g_if |= B1;
+		g_ints->if_reg |= B1;
 		break;
 	case INT_TIMER_OVERFLOW:
-		g_if |= B2;
+		g_ints->if_reg |= B2;
 		break;
 	case INT_SERIAL_IO_TRANSFER_COMPLETE:
-		g_if |= B3;
+		g_ints->if_reg |= B3;
 		break;
 	case INT_HIGH_TO_LOW_P10_P13:
-		g_if |= B4;
+		g_ints->if_reg |= B4;
 		break;
 	default:
 		break;
 	}
+	cpu_events_changed();
 }
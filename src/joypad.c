@@ -1,37 +1,47 @@
+#include<stdlib.h>
+#include"context_priv.h"
 #include"debug.h"
-#include"events.h"
 #include"ints.h"
 #include"joypad.h"
+#include"logger.h"
 #include"mem_priv.h"
+#include"state.h"
 #include"types.h"
 
 
 #define JOYPAD_INPUT_ADDR 0xFF00
 
 
-static struct all_inputs g_all_inputs;
-
-static enum joypad_reg_mode {
+enum joypad_reg_mode {
 	MODE_INIT,
 	MODE_BUTTON,
 	MODE_DIRECTIONAL,
-} g_joypad_mode = MODE_INIT;
+};
+
+struct joypad_context {
+	struct all_inputs all_inputs;
+	struct all_inputs next_inputs;
+	enum joypad_reg_mode mode;
+};
+
+// State of the current context
+#define g_joypad (g_context->joypad)
 
 static u8 _joypad_read_handler(a16 addr __attribute__((unused)))
 {
 	debug_assert(addr == JOYPAD_INPUT_ADDR,
 			"_joypad_read_handler: invalid address");
 
-	if (g_joypad_mode == MODE_INIT)
+	if (g_joypad->mode == MODE_INIT)
 		return 0x3F;
 
 	struct joypad_register_bits bits = {
-		.RIGHT_A    = !((g_joypad_mode == MODE_BUTTON) ? g_all_inputs.A      : g_all_inputs.RIGHT),
-		.LEFT_B     = !((g_joypad_mode == MODE_BUTTON) ? g_all_inputs.B      : g_all_inputs.LEFT),
-		.DOWN_START = !((g_joypad_mode == MODE_BUTTON) ? g_all_inputs.START  : g_all_inputs.DOWN),
-		.UP_SELECT  = !((g_joypad_mode == MODE_BUTTON) ? g_all_inputs.SELECT : g_all_inputs.UP),
-		.SELECT_DIRECTIONS = !((g_joypad_mode == MODE_DIRECTIONAL)),
-		.SELECT_BUTTONS = !((g_joypad_mode == MODE_BUTTON))
+		.RIGHT_A    = !((g_joypad->mode == MODE_BUTTON) ? g_joypad->all_inputs.A      : g_joypad->all_inputs.RIGHT),
+		.LEFT_B     = !((g_joypad->mode == MODE_BUTTON) ? g_joypad->all_inputs.B      : g_joypad->all_inputs.LEFT),
+		.DOWN_START = !((g_joypad->mode == MODE_BUTTON) ? g_joypad->all_inputs.START  : g_joypad->all_inputs.DOWN),
+		.UP_SELECT  = !((g_joypad->mode == MODE_BUTTON) ? g_joypad->all_inputs.SELECT : g_joypad->all_inputs.UP),
+		.SELECT_DIRECTIONS = !((g_joypad->mode == MODE_DIRECTIONAL)),
+		.SELECT_BUTTONS = !((g_joypad->mode == MODE_BUTTON))
 	};
 
 	struct joypad_register reg;
@@ -46,27 +56,27 @@ static void _joypad_write_handler(a16 addr __attribute__((unused)), u8 data)
 			"_joypad_write_handler: invalid address");
 
 	if (BV(data, 5) == 0 && BV(data, 4) == 1) {
-		g_joypad_mode = MODE_BUTTON;
+		g_joypad->mode = MODE_BUTTON;
 	} else if (BV(data, 5) == 1 && BV(data, 4) == 0) {
-		g_joypad_mode = MODE_DIRECTIONAL;
+		g_joypad->mode = MODE_DIRECTIONAL;
 	}
 }
 
 void _joypad_check_interrupt(struct all_inputs *prev)
 {
-	switch(g_joypad_mode) {
+	switch(g_joypad->mode) {
 		case MODE_DIRECTIONAL:
-			if ((prev->DOWN == 1 && g_all_inputs.DOWN == 0)
-					|| (prev->UP    == 1 && g_all_inputs.UP    == 0)
-					|| (prev->LEFT  == 1 && g_all_inputs.LEFT  == 0)
-					|| (prev->RIGHT == 1 && g_all_inputs.RIGHT == 0))
+			if ((prev->DOWN == 1 && g_joypad->all_inputs.DOWN == 0)
+					|| (prev->UP    == 1 && g_joypad->all_inputs.UP    == 0)
+					|| (prev->LEFT  == 1 && g_joypad->all_inputs.LEFT  == 0)
+					|| (prev->RIGHT == 1 && g_joypad->all_inputs.RIGHT == 0))
 				ints_request(INT_HIGH_TO_LOW_P10_P13);
 			break;
 		case MODE_BUTTON:
-			if ((prev->START == 1 && g_all_inputs.START == 0)
-					|| (prev->SELECT == 1 && g_all_inputs.SELECT == 0)
-					|| (prev->A      == 1 && g_all_inputs.A      == 0)
-					|| (prev->B      == 1 && g_all_inputs.B      == 0))
+			if ((prev->START == 1 && g_joypad->all_inputs.START == 0)
+					|| (prev->SELECT == 1 && g_joypad->all_inputs.SELECT == 0)
+					|| (prev->A      == 1 && g_joypad->all_inputs.A      == 0)
+					|| (prev->B      == 1 && g_joypad->all_inputs.B      == 0))
 				ints_request(INT_HIGH_TO_LOW_P10_P13);
 			break;
 		default:
@@ -74,16 +84,39 @@ void _joypad_check_interrupt(struct all_inputs *prev)
 	}
 }
 
-void joypad_prepare(void)
+bool joypad_prepare(void)
 {
+	g_joypad = calloc(1, sizeof(*g_joypad));
+	if (g_joypad == NULL) {
+		logger_print(LOG_FATAL, "JOYPAD: couldn't allocate the context.\n");
+		return false;
+	}
+	g_joypad->mode = MODE_INIT;
+
 	mem_register_handlers(JOYPAD_INPUT_ADDR,
 			_joypad_read_handler, _joypad_write_handler);
+
+	state_register(&g_joypad->all_inputs, sizeof(g_joypad->all_inputs));
+	state_register(&g_joypad->mode, sizeof(g_joypad->mode));
+
+	return true;
+}
+
+void joypad_destroy(void)
+{
+	free(g_joypad);
+	g_joypad = NULL;
+}
+
+void joypad_set_inputs(struct all_inputs inputs)
+{
+	g_joypad->next_inputs = inputs;
 }
 
 void joypad_step(void)
 {
-	struct all_inputs prev_inputs = g_all_inputs;
-	g_all_inputs = events_get_inputs();
+	struct all_inputs prev_inputs = g_joypad->all_inputs;
+	g_joypad->all_inputs = g_joypad->next_inputs;
 	_joypad_check_interrupt(&prev_inputs);
 }
 
@@ -22,6 +22,7 @@ typedef struct log_info {
 
 static log_info g_log_buffer[LOG_BUFFER_SIZE];
 static bool     g_kill                        = false;
+static bool     g_quiet                       = false;
 static s8       g_start_index                 = 0,
                 g_end_index                   = 0;
 
@@ -84,6 +85,12 @@ static void _logger_store(
 {
 	pthread_mutex_lock(&g_lock);
 
+	// The message logged by logger_destroy has to go through
+	if(g_quiet && type == LOG_INFO && !g_kill) {
+		pthread_mutex_unlock(&g_lock);
+		return;
+	}
+
 	//If not full, go
 	if(_logger_is_buffer_full()) {
 		pthread_cond_wait(&g_condition_not_full, &g_lock);
@@ -226,6 +233,13 @@ void logger_log(
 	va_end(args);
 }
 
+void logger_set_quiet(bool quiet)
+{
+	pthread_mutex_lock(&g_lock);
+	g_quiet = quiet;
+	pthread_mutex_unlock(&g_lock);
+}
+
 bool logger_prepare(void)
 {
 	int error_code = pthread_create(&g_logger_thread, NULL, _logger_pop, NULL);
@@ -1,17 +1,27 @@
 #include<SDL2/SDL_main.h>
+#include<stdio.h>
 #include<stdlib.h>
 #include<time.h>
+#include"capture.h"
+#include"context.h"
 #include"display.h"
+#include"display_shm.h"
 #include"events.h"
 #include"gpu.h"
+#include"hotspot.h"
 #include"ints.h"
 #include"joypad.h"
 #include"logger.h"
+#include"profile.h"
 #include"mem.h"
 #include"regs.h"
 #include"rom.h"
+#include"runahead.h"
+#include"scale.h"
+#include"serial.h"
 #include"sound.h"
 #include"timer.h"
+#include"trace.h"
 #include"types.h"
 #include"sys.h"
 
@@ -26,21 +36,71 @@ static inline long timespec_diff(struct timespec *t_end, struct timespec *t_star
 	return (t_end->tv_sec * SEC + t_end->tv_nsec) - (t_start->tv_sec * SEC + t_start->tv_nsec);
 }
 
-static inline void wait_clock(struct timespec *t_start, int cycles)
+// Returns the time spent waiting, time owed (spent running ahead) is taken
+// off the wait
+static inline long wait_clock(struct timespec *t_start, int cycles, long *owed)
 {
 	int clock_div = cpu_is_double_speed() ? 4 : 2;
 
 	struct timespec t_end;
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	long busy = timespec_diff(&t_end, t_start);
 
 	// for some reason the theoretical cycle time divided by 2
 	// (by 4 in double speed mode) is about the right speed
-	while (timespec_diff(&t_end, t_start) < NSEC_PER_CLOCK / clock_div * cycles) {
+	long duration = NSEC_PER_CLOCK / clock_div * cycles;
+	long repaid = MIN(*owed, duration);
+	*owed -= repaid;
+	duration -= repaid;
+
+	while (timespec_diff(&t_end, t_start) < duration) {
 		clock_gettime(CLOCK_MONOTONIC, &t_end);
 	}
+
+	return timespec_diff(&t_end, t_start) - busy;
 }
 #endif // defined(__x86_64__)
 
+// Run a single instruction and let every module catch up with it
+static int emulate_step(void)
+{
+	PROFILE_STEP();
+
+	PROFILE_BEGIN(PROFILE_CPU);
+	int cycles_delta = cpu_single_step();
+	PROFILE_END(PROFILE_CPU);
+	hotspot_step(cycles_delta);
+	TRACE_STEP(cycles_delta);
+
+	PROFILE_BEGIN(PROFILE_GPU);
+	gpu_step(cpu_is_double_speed() ? cycles_delta/2 : cycles_delta);
+	PROFILE_END(PROFILE_GPU);
+
+	PROFILE_BEGIN(PROFILE_MEM);
+	mem_step(cycles_delta);
+	PROFILE_END(PROFILE_MEM);
+
+	// sound_step(cycles_delta)
+	PROFILE_BEGIN(PROFILE_JOYPAD);
+	joypad_set_inputs(events_get_inputs());
+	joypad_step();
+	PROFILE_END(PROFILE_JOYPAD);
+
+	PROFILE_BEGIN(PROFILE_TIMER);
+	timer_step(cycles_delta);
+	PROFILE_END(PROFILE_TIMER);
+
+	PROFILE_BEGIN(PROFILE_SERIAL);
+	serial_step(cycles_delta);
+	PROFILE_END(PROFILE_SERIAL);
+
+	PROFILE_BEGIN(PROFILE_INTS);
+	ints_check();
+	PROFILE_END(PROFILE_INTS);
+
+	return cycles_delta;
+}
+
 int main(int argc, char *argv[])
 {
 	char *save_path = NULL;
@@ -52,6 +112,10 @@ int main(int argc, char *argv[])
 	if (!sys_parse_args(argc, argv, &g_args))
 		return 1;
 
+	struct gb_context *context = context_create();
+	if (context == NULL)
+		return 1;
+
 	if (g_args.save_path[0] != '\0')
 		save_path = g_args.save_path;
 	if (g_args.input_bindings.filled)
@@ -70,47 +134,119 @@ int main(int argc, char *argv[])
 	rom_get_title(title);
 	logger_print(LOG_INFO, "ROM title: %.16s\n", title);
 
+	char label[sizeof(title) + 1];
+	snprintf(label, sizeof(label), "%.16s", title);
+	profile_prepare(g_args.profile_csv[0] != '\0' ? g_args.profile_csv : NULL,
+			label);
+
 	//TODO prepare memory and fill stack with data according to powerup sequence
-	sound_prepare();
-	cpu_prepare();
-	ints_prepare();
-	gpu_prepare(title, g_args.frame_rate, g_args.fullscreen);
+	if (!sound_prepare() || !cpu_prepare() || !ints_prepare())
+		return 1;
+	if (g_args.shm_name[0] != '\0')
+		display_shm_prepare(g_args.shm_name);
+	if (g_args.capture_path[0] != '\0')
+		capture_prepare(g_args.capture_path, g_args.capture_format);
+	if (g_args.scale_filter[0] != '\0') {
+		if (scale_prepare(g_args.scale_filter, SCALE_WORKERS_AUTO))
+			logger_print(LOG_INFO, "Upscaling %dx with %s.\n",
+					scale_factor(), g_args.scale_filter);
+		else
+			logger_print(LOG_WARN, "Unknown scaling filter %s.\n",
+					g_args.scale_filter);
+	}
+	display_prepare(1.0 / g_args.frame_rate, title, g_args.fullscreen);
+	struct gpu_frame_sink sink = { display_draw, display_frame_wanted };
+	if (!gpu_prepare(&sink, g_args.render_thread, g_args.auto_frameskip))
+		return 1;
 	if(!events_prepare(input_bindings))
 		return 1;
-	joypad_prepare();
-	timer_prepare();
+	if (!joypad_prepare() || !timer_prepare() || !serial_prepare())
+		return 1;
+	if (g_args.hotspot_path[0] != '\0') {
+		// Speculative frames would be sampled, and unwind the call stack
+		if (g_args.run_ahead > 0) {
+			logger_print(LOG_WARN, "Run-ahead is off while profiling the guest.\n");
+			g_args.run_ahead = 0;
+		}
+		hotspot_prepare(g_args.hotspot_path, g_args.rom_path, g_args.hotspot_period);
+	}
+	if (g_args.trace_path[0] != '\0') {
+		// Speculative frames would show up on the timeline
+		if (g_args.run_ahead > 0) {
+			logger_print(LOG_WARN, "Run-ahead is off while tracing.\n");
+			g_args.run_ahead = 0;
+		}
+		trace_prepare(g_args.trace_path, label);
+	}
+	if (g_args.run_ahead > 0)
+		runahead_prepare(g_args.run_ahead);
 
 	logger_print(LOG_INFO, "Starting emulation.\n");
 	int cycles_delta = 0;
+	unsigned long frame = gpu_get_frame_count();
 
 #if defined(__x86_64__)
 	struct timespec t_start;
+	long ahead_nsec = 0;
 #endif // defined(__x86_64__)
 
+#ifdef PROFILE
+	unsigned long profiled_frame = frame;
+#endif // PROFILE
+
 	// Main Loop
 	while ( cycles_delta != -1 && !display_get_closed_status() ) {
+#ifdef PROFILE
+		if (gpu_get_frame_count() != profiled_frame) {
+			profiled_frame = gpu_get_frame_count();
+			profile_frame();
+		}
+#endif // PROFILE
+
+		if (g_args.run_ahead > 0 && gpu_get_frame_count() != frame) {
+			frame = gpu_get_frame_count();
+#if defined(__x86_64__)
+			ahead_nsec += runahead_frame(emulate_step);
+#else
+			runahead_frame(emulate_step);
+#endif // defined(__x86_64__)
+		}
+
 #if defined(__x86_64__)
 		clock_gettime(CLOCK_MONOTONIC, &t_start);
 #endif // defined(__x86_64__)
 
-		cycles_delta = cpu_single_step();
-		gpu_step(cpu_is_double_speed() ? cycles_delta/2 : cycles_delta);
-		mem_step(cycles_delta);
-		// sound_step(cycles_delta)
-		joypad_step();
-		timer_step(cycles_delta);
-		ints_check();
+		cycles_delta = emulate_step();
 
 #if defined(__x86_64__)
-		wait_clock(&t_start, cycles_delta);
+		PROFILE_BEGIN(PROFILE_WAIT);
+		long idle_nsec = wait_clock(&t_start, cycles_delta, &ahead_nsec);
+		PROFILE_END(PROFILE_WAIT);
+		TRACE_WAIT(idle_nsec);
+		gpu_add_idle_time(idle_nsec);
 #endif // defined(__x86_64__)
 	}
 
 	logger_print(LOG_INFO, "Halting emulation.\n");
+	profile_destroy();
+	hotspot_destroy();
+	trace_destroy();
 
+	cpu_destroy();
 	events_destroy();
 	gpu_destroy();
+	display_destroy();
+	display_shm_destroy();
+	capture_destroy();
+	scale_destroy();
+	runahead_destroy();
+	serial_destroy();
+	timer_destroy();
+	joypad_destroy();
+	ints_destroy();
+	sound_destroy();
 	mem_destroy(save_path);
+	context_destroy(context);
 	logger_destroy();
 
 	return 0;
@@ -1,12 +1,16 @@
 #include<stddef.h>
 #include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
+#include"context_priv.h"
 #include"cpu.h"
 #include"debug.h"
 #include"logger.h"
 #include"mem_priv.h"
 #include"mem_rtc.h"
 #include"rom.h"
+#include"state.h"
+#include"trace.h"
 
 #define BASE_ADDR_CART_MEM       0x0000
 #define BASE_ADDR_VRAM           0x8000
@@ -71,31 +75,40 @@ enum mem_dma_state {
 };
 
 // Memory module state
-static bool g_ram_enable = 0;
-static u16 g_rom_bank = 1;
-static u8 g_ram_bank = 0;
-static u8 g_wram_bank = 1;
-static u8 g_vram_bank = 0;
-static int g_dma_lock = 0;
-static u16 g_dma_length = 0, g_dma_remaining = 0;
-static a16 g_dma_src = 0, g_dma_dst = 0;
-static enum mem_banking_mode g_banking_mode = ROM_BANKING_MODE;
-static enum mem_dma_state g_dma_state = DMA_NONE;
-
-static u8 g_hram[SIZE_HRAM] = {0};
-static u8 g_io_ports[SIZE_IO_PORTS] = {0};
-
-static mem_read_handler_t g_io_ports_read[SIZE_IO_PORTS] = {0};
-static mem_write_handler_t g_io_ports_write[SIZE_IO_PORTS] = {0};
-static mem_read_handler_t g_int_enable_read = NULL;
-static mem_write_handler_t g_int_enable_write = NULL;
-
-static u8 g_sprite_attr[SIZE_SPRITE_ATTR] = {0};
-
-static struct mem_bank g_rom[MAX_ROM_BANKS] = {0};
-static struct mem_bank g_ram[MAX_RAM_BANKS] = {0};
-static struct mem_bank g_wram[NUM_WRAM_BANKS] = {0};
-static struct mem_bank g_vram[NUM_VRAM_BANKS] = {0};
+struct mem_context {
+	bool ram_enable;
+	u16 rom_bank;
+	u8 ram_bank;
+	u8 wram_bank;
+	u8 vram_bank;
+	int dma_lock;
+	u16 dma_length, dma_remaining;
+	a16 dma_src, dma_dst;
+	enum mem_banking_mode banking_mode;
+	enum mem_dma_state dma_state;
+
+	u8 hram[SIZE_HRAM];
+	u8 io_ports[SIZE_IO_PORTS];
+
+	mem_read_handler_t io_ports_read[SIZE_IO_PORTS];
+	mem_write_handler_t io_ports_write[SIZE_IO_PORTS];
+	mem_read_handler_t int_enable_read;
+	mem_write_handler_t int_enable_write;
+	mem_video_write_handler_t video_write_handler;
+
+	u8 sprite_attr[SIZE_SPRITE_ATTR];
+
+	struct mem_bank rom[MAX_ROM_BANKS];
+	struct mem_bank ram[MAX_RAM_BANKS];
+	struct mem_bank wram[NUM_WRAM_BANKS];
+	struct mem_bank vram[NUM_VRAM_BANKS];
+#ifdef CPU_LOCKSTEP
+	struct mem_write_log *write_log;
+#endif
+};
+
+// State of the current context
+#define g_mem (g_context->mem)
 
 static void _mem_not_implemented(const char *feature, a16 addr)
 {
@@ -110,6 +123,38 @@ static inline void _mem_fatal(char *msg) {
 	logger_log(LOG_FATAL, "MEM: ERROR", msg);
 }
 
+#ifdef CPU_LOCKSTEP
+static inline void _mem_log_write(a16 addr, u8 data)
+{
+	struct mem_write_log *log = g_mem->write_log;
+
+	if (log == NULL)
+		return;
+	if (log->count < MEM_WRITE_LOG_SIZE) {
+		log->addr[log->count] = addr;
+		log->data[log->count] = data;
+	}
+	log->count++;
+}
+
+static inline void _mem_log_writes(a16 addr, const u8 *data, int length)
+{
+	for (int i = 0; i < length; i++)
+		_mem_log_write(addr + i, data[i]);
+}
+#else
+static inline void _mem_log_write(a16 addr __attribute__((unused)),
+		u8 data __attribute__((unused)))
+{
+}
+
+static inline void _mem_log_writes(a16 addr __attribute__((unused)),
+		const u8 *data __attribute__((unused)),
+		int length __attribute__((unused)))
+{
+}
+#endif
+
 static u8 _mem_read_bank(struct mem_bank bank, a16 addr)
 {
 	debug_assert(addr < bank.size, "_mem_read_bank: address out of bounds");
@@ -124,52 +169,59 @@ static void _mem_write_bank(struct mem_bank bank, a16 addr, u8 data)
 
 static inline void _mem_dma_start(a16 total_length)
 {
-	debug_assert(g_dma_state & DMA_AVAILIBLE, "_mem_dma_start: DMA in progress");
+	debug_assert(g_mem->dma_state & DMA_AVAILIBLE, "_mem_dma_start: DMA in progress");
 
-	g_dma_length = g_dma_remaining = total_length;
+	g_mem->dma_length = g_mem->dma_remaining = total_length;
 }
 
 static void _mem_dma(a16 length)
 {
-	int dma_lock_temp = g_dma_lock;
-	g_dma_lock = 0;
+	int dma_lock_temp = g_mem->dma_lock;
+	g_mem->dma_lock = 0;
 	u8 data;
-	a16 offset = g_dma_length - g_dma_remaining;
+	a16 offset = g_mem->dma_length - g_mem->dma_remaining;
 
-	debug_assert(length <= g_dma_remaining, "_mem_dma: invalid DMA length");
+	debug_assert(length <= g_mem->dma_remaining, "_mem_dma: invalid DMA length");
 
+	TRACE_BEGIN(dma);
 	for (u16 i = 0; i < length; i++) {
-		data = mem_read8(g_dma_src + offset + i);
-		mem_write8(g_dma_dst + offset + i, data);
+		data = mem_read8(g_mem->dma_src + offset + i);
+		mem_write8(g_mem->dma_dst + offset + i, data);
 	}
 
-	g_dma_lock = dma_lock_temp;
-	g_dma_remaining -= length;
+	g_mem->dma_lock = dma_lock_temp;
+	g_mem->dma_remaining -= length;
 
-	if (g_dma_remaining == 0) {
-		g_dma_state = DMA_VRAM_SUCCESS;
+	TRACE_END(dma, TRACE_DMA,
+			g_mem->dma_dst == BASE_ADDR_SPRITE_ATTR ? "OAM DMA"
+			: g_mem->dma_state == DMA_H_BLANK_IN_PROGRESS ? "H-blank DMA block"
+			: "general DMA",
+			"bytes", length);
+
+	if (g_mem->dma_remaining == 0) {
+		g_mem->dma_state = DMA_VRAM_SUCCESS;
 	}
 }
 
 static u8 _mem_read_cart_mem(a16 addr)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
 	const struct rom_header *header = rom_get_header();
 
 	switch (header->mbc) {
 		case ROM_ONLY:
-			return _mem_read_bank(g_rom[0], addr - BASE_ADDR_CART_MEM);
+			return _mem_read_bank(g_mem->rom[0], addr - BASE_ADDR_CART_MEM);
 			break;
 		case MBC1:
 		case MBC2:
 		case MBC3:
 		case MBC5:
 			if (addr < 0x4000 || header->num_rom_banks == 1) {
-				return _mem_read_bank(g_rom[0], addr - BASE_ADDR_CART_MEM);
+				return _mem_read_bank(g_mem->rom[0], addr - BASE_ADDR_CART_MEM);
 			} else if (addr < 0x8000) {
-				return _mem_read_bank(g_rom[g_rom_bank], addr - BASE_ADDR_CART_MEM - header->rom_bank_size);
+				return _mem_read_bank(g_mem->rom[g_mem->rom_bank], addr - BASE_ADDR_CART_MEM - header->rom_bank_size);
 			}
 			break;
 		case MMM01:
@@ -188,7 +240,7 @@ static u8 _mem_read_cart_mem(a16 addr)
 
 static void _mem_write_cart_mem(a16 addr, u8 data)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
 	switch(rom_get_header()->mbc) {
@@ -201,7 +253,7 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				// RAM is enabled when the lower 4 bytes of data written
 				// to 0x0000-0x1FFFF are equal to 0x0A, otherwise RAM is disabled
 
-				g_ram_enable = (data & 0xF) == 0x0A;
+				g_mem->ram_enable = (data & 0xF) == 0x0A;
 			} else if (addr < 0x4000) {
 				// ROM Bank number lower:
 				// data written to 0x2000-0x3FFF selects the lower 5 bits of the
@@ -210,35 +262,35 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				// is used (eg. if Bank 0 is selected Bank 1 will be used,
 				// Bank 20 -> Bank 21, etc.
 
-				g_rom_bank = (g_rom_bank & 0x00E0) | (data & 0x1F);
+				g_mem->rom_bank = (g_mem->rom_bank & 0x00E0) | (data & 0x1F);
 				if ((data & 0x1F) == 0)
-					g_rom_bank += 1;
+					g_mem->rom_bank += 1;
 			} else if (addr < 0x6000) {
 				// depending on currently set ROM/RAM banking mode
 
-				if (g_banking_mode == ROM_BANKING_MODE) {
+				if (g_mem->banking_mode == ROM_BANKING_MODE) {
 					// ROM Bank number upper:
 					// bits 0-1 of data are bits 5-6 of ROM Bank number
 
-					g_rom_bank = (g_rom_bank & 0x001F) | ((data & 0x03) << 5);
+					g_mem->rom_bank = (g_mem->rom_bank & 0x001F) | ((data & 0x03) << 5);
 				} else {
 					// RAM Bank number:
 					// bits 0-1 of data select RAM Bank number used
 
-					g_ram_bank = data & 0x03;
+					g_mem->ram_bank = data & 0x03;
 				}
 			} else if (addr < 0x8000) {
 				// ROM/RAM banking mode select
 				// bit 0 of data selects banking mode:
 				//		* 0x00: ROM Banking Mode (default)
 				//		* 0x01: RAM Banking Mode
-				g_banking_mode = (enum mem_banking_mode)(data & 0x01);
+				g_mem->banking_mode = (enum mem_banking_mode)(data & 0x01);
 
 				// reset the bank values
-				if (g_banking_mode == ROM_BANKING_MODE) {
-					g_ram_bank = 0x01;
+				if (g_mem->banking_mode == ROM_BANKING_MODE) {
+					g_mem->ram_bank = 0x01;
 				} else {
-					g_rom_bank = g_rom_bank & 0x001F;
+					g_mem->rom_bank = g_mem->rom_bank & 0x001F;
 				}
 			}
 			break;
@@ -249,7 +301,7 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				// TODO: is 0x0A used same as in MBC1? Pan Docs does not specify
 
 				if ((addr & 0x100) == 0) {
-					g_ram_enable = (data & 0xF) == 0x0A;
+					g_mem->ram_enable = (data & 0xF) == 0x0A;
 				}
 			} else if (addr < 0x4000) {
 				// ROM Bank number:
@@ -261,10 +313,10 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				//       ROM Bank is set to 1 in case 0 is written here
 
 				if ((addr & 0x100) != 0) {
-					g_rom_bank = data & 0x000F;
+					g_mem->rom_bank = data & 0x000F;
 
 					if ((data & 0x0F) == 0)
-						g_rom_bank += 1;
+						g_mem->rom_bank += 1;
 				}
 			}
 			break;
@@ -275,7 +327,7 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				// data written to 0x0000-0x1FFFF are equal to 0x0A, otherwise
 				// RAM and RTC Register are disabled
 
-				g_ram_enable = (data & 0xF) == 0x0A;
+				g_mem->ram_enable = (data & 0xF) == 0x0A;
 			} else if (addr < 0x4000) {
 				// ROM Bank number:
 				// data written to 0x2000-0x3FFF selects the 7 bit ROM Bank
@@ -283,9 +335,9 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				// If bits 6-0 are all cleared, ROM Bank 1 will be selected
 
 				if ((data & 0x7F) != 0) {
-					g_rom_bank = data & 0x7F;
+					g_mem->rom_bank = data & 0x7F;
 				} else {
-					g_rom_bank = 1;
+					g_mem->rom_bank = 1;
 				}
 			} else if (addr < 0x6000) {
 				// RAM Bank number / RTC register select
@@ -295,7 +347,7 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				// is mapped to 0xA000-0xBFFF.
 
 				if (data < 0x04 || (0x08 <= data && data < 0x0D))
-					g_ram_bank = data;
+					g_mem->ram_bank = data;
 
 			} else if (addr < 0x8000) {
 				mem_rtc_latch(data);
@@ -307,22 +359,22 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 				// RAM is enabled when the data written to 0x0000-0x1FFFF is equal
 				// to 0x0A, otherwise RAM is disabled
 
-				g_ram_enable = data == 0x0A;
+				g_mem->ram_enable = data == 0x0A;
 			} else if (addr < 0x3000) {
 				// ROM Bank number lower:
 				// data written to 0x2000-0x3FFF selects the lower 8 bits of the
 				// ROM Bank number
-				g_rom_bank = (g_rom_bank & 0xFF00) | data;
+				g_mem->rom_bank = (g_mem->rom_bank & 0xFF00) | data;
 			} else if (addr < 0x4000) {
 				// ROM Bank number higher:
 				// highest bit of the ROM Bank selection
 
-				g_rom_bank = (g_rom_bank & 0x00FF) | ((data & 1) << 8);
+				g_mem->rom_bank = (g_mem->rom_bank & 0x00FF) | ((data & 1) << 8);
 			} else if (addr < 0x6000) {
 				// RAM Bank number:
 				// bits 0-3 of data select RAM Bank number used
 
-				g_ram_bank = data & 0x0F;
+				g_mem->ram_bank = data & 0x0F;
 			}
 		break;
 		case MMM01:
@@ -339,38 +391,46 @@ static void _mem_write_cart_mem(a16 addr, u8 data)
 
 static inline u8 _mem_read_vram(a16 addr)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
-	return _mem_read_bank(g_vram[g_vram_bank], addr - BASE_ADDR_VRAM);
+	return _mem_read_bank(g_mem->vram[g_mem->vram_bank], addr - BASE_ADDR_VRAM);
+}
+
+static inline void _mem_video_written(int bank, a16 addr, const u8 *data,
+		int length)
+{
+	if (g_mem->video_write_handler)
+		g_mem->video_write_handler(bank, addr, data, length);
 }
 
 static inline void _mem_write_vram(a16 addr, u8 data)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
-	_mem_write_bank(g_vram[g_vram_bank], addr - BASE_ADDR_VRAM, data);
+	_mem_write_bank(g_mem->vram[g_mem->vram_bank], addr - BASE_ADDR_VRAM, data);
+	_mem_video_written(g_mem->vram_bank, addr, &data, 1);
 }
 
 static u8 _mem_read_ram_switch(a16 addr)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
 	const struct rom_header *header = rom_get_header();
 
 	switch(header->mbc) {
 		case ROM_ONLY:
-			return _mem_read_bank(g_ram[0], addr - BASE_ADDR_RAM_SWITCH);
+			return _mem_read_bank(g_mem->ram[0], addr - BASE_ADDR_RAM_SWITCH);
 			break;
 		case MBC1:
 		case MBC5:
-			return _mem_read_bank(g_ram[g_ram_bank], addr - BASE_ADDR_RAM_SWITCH);
+			return _mem_read_bank(g_mem->ram[g_mem->ram_bank], addr - BASE_ADDR_RAM_SWITCH);
 			break;
 		case MBC2:
 		{
-			u8 data = _mem_read_bank(g_ram[g_ram_bank], addr - BASE_ADDR_RAM_SWITCH);
+			u8 data = _mem_read_bank(g_mem->ram[g_mem->ram_bank], addr - BASE_ADDR_RAM_SWITCH);
 #ifdef DEBUG
 			// in debug build run additional check if nothing was written
 			// to 4 upper bits of RAM cell on read
@@ -382,10 +442,10 @@ static u8 _mem_read_ram_switch(a16 addr)
 			break;
 		}
 		case MBC3:
-			if (g_ram_bank < 0x04) {
-				return _mem_read_bank(g_ram[g_ram_bank], addr - BASE_ADDR_RAM_SWITCH);
-			} else if (0x08 <= g_ram_bank  && g_ram_bank < 0x0D) {
-				return mem_rtc_read(g_ram_bank);
+			if (g_mem->ram_bank < 0x04) {
+				return _mem_read_bank(g_mem->ram[g_mem->ram_bank], addr - BASE_ADDR_RAM_SWITCH);
+			} else if (0x08 <= g_mem->ram_bank  && g_mem->ram_bank < 0x0D) {
+				return mem_rtc_read(g_mem->ram_bank);
 			}
 			break;
 		case MMM01:
@@ -402,31 +462,31 @@ static u8 _mem_read_ram_switch(a16 addr)
 
 static void _mem_write_ram_switch(a16 addr, u8 data)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
 	const struct rom_header *header = rom_get_header();
 
 	switch(header->mbc) {
 		case ROM_ONLY:
-			_mem_write_bank(g_ram[0], addr - BASE_ADDR_RAM_SWITCH, data);
+			_mem_write_bank(g_mem->ram[0], addr - BASE_ADDR_RAM_SWITCH, data);
 			break;
 		case MBC1:
 		case MBC5:
-			_mem_write_bank(g_ram[g_ram_bank],
+			_mem_write_bank(g_mem->ram[g_mem->ram_bank],
 					addr - BASE_ADDR_RAM_SWITCH, data);
 			break;
 		case MBC2:
 			// in MBC2 each addressable memory cell is 4 b only
-			_mem_write_bank(g_ram[g_ram_bank],
+			_mem_write_bank(g_mem->ram[g_mem->ram_bank],
 					addr - BASE_ADDR_RAM_SWITCH, data & 0x0F);
 			break;
 		case MBC3:
-			if (g_ram_bank < 0x04) {
-				_mem_write_bank(g_ram[g_ram_bank],
+			if (g_mem->ram_bank < 0x04) {
+				_mem_write_bank(g_mem->ram[g_mem->ram_bank],
 						addr - BASE_ADDR_RAM_SWITCH, data);
 			} else {
-				mem_rtc_write(g_ram_bank, data);
+				mem_rtc_write(g_mem->ram_bank, data);
 			}
 			break;
 		case MMM01:
@@ -442,48 +502,48 @@ static void _mem_write_ram_switch(a16 addr, u8 data)
 
 static inline u8 _mem_read_wram0(a16 addr)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
-	return _mem_read_bank(g_wram[0], addr - BASE_ADDR_WRAM0);
+	return _mem_read_bank(g_mem->wram[0], addr - BASE_ADDR_WRAM0);
 }
 
 static inline void _mem_write_wram0(a16 addr, u8 data)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
-	_mem_write_bank(g_wram[0], addr - BASE_ADDR_WRAM0, data);
+	_mem_write_bank(g_mem->wram[0], addr - BASE_ADDR_WRAM0, data);
 }
 
 static inline u8 _mem_read_wram(a16 addr)
 {
-	debug_assert(0 < g_wram_bank && g_wram_bank < NUM_WRAM_BANKS,
+	debug_assert(0 < g_mem->wram_bank && g_mem->wram_bank < NUM_WRAM_BANKS,
 			"_mem_read_wram: incorrect WRAM Bank number");
 
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
 	if (rom_is_cgb())
-		return _mem_read_bank(g_wram[g_wram_bank], addr - BASE_ADDR_WRAM);
+		return _mem_read_bank(g_mem->wram[g_mem->wram_bank], addr - BASE_ADDR_WRAM);
 
-	return _mem_read_bank(g_wram[1], addr - BASE_ADDR_WRAM);
+	return _mem_read_bank(g_mem->wram[1], addr - BASE_ADDR_WRAM);
 }
 
 static inline void _mem_write_wram(a16 addr, u8 data)
 {
-	debug_assert(0 < g_wram_bank && g_wram_bank < NUM_WRAM_BANKS,
+	debug_assert(0 < g_mem->wram_bank && g_mem->wram_bank < NUM_WRAM_BANKS,
 			"_mem_write_wram: incorrect WRAM Bank number");
 
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
 	if (rom_is_cgb()) {
-		_mem_write_bank(g_wram[g_wram_bank],
+		_mem_write_bank(g_mem->wram[g_mem->wram_bank],
 				addr - BASE_ADDR_WRAM,
 				data);
 	} else {
-		_mem_write_bank(g_wram[1], addr - BASE_ADDR_WRAM, data);
+		_mem_write_bank(g_mem->wram[1], addr - BASE_ADDR_WRAM, data);
 	}
 }
 
@@ -505,18 +565,19 @@ static inline void _mem_write_wram_echo(a16 addr, u8 data)
 
 static inline u8 _mem_read_sprite_attr(a16 addr)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
-	return g_sprite_attr[addr - BASE_ADDR_SPRITE_ATTR];
+	return g_mem->sprite_attr[addr - BASE_ADDR_SPRITE_ATTR];
 }
 
 static inline void _mem_write_sprite_attr(a16 addr, u8 data)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
-	g_sprite_attr[addr - BASE_ADDR_SPRITE_ATTR] = data;
+	g_mem->sprite_attr[addr - BASE_ADDR_SPRITE_ATTR] = data;
+	_mem_video_written(0, addr, &data, 1);
 }
 
 static inline u8 _mem_read_empty0(a16 addr __attribute__((unused)))
@@ -536,7 +597,7 @@ static inline u8 _mem_io_ports_read_handler(a16 addr)
 	case 0xFF4F:
 		// VBK: VRAM Bank selection
 		if (rom_is_cgb())
-			return 0xFE | g_vram_bank;
+			return 0xFE | g_mem->vram_bank;
 		break;
 	case 0xFF55:
 		// VRAM DMA transfer remaining
@@ -549,25 +610,25 @@ static inline u8 _mem_io_ports_read_handler(a16 addr)
 		//
 		// Right now all VRAM DMA is instant, so we always return 0xFF.
 		if (rom_is_cgb()) {
-			switch (g_dma_state) {
+			switch (g_mem->dma_state) {
 			case DMA_NONE:
 			case DMA_VRAM_SUCCESS:
 				return 0xFF;
 			case DMA_GENERAL_IN_PROGRESS:
 			case DMA_H_BLANK_IN_PROGRESS:
-				return (g_dma_remaining / 0x10) - 1;
+				return (g_mem->dma_remaining / 0x10) - 1;
 			case DMA_H_BLANK_TERMINATED:
-				return 0x80 | ((g_dma_remaining / 0x10) - 1);
+				return 0x80 | ((g_mem->dma_remaining / 0x10) - 1);
 			default:
 				debug_assert(false, "_mem_read_io_ports: invalid DMA state");
-				g_dma_state = DMA_NONE;
+				g_mem->dma_state = DMA_NONE;
 			}
 		}
 		break;
 	case 0xFF70:
 		// SVBK: WRAM Bank selection
 		if (rom_is_cgb())
-			return g_wram_bank;
+			return g_mem->wram_bank;
 		break;
 	case 0xFF46: // OAM DMA
 	case 0xFF51: // HDMA1
@@ -577,7 +638,7 @@ static inline u8 _mem_io_ports_read_handler(a16 addr)
 		break;
 	default:
 		_mem_not_implemented("IO ports read", addr);
-		return g_io_ports[addr - BASE_ADDR_IO_PORTS];
+		return g_mem->io_ports[addr - BASE_ADDR_IO_PORTS];
 	}
 
 	return 0xFF;
@@ -589,11 +650,11 @@ static inline void _mem_io_ports_write_handler(a16 addr, u8 data)
 	case 0xFF46:
 		// DMA: OAM DMA transfer address
 		if (data <= 0xF1) {
-			g_dma_dst = BASE_ADDR_SPRITE_ATTR;
-			g_dma_src = (a16)data << 8;
+			g_mem->dma_dst = BASE_ADDR_SPRITE_ATTR;
+			g_mem->dma_src = (a16)data << 8;
 			_mem_dma_start(SIZE_SPRITE_ATTR);
 			_mem_dma(SIZE_SPRITE_ATTR);
-			g_dma_lock = 160;
+			g_mem->dma_lock = 160;
 		} else {
 			debug_assert(true, "_mem_write_empty1: invalid OAM DMA address");
 		}
@@ -601,30 +662,30 @@ static inline void _mem_io_ports_write_handler(a16 addr, u8 data)
 	case 0xFF4F:
 		// VBK: VRAM Bank selection
 		if (rom_is_cgb())
-			g_vram_bank = data & 0x01;
+			g_mem->vram_bank = data & 0x01;
 		break;
 	case 0xFF51:
 		// HDMA1: VRAM DMA Source address, higher
 		if (rom_is_cgb())
-			g_dma_src = (g_dma_src & 0x00FF) | ((a16)data << 8);
+			g_mem->dma_src = (g_mem->dma_src & 0x00FF) | ((a16)data << 8);
 		break;
 	case 0xFF52:
 		// HDMA2: VRAM DMA Source address, lower
 		// Bits 0-3 are ignored (zeros are used)
 		if (rom_is_cgb())
-			g_dma_src = (g_dma_src & 0xFF00) | data;
+			g_mem->dma_src = (g_mem->dma_src & 0xFF00) | data;
 		break;
 	case 0xFF53:
 		// HDMA3: VRAM DMA Destination address, higher
 		// Bits 5-7 are ignored (0x80 is used)
 		if (rom_is_cgb())
-			g_dma_dst = (g_dma_dst & 0x00FF) | ((a16)data << 8);
+			g_mem->dma_dst = (g_mem->dma_dst & 0x00FF) | ((a16)data << 8);
 		break;
 	case 0xFF54:
 		// HDMA4: VRAM DMA Destination address, lower
 		// Bits 0-3 are ignored (zeros are used)
 		if (rom_is_cgb())
-			g_dma_dst = (g_dma_dst & 0xFF00) | data;
+			g_mem->dma_dst = (g_mem->dma_dst & 0xFF00) | data;
 		break;
 	case 0xFF55:
 		// HDMA5: VRAM DMA mode/length
@@ -635,51 +696,51 @@ static inline void _mem_io_ports_write_handler(a16 addr, u8 data)
 		if (rom_is_cgb()) {
 			a16 length;
 
-			switch (g_dma_state) {
+			switch (g_mem->dma_state) {
 			case DMA_NONE:
 			case DMA_VRAM_SUCCESS:
 			case DMA_H_BLANK_TERMINATED:
-				g_dma_dst &= 0x1FF0;
-				g_dma_dst |= 0x8000;
-				g_dma_src &= 0xFFF0;
+				g_mem->dma_dst &= 0x1FF0;
+				g_mem->dma_dst |= 0x8000;
+				g_mem->dma_src &= 0xFFF0;
 				length = ((data & 0x7F) + 1) * 0x10;
 
 				_mem_dma_start(length);
 
 				if ((data & 0x80) == 0) {
 					// Execute General DMA all at once
-					g_dma_state = DMA_GENERAL_IN_PROGRESS;
-					g_dma_lock = DMA_CYCLES_PER_10H * (g_dma_length / 0x10);
+					g_mem->dma_state = DMA_GENERAL_IN_PROGRESS;
+					g_mem->dma_lock = DMA_CYCLES_PER_10H * (g_mem->dma_length / 0x10);
 					_mem_dma(length);
-					g_dma_lock = 0;
+					g_mem->dma_lock = 0;
 				} else {
-					g_dma_state = DMA_H_BLANK_IN_PROGRESS;
+					g_mem->dma_state = DMA_H_BLANK_IN_PROGRESS;
 				}
 				break;
 			case DMA_H_BLANK_IN_PROGRESS:
 				// Assuming writes with bit 7 = 1 are ignored
 				if ((data & 0x80) == 0)
-					g_dma_state = DMA_H_BLANK_TERMINATED;
+					g_mem->dma_state = DMA_H_BLANK_TERMINATED;
 				break;
 			default:
 				debug_assert(false, "_mem_write_io_ports: invalid DMA state");
-				g_dma_state = DMA_NONE;
+				g_mem->dma_state = DMA_NONE;
 			}
 		}
 		break;
 	case 0xFF70:
 		// SVBK: WRAM Bank selection
 		if (rom_is_cgb()) {
-			g_wram_bank = data & 0x07;
-			if (g_wram_bank == 0)
-				g_wram_bank = 1;
+			g_mem->wram_bank = data & 0x07;
+			if (g_mem->wram_bank == 0)
+				g_mem->wram_bank = 1;
 		}
 		break;
 	default:
 		// If an address within IO ports does not have any special handling
 		// implemented just write the data, so that it can be read through
 		// mem_readX later
-		g_io_ports[addr - BASE_ADDR_IO_PORTS] = data;
+		g_mem->io_ports[addr - BASE_ADDR_IO_PORTS] = data;
 
 		_mem_not_implemented("IO ports write", addr);
 		break;
@@ -688,10 +749,10 @@ static inline void _mem_io_ports_write_handler(a16 addr, u8 data)
 
 static inline u8 _mem_read_io_ports(a16 addr)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
-	mem_read_handler_t r = g_io_ports_read[addr - BASE_ADDR_IO_PORTS];
+	mem_read_handler_t r = g_mem->io_ports_read[addr - BASE_ADDR_IO_PORTS];
 
 	if (r)
 		return r(addr);
@@ -701,46 +762,48 @@ static inline u8 _mem_read_io_ports(a16 addr)
 
 static inline void _mem_write_io_ports(a16 addr, u8 data)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
-	mem_write_handler_t w = g_io_ports_write[addr - BASE_ADDR_IO_PORTS];
+	mem_write_handler_t w = g_mem->io_ports_write[addr - BASE_ADDR_IO_PORTS];
 
 	if (w) {
 		w(addr, data);
 	} else {
 		_mem_io_ports_write_handler(addr, data);
 	}
+	cpu_events_changed();
 }
 
 static inline u8 _mem_read_hram(a16 addr)
 {
-	return g_hram[addr - BASE_ADDR_HRAM];
+	return g_mem->hram[addr - BASE_ADDR_HRAM];
 }
 
 static inline void _mem_write_hram(a16 addr, u8 data)
 {
-	g_hram[addr - BASE_ADDR_HRAM] = data;
+	g_mem->hram[addr - BASE_ADDR_HRAM] = data;
 }
 
 static inline u8 _mem_read_int_enable(a16 addr)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return 0;
 
-	if (g_int_enable_read)
-		return g_int_enable_read(addr);
+	if (g_mem->int_enable_read)
+		return g_mem->int_enable_read(addr);
 
 	return 0;
 }
 
 static inline void _mem_write_int_enable(a16 addr, u8 data)
 {
-	if (g_dma_lock)
+	if (g_mem->dma_lock)
 		return;
 
-	if (g_int_enable_write)
-		g_int_enable_write(addr, data);
+	if (g_mem->int_enable_write)
+		g_mem->int_enable_write(addr, data);
+	cpu_events_changed();
 }
 
 
@@ -833,6 +896,7 @@ void mem_write8(a16 addr, u8 data)
 		return;
 	}
 
+	_mem_log_write(addr, data);
 	block->write(addr, data);
 }
 
@@ -879,14 +943,50 @@ void mem_write16(a16 addr, u16 data)
 		block_2 = block_1;
 	}
 
+	_mem_log_write(addr, _mem_u16_lower(data));
+	_mem_log_write(addr + 1, _mem_u16_higher(data));
 	block_1->write(addr, _mem_u16_lower(data));
 	block_2->write(addr + 1, _mem_u16_higher(data));
 }
 
-int _mem_load_rom(const char *path)
+static int _mem_load_rom_buffer(const u8 *rom, size_t rom_len)
 {
-	long rom_len;
+	if (rom_len > MAX_ROM_SIZE) {
+		_mem_fatal("ROM file size is larger than allowed maximum");
+		return 0;
+	}
+
+	if (rom_len < 0x4000) {
+		_mem_fatal("ROM file is smaller than a single bank");
+		return 0;
+	}
+
 	u8 rom0[0x4000];
+	memcpy(rom0, rom, sizeof(rom0));
+	rom_parse_header(rom0);
+	const struct rom_header *header = rom_get_header();
+
+	if (header->rom_bank_size == 0
+			|| rom_len / header->rom_bank_size
+				!= (size_t)header->num_rom_banks) {
+		_mem_fatal("Incoherent declared ROM bank size");
+		return 0;
+	}
+
+	for (int i = 0; i < header->num_rom_banks; i++) {
+		g_mem->rom[i].mem = (u8 *)malloc(header->rom_bank_size);
+		g_mem->rom[i].size = header->rom_bank_size;
+		memcpy(g_mem->rom[i].mem, rom + i * header->rom_bank_size,
+				header->rom_bank_size);
+	}
+
+	return 1;
+}
+
+static int _mem_load_rom(const char *path)
+{
+	long rom_len;
+	int rc;
 
 	FILE *rom_fileptr = fopen(path, "rb");
 
@@ -898,7 +998,7 @@ int _mem_load_rom(const char *path)
 	fseek(rom_fileptr, 0, SEEK_END);
 	rom_len = ftell(rom_fileptr);
 
-	if (rom_len > MAX_ROM_SIZE) {
+	if (rom_len < 0 || rom_len > MAX_ROM_SIZE) {
 		_mem_fatal("ROM file size is larger than allowed maximum");
 		fclose(rom_fileptr);
 		return 0;
@@ -906,27 +1006,17 @@ int _mem_load_rom(const char *path)
 
 	rewind(rom_fileptr);
 
-	fread(rom0, 0x4000, 1, rom_fileptr);
-
-	rom_parse_header(rom0);
-	const struct rom_header *header = rom_get_header();
-
-	if (header->rom_bank_size == 0
-			|| rom_len / header->rom_bank_size != header->num_rom_banks) {
-		_mem_fatal("Incoherent declared ROM bank size");
-		return 0;
-	}
-
-	rewind(rom_fileptr);
-
-	for (int i = 0; i < header->num_rom_banks; i++) {
-		g_rom[i].mem = (u8 *)calloc(1, header->rom_bank_size);
-		g_rom[i].size = header->rom_bank_size;
-		fread(g_rom[i].mem, g_rom[i].size, 1, rom_fileptr);
+	u8 *rom = malloc(rom_len);
+	if (rom == NULL || fread(rom, 1, rom_len, rom_fileptr) != (size_t)rom_len) {
+		_mem_fatal("Couldn't read rom file");
+		rc = 0;
+	} else {
+		rc = _mem_load_rom_buffer(rom, rom_len);
 	}
 
+	free(rom);
 	fclose(rom_fileptr);
-	return 1;
+	return rc;
 }
 
 static int _mem_save_ram(const char *save_path)
@@ -941,9 +1031,9 @@ static int _mem_save_ram(const char *save_path)
 	const struct rom_header *header = rom_get_header();
 
 	for (int i = 0; i < header->num_ram_banks; i++) {
-		debug_assert(g_ram[i].mem != NULL,
+		debug_assert(g_mem->ram[i].mem != NULL,
 				"mem_destroy: null RAM Bank memory");
-		fwrite(g_ram[i].mem, g_ram[i].size, 1, file);
+		fwrite(g_mem->ram[i].mem, g_mem->ram[i].size, 1, file);
 	}
 
 	if (header->mbc == MBC3) {
@@ -965,7 +1055,7 @@ static int _mem_load_ram(const char *save_path)
 	if(file == NULL) {
 		logger_print(LOG_INFO, "Save file does not exist, skipping save load");
 		if (header->mbc == MBC3)
-			mem_rtc_prepare(NULL);
+			return mem_rtc_prepare(NULL) ? 1 : 0;
 		return 1;
 	}
 
@@ -985,9 +1075,9 @@ static int _mem_load_ram(const char *save_path)
 	}
 
 	for (int i = 0; i < header->num_ram_banks; i++) {
-		debug_assert(g_ram[i].mem != NULL,
+		debug_assert(g_mem->ram[i].mem != NULL,
 				"mem_destroy: null RAM Bank memory");
-		fread(g_ram[i].mem, g_ram[i].size, 1, file);
+		fread(g_mem->ram[i].mem, g_mem->ram[i].size, 1, file);
 	}
 
 	if (header->mbc == MBC3)
@@ -995,57 +1085,84 @@ static int _mem_load_ram(const char *save_path)
 
 	fclose(file);
 
-	mem_rtc_prepare(&rtc);
+	return mem_rtc_prepare(&rtc) ? 1 : 0;
+}
 
-	return 1;
+static void _mem_register_state(void)
+{
+	state_register(&g_mem->ram_enable, sizeof(g_mem->ram_enable));
+	state_register(&g_mem->rom_bank, sizeof(g_mem->rom_bank));
+	state_register(&g_mem->ram_bank, sizeof(g_mem->ram_bank));
+	state_register(&g_mem->wram_bank, sizeof(g_mem->wram_bank));
+	state_register(&g_mem->vram_bank, sizeof(g_mem->vram_bank));
+	state_register(&g_mem->dma_lock, sizeof(g_mem->dma_lock));
+	state_register(&g_mem->dma_length, sizeof(g_mem->dma_length));
+	state_register(&g_mem->dma_remaining, sizeof(g_mem->dma_remaining));
+	state_register(&g_mem->dma_src, sizeof(g_mem->dma_src));
+	state_register(&g_mem->dma_dst, sizeof(g_mem->dma_dst));
+	state_register(&g_mem->banking_mode, sizeof(g_mem->banking_mode));
+	state_register(&g_mem->dma_state, sizeof(g_mem->dma_state));
+	state_register(g_mem->hram, sizeof(g_mem->hram));
+	state_register(g_mem->io_ports, sizeof(g_mem->io_ports));
+	state_register(g_mem->sprite_attr, sizeof(g_mem->sprite_attr));
+
+	struct mem_bank *banks[] = { g_mem->ram, g_mem->wram, g_mem->vram };
+	int counts[] = { MAX_RAM_BANKS, NUM_WRAM_BANKS, NUM_VRAM_BANKS };
+	for (int i = 0; i < 3; i++)
+		for (int bank = 0; bank < counts[i]; bank++)
+			if (banks[i][bank].mem != NULL)
+				state_register(banks[i][bank].mem, banks[i][bank].size);
 }
 
-/**
- * Initialize memory module:
- *	- parse cartridge header into rom_header
- *	- allocate memory for ROM and RAM
- *	- load ROM contents from ROM file
- *	- optionally load RAM content from save file
- *
- *	@param  rom_path    path to file containing ROM data to load
- *	@param	save_path   path to file containing saved RAM data to load. If NULL
- *	                    is passed, then RAM is ininitialized to 0
- *
- *	@return	1 if everything succeeded, 0 if an error occurred during module
- *          initialization
- */
-int mem_prepare(const char *rom_path, const char *save_path)
+static int _mem_prepare(const char *rom_path, const u8 *rom, size_t rom_len,
+		const char *save_path)
 {
 	int rc = 1;
 
-	rc = _mem_load_rom(rom_path);
-
-	if (rc != 1)
+	g_mem = calloc(1, sizeof(*g_mem));
+	if (g_mem == NULL) {
+		logger_print(LOG_FATAL, "MEM: couldn't allocate the context.\n");
+		return 0;
+	}
+	g_mem->rom_bank = 1;
+	g_mem->wram_bank = 1;
+	g_mem->banking_mode = ROM_BANKING_MODE;
+	g_mem->dma_state = DMA_NONE;
+
+	if (rom_path)
+		rc = _mem_load_rom(rom_path);
+	else
+		rc = _mem_load_rom_buffer(rom, rom_len);
+
+	if (rc != 1) {
+		free(g_mem);
+		g_mem = NULL;
 		return rc;
+	}
 
 	const struct rom_header *header = rom_get_header();
 
 	for (int i = 0; i < header->num_ram_banks; i++) {
-		g_ram[i].mem = (u8 *)calloc(1, header->ram_bank_size);
-		g_ram[i].size = header->ram_bank_size;
+		g_mem->ram[i].mem = (u8 *)calloc(1, header->ram_bank_size);
+		g_mem->ram[i].size = header->ram_bank_size;
 	}
 
-	g_vram[0].mem = (u8 *)calloc(1, SIZE_VRAM);
-	g_vram[0].size = SIZE_VRAM;
+	g_mem->vram[0].mem = (u8 *)calloc(1, SIZE_VRAM);
+	g_mem->vram[0].size = SIZE_VRAM;
 
 	if (rom_is_cgb()) {
 		for (int i = 0; i < NUM_WRAM_BANKS; i++) {
-			g_wram[i].mem = (u8 *)calloc(1, SIZE_WRAM);
-			g_wram[i].size = SIZE_WRAM;
+			g_mem->wram[i].mem = (u8 *)calloc(1, SIZE_WRAM);
+			g_mem->wram[i].size = SIZE_WRAM;
 		}
 
-		g_vram[1].mem = (u8 *)calloc(1, SIZE_VRAM);
-		g_vram[1].size = SIZE_VRAM;
+		g_mem->vram[1].mem = (u8 *)calloc(1, SIZE_VRAM);
+		g_mem->vram[1].size = SIZE_VRAM;
 	} else {
-		g_wram[0].mem = (u8 *)calloc(1, SIZE_WRAM0);
-		g_wram[0].size = SIZE_WRAM0;
-		g_wram[1].mem = (u8 *)calloc(1, SIZE_WRAM);
-		g_wram[1].size = SIZE_WRAM;
+		g_mem->wram[0].mem = (u8 *)calloc(1, SIZE_WRAM0);
+		g_mem->wram[0].size = SIZE_WRAM0;
+		g_mem->wram[1].mem = (u8 *)calloc(1, SIZE_WRAM);
+		g_mem->wram[1].size = SIZE_WRAM;
 	}
 
 	if (save_path) {
@@ -1054,13 +1171,50 @@ int mem_prepare(const char *rom_path, const char *save_path)
 			mem_destroy(NULL);
 			return rc;
 		}
-	} else if (header->mbc == MBC3) {
-		mem_rtc_prepare(NULL);
+	} else if (header->mbc == MBC3 && !mem_rtc_prepare(NULL)) {
+		mem_destroy(NULL);
+		return 0;
 	}
 
+	_mem_register_state();
+
 	return 1;
 }
 
+/**
+ * Initialize memory module:
+ *	- parse cartridge header into rom_header
+ *	- allocate memory for ROM and RAM
+ *	- load ROM contents from ROM file
+ *	- optionally load RAM content from save file
+ *
+ *	@param  rom_path    path to file containing ROM data to load
+ *	@param	save_path   path to file containing saved RAM data to load. If NULL
+ *	                    is passed, then RAM is ininitialized to 0
+ *
+ *	@return	1 if everything succeeded, 0 if an error occurred during module
+ *          initialization
+ */
+int mem_prepare(const char *rom_path, const char *save_path)
+{
+	return _mem_prepare(rom_path, NULL, 0, save_path);
+}
+
+/**
+ * Initialize memory module like mem_prepare, with ROM contents copied from
+ * a buffer and RAM initialized to 0.
+ *
+ *	@param  rom         ROM data to load
+ *	@param  rom_len     size of the ROM data in bytes
+ *
+ *	@return	1 if everything succeeded, 0 if an error occurred during module
+ *          initialization
+ */
+int mem_prepare_buffer(const u8 *rom, size_t rom_len)
+{
+	return _mem_prepare(NULL, rom, rom_len, NULL);
+}
+
 /**
  * Safely terminate the module and optionally save RAM contents to given path.
  *
@@ -1075,41 +1229,63 @@ void mem_destroy(const char *save_path)
 	const struct rom_header *header = rom_get_header();
 
 	for (int i = 0; i < header->num_rom_banks; i++) {
-		debug_assert(g_rom[i].mem != NULL,
+		debug_assert(g_mem->rom[i].mem != NULL,
 				"mem_destroy: null ROM Bank memory");
-		free(g_rom[i].mem);
+		free(g_mem->rom[i].mem);
 	}
 
 	for (int i = 0; i < header->num_ram_banks; i++) {
-		debug_assert(g_rom[i].mem != NULL,
+		debug_assert(g_mem->rom[i].mem != NULL,
 				"mem_destroy: null RAM Bank memory");
-		free(g_ram[i].mem);
+		free(g_mem->ram[i].mem);
 	}
 
 	for (int i = 0; i < NUM_WRAM_BANKS; i++) {
-		if (g_wram[i].mem)
-			free(g_wram[i].mem);
+		if (g_mem->wram[i].mem)
+			free(g_mem->wram[i].mem);
 	}
 
-	free(g_vram[0].mem);
+	free(g_mem->vram[0].mem);
+
+	if (g_mem->vram[1].mem)
+		free(g_mem->vram[1].mem);
 
-	if (g_vram[1].mem)
-		free(g_vram[1].mem);
+	mem_rtc_destroy();
+	free(g_mem);
+	g_mem = NULL;
 }
 
 void mem_step(int cycles_delta)
 {
-	if (g_dma_lock > cycles_delta) {
-		g_dma_lock -= cycles_delta;
+	if (g_mem->dma_lock > cycles_delta) {
+		g_mem->dma_lock -= cycles_delta;
 	} else {
-		g_dma_lock = 0;
+		g_mem->dma_lock = 0;
 	}
 
-	if (g_dma_state == DMA_GENERAL_IN_PROGRESS && g_dma_lock == 0) {
-		g_dma_state = DMA_VRAM_SUCCESS;
+	if (g_mem->dma_state == DMA_GENERAL_IN_PROGRESS && g_mem->dma_lock == 0) {
+		g_mem->dma_state = DMA_VRAM_SUCCESS;
 	}
 }
 
+int mem_get_bank(a16 addr)
+{
+	const struct rom_header *header = rom_get_header();
+
+	if (addr < 0x4000)
+		return 0;
+	if (addr < BASE_ADDR_VRAM)
+		return header->mbc == ROM_ONLY || header->num_rom_banks == 1
+			? 1 : g_mem->rom_bank;
+	if (addr < BASE_ADDR_RAM_SWITCH)
+		return g_mem->vram_bank;
+	if (addr < BASE_ADDR_WRAM0)
+		return g_mem->ram_bank;
+	if (addr >= BASE_ADDR_WRAM && addr < BASE_ADDR_WRAM_ECHO)
+		return rom_is_cgb() ? g_mem->wram_bank : 1;
+	return 0;
+}
+
 /* Read from arbitrary VRAM bank
  *
  * NOTE: addr parameter is an address that would be used in normal mem_read8
@@ -1117,7 +1293,7 @@ void mem_step(int cycles_delta)
  */
 u8 mem_vram_read8(int bank, a16 addr)
 {
-	return _mem_read_bank(g_vram[bank], addr - BASE_ADDR_VRAM);
+	return _mem_read_bank(g_mem->vram[bank], addr - BASE_ADDR_VRAM);
 }
 
 /* Write to arbitrary VRAM bank
@@ -1127,7 +1303,136 @@ u8 mem_vram_read8(int bank, a16 addr)
  */
 void mem_vram_write8(int bank, a16 addr, u8 data)
 {
-	_mem_write_bank(g_vram[bank], addr - BASE_ADDR_VRAM, data);
+	_mem_write_bank(g_mem->vram[bank], addr - BASE_ADDR_VRAM, data);
+	_mem_video_written(bank, addr, &data, 1);
+}
+
+static u8 *_mem_bank_range(struct mem_bank *bank, int offset, int length)
+{
+	if (bank->mem == NULL || offset < 0 || offset + length > bank->size)
+		return NULL;
+
+	return bank->mem + offset;
+}
+
+/* Get host memory backing the whole [addr, addr + length) range.
+ *
+ * Only ranges lying within a single bank of plain memory (ROM, VRAM, WRAM,
+ * OAM, HRAM) qualify, everything else (IO ports, cartridge RAM, echo) has to
+ * go through regular mem_read8/mem_write8. Returns NULL if the range does not
+ * qualify.
+ */
+static u8 *_mem_get_direct(a16 addr, int length, bool write)
+{
+	int end = addr + length;
+
+	if (length <= 0 || end > 0x10000)
+		return NULL;
+
+	if (end <= BASE_ADDR_VRAM) {
+		const struct rom_header *header = rom_get_header();
+
+		if (write)
+			return NULL;
+
+		switch (header->mbc) {
+		case ROM_ONLY:
+			return _mem_bank_range(&g_mem->rom[0], addr, length);
+		case MBC1:
+		case MBC2:
+		case MBC3:
+		case MBC5:
+			if (end <= 0x4000 || header->num_rom_banks == 1)
+				return _mem_bank_range(&g_mem->rom[0], addr, length);
+			if (addr >= 0x4000)
+				return _mem_bank_range(&g_mem->rom[g_mem->rom_bank],
+						addr - header->rom_bank_size, length);
+			return NULL;
+		default:
+			return NULL;
+		}
+	}
+
+	if (addr >= BASE_ADDR_VRAM && end <= BASE_ADDR_VRAM + SIZE_VRAM)
+		return _mem_bank_range(&g_mem->vram[g_mem->vram_bank],
+				addr - BASE_ADDR_VRAM, length);
+
+	if (addr >= BASE_ADDR_WRAM0 && end <= BASE_ADDR_WRAM0 + SIZE_WRAM0)
+		return _mem_bank_range(&g_mem->wram[0], addr - BASE_ADDR_WRAM0, length);
+
+	if (addr >= BASE_ADDR_WRAM && end <= BASE_ADDR_WRAM + SIZE_WRAM)
+		return _mem_bank_range(&g_mem->wram[rom_is_cgb() ? g_mem->wram_bank : 1],
+				addr - BASE_ADDR_WRAM, length);
+
+	if (addr >= BASE_ADDR_SPRITE_ATTR
+			&& end <= BASE_ADDR_SPRITE_ATTR + SIZE_SPRITE_ATTR)
+		return g_mem->sprite_attr + (addr - BASE_ADDR_SPRITE_ATTR);
+
+	if (addr >= BASE_ADDR_HRAM && end <= BASE_ADDR_HRAM + SIZE_HRAM)
+		return g_mem->hram + (addr - BASE_ADDR_HRAM);
+
+	return NULL;
+}
+
+static inline bool _mem_is_video(a16 addr)
+{
+	return (addr >= BASE_ADDR_VRAM && addr < BASE_ADDR_RAM_SWITCH)
+		|| (addr >= BASE_ADDR_SPRITE_ATTR
+			&& addr < BASE_ADDR_SPRITE_ATTR + SIZE_SPRITE_ATTR);
+}
+
+// Bank reported with a video write, OAM is always bank 0
+static inline int _mem_video_bank(a16 addr)
+{
+	return addr < BASE_ADDR_RAM_SWITCH ? g_mem->vram_bank : 0;
+}
+
+/* Copy length bytes from src to dst in one go.
+ *
+ * Equivalent to a sequence of mem_read8/mem_write8 calls, but only done if
+ * both ranges are plain memory and do not overlap. Returns false (and does
+ * nothing) otherwise, so that the caller can fall back to emulating accesses.
+ */
+bool mem_block_copy(a16 dst, a16 src, int length)
+{
+	if (g_mem->dma_lock)
+		return false;
+
+	if (dst < src + length && src < dst + length)
+		return false;
+
+	u8 *dst_mem = _mem_get_direct(dst, length, true);
+	u8 *src_mem = _mem_get_direct(src, length, false);
+
+	if (dst_mem == NULL || src_mem == NULL)
+		return false;
+
+	memcpy(dst_mem, src_mem, length);
+	_mem_log_writes(dst, dst_mem, length);
+	if (_mem_is_video(dst))
+		_mem_video_written(_mem_video_bank(dst), dst, dst_mem, length);
+	return true;
+}
+
+/* Fill length bytes starting at dst with data.
+ *
+ * See mem_block_copy for the conditions under which this is done.
+ */
+bool mem_block_fill(a16 dst, u8 data, int length)
+{
+	if (g_mem->dma_lock)
+		return false;
+
+	u8 *dst_mem = _mem_get_direct(dst, length, true);
+
+	if (dst_mem == NULL)
+		return false;
+
+	memset(dst_mem, data, length);
+	_mem_log_writes(dst, dst_mem, length);
+	if (_mem_is_video(dst))
+		_mem_video_written(_mem_video_bank(dst), dst, dst_mem, length);
+	return true;
 }
 
 /* Register read/write handler function for address within IO Ports range
@@ -1137,32 +1442,64 @@ void mem_register_handlers(a16 addr,
 		mem_read_handler_t r, mem_write_handler_t w)
 {
 	if (addr == BASE_ADDR_INT_ENABLE) {
-		debug_assert(g_int_enable_read == NULL && g_int_enable_write == NULL,
+		debug_assert(g_mem->int_enable_read == NULL && g_mem->int_enable_write == NULL,
 				"mem_register_handlers: handlers already registered");
-		g_int_enable_read = r;
-		g_int_enable_write = w;
+		g_mem->int_enable_read = r;
+		g_mem->int_enable_write = w;
 	} else {
 		debug_assert(addr >= BASE_ADDR_IO_PORTS
 				&& addr < BASE_ADDR_IO_PORTS + SIZE_IO_PORTS,
 				"mem_register_io_port_handlers: "
 				"this address is handled within mem");
-		debug_assert(g_io_ports_read[addr - BASE_ADDR_IO_PORTS] == NULL
-				&& g_io_ports_write[addr - BASE_ADDR_IO_PORTS] == NULL,
+		debug_assert(g_mem->io_ports_read[addr - BASE_ADDR_IO_PORTS] == NULL
+				&& g_mem->io_ports_write[addr - BASE_ADDR_IO_PORTS] == NULL,
 				"mem_register_handlers: handlers already registered");
 
-		g_io_ports_read[addr - BASE_ADDR_IO_PORTS] = r;
-		g_io_ports_write[addr - BASE_ADDR_IO_PORTS] = w;
+		g_mem->io_ports_read[addr - BASE_ADDR_IO_PORTS] = r;
+		g_mem->io_ports_write[addr - BASE_ADDR_IO_PORTS] = w;
 	}
 }
 
+/* Register function called after VRAM or OAM contents change (through the
+ * CPU, DMA or mem_vram_write8) with the bytes just written. bank is always 0
+ * for OAM. Only a single handler is supported.
+ */
+void mem_register_video_write_handler(mem_video_write_handler_t w)
+{
+	debug_assert(g_mem->video_write_handler == NULL,
+			"mem_register_video_write_handler: handler already registered");
+	g_mem->video_write_handler = w;
+}
+
+/* Whether VRAM and OAM are currently inaccessible due to a DMA transfer.
+ */
+bool mem_is_dma_locked(void)
+{
+	return g_mem->dma_lock != 0;
+}
+
+/* Whether an H-blank DMA transfer waits for the next H-blank.
+ */
+bool mem_is_h_blank_dma(void)
+{
+	return g_mem->dma_state == DMA_H_BLANK_IN_PROGRESS;
+}
+
 /* Notify mem module about H-blank interval start.
  *
  * The purpose of this function is to drive the emulation of the H-blank DMA.
  */
 void mem_h_blank_notify(void)
 {
-	if (g_dma_state != DMA_H_BLANK_IN_PROGRESS)
+	if (g_mem->dma_state != DMA_H_BLANK_IN_PROGRESS)
 		return;
 
 	_mem_dma(0x10);
 }
+
+#ifdef CPU_LOCKSTEP
+void mem_set_write_log(struct mem_write_log *log)
+{
+	g_mem->write_log = log;
+}
+#endif
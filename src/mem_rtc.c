@@ -1,7 +1,11 @@
+#include<stdlib.h>
 #include<time.h>
+#include"context_priv.h"
 #include"debug.h"
+#include"logger.h"
 #include"mem_rtc.h"
 #include"rom.h"
+#include"state.h"
 
 enum mem_rtc_state {
 	RTC_NONE = 0,
@@ -26,25 +30,30 @@ struct mem_rtc_regs {
 	};
 };
 
-static enum mem_rtc_state g_rtc_state = RTC_NONE;
-static bool g_rtc_halt = true;
+struct mem_rtc_context {
+	enum mem_rtc_state state;
+	bool halt;
 
-static struct mem_rtc_regs g_rtc_latched = {0}, g_rtc_current = {0};
-static time_t g_rtc_origin = 0;
+	struct mem_rtc_regs latched, current;
+	time_t origin;
+};
+
+// State of the current context
+#define g_mem_rtc (g_context->mem_rtc)
 
 static struct mem_rtc_regs _mem_rtc_make_regs(time_t current)
 {
 	struct mem_rtc_regs regs = {0};
 
 	// If RTC is halted return register state saved on halt
-	if (g_rtc_halt)
-		return g_rtc_current;
+	if (g_mem_rtc->halt)
+		return g_mem_rtc->current;
 
 	// Do not update RTC time-keeping registers when RTC is halted
 	if (current == 0)
 		current = time(NULL);
 
-	time_t diff = difftime(current, g_rtc_origin);
+	time_t diff = difftime(current, g_mem_rtc->origin);
 
 	// Calculate values in RTC registers based on difference between
 	// set origin time and current time
@@ -57,7 +66,7 @@ static struct mem_rtc_regs _mem_rtc_make_regs(time_t current)
 	regs.day_lower = diff & 0xFF;
 	regs.day_bit_9 = (diff & 0x100) >> 8;
 	regs.day_carry = (diff & 0x200) >> 9;
-	regs.halt = g_rtc_halt ? 1 : 0;
+	regs.halt = g_mem_rtc->halt ? 1 : 0;
 
 	return regs;
 }
@@ -68,13 +77,13 @@ static inline void _mem_rtc_calc_origin(time_t current)
 		current = time(NULL);
 
 	// Calculate new origin time based on current state of the RTC registers
-	current -= g_rtc_current.sec;
-	current -= g_rtc_current.min * 60;
-	current -= g_rtc_current.hour * 60 * 60;
-	current -= g_rtc_current.day_lower * 60 * 60 * 24;
-	current -= g_rtc_current.day_bit_9 * 60 * 60 * 24 * (0x100);
-	current -= g_rtc_current.day_carry * 60 * 60 * 24 * (0x200);
-	g_rtc_origin = current;
+	current -= g_mem_rtc->current.sec;
+	current -= g_mem_rtc->current.min * 60;
+	current -= g_mem_rtc->current.hour * 60 * 60;
+	current -= g_mem_rtc->current.day_lower * 60 * 60 * 24;
+	current -= g_mem_rtc->current.day_bit_9 * 60 * 60 * 24 * (0x100);
+	current -= g_mem_rtc->current.day_carry * 60 * 60 * 24 * (0x200);
+	g_mem_rtc->origin = current;
 }
 
 static inline void _mem_rtc_halt(void)
@@ -82,15 +91,15 @@ static inline void _mem_rtc_halt(void)
 	// Save register state as if it would be in the moment of halt.
 	// Until the registers are latched, the old value must be shown, so we
 	// can't update them right away. RTC registers are set to
-	// g_rtc_current when RTC is halted and the registers are latched.
-	g_rtc_current = _mem_rtc_make_regs(0);
-	g_rtc_current.halt = 1;
-	g_rtc_halt = true;
+	// g_mem_rtc->current when RTC is halted and the registers are latched.
+	g_mem_rtc->current = _mem_rtc_make_regs(0);
+	g_mem_rtc->current.halt = 1;
+	g_mem_rtc->halt = true;
 }
 
 static inline void _mem_rtc_resume(time_t current)
 {
-	g_rtc_halt = false;
+	g_mem_rtc->halt = false;
 
 	_mem_rtc_calc_origin(current);
 }
@@ -104,21 +113,21 @@ u8 mem_rtc_read(u8 reg)
 {
 	debug_assert(rom_get_header()->mbc == MBC3, "_mem_rtc_read: RTC unsupported on this MBC");
 
-	if (g_rtc_state != RTC_LATCHED && g_rtc_state != RTC_LATCHED_00)
+	if (g_mem_rtc->state != RTC_LATCHED && g_mem_rtc->state != RTC_LATCHED_00)
 		// TODO: can RTC registers be read without latching first?
 		return 0;
 
 	switch(reg) {
 		case 0x08:
-			return g_rtc_latched.sec;
+			return g_mem_rtc->latched.sec;
 		case 0x09:
-			return g_rtc_latched.min;
+			return g_mem_rtc->latched.min;
 		case 0x0A:
-			return g_rtc_latched.hour;
+			return g_mem_rtc->latched.hour;
 		case 0x0B:
-			return g_rtc_latched.day_lower;
+			return g_mem_rtc->latched.day_lower;
 		case 0x0C:
-			return g_rtc_latched.day_higher;
+			return g_mem_rtc->latched.day_higher;
 		default:
 			debug_assert(false, "_mem_rtc_read: invalid RTC register");
 	}
@@ -139,29 +148,29 @@ void mem_rtc_write(u8 reg, u8 data)
 	debug_assert(rom_get_header()->mbc == MBC3, "_mem_rtc_write: RTC unsupported on this MBC");
 
 	// ignore write if RTC is not halted and it is not halt flag written
-	if (!g_rtc_halt && reg != 0x0C && !(data & 0x40))
+	if (!g_mem_rtc->halt && reg != 0x0C && !(data & 0x40))
 		return;
 
 	switch(reg) {
 		case 0x08:
-			g_rtc_current.sec = (data < 60) ? data : 0;
+			g_mem_rtc->current.sec = (data < 60) ? data : 0;
 			break;
 		case 0x09:
-			g_rtc_current.min = (data < 60) ? data : 0;
+			g_mem_rtc->current.min = (data < 60) ? data : 0;
 			break;
 		case 0x0A:
-			g_rtc_current.hour = (data < 24) ? data : 0;
+			g_mem_rtc->current.hour = (data < 24) ? data : 0;
 			break;
 		case 0x0B:
-			g_rtc_current.day_lower = data;
+			g_mem_rtc->current.day_lower = data;
 			break;
 		case 0x0C:
-			if (g_rtc_current.halt == 0 && (data & 0x40)) {
+			if (g_mem_rtc->current.halt == 0 && (data & 0x40)) {
 				_mem_rtc_halt();
-			} else if (g_rtc_current.halt == 1 && !(data & 0x40)) {
+			} else if (g_mem_rtc->current.halt == 1 && !(data & 0x40)) {
 				_mem_rtc_resume(0);
 			} else {
-				g_rtc_current.day_higher = data & 0xC1;
+				g_mem_rtc->current.day_higher = data & 0xC1;
 			}
 			break;
 		default:
@@ -180,29 +189,29 @@ void mem_rtc_latch(u8 data)
 {
 	debug_assert(rom_get_header()->mbc == MBC3, "_mem_rtc_latch: RTC unsupported on this MBC");
 
-	switch (g_rtc_state) {
+	switch (g_mem_rtc->state) {
 		case RTC_NONE:
 			if (data == 0x00)
-				g_rtc_state = RTC_00;
+				g_mem_rtc->state = RTC_00;
 			break;
 		case RTC_00:
 			if (data == 0x01) {
-				g_rtc_state = RTC_LATCHED;
-				g_rtc_latched = _mem_rtc_make_regs(0);
+				g_mem_rtc->state = RTC_LATCHED;
+				g_mem_rtc->latched = _mem_rtc_make_regs(0);
 			} else {
-				g_rtc_state = RTC_NONE;
+				g_mem_rtc->state = RTC_NONE;
 			}
 			break;
 		case RTC_LATCHED:
 			if (data == 0x00) {
-				g_rtc_state = RTC_LATCHED_00;
+				g_mem_rtc->state = RTC_LATCHED_00;
 			}
 			break;
 		case RTC_LATCHED_00:
 			if (data == 0x01) {
-				g_rtc_latched = _mem_rtc_make_regs(0);
+				g_mem_rtc->latched = _mem_rtc_make_regs(0);
 			}
-			g_rtc_state = RTC_LATCHED;
+			g_mem_rtc->state = RTC_LATCHED;
 			break;
 		default:
 			debug_assert(false, "_mem_rtc_latch: invalid RTC latch state");
@@ -216,44 +225,66 @@ void mem_rtc_latch(u8 data)
  * of saving.
  *
  * @param	save	RTC state to be replicated
+ *
+ * @return	false if the RTC state couldn't be allocated
  */
-void mem_rtc_prepare(struct mem_rtc_save *save)
+bool mem_rtc_prepare(struct mem_rtc_save *save)
 {
-	g_rtc_halt = true;
+	g_mem_rtc = calloc(1, sizeof(*g_mem_rtc));
+	if (g_mem_rtc == NULL) {
+		logger_print(LOG_FATAL, "RTC: couldn't allocate the context.\n");
+		return false;
+	}
+	g_mem_rtc->state = RTC_NONE;
+	g_mem_rtc->halt = true;
+
+	state_register(&g_mem_rtc->state, sizeof(g_mem_rtc->state));
+	state_register(&g_mem_rtc->halt, sizeof(g_mem_rtc->halt));
+	state_register(&g_mem_rtc->latched, sizeof(g_mem_rtc->latched));
+	state_register(&g_mem_rtc->current, sizeof(g_mem_rtc->current));
+	state_register(&g_mem_rtc->origin, sizeof(g_mem_rtc->origin));
 
 	if (save) {
 		// Load latched register state
-		g_rtc_latched.sec        = (u8)save->latched_sec;
-		g_rtc_latched.min        = (u8)save->latched_min;
-		g_rtc_latched.hour       = (u8)save->latched_hour;
-		g_rtc_latched.day_lower  = (u8)save->latched_day_lower;
-		g_rtc_latched.day_higher = (u8)save->latched_day_higher;
+		g_mem_rtc->latched.sec        = (u8)save->latched_sec;
+		g_mem_rtc->latched.min        = (u8)save->latched_min;
+		g_mem_rtc->latched.hour       = (u8)save->latched_hour;
+		g_mem_rtc->latched.day_lower  = (u8)save->latched_day_lower;
+		g_mem_rtc->latched.day_higher = (u8)save->latched_day_higher;
 
 		// Load RTC state at the time of save
-		g_rtc_current.sec        = (u8)save->sec;
-		g_rtc_current.min        = (u8)save->min;
-		g_rtc_current.hour       = (u8)save->hour;
-		g_rtc_current.day_lower  = (u8)save->day_lower;
-		g_rtc_current.day_higher = (u8)save->day_higher;
+		g_mem_rtc->current.sec        = (u8)save->sec;
+		g_mem_rtc->current.min        = (u8)save->min;
+		g_mem_rtc->current.hour       = (u8)save->hour;
+		g_mem_rtc->current.day_lower  = (u8)save->day_lower;
+		g_mem_rtc->current.day_higher = (u8)save->day_higher;
 
-		if (g_rtc_current.halt)
-			return;
+		if (g_mem_rtc->current.halt)
+			return true;
 
 		// Recalculate origin time from the time of save and unhalt the RTC.
-		// (g_rtc_current contents from the time of save needed)
+		// (g_mem_rtc->current contents from the time of save needed)
 		// It is not required on halt as new origin time will be recalculated
 		// on resume anyway.
 		_mem_rtc_calc_origin((time_t)save->epoch);
 
 		// Unhalt the RTC
-		g_rtc_halt = false;
+		g_mem_rtc->halt = false;
 
-		// Fill g_rtc_current with actual current time
-		g_rtc_current = _mem_rtc_make_regs(0);
+		// Fill g_mem_rtc->current with actual current time
+		g_mem_rtc->current = _mem_rtc_make_regs(0);
 
 	} else {
 		_mem_rtc_resume(0);
 	}
+
+	return true;
+}
+
+void mem_rtc_destroy(void)
+{
+	free(g_mem_rtc);
+	g_mem_rtc = NULL;
 }
 
 /**
@@ -267,11 +298,11 @@ struct mem_rtc_save mem_rtc_get_save(void)
 	time_t t = time(NULL);
 	struct mem_rtc_regs regs = _mem_rtc_make_regs(t);
 
-	save.latched_sec        = g_rtc_latched.sec;
-	save.latched_min        = g_rtc_latched.min;
-	save.latched_hour       = g_rtc_latched.hour;
-	save.latched_day_lower  = g_rtc_latched.day_lower;
-	save.latched_day_higher = g_rtc_latched.day_higher;
+	save.latched_sec        = g_mem_rtc->latched.sec;
+	save.latched_min        = g_mem_rtc->latched.min;
+	save.latched_hour       = g_mem_rtc->latched.hour;
+	save.latched_day_lower  = g_mem_rtc->latched.day_lower;
+	save.latched_day_higher = g_mem_rtc->latched.day_higher;
 	save.sec                = regs.sec;
 	save.min                = regs.min;
 	save.hour               = regs.hour;
@@ -0,0 +1,188 @@
+#include<signal.h>
+#include<stdio.h>
+#include<string.h>
+#include<time.h>
+#include"logger.h"
+#include"profile.h"
+
+#ifdef PROFILE
+
+_Thread_local bool g_profile_sampled;
+_Thread_local uint64_t  g_profile_nested;
+unsigned           g_profile_steps;
+
+static const char *g_section_names[PROFILE_SECTIONS] = {
+	[PROFILE_CPU]      = "cpu_single_step",
+	[PROFILE_GPU]      = "gpu_step",
+	[PROFILE_MEM]      = "mem_step",
+	[PROFILE_JOYPAD]   = "joypad_step",
+	[PROFILE_TIMER]    = "timer_step",
+	[PROFILE_SERIAL]   = "serial_step",
+	[PROFILE_INTS]     = "ints_check",
+	[PROFILE_WAIT]     = "wait_clock",
+	[PROFILE_SCANLINE] = "_gpu_draw_scanline",
+	[PROFILE_DISPLAY]  = "display_draw",
+};
+
+static struct {
+	// Ticks as measured, not scaled up for sampling
+	uint64_t total[PROFILE_SECTIONS];
+	uint64_t at_frame[PROFILE_SECTIONS];
+	uint64_t last_frame[PROFILE_SECTIONS];
+	unsigned long frames;
+	// For converting ticks to nanoseconds, and the wall time
+	uint64_t start_ticks;
+	uint64_t start_ns;
+	char csv_path[260];
+	char label[32];
+} g_profile;
+
+static volatile sig_atomic_t g_profile_requested;
+
+
+static uint64_t _profile_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static double _profile_ns_per_tick(void)
+{
+	uint64_t ticks = profile_ticks() - g_profile.start_ticks;
+	return ticks ? (double)(_profile_now_ns() - g_profile.start_ns) / ticks : 0;
+}
+
+
+static double _profile_ns(enum profile_section section, uint64_t ticks,
+		double ns_per_tick)
+{
+	double scale = section < PROFILE_SCANLINE ? PROFILE_SAMPLE_PERIOD : 1;
+	return ticks * scale * ns_per_tick;
+}
+
+
+static void _profile_print(void)
+{
+	double ns_per_tick = _profile_ns_per_tick();
+	double wall = _profile_now_ns() - g_profile.start_ns;
+	unsigned long frames = g_profile.frames ? g_profile.frames : 1;
+	double profiled = 0;
+
+	logger_print(LOG_INFO, "[PROFILE] %lu frames in %.2f s, 1 in %d steps timed\n",
+			g_profile.frames, wall * 1e-9, PROFILE_SAMPLE_PERIOD);
+	logger_print(LOG_INFO, "  %-20s %10s %6s %10s %12s\n", "section",
+			"total ms", "%", "us/frame", "last frame");
+	for (int i = 0; i < PROFILE_SECTIONS; i++) {
+		double total = _profile_ns(i, g_profile.total[i], ns_per_tick);
+		double last = _profile_ns(i, g_profile.last_frame[i], ns_per_tick);
+		profiled += total;
+		logger_print(LOG_INFO, "  %-20s %10.1f %6.2f %10.1f %12.1f\n",
+				g_section_names[i], total * 1e-6, 100 * total / wall,
+				total * 1e-3 / frames, last * 1e-3);
+	}
+	logger_print(LOG_INFO, "  %-20s %10.1f %6.2f %10.1f\n", "other",
+			(wall - profiled) * 1e-6, 100 * (wall - profiled) / wall,
+			(wall - profiled) * 1e-3 / frames);
+}
+
+
+static void _profile_write_csv(void)
+{
+	FILE *file = fopen(g_profile.csv_path, "a");
+	if (file == NULL) {
+		logger_print(LOG_WARN, "[PROFILE] Couldn't open %s\n", g_profile.csv_path);
+		return;
+	}
+
+	// The build is told apart by when profile.c was compiled
+	if (ftell(file) == 0)
+		fprintf(file, "build,label,section,frames,total_ms,us_per_frame,percent\n");
+
+	double ns_per_tick = _profile_ns_per_tick();
+	double wall = _profile_now_ns() - g_profile.start_ns;
+	unsigned long frames = g_profile.frames ? g_profile.frames : 1;
+	for (int i = 0; i < PROFILE_SECTIONS; i++) {
+		double total = _profile_ns(i, g_profile.total[i], ns_per_tick);
+		fprintf(file, "%s %s,%s,%s,%lu,%.3f,%.3f,%.3f\n", __DATE__, __TIME__,
+				g_profile.label, g_section_names[i], g_profile.frames,
+				total * 1e-6, total * 1e-3 / frames, 100 * total / wall);
+	}
+
+	fclose(file);
+}
+
+
+static void _profile_signal(int number __attribute__((unused)))
+{
+	g_profile_requested = 1;
+}
+
+
+void profile_add(enum profile_section section, uint64_t ticks)
+{
+	g_profile.total[section] += ticks;
+}
+
+
+void profile_frame(void)
+{
+	for (int i = 0; i < PROFILE_SECTIONS; i++) {
+		g_profile.last_frame[i] = g_profile.total[i] - g_profile.at_frame[i];
+		g_profile.at_frame[i] = g_profile.total[i];
+	}
+	g_profile.frames++;
+
+	if (g_profile_requested) {
+		g_profile_requested = 0;
+		_profile_print();
+	}
+}
+
+
+void profile_prepare(const char *csv_path, const char *label)
+{
+	g_profile.start_ticks = profile_ticks();
+	g_profile.start_ns = _profile_now_ns();
+	if (csv_path != NULL)
+		snprintf(g_profile.csv_path, sizeof(g_profile.csv_path), "%s", csv_path);
+	snprintf(g_profile.label, sizeof(g_profile.label), "%s", label);
+	for (char *c = g_profile.label; *c != '\0'; c++)
+		if (*c == ',')
+			*c = ' ';
+
+	struct sigaction action = { .sa_handler = _profile_signal };
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &action, NULL);
+}
+
+
+void profile_destroy(void)
+{
+	_profile_print();
+	if (g_profile.csv_path[0] != '\0')
+		_profile_write_csv();
+}
+
+#else
+
+void profile_frame(void)
+{
+}
+
+
+void profile_prepare(const char *csv_path, const char *label __attribute__((unused)))
+{
+	if (csv_path != NULL)
+		logger_print(LOG_WARN, "[PROFILE] Built without PROFILE, "
+				"see make gbc_profile.\n");
+}
+
+
+void profile_destroy(void)
+{
+}
+
+#endif // PROFILE
@@ -1,10 +1,12 @@
+#include"context_priv.h"
 #include"debug.h"
 #include"logger.h"
 #include"mem.h"
 #include"rom.h"
 #include"types.h"
 
-static struct rom_header g_header = {0};
+// Header of the current context's cartridge
+#define g_header (g_context->rom_header)
 
 static void _rom_cart_type_not_implemented(u8 type_byte, u8 rom_size_byte)
 {
@@ -0,0 +1,131 @@
+#include<stdlib.h>
+#include<time.h>
+#include"cpu.h"
+#include"gpu.h"
+#include"gpu_render.h"
+#include"logger.h"
+#include"runahead.h"
+#include"state.h"
+
+/*
+ * When a frame that is going to be drawn starts, the emulated state is saved
+ * and the following frames are run right away with the current inputs,
+ * drawing only the last of them. Then the state is restored and the real
+ * frame runs without being drawn. What is on screen is thus always a few
+ * frames ahead of the real emulation, which hides the game's own input lag.
+ */
+
+// A frame which doesn't end within this many cycles (LCD off) is cut short
+#define RUNAHEAD_FRAME_CYCLES_MAX  (4 * 70224)
+
+static int             g_frames   = 0;
+static u8             *g_snapshot = NULL;
+static struct gpu_render_state g_render_state;
+
+static unsigned long   g_runs        = 0;
+static unsigned long   g_frames_run  = 0;
+static long            g_run_nsec    = 0;
+static long            g_state_nsec  = 0;
+
+
+static long _runahead_nsec_since(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000000L
+		+ (now.tv_nsec - start->tv_nsec);
+}
+
+
+// Run until the next frame starts, false if emulation failed
+static bool _runahead_run_frame(int (*step)(void))
+{
+	unsigned long frame = gpu_get_frame_count();
+	int cycles = 0;
+
+	while (gpu_get_frame_count() == frame && cycles < RUNAHEAD_FRAME_CYCLES_MAX) {
+		int cycles_delta = step();
+		if (cycles_delta == -1)
+			return false;
+		cycles += cycles_delta;
+	}
+
+	return true;
+}
+
+
+bool runahead_prepare(int frames)
+{
+	g_snapshot = malloc(state_size());
+	if (g_snapshot == NULL) {
+		logger_print(LOG_WARN, "RUN-AHEAD: couldn't allocate the snapshot.\n");
+		return false;
+	}
+
+	g_frames = frames;
+	logger_print(LOG_INFO, "Running %d frame(s) ahead, %zu bytes of state.\n",
+			frames, state_size());
+	return true;
+}
+
+
+long runahead_frame(int (*step)(void))
+{
+	if (g_snapshot == NULL || !gpu_is_frame_drawn())
+		return 0;
+
+	struct timespec start, ahead;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	gpu_render_save(&g_render_state);
+	state_save(g_snapshot);
+	gpu_hold_frameskip(true);
+
+	clock_gettime(CLOCK_MONOTONIC, &ahead);
+	long save_nsec = _runahead_nsec_since(&start);
+
+	int frame;
+	// The current frame and then g_frames more, of which only the last shows
+	for (frame = 0; frame <= g_frames; frame++) {
+		gpu_set_frame_drawn(frame == g_frames);
+		if (!_runahead_run_frame(step))
+			break;
+	}
+	g_run_nsec += _runahead_nsec_since(&ahead);
+	g_frames_run += frame;
+	g_runs++;
+
+	struct timespec restore;
+	clock_gettime(CLOCK_MONOTONIC, &restore);
+
+	state_load(g_snapshot);
+	cpu_events_changed();
+	gpu_render_load(&g_render_state);
+	gpu_hold_frameskip(false);
+	gpu_set_frame_drawn(false);
+
+	g_state_nsec += save_nsec + _runahead_nsec_since(&restore);
+	return _runahead_nsec_since(&start);
+}
+
+
+void runahead_destroy(void)
+{
+	if (g_snapshot == NULL)
+		return;
+
+	free(g_snapshot);
+	g_snapshot = NULL;
+
+	if (g_runs == 0)
+		return;
+
+	logger_print(
+		LOG_INFO,
+		"Run-ahead: %lu frames run ahead, %.3f ms each, "
+		"%.3f ms saving and restoring state per drawn frame.\n",
+		g_frames_run,
+		g_frames_run ? g_run_nsec / 1e6 / g_frames_run : 0.0,
+		g_state_nsec / 1e6 / g_runs
+	);
+}
@@ -0,0 +1,414 @@
+#include<pthread.h>
+#include<semaphore.h>
+#include<stdatomic.h>
+#include<stdlib.h>
+#include<string.h>
+#include<unistd.h>
+#include"scale.h"
+
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#endif
+
+/*
+ * Filters read the whole frame and write whole output lines, so a band of
+ * lines can be scaled independently of the others. scale_frame splits the
+ * requested lines into bands, one for the caller and one for each worker.
+ */
+
+#define SCALE_MAX_WORKERS     3
+// Below this many lines per band waking the workers costs more than it saves
+#define SCALE_MIN_BAND_LINES  8
+
+typedef void (*scale_lines_fn)(const texel *frame, int first, int last,
+		u8 *dst, int pitch);
+
+static void _scale2x_lines(const texel *frame, int first, int last, u8 *dst, int pitch);
+static void _scale3x_lines(const texel *frame, int first, int last, u8 *dst, int pitch);
+static void _scale_xbr_lines(const texel *frame, int first, int last, u8 *dst, int pitch);
+
+static const struct {
+	const char     *name;
+	scale_lines_fn  lines;
+	int             factor;
+	int             radius;
+} g_filters[] = {
+	{ "scale2x", _scale2x_lines,   2, 1 },
+	{ "scale3x", _scale3x_lines,   3, 1 },
+	{ "xbr",     _scale_xbr_lines, 2, 2 },
+};
+
+static scale_lines_fn g_lines  = NULL;
+static int            g_factor = 1;
+static int            g_radius = 0;
+
+static struct {
+	const texel *frame;
+	int          first;
+	int          last;
+	u8          *dst;
+	int          pitch;
+	int          bands;
+} g_job;
+
+static pthread_t    g_workers[SCALE_MAX_WORKERS];
+static sem_t        g_work[SCALE_MAX_WORKERS];
+static sem_t        g_done;
+static int          g_worker_count = 0;
+static atomic_bool  g_stop         = false;
+
+
+// Line y of the frame, lines beyond the edges repeat the border
+static inline const texel *_scale_line(const texel *frame, int y)
+{
+	return frame + MIN(MAX(y, 0), SCREEN_HEIGHT - 1) * SCREEN_WIDTH;
+}
+
+
+// -------------- SCALE2X --------------
+
+
+static void _scale2x_pixels(const texel *up, const texel *line,
+		const texel *down, int x0, int x1, texel *out0, texel *out1)
+{
+	for (int x = x0; x < x1; x++) {
+		texel b = up[x], h = down[x], e = line[x];
+		texel d = line[MAX(x - 1, 0)], f = line[MIN(x + 1, SCREEN_WIDTH - 1)];
+
+		if (b != h && d != f) {
+			out0[2 * x]     = d == b ? d : e;
+			out0[2 * x + 1] = b == f ? f : e;
+			out1[2 * x]     = d == h ? d : e;
+			out1[2 * x + 1] = h == f ? f : e;
+		} else {
+			out0[2 * x] = out0[2 * x + 1] = e;
+			out1[2 * x] = out1[2 * x + 1] = e;
+		}
+	}
+}
+
+
+#if defined(__SSE2__)
+#ifdef DISPLAY_RGB565
+#define _SCALE_CMPEQ(a, b)     _mm_cmpeq_epi16(a, b)
+#define _SCALE_UNPACKLO(a, b)  _mm_unpacklo_epi16(a, b)
+#define _SCALE_UNPACKHI(a, b)  _mm_unpackhi_epi16(a, b)
+#else
+#define _SCALE_CMPEQ(a, b)     _mm_cmpeq_epi32(a, b)
+#define _SCALE_UNPACKLO(a, b)  _mm_unpacklo_epi32(a, b)
+#define _SCALE_UNPACKHI(a, b)  _mm_unpackhi_epi32(a, b)
+#endif
+#define _SCALE_LANES  ((int) (sizeof(__m128i) / sizeof(texel)))
+
+static inline __m128i _scale_select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline void _scale_store_pairs(texel *dst, __m128i a, __m128i b)
+{
+	_mm_storeu_si128((__m128i *) dst, _SCALE_UNPACKLO(a, b));
+	_mm_storeu_si128((__m128i *) (dst + _SCALE_LANES), _SCALE_UNPACKHI(a, b));
+}
+
+// Border pixels, which need clamped neighbours, are left to the scalar loop
+static void _scale2x_line_sse2(const texel *up, const texel *line,
+		const texel *down, texel *out0, texel *out1)
+{
+	int x = 1;
+
+	_scale2x_pixels(up, line, down, 0, 1, out0, out1);
+	for (; x + _SCALE_LANES < SCREEN_WIDTH; x += _SCALE_LANES) {
+		__m128i b = _mm_loadu_si128((const __m128i *) (up + x));
+		__m128i h = _mm_loadu_si128((const __m128i *) (down + x));
+		__m128i e = _mm_loadu_si128((const __m128i *) (line + x));
+		__m128i d = _mm_loadu_si128((const __m128i *) (line + x - 1));
+		__m128i f = _mm_loadu_si128((const __m128i *) (line + x + 1));
+
+		__m128i edge = _mm_andnot_si128(_SCALE_CMPEQ(b, h),
+			_mm_andnot_si128(_SCALE_CMPEQ(d, f), _SCALE_CMPEQ(e, e)));
+
+		__m128i e0 = _scale_select(_mm_and_si128(edge, _SCALE_CMPEQ(d, b)), d, e);
+		__m128i e1 = _scale_select(_mm_and_si128(edge, _SCALE_CMPEQ(b, f)), f, e);
+		__m128i e2 = _scale_select(_mm_and_si128(edge, _SCALE_CMPEQ(d, h)), d, e);
+		__m128i e3 = _scale_select(_mm_and_si128(edge, _SCALE_CMPEQ(h, f)), f, e);
+
+		_scale_store_pairs(out0 + 2 * x, e0, e1);
+		_scale_store_pairs(out1 + 2 * x, e2, e3);
+	}
+	_scale2x_pixels(up, line, down, x, SCREEN_WIDTH, out0, out1);
+}
+#endif
+
+
+static void _scale2x_lines(const texel *frame, int first, int last, u8 *dst, int pitch)
+{
+	for (int y = first; y <= last; y++, dst += 2 * pitch) {
+		const texel *up   = _scale_line(frame, y - 1);
+		const texel *line = _scale_line(frame, y);
+		const texel *down = _scale_line(frame, y + 1);
+		texel *out0 = (texel *) dst;
+		texel *out1 = (texel *) (dst + pitch);
+
+#if defined(__SSE2__)
+		_scale2x_line_sse2(up, line, down, out0, out1);
+#else
+		_scale2x_pixels(up, line, down, 0, SCREEN_WIDTH, out0, out1);
+#endif
+	}
+}
+
+
+// -------------- SCALE3X --------------
+
+
+static void _scale3x_lines(const texel *frame, int first, int last, u8 *dst, int pitch)
+{
+	for (int y = first; y <= last; y++, dst += 3 * pitch) {
+		const texel *up   = _scale_line(frame, y - 1);
+		const texel *line = _scale_line(frame, y);
+		const texel *down = _scale_line(frame, y + 1);
+		texel *out0 = (texel *) dst;
+		texel *out1 = (texel *) (dst + pitch);
+		texel *out2 = (texel *) (dst + 2 * pitch);
+
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			int left = MAX(x - 1, 0), right = MIN(x + 1, SCREEN_WIDTH - 1);
+			texel a = up[left],   b = up[x],   c = up[right];
+			texel d = line[left], e = line[x], f = line[right];
+			texel g = down[left], h = down[x], i = down[right];
+			texel *o0 = out0 + 3 * x, *o1 = out1 + 3 * x, *o2 = out2 + 3 * x;
+
+			if (b != h && d != f) {
+				o0[0] = d == b ? d : e;
+				o0[1] = (d == b && e != c) || (b == f && e != a) ? b : e;
+				o0[2] = b == f ? f : e;
+				o1[0] = (d == b && e != g) || (d == h && e != a) ? d : e;
+				o1[1] = e;
+				o1[2] = (b == f && e != i) || (h == f && e != c) ? f : e;
+				o2[0] = d == h ? d : e;
+				o2[1] = (d == h && e != i) || (h == f && e != g) ? h : e;
+				o2[2] = h == f ? f : e;
+			} else {
+				o0[0] = o0[1] = o0[2] = e;
+				o1[0] = o1[1] = o1[2] = e;
+				o2[0] = o2[1] = o2[2] = e;
+			}
+		}
+	}
+}
+
+
+// -------------- XBR --------------
+
+
+// Colour distance, green weighs the most as in luma
+static inline int _scale_distance(texel a, texel b)
+{
+#ifdef DISPLAY_RGB565
+	int dr = ((a >> 11) - (b >> 11)) << 3;
+	int dg = (((a >> 5) & 0x3F) - ((b >> 5) & 0x3F)) << 2;
+	int db = ((a & 0x1F) - (b & 0x1F)) << 3;
+#else
+	int dr = (int) (a & 0xFF) - (int) (b & 0xFF);
+	int dg = (int) ((a >> 8) & 0xFF) - (int) ((b >> 8) & 0xFF);
+	int db = (int) ((a >> 16) & 0xFF) - (int) ((b >> 16) & 0xFF);
+#endif
+	return abs(dr) + 2 * abs(dg) + abs(db);
+}
+
+// Average of two texels, per channel
+static inline texel _scale_blend(texel a, texel b)
+{
+#ifdef DISPLAY_RGB565
+	return (((a ^ b) & 0xF7DE) >> 1) + (a & b);
+#else
+	return (((a ^ b) & 0xFEFEFEFE) >> 1) + (a & b);
+#endif
+}
+
+/*
+ * xBR level 1 rule for the corner of e pointing to (sx, sy), on the 5x5
+ * neighbourhood n. In the comments the corner is the bottom right one:
+ *
+ *        b
+ *     d  e  f  f4
+ *     g  h  i  i4
+ *        h5 i5
+ */
+static inline texel _scale_xbr_corner(texel n[5][5], int sx, int sy)
+{
+#define _SCALE_XBR_N(u, v) n[2 + sy * (v)][2 + sx * (u)]
+	texel e  = _SCALE_XBR_N(0, 0),  f  = _SCALE_XBR_N(1, 0);
+	texel h  = _SCALE_XBR_N(0, 1),  i  = _SCALE_XBR_N(1, 1);
+	texel b  = _SCALE_XBR_N(0, -1), d  = _SCALE_XBR_N(-1, 0);
+	texel c  = _SCALE_XBR_N(1, -1), g  = _SCALE_XBR_N(-1, 1);
+	texel f4 = _SCALE_XBR_N(2, 0),  i4 = _SCALE_XBR_N(2, 1);
+	texel h5 = _SCALE_XBR_N(0, 2),  i5 = _SCALE_XBR_N(1, 2);
+#undef _SCALE_XBR_N
+
+	if (e == h || e == f)
+		return e;
+
+	// Weight of an edge along h-f against one along e-i
+	int edge_hf = _scale_distance(e, c) + _scale_distance(e, g)
+		+ _scale_distance(i, h5) + _scale_distance(i, f4)
+		+ 4 * _scale_distance(h, f);
+	int edge_ei = _scale_distance(h, d) + _scale_distance(h, i5)
+		+ _scale_distance(f, i4) + _scale_distance(f, b)
+		+ 4 * _scale_distance(e, i);
+
+	if (edge_hf >= edge_ei)
+		return e;
+	if (!((f != b && h != d) || (e == i && f != i4 && h != i5)
+			|| e == g || e == c))
+		return e;
+
+	texel closest = _scale_distance(e, f) <= _scale_distance(e, h) ? f : h;
+	return _scale_blend(e, closest);
+}
+
+static void _scale_xbr_lines(const texel *frame, int first, int last, u8 *dst, int pitch)
+{
+	texel n[5][5];
+
+	for (int y = first; y <= last; y++, dst += 2 * pitch) {
+		const texel *lines[5];
+		for (int v = 0; v < 5; v++)
+			lines[v] = _scale_line(frame, y + v - 2);
+		texel *out0 = (texel *) dst;
+		texel *out1 = (texel *) (dst + pitch);
+
+		for (int x = 0; x < SCREEN_WIDTH; x++) {
+			for (int v = 0; v < 5; v++)
+				for (int u = 0; u < 5; u++)
+					n[v][u] = lines[v][MIN(MAX(x + u - 2, 0), SCREEN_WIDTH - 1)];
+
+			out0[2 * x]     = _scale_xbr_corner(n, -1, -1);
+			out0[2 * x + 1] = _scale_xbr_corner(n,  1, -1);
+			out1[2 * x]     = _scale_xbr_corner(n, -1,  1);
+			out1[2 * x + 1] = _scale_xbr_corner(n,  1,  1);
+		}
+	}
+}
+
+
+// -------------- THREAD POOL --------------
+
+
+static void _scale_band(int band)
+{
+	int lines = g_job.last - g_job.first + 1;
+	int first = g_job.first + lines * band / g_job.bands;
+	int last  = g_job.first + lines * (band + 1) / g_job.bands - 1;
+
+	if (first <= last)
+		g_lines(g_job.frame, first, last,
+				g_job.dst + (first - g_job.first) * g_factor * g_job.pitch,
+				g_job.pitch);
+}
+
+
+static void *_scale_worker(void *arg)
+{
+	int worker = (int) (intptr_t) arg;
+
+	while (true) {
+		sem_wait(&g_work[worker]);
+		if (atomic_load(&g_stop))
+			break;
+		_scale_band(worker + 1);
+		sem_post(&g_done);
+	}
+
+	return NULL;
+}
+
+
+// -------------- MAIN SECTION --------------
+
+
+bool scale_prepare(const char *filter, int workers)
+{
+	size_t i;
+	for (i = 0; i < sizeof(g_filters) / sizeof(g_filters[0]); i++)
+		if (strcmp(filter, g_filters[i].name) == 0)
+			break;
+
+	if (i == sizeof(g_filters) / sizeof(g_filters[0]))
+		return false;
+	g_lines = g_filters[i].lines;
+	g_factor = g_filters[i].factor;
+	g_radius = g_filters[i].radius;
+
+	if (workers == SCALE_WORKERS_AUTO)
+		workers = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	workers = MIN(MAX(workers, 0), SCALE_MAX_WORKERS);
+
+	sem_init(&g_done, 0, 0);
+	for (g_worker_count = 0; g_worker_count < workers; g_worker_count++) {
+		sem_init(&g_work[g_worker_count], 0, 0);
+		if (pthread_create(&g_workers[g_worker_count], NULL, _scale_worker,
+				(void *) (intptr_t) g_worker_count) != 0) {
+			// Carry on with the workers there are
+			sem_destroy(&g_work[g_worker_count]);
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+int scale_factor(void)
+{
+	return g_factor;
+}
+
+
+int scale_radius(void)
+{
+	return g_radius;
+}
+
+
+void scale_frame(const texel frame[SCREEN_HEIGHT * SCREEN_WIDTH], int first,
+		int last, void *dst, int dst_pitch)
+{
+	int lines = last - first + 1;
+	int bands = MIN(g_worker_count + 1, lines / SCALE_MIN_BAND_LINES);
+
+	g_job.frame = frame;
+	g_job.first = first;
+	g_job.last  = last;
+	g_job.dst   = dst;
+	g_job.pitch = dst_pitch;
+	g_job.bands = MAX(bands, 1);
+
+	for (int worker = 0; worker < g_job.bands - 1; worker++)
+		sem_post(&g_work[worker]);
+	_scale_band(0);
+	for (int worker = 0; worker < g_job.bands - 1; worker++)
+		sem_wait(&g_done);
+}
+
+
+void scale_destroy(void)
+{
+	if (g_lines == NULL)
+		return;
+
+	atomic_store(&g_stop, true);
+	for (int worker = 0; worker < g_worker_count; worker++) {
+		sem_post(&g_work[worker]);
+		pthread_join(g_workers[worker], NULL);
+		sem_destroy(&g_work[worker]);
+	}
+	sem_destroy(&g_done);
+
+	g_worker_count = 0;
+	g_lines = NULL;
+	g_factor = 1;
+	g_radius = 0;
+	atomic_store(&g_stop, false);
+}
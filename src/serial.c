@@ -0,0 +1,174 @@
+#include<limits.h>
+#include<stdlib.h>
+#include<string.h>
+#include"context_priv.h"
+#include"debug.h"
+#include"ints.h"
+#include"logger.h"
+#include"mem_priv.h"
+#include"rom.h"
+#include"serial.h"
+#include"state.h"
+#include"types.h"
+
+#define SB_ADDR 0xFF01
+#define SC_ADDR 0xFF02
+
+// Clocks per bit at 8192 Hz, and at 262144 Hz with the CGB fast clock
+#define SERIAL_BIT_CYCLES      512
+#define SERIAL_FAST_BIT_CYCLES 16
+
+/*
+ * There is never a link partner: a transfer on the internal clock shifts in
+ * ones, so the byte received is 0xFF, while one on the external clock never
+ * completes. Every byte sent is kept, for test ROMs reporting over serial.
+ */
+struct serial_registers {
+	u8 sb;
+	union {
+		struct {
+			u8 internal_clock : 1;
+			u8 fast_clock     : 1;
+			u8 unused         : 5;
+			u8 transfer       : 1;
+		};
+		u8 sc;
+	};
+	u8 bits_left;
+	int bit_cycles;
+};
+
+struct serial_context {
+	struct serial_registers regs;
+	size_t output_length;
+	char output[SERIAL_OUTPUT_SIZE + 1];
+};
+
+// State of the current context
+#define g_serial (g_context->serial)
+
+static int _serial_bit_period(void)
+{
+	return (g_serial->regs.fast_clock && rom_is_cgb())
+		? SERIAL_FAST_BIT_CYCLES
+		: SERIAL_BIT_CYCLES;
+}
+
+static void _serial_output(u8 data)
+{
+	// Keep the newest half once full, test results come last
+	if (g_serial->output_length == SERIAL_OUTPUT_SIZE) {
+		memmove(g_serial->output, g_serial->output + SERIAL_OUTPUT_SIZE/2,
+				SERIAL_OUTPUT_SIZE/2);
+		g_serial->output_length = SERIAL_OUTPUT_SIZE/2;
+	}
+
+	g_serial->output[g_serial->output_length++] = data;
+	g_serial->output[g_serial->output_length] = '\0';
+}
+
+static void _serial_update_sc(u8 data)
+{
+	g_serial->regs.sc = data;
+	// Clearing either bit cancels a transfer in progress
+	if (!g_serial->regs.transfer || !g_serial->regs.internal_clock) {
+		g_serial->regs.bits_left = 0;
+		return;
+	}
+
+	_serial_output(g_serial->regs.sb);
+	g_serial->regs.bits_left = 8;
+	g_serial->regs.bit_cycles = 0;
+}
+
+static u8 _serial_read_handler(a16 addr)
+{
+	switch(addr) {
+		case SB_ADDR:
+			return g_serial->regs.sb;
+		case SC_ADDR:
+			return g_serial->regs.sc | (rom_is_cgb() ? 0x7C : 0x7E);
+	}
+
+	debug_assert(false, "_serial_read_handler: invalid address");
+	return 0;
+}
+
+static void _serial_write_handler(a16 addr, u8 data)
+{
+	switch(addr) {
+		case SB_ADDR:
+			g_serial->regs.sb = data;
+			break;
+		case SC_ADDR:
+			_serial_update_sc(data);
+			break;
+		default:
+			debug_assert(false, "_serial_write_handler: invalid address");
+	}
+}
+
+void serial_step(int cycles_delta)
+{
+	struct serial_registers *regs = &g_serial->regs;
+
+	if (regs->bits_left == 0)
+		return;
+
+	int period = _serial_bit_period();
+	regs->bit_cycles += cycles_delta;
+	while (regs->bit_cycles >= period && regs->bits_left > 0) {
+		regs->bit_cycles -= period;
+		regs->sb = regs->sb << 1 | 1;
+		regs->bits_left--;
+	}
+
+	if (regs->bits_left == 0) {
+		regs->transfer = 0;
+		ints_request(INT_SERIAL_IO_TRANSFER_COMPLETE);
+	}
+}
+
+int serial_cycles_until_complete(void)
+{
+	if (g_serial->regs.bits_left == 0)
+		return INT_MAX;
+
+	return g_serial->regs.bits_left * _serial_bit_period()
+		- g_serial->regs.bit_cycles;
+}
+
+const char *serial_get_output(size_t *length)
+{
+	*length = g_serial->output_length;
+	return g_serial->output;
+}
+
+void serial_clear_output(void)
+{
+	g_serial->output_length = 0;
+	g_serial->output[0] = '\0';
+}
+
+bool serial_prepare(void)
+{
+	g_serial = calloc(1, sizeof(*g_serial));
+	if (g_serial == NULL) {
+		logger_print(LOG_FATAL, "SERIAL: couldn't allocate the context.\n");
+		return false;
+	}
+
+	mem_register_handlers(SB_ADDR, _serial_read_handler, _serial_write_handler);
+	mem_register_handlers(SC_ADDR, _serial_read_handler, _serial_write_handler);
+
+	// The output is left out, states stay small and loading one keeps it
+	state_register(&g_serial->regs, sizeof(g_serial->regs));
+
+	return true;
+}
+
+void serial_destroy(void)
+{
+	free(g_serial);
+	g_serial = NULL;
+}
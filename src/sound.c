@@ -1,6 +1,8 @@
+#include<stdlib.h>
+#include"context_priv.h"
 #include"debug.h"
-#include"events.h"
 #include"ints.h"
+#include"logger.h"
 #include"sound.h"
 #include"mem_priv.h"
 #include"types.h"
@@ -41,14 +43,14 @@ struct channel1_attributes {
 	d8 volume_envelope;
 	d8 frequency_lo;
 	d8 frequency_hi;
-} g_channel1;
+};
 
 struct channel2_attributes {
 	d8 sound_length_wave_pattern_duty;
 	d8 volume_envelope;
 	d8 frequency_lo;
 	d8 frequency_hi;
-} g_channel2;
+};
 
 struct channel3_attributes {
 	d8 sound_on_off;
@@ -56,9 +58,7 @@ struct channel3_attributes {
 	d8 select_output_level;
 	d8 frequency_lo;
 	d8 frequency_hi;
-} g_channel3;
-
-d8 g_wave_pattern_ram[16];
+};
 
 struct channel4_attributes {
 	d8 sound_length;
@@ -67,66 +67,77 @@ struct channel4_attributes {
 	d8 counter_consecutive;
 	d8 frequency_lo;
 	d8 frequency_hi;
-} g_channel4;
+};
+
+struct sound_context {
+	struct channel1_attributes channel1;
+	struct channel2_attributes channel2;
+	struct channel3_attributes channel3;
+	d8 wave_pattern_ram[16];
+	struct channel4_attributes channel4;
 
-// General
-d8 g_channel_control = 0;
-d8 g_sound_output_terminal = 0;
-d8 g_sound_on_off;
+	// General
+	d8 channel_control;
+	d8 sound_output_terminal;
+	d8 sound_on_off;
+};
+
+// State of the current context
+#define g_sound (g_context->sound)
 
 
 static u8 _sound_read_handler(a16 addr)
 {
 	if(addr >= WAVEFORM_RAM_START_ADDRESS && addr <= WAVEFORM_RAM_END_ADDRESS) {
-			return g_wave_pattern_ram[addr - WAVEFORM_RAM_START_ADDRESS];
+			return g_sound->wave_pattern_ram[addr - WAVEFORM_RAM_START_ADDRESS];
 	}
 	switch(addr) {
 		case CH1_SWEEP_REG_ADDRESS:
-			return g_channel1.sweep_register;
+			return g_sound->channel1.sweep_register;
 			break;
 		case CH1_SND_LEN_PATTERN_ADDRESS:
-			return g_channel1.sound_length_wave_pattern_duty & 0xC0;
+			return g_sound->channel1.sound_length_wave_pattern_duty & 0xC0;
 		case CH1_VOL_ENVELOPE_ADDRESS:
-			return g_channel1.volume_envelope;
+			return g_sound->channel1.volume_envelope;
 		case CH1_FREQ_LO_ADDRESS:
 			debug_assert(false, "_sound_read_handler: write only address");
 			return 0;
 		case CH1_FREQ_HI_ADDRESS:
-			return g_channel1.frequency_hi & 0x40;
+			return g_sound->channel1.frequency_hi & 0x40;
 		case CH2_SND_LEN_PATTERN_ADDRESS:
-			return g_channel2.sound_length_wave_pattern_duty & 0xC0;
+			return g_sound->channel2.sound_length_wave_pattern_duty & 0xC0;
 		case CH2_VOL_ENVELOPE_ADDRESS:
-			return g_channel1.volume_envelope;
+			return g_sound->channel1.volume_envelope;
 		case CH2_FREQ_LO_ADDRESS:
 			debug_assert(false, "_sound_read_handler: write only address");
 			return 0;
 		case CH2_FREQ_HI_ADDRESS:
-			return g_channel2.frequency_hi & 0x40;
+			return g_sound->channel2.frequency_hi & 0x40;
 		case CH3_SND_ON_OFF_ADDRESS:
-			return g_channel3.sound_on_off;
+			return g_sound->channel3.sound_on_off;
 		case CH3_SND_LEN_ADDRESS:
-			return g_channel3.sound_length;
+			return g_sound->channel3.sound_length;
 		case CH3_SND_SEL_OUT_LVL_ADDRESS:
-			return g_channel3.select_output_level;
+			return g_sound->channel3.select_output_level;
 		case CH3_FREQ_LO_ADDRESS:
 			debug_assert(false, "_sound_read_handler: write only address");
 			return 0;
 		case CH3_FREQ_HI_ADDRESS:
-			return g_channel3.frequency_hi & 0x40;
+			return g_sound->channel3.frequency_hi & 0x40;
 		case CH4_SND_LEN_ADDRESS:
-			return g_channel4.sound_length;
+			return g_sound->channel4.sound_length;
 		case CH4_VOL_ENVELOPE_ADDRESS:
-			return g_channel4.volume_envelope;
+			return g_sound->channel4.volume_envelope;
 		case CH4_POLY_COUNT_ADDRESS:
-			return g_channel4.polynomial_counter;
+			return g_sound->channel4.polynomial_counter;
 		case CH4_COUNTER_CONSECUTIVE_ADDRESS:
-			return g_channel4.counter_consecutive & 0x7F;
+			return g_sound->channel4.counter_consecutive & 0x7F;
 		case CHANNEL_CONTROL_ADDRESS:
-			return g_channel_control;
+			return g_sound->channel_control;
 		case SOUND_TERMINAL_SELECTION_ADDRESS:
-			return g_sound_output_terminal;
+			return g_sound->sound_output_terminal;
 		case SOUND_ON_OFF_ADDRESS:
-			return g_sound_on_off & (g_channel3.sound_on_off >> 4);
+			return g_sound->sound_on_off & (g_sound->channel3.sound_on_off >> 4);
 	}
 	debug_assert(false, "_sound_read_handler: invalid address");
 	return 0;
@@ -135,81 +146,87 @@ static u8 _sound_read_handler(a16 addr)
 static void _sound_write_handler(a16 addr, u8 data)
 {
 	if(addr >= WAVEFORM_RAM_START_ADDRESS && addr <= WAVEFORM_RAM_END_ADDRESS) {
-		g_wave_pattern_ram[addr - WAVEFORM_RAM_START_ADDRESS] = data;
+		g_sound->wave_pattern_ram[addr - WAVEFORM_RAM_START_ADDRESS] = data;
 		return;
 	}
 	switch(addr) {
 		case CH1_SWEEP_REG_ADDRESS:
-			g_channel1.sweep_register = data;
+			g_sound->channel1.sweep_register = data;
 			break;
 		case CH1_SND_LEN_PATTERN_ADDRESS:
-			g_channel1.sound_length_wave_pattern_duty = data;
+			g_sound->channel1.sound_length_wave_pattern_duty = data;
 			break;
 		case CH1_VOL_ENVELOPE_ADDRESS:
-			g_channel1.volume_envelope = data;
+			g_sound->channel1.volume_envelope = data;
 			break;
 		case CH1_FREQ_LO_ADDRESS:
-			g_channel1.frequency_lo = data;
+			g_sound->channel1.frequency_lo = data;
 			break;
 		case CH1_FREQ_HI_ADDRESS:
-			g_channel1.frequency_hi = data;
+			g_sound->channel1.frequency_hi = data;
 			break;
 		case CH2_SND_LEN_PATTERN_ADDRESS:
-			g_channel2.sound_length_wave_pattern_duty = data;
+			g_sound->channel2.sound_length_wave_pattern_duty = data;
 			break;
 		case CH2_VOL_ENVELOPE_ADDRESS:
-			g_channel2.volume_envelope = data;
+			g_sound->channel2.volume_envelope = data;
 			break;
 		case CH2_FREQ_LO_ADDRESS:
-			g_channel2.frequency_lo = data;
+			g_sound->channel2.frequency_lo = data;
 			break;
 		case CH2_FREQ_HI_ADDRESS:
-			g_channel2.frequency_hi = data;
+			g_sound->channel2.frequency_hi = data;
 			break;
 		case CH3_SND_ON_OFF_ADDRESS:
-			g_channel3.sound_on_off = data & 0x80;
+			g_sound->channel3.sound_on_off = data & 0x80;
 			break;
 		case CH3_SND_LEN_ADDRESS:
-			g_channel3.sound_length = data;
+			g_sound->channel3.sound_length = data;
 			break;
 		case CH3_SND_SEL_OUT_LVL_ADDRESS:
-			g_channel3.select_output_level = data & 0x60;
+			g_sound->channel3.select_output_level = data & 0x60;
 			break;
 		case CH3_FREQ_LO_ADDRESS:
-			g_channel3.frequency_lo = data;
+			g_sound->channel3.frequency_lo = data;
 			break;
 		case CH3_FREQ_HI_ADDRESS:
-			g_channel3.frequency_hi = data;
+			g_sound->channel3.frequency_hi = data;
 			break;
 		case CH4_SND_LEN_ADDRESS:
-			g_channel4.sound_length = data & 0x3F;
+			g_sound->channel4.sound_length = data & 0x3F;
 			break;
 		case CH4_VOL_ENVELOPE_ADDRESS:
-			g_channel4.volume_envelope = data;
+			g_sound->channel4.volume_envelope = data;
 			break;
 		case CH4_POLY_COUNT_ADDRESS:
-			g_channel4.polynomial_counter = data;
+			g_sound->channel4.polynomial_counter = data;
 			break;
 		case CH4_COUNTER_CONSECUTIVE_ADDRESS:
-			g_channel4.counter_consecutive = data;
+			g_sound->channel4.counter_consecutive = data;
 			break;
 		case CHANNEL_CONTROL_ADDRESS:
-			g_channel_control = data;
+			g_sound->channel_control = data;
 			break;
 		case SOUND_TERMINAL_SELECTION_ADDRESS:
-			g_sound_output_terminal = data;
+			g_sound->sound_output_terminal = data;
 			break;
 		case SOUND_ON_OFF_ADDRESS:
-			g_sound_on_off &= 0x7F;
-			g_sound_on_off |= data & 0x80;
+			g_sound->sound_on_off &= 0x7F;
+			g_sound->sound_on_off |= data & 0x80;
 			break;
 		default:
 			debug_assert(false, "_sound_write_handler: invalid address");
 		}
 }
 
-void sound_prepare(void)
+bool sound_prepare(void)
 {
+	g_sound = calloc(1, sizeof(*g_sound));
+	if (g_sound == NULL) {
+		logger_print(LOG_FATAL, "SOUND: couldn't allocate the context.\n");
+		return false;
+	}
+
 	for (a16 addr = CH1_SWEEP_REG_ADDRESS; addr <= CH1_FREQ_HI_ADDRESS; addr++) {
 		mem_register_handlers(addr,
 				_sound_read_handler, _sound_write_handler);
@@ -229,4 +246,12 @@ void sound_prepare(void)
 		mem_register_handlers(addr,
 				_sound_read_handler, _sound_write_handler);
 	}
+
+	return true;
+}
+
+void sound_destroy(void)
+{
+	free(g_sound);
+	g_sound = NULL;
 }
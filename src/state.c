@@ -0,0 +1,72 @@
+#include<stdlib.h>
+#include<string.h>
+#include"context_priv.h"
+#include"debug.h"
+#include"state.h"
+
+#define STATE_MAX_REGIONS 128
+
+struct state_context {
+	struct {
+		void   *data;
+		size_t  size;
+	} regions[STATE_MAX_REGIONS];
+
+	int    region_count;
+	size_t size;
+};
+
+// State of the current context
+#define g_state (g_context->state)
+
+
+bool state_prepare(void)
+{
+	g_state = calloc(1, sizeof(*g_state));
+	return g_state != NULL;
+}
+
+
+void state_destroy(void)
+{
+	free(g_state);
+	g_state = NULL;
+}
+
+
+void state_register(void *data, size_t size)
+{
+	debug_assert(g_state->region_count < STATE_MAX_REGIONS,
+			"state_register: too many state regions");
+	if (g_state->region_count == STATE_MAX_REGIONS)
+		return;
+
+	g_state->regions[g_state->region_count].data = data;
+	g_state->regions[g_state->region_count].size = size;
+	g_state->region_count++;
+	g_state->size += size;
+}
+
+
+size_t state_size(void)
+{
+	return g_state->size;
+}
+
+
+void state_save(u8 *snapshot)
+{
+	for (int i = 0; i < g_state->region_count; i++) {
+		memcpy(snapshot, g_state->regions[i].data, g_state->regions[i].size);
+		snapshot += g_state->regions[i].size;
+	}
+}
+
+
+void state_load(const u8 *snapshot)
+{
+	for (int i = 0; i < g_state->region_count; i++) {
+		memcpy(g_state->regions[i].data, snapshot, g_state->regions[i].size);
+		snapshot += g_state->regions[i].size;
+	}
+}
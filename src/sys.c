@@ -66,6 +66,24 @@ int _sys_load_custom_bindings(const char *input_config_path, struct sys_args *op
  *                     check the provided input.config file
  *     -f              run in fulscreen window
  *     -r <frame rate> adjust display frame rate
+ *     -t              draw scanlines on a separate render thread
+ *     -k              automatically skip more frames when the host can't
+ *                     keep up
+ *     -m <shm name>   export every frame to POSIX shared memory, e.g. /gbc
+ *                     (see display_shm.h for the layout)
+ *     -v <file>       capture every frame to a file or named pipe
+ *     -V <format>     capture format: y4m (default), rgb, rgb565, rgb-diff
+ *                     or rgb565-diff (see capture.h)
+ *     -u <filter>     upscale frames on the CPU with scale2x, scale3x or xbr
+ *     -A <frames>     run ahead this many frames to hide input lag
+ *     -P <file>       append the time spent in each subsystem to a CSV
+ *                     file at exit (make gbc_profile builds, see profile.h)
+ *     -G <file>       profile the guest code, writing its call stacks to a
+ *                     file for flamegraph.pl at exit (see hotspot.h)
+ *     -g <cycles>     emulated cycles between samples of the guest profiler
+ *     -T <file>       write a timeline of frames, scanlines, DMA, interrupts
+ *                     and input in Chrome's trace format (make gbc_trace
+ *                     builds, see trace.h)
  *
  * @param argc  argument count from main
  * @param argv  argument vector form main
@@ -80,6 +98,7 @@ bool sys_parse_args(int argc, char *argv[], struct sys_args *opts)
 	memset(opts, 0, sizeof(struct sys_args));
 
 	opts->frame_rate = DEFAULT_FRAME_RATE;
+	strcpy(opts->capture_format, "y4m");
 
 	char *arg;
 
@@ -105,6 +124,41 @@ bool sys_parse_args(int argc, char *argv[], struct sys_args *opts)
 				if (opts->frame_rate <= 0)
 					opts->frame_rate = DEFAULT_FRAME_RATE;
 				break;
+			case 't':
+				opts->render_thread = true;
+				break;
+			case 'k':
+				opts->auto_frameskip = true;
+				break;
+			case 'm':
+				strncpy(opts->shm_name, argv[++i], PATH_LENGTH);
+				break;
+			case 'v':
+				strncpy(opts->capture_path, argv[++i], PATH_LENGTH);
+				break;
+			case 'V':
+				strncpy(opts->capture_format, argv[++i], CAPTURE_FORMAT_LENGTH);
+				break;
+			case 'u':
+				strncpy(opts->scale_filter, argv[++i], SCALE_FILTER_LENGTH);
+				break;
+			case 'P':
+				strncpy(opts->profile_csv, argv[++i], PATH_LENGTH);
+				break;
+			case 'G':
+				strncpy(opts->hotspot_path, argv[++i], PATH_LENGTH);
+				break;
+			case 'T':
+				strncpy(opts->trace_path, argv[++i], PATH_LENGTH);
+				break;
+			case 'g':
+				opts->hotspot_period = atol(argv[++i]);
+				break;
+			case 'A':
+				opts->run_ahead = atoi(argv[++i]);
+				if (opts->run_ahead < 0)
+					opts->run_ahead = 0;
+				break;
 			}
 		} else if (opts->rom_path[0] == '\0') {
 			strncpy(opts->rom_path, argv[i], PATH_LENGTH);
@@ -1,6 +1,11 @@
+#include<limits.h>
+#include<stdlib.h>
+#include"context_priv.h"
 #include"debug.h"
 #include"ints.h"
+#include"logger.h"
 #include"mem_priv.h"
+#include"state.h"
 #include"types.h"
 
 #define DIV_ADDR  0xFF04
@@ -8,7 +13,7 @@
 #define TMA_ADDR  0xFF06
 #define TAC_ADDR  0xFF07
 
-static struct {
+struct timer_context {
 	u16 div;
 	u8 tima;
 	u8 tma;
@@ -20,21 +25,24 @@ static struct {
 		};
 		u8 tac;
 	};
-} g_timer_reg = {0};
+};
+
+// State of the current context
+#define g_timer (g_context->timer)
 
 static void _timer_inc_tima(void)
 {
-	if (g_timer_reg.tima == 0xFF) {
+	if (g_timer->tima == 0xFF) {
 		ints_request(INT_TIMER_OVERFLOW);
-		g_timer_reg.tima = g_timer_reg.tma;
+		g_timer->tima = g_timer->tma;
 	} else {
-		g_timer_reg.tima++;
+		g_timer->tima++;
 	}
 }
 
 static u8 _timer_clock_bit(void)
 {
-	switch(g_timer_reg.clk_select) {
+	switch(g_timer->clk_select) {
 		case 0x00:
 			return 9;
 		case 0x01:
@@ -51,7 +59,7 @@ static u8 _timer_clock_bit(void)
 
 static inline u8 _timer_get_tima_driver(void)
 {
-	return BV(g_timer_reg.div, _timer_clock_bit());
+	return BV(g_timer->div, _timer_clock_bit());
 }
 
 static void _timer_reset_div(void)
@@ -61,13 +69,13 @@ static void _timer_reset_div(void)
 	if (_timer_get_tima_driver() == 1)
 		_timer_inc_tima();
 
-	g_timer_reg.div = 0;
+	g_timer->div = 0;
 }
 
 static void _timer_update_tac(u8 val)
 {
 	u8 driver_prev = _timer_get_tima_driver();
-	g_timer_reg.tac = val;
+	g_timer->tac = val;
 
 	// If the bit that's driving TIMA is changed (1 -> 0) increment TIMA
 	if (driver_prev == 1 && _timer_get_tima_driver() == 0)
@@ -78,13 +86,13 @@ static u8 _timer_read_handler(a16 addr)
 {
 	switch(addr) {
 		case DIV_ADDR:
-			return g_timer_reg.div & 0xFF;
+			return g_timer->div & 0xFF;
 		case TIMA_ADDR:
-			return g_timer_reg.tima;
+			return g_timer->tima;
 		case TMA_ADDR:
-			return g_timer_reg.tma;
+			return g_timer->tma;
 		case TAC_ADDR:
-			return g_timer_reg.tac;
+			return g_timer->tac;
 	}
 
 	debug_assert(false, "_timer_read_handler: invalid address");
@@ -98,10 +106,10 @@ static void _timer_write_handler(a16 addr, u8 data)
 			_timer_reset_div();
 			break;
 		case TIMA_ADDR:
-			g_timer_reg.tima = data;
+			g_timer->tima = data;
 			break;
 		case TMA_ADDR:
-			g_timer_reg.tma = data;
+			g_timer->tma = data;
 			break;
 		case TAC_ADDR:
 			_timer_update_tac(data);
@@ -117,10 +125,10 @@ static void _timer_update(int cycles)
 
 	// TODO: [optimization] Update TIMA combinatorically instead of iteratively
 	for (int i = 0; i < cycles; i++) {
-		g_timer_reg.div++;
+		g_timer->div++;
 
 		// Increment TIMA when the clock bit changes 1 -> 0
-		if (BV(g_timer_reg.div - 1, clock_bit) == 1
+		if (BV(g_timer->div - 1, clock_bit) == 1
 				&& _timer_get_tima_driver() == 0)
 			_timer_inc_tima();
 	}
@@ -128,16 +136,46 @@ static void _timer_update(int cycles)
 
 void timer_step(int cycles_delta)
 {
-	if (g_timer_reg.timer_en)
+	if (g_timer->timer_en)
 		_timer_update(cycles_delta);
 	else
-		g_timer_reg.div += cycles_delta;
+		g_timer->div += cycles_delta;
 }
 
-void timer_prepare(void)
+/* Number of cycles after which TIMA will overflow, if nothing is written to
+ * the timer registers in the meantime.
+ */
+int timer_cycles_until_overflow(void)
 {
+	if (!g_timer->timer_en)
+		return INT_MAX;
+
+	int period = 1 << (_timer_clock_bit() + 1);
+	int until_inc = period - (g_timer->div & (period - 1));
+
+	return until_inc + (0xFF - g_timer->tima) * period;
+}
+
+bool timer_prepare(void)
+{
+	g_timer = calloc(1, sizeof(*g_timer));
+	if (g_timer == NULL) {
+		logger_print(LOG_FATAL, "TIMER: couldn't allocate the context.\n");
+		return false;
+	}
+
 	mem_register_handlers(DIV_ADDR,  _timer_read_handler, _timer_write_handler);
 	mem_register_handlers(TIMA_ADDR, _timer_read_handler, _timer_write_handler);
 	mem_register_handlers(TMA_ADDR,  _timer_read_handler, _timer_write_handler);
 	mem_register_handlers(TAC_ADDR,  _timer_read_handler, _timer_write_handler);
+
+	state_register(g_timer, sizeof(*g_timer));
+
+	return true;
+}
+
+void timer_destroy(void)
+{
+	free(g_timer);
+	g_timer = NULL;
 }
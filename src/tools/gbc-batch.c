@@ -0,0 +1,494 @@
+/*
+ * Headless regression runner over a ROM corpus.
+ *
+ * Runs every .gb and .gbc file of a directory on libgbc, unthrottled and
+ * spread over the CPUs, hashes the framebuffer at the frames the manifest
+ * asks for and compares the hashes with the golden ones. Prints a pass/fail
+ * table with the frames per second of every ROM and exits with 1 if any did
+ * not pass. With -u the golden file is written from this run instead.
+ *
+ * Manifest, one ROM per line, the line for * applying to ROMs not listed:
+ *   <rom> <frames> <frame>[,<frame>...] [<first>[-<last>]:<button>[+<button>...] ...]
+ * for example
+ *   tetris.gb 600 60,300,600 100-110:START 200-260:LEFT+A
+ * holds START for frames 100 to 110 and LEFT and A for 200 to 260, frames
+ * counting from 1. Buttons are RIGHT LEFT UP DOWN A B SELECT START.
+ * Golden file: <rom> <frame> <hash> per line. Hashes are of the framebuffer
+ * as is, so a DISPLAY_RGB565 build needs golden hashes of its own.
+ * Usage: gbc-batch [-j threads] [-u] rom_dir manifest golden
+ */
+#include<dirent.h>
+#include<limits.h>
+#include<pthread.h>
+#include<stdatomic.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include<unistd.h>
+#include"gbc.h"
+
+#define BATCH_MAX_CHECKS   32
+#define BATCH_MAX_INPUTS   64
+#define BATCH_MAX_NAME     256
+#define BATCH_MAX_LINE     4096
+
+struct batch_input {
+	long     first;
+	long     last;
+	unsigned buttons;
+};
+
+struct batch_script {
+	char               rom[BATCH_MAX_NAME];
+	long               frames;
+	int                checks;
+	long               check[BATCH_MAX_CHECKS];
+	int                inputs;
+	struct batch_input input[BATCH_MAX_INPUTS];
+};
+
+struct batch_golden {
+	char     rom[BATCH_MAX_NAME];
+	long     frame;
+	uint64_t hash;
+};
+
+enum batch_result {
+	RESULT_PASS,
+	RESULT_FAIL,
+	RESULT_NEW,
+	RESULT_ERROR,
+	RESULT_SAVED,
+};
+
+struct batch_job {
+	char                       rom[BATCH_MAX_NAME];
+	const struct batch_script *script;
+	bool                       loaded;
+	long                       halted_at;
+	uint64_t                   hash[BATCH_MAX_CHECKS];
+	double                     seconds;
+	enum batch_result          result;
+	char                       note[128];
+};
+
+static const char *g_result_names[] = { "PASS", "FAIL", "NEW", "ERROR", "SAVED" };
+
+static const struct {
+	const char *name;
+	unsigned    button;
+} g_buttons[] = {
+	{ "RIGHT",  GBC_BUTTON_RIGHT },
+	{ "LEFT",   GBC_BUTTON_LEFT },
+	{ "UP",     GBC_BUTTON_UP },
+	{ "DOWN",   GBC_BUTTON_DOWN },
+	{ "A",      GBC_BUTTON_A },
+	{ "B",      GBC_BUTTON_B },
+	{ "SELECT", GBC_BUTTON_SELECT },
+	{ "START",  GBC_BUTTON_START },
+};
+
+static const char       *g_rom_dir;
+static struct batch_job *g_jobs;
+static int               g_job_count;
+static atomic_int        g_next_job;
+
+
+static double _batch_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static bool _batch_parse_buttons(char *names, unsigned *buttons)
+{
+	*buttons = 0;
+	for (char *name = strtok(names, "+"); name; name = strtok(NULL, "+")) {
+		size_t i;
+		for (i = 0; i < sizeof(g_buttons) / sizeof(g_buttons[0]); i++)
+			if (strcmp(name, g_buttons[i].name) == 0)
+				break;
+		if (i == sizeof(g_buttons) / sizeof(g_buttons[0]))
+			return false;
+		*buttons |= g_buttons[i].button;
+	}
+	return true;
+}
+
+
+static bool _batch_parse_script(char *line, struct batch_script *script)
+{
+	char *saved;
+	char *rom = strtok_r(line, " \t\n", &saved);
+	char *frames = strtok_r(NULL, " \t\n", &saved);
+	char *checks = strtok_r(NULL, " \t\n", &saved);
+
+	memset(script, 0, sizeof(*script));
+	if (rom == NULL || frames == NULL || checks == NULL)
+		return false;
+	snprintf(script->rom, sizeof(script->rom), "%s", rom);
+	script->frames = atol(frames);
+
+	for (char *check = strtok(checks, ","); check; check = strtok(NULL, ",")) {
+		if (script->checks == BATCH_MAX_CHECKS)
+			return false;
+		script->check[script->checks] = atol(check);
+		if (script->check[script->checks] < 1
+				|| script->check[script->checks] > script->frames)
+			return false;
+		script->checks++;
+	}
+
+	for (char *input = strtok_r(NULL, " \t\n", &saved); input;
+			input = strtok_r(NULL, " \t\n", &saved)) {
+		struct batch_input *range = &script->input[script->inputs];
+		char *buttons = strchr(input, ':');
+		if (script->inputs == BATCH_MAX_INPUTS || buttons == NULL)
+			return false;
+		*buttons++ = '\0';
+
+		char *last = strchr(input, '-');
+		range->first = atol(input);
+		range->last = last ? atol(last + 1) : range->first;
+		if (!_batch_parse_buttons(buttons, &range->buttons))
+			return false;
+		script->inputs++;
+	}
+
+	return script->frames > 0;
+}
+
+
+static struct batch_script *_batch_read_manifest(const char *path, int *count)
+{
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		perror(path);
+		return NULL;
+	}
+
+	struct batch_script *scripts = NULL;
+	char line[BATCH_MAX_LINE];
+	int number = 0;
+
+	*count = 0;
+	while (fgets(line, sizeof(line), file)) {
+		number++;
+		if (line[strspn(line, " \t\n")] == '\0' || line[0] == '#')
+			continue;
+
+		scripts = realloc(scripts, (*count + 1) * sizeof(*scripts));
+		if (!_batch_parse_script(line, &scripts[*count])) {
+			fprintf(stderr, "%s:%d: bad manifest line\n", path, number);
+			free(scripts);
+			fclose(file);
+			return NULL;
+		}
+		(*count)++;
+	}
+
+	fclose(file);
+	return scripts;
+}
+
+
+static struct batch_golden *_batch_read_golden(const char *path, int *count)
+{
+	struct batch_golden *golden = NULL;
+	struct batch_golden entry;
+	unsigned long long hash;
+
+	*count = 0;
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return NULL;
+
+	while (fscanf(file, "%255s %ld %llx", entry.rom, &entry.frame, &hash) == 3) {
+		entry.hash = hash;
+		golden = realloc(golden, (*count + 1) * sizeof(*golden));
+		golden[(*count)++] = entry;
+	}
+
+	fclose(file);
+	return golden;
+}
+
+
+static const struct batch_script *_batch_find_script(
+		const struct batch_script *scripts, int count, const char *rom)
+{
+	const struct batch_script *fallback = NULL;
+
+	for (int i = 0; i < count; i++) {
+		if (strcmp(scripts[i].rom, rom) == 0)
+			return &scripts[i];
+		if (strcmp(scripts[i].rom, "*") == 0)
+			fallback = &scripts[i];
+	}
+
+	return fallback;
+}
+
+
+static int _batch_is_rom(const struct dirent *entry)
+{
+	const char *extension = strrchr(entry->d_name, '.');
+	return extension && (strcmp(extension, ".gb") == 0
+			|| strcmp(extension, ".gbc") == 0);
+}
+
+
+static uint8_t *_batch_read_rom(const char *name, size_t *size)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/%s", g_rom_dir, name);
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+
+	uint8_t *rom = malloc(*size);
+	if (rom != NULL && fread(rom, 1, *size, file) != *size) {
+		free(rom);
+		rom = NULL;
+	}
+	fclose(file);
+	return rom;
+}
+
+
+// FNV-1a over the framebuffer
+static uint64_t _batch_hash(struct gbc *gbc)
+{
+	const uint8_t *frame = gbc_framebuffer(gbc);
+	size_t size = GBC_SCREEN_WIDTH * GBC_SCREEN_HEIGHT * gbc_pixel_size();
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= frame[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+
+static unsigned _batch_buttons(const struct batch_script *script, long frame)
+{
+	unsigned buttons = 0;
+
+	for (int i = 0; i < script->inputs; i++)
+		if (frame >= script->input[i].first && frame <= script->input[i].last)
+			buttons |= script->input[i].buttons;
+
+	return buttons;
+}
+
+
+static void _batch_run(struct batch_job *job)
+{
+	size_t size;
+	uint8_t *rom = _batch_read_rom(job->rom, &size);
+	struct gbc *gbc = rom ? gbc_create(rom, size) : NULL;
+	free(rom);
+	if (gbc == NULL)
+		return;
+
+	const struct batch_script *script = job->script;
+	double start = _batch_now();
+
+	job->loaded = true;
+	for (long frame = 1; frame <= script->frames; frame++) {
+		gbc_set_joypad(gbc, _batch_buttons(script, frame));
+		if (!gbc_run_frame(gbc) && job->halted_at == 0)
+			job->halted_at = frame;
+
+		for (int i = 0; i < script->checks; i++)
+			if (script->check[i] == frame)
+				job->hash[i] = _batch_hash(gbc);
+	}
+
+	job->seconds = _batch_now() - start;
+	gbc_destroy(gbc);
+}
+
+
+static void *_batch_worker(void *arg __attribute__((unused)))
+{
+	int job;
+
+	while ((job = atomic_fetch_add(&g_next_job, 1)) < g_job_count)
+		_batch_run(&g_jobs[job]);
+
+	return NULL;
+}
+
+
+static void _batch_compare(struct batch_job *job,
+		const struct batch_golden *golden, int golden_count)
+{
+	job->result = RESULT_PASS;
+	if (!job->loaded) {
+		job->result = RESULT_ERROR;
+		snprintf(job->note, sizeof(job->note), "couldn't load the ROM");
+		return;
+	}
+
+	for (int i = 0; i < job->script->checks; i++) {
+		const struct batch_golden *expected = NULL;
+		for (int j = 0; j < golden_count; j++)
+			if (golden[j].frame == job->script->check[i]
+					&& strcmp(golden[j].rom, job->rom) == 0)
+				expected = &golden[j];
+
+		if (expected == NULL) {
+			job->result = RESULT_NEW;
+			snprintf(job->note, sizeof(job->note),
+					"no golden hash for frame %ld", job->script->check[i]);
+			return;
+		}
+		if (expected->hash != job->hash[i]) {
+			job->result = RESULT_FAIL;
+			snprintf(job->note, sizeof(job->note),
+					"frame %ld: %016llx, expected %016llx",
+					job->script->check[i], (unsigned long long)job->hash[i],
+					(unsigned long long)expected->hash);
+			return;
+		}
+	}
+
+	if (job->halted_at)
+		snprintf(job->note, sizeof(job->note), "CPU stopped in frame %ld",
+				job->halted_at);
+}
+
+
+static bool _batch_write_golden(const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		perror(path);
+		return false;
+	}
+
+	for (int i = 0; i < g_job_count; i++) {
+		struct batch_job *job = &g_jobs[i];
+		if (!job->loaded)
+			continue;
+		for (int check = 0; check < job->script->checks; check++)
+			fprintf(file, "%s %ld %016llx\n", job->rom,
+					job->script->check[check],
+					(unsigned long long)job->hash[check]);
+		job->result = RESULT_SAVED;
+	}
+
+	fclose(file);
+	return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	bool update = false;
+	int option;
+
+	while ((option = getopt(argc, argv, "j:u")) != -1) {
+		switch (option) {
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		case 'u':
+			update = true;
+			break;
+		default:
+			threads = 0;
+		}
+	}
+	if (argc - optind != 3 || threads <= 0) {
+		fprintf(stderr, "Usage: %s [-j threads] [-u] rom_dir manifest golden\n",
+				argv[0]);
+		return 2;
+	}
+	g_rom_dir = argv[optind];
+
+	int script_count, golden_count;
+	struct batch_script *scripts = _batch_read_manifest(argv[optind + 1],
+			&script_count);
+	if (scripts == NULL)
+		return 2;
+	struct batch_golden *golden = _batch_read_golden(argv[optind + 2],
+			&golden_count);
+
+	struct dirent **entries;
+	int entry_count = scandir(g_rom_dir, &entries, _batch_is_rom, alphasort);
+	if (entry_count < 0) {
+		perror(g_rom_dir);
+		return 2;
+	}
+
+	g_jobs = calloc(entry_count, sizeof(*g_jobs));
+	for (int i = 0; i < entry_count; i++) {
+		const struct batch_script *script = _batch_find_script(scripts,
+				script_count, entries[i]->d_name);
+		if (script != NULL) {
+			snprintf(g_jobs[g_job_count].rom, BATCH_MAX_NAME, "%s",
+					entries[i]->d_name);
+			g_jobs[g_job_count++].script = script;
+		}
+		free(entries[i]);
+	}
+	free(entries);
+
+	gbc_set_quiet(true);
+
+	double start = _batch_now();
+	pthread_t *workers = malloc(threads * sizeof(*workers));
+	for (int i = 1; i < threads; i++)
+		pthread_create(&workers[i], NULL, _batch_worker, NULL);
+	_batch_worker(NULL);
+	for (int i = 1; i < threads; i++)
+		pthread_join(workers[i], NULL);
+	double elapsed = _batch_now() - start;
+	free(workers);
+
+	if (update && !_batch_write_golden(argv[optind + 2]))
+		return 2;
+
+	int counts[RESULT_SAVED + 1] = { 0 };
+	long frames = 0;
+	printf("%-32s %8s %-6s %10s  %s\n", "ROM", "FRAMES", "RESULT", "FRAMES/S", "");
+	for (int i = 0; i < g_job_count; i++) {
+		struct batch_job *job = &g_jobs[i];
+		if (!update)
+			_batch_compare(job, golden, golden_count);
+		else if (!job->loaded)
+			job->result = RESULT_ERROR;
+		counts[job->result]++;
+		frames += job->loaded ? job->script->frames : 0;
+
+		printf("%-32s %8ld %-6s %10.0f  %s\n", job->rom, job->script->frames,
+				g_result_names[job->result],
+				job->seconds > 0 ? job->script->frames / job->seconds : 0,
+				job->note);
+	}
+
+	printf("%d passed, %d failed, %d new, %d errors, %d saved "
+			"in %.2f s on %d threads, %.0f frames/s\n",
+			counts[RESULT_PASS], counts[RESULT_FAIL], counts[RESULT_NEW],
+			counts[RESULT_ERROR], counts[RESULT_SAVED], elapsed, threads,
+			frames / elapsed);
+
+	free(scripts);
+	free(golden);
+	free(g_jobs);
+
+	return counts[RESULT_FAIL] + counts[RESULT_NEW] + counts[RESULT_ERROR] > 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * Headless test ROM suite runner (make test).
+ *
+ * Runs every ROM given on libgbc, spread over the CPUs, until it reports a
+ * result or timeout emulated seconds have passed, and prints a table of the
+ * results. Exits with 1 unless every ROM passed. Results are read from:
+ *  - the serial output, "Passed" or "Failed" as printed by blargg's ROMs,
+ *    or the bytes 3 5 8 13 21 34 (pass) and six 0x42 (fail) sent by mooneye's
+ *  - cartridge RAM, for blargg's ROMs without serial output: the signature
+ *    DE B0 61 at 0xA001, the result at 0xA000 (0x80 while running, 0 once
+ *    passed) and the text from 0xA004
+ * Usage: gbc-test [-j threads] [-t timeout] rom...
+ */
+#include<pthread.h>
+#include<stdatomic.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+#include<unistd.h>
+#include"gbc.h"
+
+// Frames per emulated second
+#define TEST_FRAME_RATE   60
+#define TEST_MAX_NOTE     64
+// Frames run once a result shows up, for the rest of the text to follow
+#define TEST_SETTLE_FRAMES 30
+// Cartridge RAM size in the ROM header, 0 for none
+#define TEST_RAM_SIZE     0x0149
+
+enum test_result {
+	RESULT_PASS,
+	RESULT_FAIL,
+	RESULT_TIMEOUT,
+	RESULT_ERROR,
+};
+
+struct test_job {
+	const char       *rom;
+	bool              has_ram;
+	enum test_result  result;
+	long              frames;
+	double            seconds;
+	char              note[TEST_MAX_NOTE];
+};
+
+static const char *g_result_names[] = { "PASS", "FAIL", "TIMEOUT", "ERROR" };
+
+static const char g_mooneye_pass[] = { 3, 5, 8, 13, 21, 34, 0 };
+static const char g_mooneye_fail[] = { 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0 };
+
+static struct test_job *g_jobs;
+static int              g_job_count;
+static atomic_int       g_next_job;
+static long             g_timeout = 120;
+
+
+static double _test_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static uint8_t *_test_read_rom(const char *path, size_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	rewind(file);
+
+	uint8_t *rom = malloc(*size);
+	if (rom != NULL && fread(rom, 1, *size, file) != *size) {
+		free(rom);
+		rom = NULL;
+	}
+	fclose(file);
+	return rom;
+}
+
+
+// Last line of text, for the note of a failure
+static void _test_last_line(struct test_job *job, const char *text)
+{
+	const char *end = text + strlen(text);
+
+	while (end > text && (end[-1] == '\n' || end[-1] == ' '))
+		end--;
+	const char *start = end;
+	while (start > text && start[-1] != '\n')
+		start--;
+
+	snprintf(job->note, sizeof(job->note), "%.*s", (int)(end - start), start);
+}
+
+
+static bool _test_check_serial(struct gbc *gbc, struct test_job *job)
+{
+	size_t length;
+	const char *output = gbc_serial_output(gbc, &length);
+
+	if (strstr(output, "Passed") || strstr(output, g_mooneye_pass)) {
+		job->result = RESULT_PASS;
+		return true;
+	}
+	if (strstr(output, "Failed") || strstr(output, g_mooneye_fail)) {
+		job->result = RESULT_FAIL;
+		_test_last_line(job, output);
+		return true;
+	}
+
+	return false;
+}
+
+
+static bool _test_check_memory(struct gbc *gbc, struct test_job *job)
+{
+	if (!job->has_ram)
+		return false;
+	if (gbc_read8(gbc, 0xA001) != 0xDE || gbc_read8(gbc, 0xA002) != 0xB0
+			|| gbc_read8(gbc, 0xA003) != 0x61)
+		return false;
+
+	uint8_t status = gbc_read8(gbc, 0xA000);
+	if (status == 0x80)
+		return false;
+
+	char text[TEST_MAX_NOTE];
+	size_t length = 0;
+	for (uint16_t addr = 0xA004; length < sizeof(text) - 1; addr++) {
+		text[length] = gbc_read8(gbc, addr);
+		if (text[length] == '\0')
+			break;
+		length++;
+	}
+	text[length] = '\0';
+
+	job->result = status == 0 ? RESULT_PASS : RESULT_FAIL;
+	if (job->result == RESULT_FAIL)
+		_test_last_line(job, text);
+	return true;
+}
+
+
+static void _test_run(struct test_job *job)
+{
+	size_t size;
+	uint8_t *rom = _test_read_rom(job->rom, &size);
+	struct gbc *gbc = rom ? gbc_create(rom, size) : NULL;
+	job->has_ram = rom && size > TEST_RAM_SIZE && rom[TEST_RAM_SIZE] != 0;
+	free(rom);
+	if (gbc == NULL) {
+		job->result = RESULT_ERROR;
+		snprintf(job->note, sizeof(job->note), "couldn't load the ROM");
+		return;
+	}
+
+	double start = _test_now();
+
+	long settle = -1;
+
+	job->result = RESULT_TIMEOUT;
+	while (job->frames < g_timeout * TEST_FRAME_RATE && settle != 0) {
+		job->frames++;
+		if (!gbc_run_frame(gbc)) {
+			job->result = RESULT_ERROR;
+			snprintf(job->note, sizeof(job->note),
+					"CPU stopped in frame %ld", job->frames);
+			break;
+		}
+		if (settle > 0)
+			settle--;
+		else if (_test_check_serial(gbc, job) || _test_check_memory(gbc, job))
+			settle = TEST_SETTLE_FRAMES;
+	}
+	if (settle >= 0 && !_test_check_serial(gbc, job))
+		_test_check_memory(gbc, job);
+
+	job->seconds = _test_now() - start;
+	gbc_destroy(gbc);
+}
+
+
+static void *_test_worker(void *arg __attribute__((unused)))
+{
+	int job;
+
+	while ((job = atomic_fetch_add(&g_next_job, 1)) < g_job_count)
+		_test_run(&g_jobs[job]);
+
+	return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int option;
+
+	while ((option = getopt(argc, argv, "j:t:")) != -1) {
+		switch (option) {
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		case 't':
+			g_timeout = atol(optarg);
+			break;
+		default:
+			threads = 0;
+		}
+	}
+	if (argc == optind || threads <= 0 || g_timeout <= 0) {
+		fprintf(stderr, "Usage: %s [-j threads] [-t timeout] rom...\n", argv[0]);
+		return 2;
+	}
+
+	g_job_count = argc - optind;
+	g_jobs = calloc(g_job_count, sizeof(*g_jobs));
+	for (int i = 0; i < g_job_count; i++)
+		g_jobs[i].rom = argv[optind + i];
+
+	gbc_set_quiet(true);
+
+	double start = _test_now();
+	pthread_t *workers = malloc(threads * sizeof(*workers));
+	for (int i = 1; i < threads; i++)
+		pthread_create(&workers[i], NULL, _test_worker, NULL);
+	_test_worker(NULL);
+	for (int i = 1; i < threads; i++)
+		pthread_join(workers[i], NULL);
+	double elapsed = _test_now() - start;
+	free(workers);
+
+	int counts[RESULT_ERROR + 1] = { 0 };
+	printf("%-48s %-7s %8s %8s  %s\n", "ROM", "RESULT", "EMULATED", "WALL", "");
+	for (int i = 0; i < g_job_count; i++) {
+		struct test_job *job = &g_jobs[i];
+		counts[job->result]++;
+		printf("%-48s %-7s %8.1f %8.2f  %s\n", job->rom,
+				g_result_names[job->result],
+				(double)job->frames / TEST_FRAME_RATE, job->seconds, job->note);
+	}
+
+	printf("%d passed, %d failed, %d timed out, %d errors in %.2f s on %d threads\n",
+			counts[RESULT_PASS], counts[RESULT_FAIL], counts[RESULT_TIMEOUT],
+			counts[RESULT_ERROR], elapsed, threads);
+
+	free(g_jobs);
+
+	return counts[RESULT_PASS] != g_job_count;
+}
@@ -0,0 +1,243 @@
+/*
+ * Lockstep differential tester, fast core against the reference interpreter.
+ *
+ * Runs a ROM in two contexts over the same memory image: one as usual, with
+ * fused handlers and native loops, the other executing every instruction
+ * through its own handler in g_instruction_table. After every step of the
+ * fast core the reference runs until it has used as many cycles, then the
+ * registers, the cycle counts and the log of memory writes are compared,
+ * and the whole emulated state at the end of every frame. The first
+ * divergence is reported with the disassembly of what both sides ran.
+ * Built with CPU_LOCKSTEP (make tools).
+ * Usage: lockstep rom [frames]
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include"context.h"
+#include"cpu.h"
+#include"debug.h"
+#include"gpu.h"
+#include"ints.h"
+#include"joypad.h"
+#include"logger.h"
+#include"mem.h"
+#include"regs.h"
+#include"serial.h"
+#include"sound.h"
+#include"state.h"
+#include"timer.h"
+
+// Reference instructions listed in a report
+#define LOCKSTEP_TRACE  16
+
+struct lockstep_side {
+	const char           *name;
+	struct gb_context    *context;
+	struct mem_write_log *log;
+	u8                   *snapshot;
+	unsigned long         cycles;
+	unsigned long         instructions;
+	int                   trace_count;
+	u16                   trace[LOCKSTEP_TRACE];
+};
+
+static struct lockstep_side g_fast = { .name = "fast" };
+static struct lockstep_side g_reference = { .name = "reference" };
+
+
+static bool _lockstep_prepare(struct lockstep_side *side, const char *rom_path,
+		bool reference)
+{
+	side->context = context_create();
+	if (side->context == NULL || !mem_prepare(rom_path, NULL))
+		return false;
+	if (!sound_prepare() || !cpu_prepare() || !ints_prepare()
+			|| !gpu_prepare(NULL, false, false)
+			|| !joypad_prepare() || !timer_prepare()
+			|| !serial_prepare())
+		return false;
+
+	cpu_set_reference(reference);
+	side->log = calloc(1, sizeof(*side->log));
+	side->snapshot = malloc(state_size());
+	if (side->log == NULL || side->snapshot == NULL)
+		return false;
+	mem_set_write_log(side->log);
+
+	return true;
+}
+
+
+// One instruction (or fused run of them) and every module catching up
+static int _lockstep_step(struct lockstep_side *side)
+{
+	if (side->trace_count < LOCKSTEP_TRACE)
+		side->trace[side->trace_count] = cpu_register_get().PC;
+	side->trace_count++;
+
+	int cycles_delta = cpu_single_step();
+	if (cycles_delta < 0)
+		return -1;
+
+	gpu_step(cpu_is_double_speed() ? cycles_delta/2 : cycles_delta);
+	mem_step(cycles_delta);
+	joypad_step();
+	timer_step(cycles_delta);
+	serial_step(cycles_delta);
+	ints_check();
+
+	side->cycles += cycles_delta;
+	side->instructions++;
+	return cycles_delta;
+}
+
+
+static void _lockstep_print_trace(struct lockstep_side *side)
+{
+	char instruction[32];
+
+	context_set_current(side->context);
+	printf("%s ran %d step(s):\n", side->name, side->trace_count);
+	for (int i = 0; i < side->trace_count && i < LOCKSTEP_TRACE; i++) {
+		debug_disassemble(side->trace[i], instruction, sizeof(instruction));
+		printf("  0x%04X  %s\n", side->trace[i], instruction);
+	}
+	if (side->trace_count > LOCKSTEP_TRACE)
+		printf("  ...\n");
+}
+
+
+static void _lockstep_print_registers(struct cpu_registers fast,
+		struct cpu_registers reference)
+{
+	const char *names[] = { "AF", "BC", "DE", "HL", "SP", "PC" };
+	u16 a[] = { fast.AF, fast.BC, fast.DE, fast.HL, fast.SP, fast.PC };
+	u16 b[] = { reference.AF, reference.BC, reference.DE, reference.HL,
+		reference.SP, reference.PC };
+
+	printf("registers   fast   reference\n");
+	for (int i = 0; i < 6; i++)
+		printf("  %s      0x%04X 0x%04X%s\n", names[i], a[i], b[i],
+				a[i] != b[i] ? "  <--" : "");
+}
+
+
+static bool _lockstep_compare_writes(void)
+{
+	struct mem_write_log *a = g_fast.log, *b = g_reference.log;
+	size_t kept = a->count < MEM_WRITE_LOG_SIZE ? a->count : MEM_WRITE_LOG_SIZE;
+
+	if (a->count != b->count) {
+		printf("writes: fast %zu, reference %zu\n", a->count, b->count);
+		return false;
+	}
+
+	for (size_t i = 0; i < kept; i++) {
+		if (a->addr[i] != b->addr[i] || a->data[i] != b->data[i]) {
+			printf("write %zu: fast (0x%04X) = 0x%02X, reference (0x%04X) = 0x%02X\n",
+					i, a->addr[i], a->data[i], b->addr[i], b->data[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static bool _lockstep_compare_state(void)
+{
+	size_t size = state_size();
+
+	context_set_current(g_fast.context);
+	state_save(g_fast.snapshot);
+	context_set_current(g_reference.context);
+	state_save(g_reference.snapshot);
+
+	for (size_t i = 0; i < size; i++) {
+		if (g_fast.snapshot[i] != g_reference.snapshot[i]) {
+			printf("emulated state differs at byte %zu of %zu: "
+					"fast 0x%02X, reference 0x%02X\n", i, size,
+					g_fast.snapshot[i], g_reference.snapshot[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		printf("Usage: %s rom [frames]\n", argv[0]);
+		return 2;
+	}
+	unsigned long frames = argc > 2 ? strtoul(argv[2], NULL, 0) : 600;
+
+	if (!logger_prepare())
+		return 2;
+	logger_set_quiet(true);
+
+	if (!_lockstep_prepare(&g_fast, argv[1], false)
+			|| !_lockstep_prepare(&g_reference, argv[1], true)) {
+		printf("Couldn't load %s\n", argv[1]);
+		return 2;
+	}
+
+	unsigned long steps = 0, fused = 0, frame = 0;
+	bool diverged = false;
+
+	while (frame < frames && !diverged) {
+		context_set_current(g_fast.context);
+		g_fast.log->count = 0;
+		g_fast.trace_count = 0;
+		bool halted = _lockstep_step(&g_fast) < 0;
+		struct cpu_registers fast = cpu_register_get();
+		unsigned long fast_frame = gpu_get_frame_count();
+
+		context_set_current(g_reference.context);
+		g_reference.log->count = 0;
+		g_reference.trace_count = 0;
+		while (g_reference.cycles < g_fast.cycles)
+			if (_lockstep_step(&g_reference) < 0)
+				break;
+		struct cpu_registers reference = cpu_register_get();
+
+		steps++;
+		fused += g_reference.trace_count > 1;
+
+		if (g_fast.cycles != g_reference.cycles) {
+			printf("cycles: fast %lu, reference %lu\n",
+					g_fast.cycles, g_reference.cycles);
+			diverged = true;
+		}
+		if (memcmp(&fast, &reference, sizeof(fast)) != 0)
+			diverged = true;
+		if (!_lockstep_compare_writes())
+			diverged = true;
+		if (!diverged && fast_frame != frame) {
+			frame = fast_frame;
+			diverged = !_lockstep_compare_state();
+		}
+
+		if (diverged) {
+			printf("Divergence at step %lu, frame %lu, reference instruction %lu\n",
+					steps, frame, g_reference.instructions);
+			_lockstep_print_trace(&g_fast);
+			_lockstep_print_trace(&g_reference);
+			_lockstep_print_registers(fast, reference);
+		} else if (halted) {
+			printf("CPU stopped at step %lu on both sides\n", steps);
+			break;
+		}
+	}
+
+	if (!diverged)
+		printf("No divergence in %lu frames: %lu steps, %lu of them fused "
+				"handlers or native loops, %lu reference instructions\n",
+				frame, steps, fused, g_reference.instructions);
+
+	logger_destroy();
+	return diverged ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Reference consumer of the shared memory frame export (gbc -m <name>).
+ *
+ * Waits for frames on the futex, checksums each one in place and reports the
+ * time from publication to the consumer seeing the frame, plus frames missed
+ * because the ring wrapped or a slot was overwritten while being read.
+ * Usage: shm_latency [name] [frames]
+ */
+#include<fcntl.h>
+#include<limits.h>
+#include<linux/futex.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<sys/syscall.h>
+#include<time.h>
+#include<unistd.h>
+#include"display_shm.h"
+
+static uint64_t _shm_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void _shm_wait(_Atomic uint32_t *word, uint32_t seen)
+{
+	syscall(SYS_futex, word, FUTEX_WAIT, seen, NULL, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *name = argc > 1 ? argv[1] : "/gbc";
+	long limit = argc > 2 ? atol(argv[2]) : 0;
+
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0) {
+		perror("shm_open");
+		return 1;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct display_shm_header)) {
+		fprintf(stderr, "%s: not a frame export\n", name);
+		return 1;
+	}
+
+	const u8 *mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	struct display_shm_header *header = (struct display_shm_header *)mem;
+	if (header->magic != DISPLAY_SHM_MAGIC
+			|| header->version != DISPLAY_SHM_VERSION) {
+		fprintf(stderr, "%s: unknown format\n", name);
+		return 1;
+	}
+
+	printf("%s: %ux%u, %u slots\n", name, header->width, header->height,
+			header->slots);
+
+	long frames = 0, missed = 0, torn = 0;
+	uint64_t latency_sum = 0, latency_max = 0;
+	uint32_t seen = atomic_load(&header->frames);
+	uint32_t checksum = 0;
+
+	while (!atomic_load(&header->closed) && (limit == 0 || frames < limit)) {
+		_shm_wait(&header->frames, seen);
+		uint32_t latest = atomic_load_explicit(&header->frames,
+				memory_order_acquire);
+		if (latest == seen || atomic_load(&header->closed))
+			continue;
+
+		missed += latest - seen - 1;
+		seen = latest;
+
+		const struct display_shm_slot *slot = (const struct display_shm_slot *)
+			(mem + sizeof(*header)
+			 + ((latest - 1) % header->slots) * header->slot_size);
+
+		uint64_t sequence = atomic_load_explicit(&slot->sequence,
+				memory_order_acquire);
+		if (sequence != 2ULL * latest) {
+			torn++;
+			continue;
+		}
+
+		uint64_t latency = _shm_now() - slot->timestamp;
+
+		// Stand-in for an encoder working on the pixels in place
+		for (uint32_t i = 0; i < header->stride * header->height; i++)
+			checksum = checksum * 31 + slot->pixels[i];
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_explicit(&slot->sequence, memory_order_relaxed)
+				!= sequence) {
+			torn++;
+			continue;
+		}
+
+		frames++;
+		latency_sum += latency;
+		if (latency > latency_max)
+			latency_max = latency;
+	}
+
+	printf("%ld frames, %ld missed, %ld torn, latency %.3f ms average, "
+			"%.3f ms max (checksum %08x)\n",
+			frames, missed, torn,
+			frames ? latency_sum / 1e6 / frames : 0.0,
+			latency_max / 1e6, checksum);
+
+	return 0;
+}
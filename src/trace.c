@@ -0,0 +1,250 @@
+#include<pthread.h>
+#include<stdarg.h>
+#include<stdio.h>
+#include<stdlib.h>
+#include"logger.h"
+#include"trace.h"
+
+#ifdef TRACE
+
+#define TRACE_BUFFER_SIZE (1 << 20)
+// Longer than any single event
+#define TRACE_EVENT_MAX   512
+
+_Atomic bool     g_trace_active;
+_Atomic uint64_t g_trace_cycles;
+
+static const char *g_track_names[TRACE_TRACKS] = {
+	[TRACE_FRAME]     = "Frames",
+	[TRACE_PPU]       = "PPU mode",
+	[TRACE_SCANLINE]  = "Scanlines",
+	[TRACE_DMA]       = "DMA",
+	[TRACE_INTERRUPT] = "Interrupts",
+	[TRACE_DISPLAY]   = "Present",
+	[TRACE_INPUT]     = "Input",
+	[TRACE_WAIT]      = "wait_clock",
+};
+
+// STAT modes 0-3
+static const char *g_mode_names[4] = { "H-blank", "V-blank", "OAM scan", "Transfer" };
+
+static struct {
+	FILE            *file;
+	char            *buffer;
+	// Bytes written since the last flush
+	size_t           buffered;
+	pthread_mutex_t  mutex;
+	uint64_t         start_ns;
+	bool             first;
+	struct trace_mark frame;
+	struct trace_mark mode;
+	int              mode_number;
+	int              mode_ly;
+	// Waits summed up since the last idle counter
+	uint64_t         idle_start_ns;
+	uint64_t         idle_nsec;
+} g_trace = { .mutex = PTHREAD_MUTEX_INITIALIZER, .mode_number = -1 };
+
+
+static double _trace_us(uint64_t ns)
+{
+	return (ns - g_trace.start_ns) / 1000.0;
+}
+
+
+// Called with the mutex held
+static void _trace_flush(void)
+{
+	fflush(g_trace.file);
+	g_trace.buffered = 0;
+}
+
+
+// Appends an event, format holds the fields after the phase
+static void _trace_write(char phase, enum trace_track track, const char *name,
+		const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+static void _trace_write(char phase, enum trace_track track, const char *name,
+		const char *format, ...)
+{
+	va_list args;
+
+	pthread_mutex_lock(&g_trace.mutex);
+	if (g_trace.file != NULL) {
+		// Flushed before stdio would have to, in the middle of the event
+		if (g_trace.buffered > TRACE_BUFFER_SIZE - TRACE_EVENT_MAX)
+			_trace_flush();
+		int length = fprintf(g_trace.file,
+				"%s{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,",
+				g_trace.first ? "" : ",\n", name, phase, track + 1);
+		va_start(args, format);
+		length += vfprintf(g_trace.file, format, args);
+		va_end(args);
+		fputc('}', g_trace.file);
+		g_trace.buffered += length + 1;
+		g_trace.first = false;
+	}
+	pthread_mutex_unlock(&g_trace.mutex);
+}
+
+
+void trace_slice(enum trace_track track, const char *name,
+		struct trace_mark start, const char *arg, long value)
+{
+	if (start.ns == 0)
+		return;
+
+	uint64_t end = trace_now();
+	if (arg != NULL)
+		_trace_write('X', track, name,
+				"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cycle\":%llu,\"%s\":%ld}",
+				_trace_us(start.ns), (end - start.ns) / 1000.0,
+				(unsigned long long)start.cycle, arg, value);
+	else
+		_trace_write('X', track, name,
+				"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cycle\":%llu}",
+				_trace_us(start.ns), (end - start.ns) / 1000.0,
+				(unsigned long long)start.cycle);
+}
+
+
+void trace_instant(enum trace_track track, const char *name,
+		const char *arg, long value)
+{
+	struct trace_mark now = trace_begin();
+
+	if (arg != NULL)
+		_trace_write('i', track, name,
+				"\"s\":\"t\",\"ts\":%.3f,\"args\":{\"cycle\":%llu,\"%s\":%ld}",
+				_trace_us(now.ns), (unsigned long long)now.cycle, arg, value);
+	else
+		_trace_write('i', track, name,
+				"\"s\":\"t\",\"ts\":%.3f,\"args\":{\"cycle\":%llu}",
+				_trace_us(now.ns), (unsigned long long)now.cycle);
+}
+
+
+void trace_frame(unsigned long frame)
+{
+	trace_slice(TRACE_FRAME, "frame", g_trace.frame, "frame", frame);
+	g_trace.frame = trace_begin();
+
+	pthread_mutex_lock(&g_trace.mutex);
+	if (g_trace.file != NULL)
+		_trace_flush();
+	pthread_mutex_unlock(&g_trace.mutex);
+}
+
+
+void trace_ppu_mode(int mode, int ly)
+{
+	if (g_trace.mode_number >= 0)
+		trace_slice(TRACE_PPU, g_mode_names[g_trace.mode_number], g_trace.mode,
+				"ly", g_trace.mode_ly);
+	g_trace.mode_number = mode & 0x03;
+	g_trace.mode_ly = ly;
+	g_trace.mode = trace_begin();
+}
+
+
+void trace_wait(long nsec)
+{
+	uint64_t now = trace_now();
+
+	if (nsec >= TRACE_SLEEP_MIN_NS) {
+		struct trace_mark start = {
+			now - nsec,
+			atomic_load_explicit(&g_trace_cycles, memory_order_relaxed)
+		};
+		trace_slice(TRACE_WAIT, "wait", start, NULL, 0);
+	}
+
+	g_trace.idle_nsec += nsec;
+	uint64_t elapsed = now - g_trace.idle_start_ns;
+	if (elapsed >= TRACE_IDLE_PERIOD_NS) {
+		_trace_write('C', TRACE_WAIT, "idle",
+				"\"ts\":%.3f,\"args\":{\"percent\":%.1f}",
+				_trace_us(now), 100.0 * g_trace.idle_nsec / elapsed);
+		g_trace.idle_start_ns = now;
+		g_trace.idle_nsec = 0;
+	}
+}
+
+
+void trace_prepare(const char *path, const char *label)
+{
+	if (path == NULL)
+		return;
+
+	g_trace.file = fopen(path, "w");
+	if (g_trace.file == NULL) {
+		logger_print(LOG_WARN, "[TRACE] Couldn't open %s.\n", path);
+		return;
+	}
+	// Sized buffer, so that _trace_write knows when stdio would flush it
+	g_trace.buffer = malloc(TRACE_BUFFER_SIZE);
+	if (g_trace.buffer == NULL) {
+		logger_print(LOG_WARN, "[TRACE] Couldn't allocate the buffer.\n");
+		fclose(g_trace.file);
+		g_trace.file = NULL;
+		return;
+	}
+	setvbuf(g_trace.file, g_trace.buffer, _IOFBF, TRACE_BUFFER_SIZE);
+
+	// JSON array format, the closing bracket may be left out
+	fputs("[\n", g_trace.file);
+	g_trace.first = true;
+	g_trace.start_ns = trace_now();
+	g_trace.idle_start_ns = g_trace.start_ns;
+
+	char name[32];
+	snprintf(name, sizeof(name), "%s", label);
+	for (char *c = name; *c != '\0'; c++)
+		if (*c == '"' || *c == '\\' || *c < ' ')
+			*c = ' ';
+	_trace_write('M', 0, "process_name", "\"args\":{\"name\":\"gbc %s\"}", name);
+	for (int i = 0; i < TRACE_TRACKS; i++) {
+		_trace_write('M', i, "thread_name", "\"args\":{\"name\":\"%s\"}",
+				g_track_names[i]);
+		_trace_write('M', i, "thread_sort_index", "\"args\":{\"sort_index\":%d}", i);
+	}
+	pthread_mutex_lock(&g_trace.mutex);
+	_trace_flush();
+	pthread_mutex_unlock(&g_trace.mutex);
+
+	g_trace_active = true;
+	g_trace.frame = trace_begin();
+	logger_print(LOG_INFO, "[TRACE] Writing the timeline to %s.\n", path);
+}
+
+
+void trace_destroy(void)
+{
+	if (g_trace.file == NULL)
+		return;
+
+	g_trace_active = false;
+	pthread_mutex_lock(&g_trace.mutex);
+	fputs("\n]\n", g_trace.file);
+	fclose(g_trace.file);
+	g_trace.file = NULL;
+	pthread_mutex_unlock(&g_trace.mutex);
+	free(g_trace.buffer);
+	g_trace.buffer = NULL;
+}
+
+#else
+
+void trace_prepare(const char *path, const char *label __attribute__((unused)))
+{
+	if (path != NULL)
+		logger_print(LOG_WARN, "[TRACE] Built without TRACE, "
+				"see make gbc_trace.\n");
+}
+
+
+void trace_destroy(void)
+{
+}
+
+#endif // TRACE